@@ -98,6 +98,7 @@ constexpr absl::Duration kDeleteSessionOnDestructorTimeout = absl::Seconds(1);
 
 Client::Client()
     : id_(0),
+      use_persistent_connection_(false),
       server_launcher_(new ServerLauncher),
       timeout_(kDefaultTimeout),
       server_status_(SERVER_UNKNOWN),
@@ -652,8 +653,14 @@ bool Client::Call(const commands::Input &input, commands::Output *output) {
   input.SerializeToString(&request);
 
   // Call IPC
-  std::unique_ptr<IPCClientInterface> client(client_factory_->NewClient(
-      kServerAddress, server_launcher_->server_program()));
+  // The kept connection is reused unless the server has closed it.
+  std::unique_ptr<IPCClientInterface> client = std::move(ipc_client_);
+  if (client == nullptr || !client->Connected()) {
+    client = client_factory_->NewClient(kServerAddress,
+                                        server_launcher_->server_program());
+  }
+  const bool persistent = use_persistent_connection_ && client != nullptr &&
+                          client->EnablePersistentConnection();
 
   // set client protocol version.
   // When an error occurs inside Connected() function,
@@ -722,6 +729,9 @@ bool Client::Call(const commands::Input &input, commands::Output *output) {
   MOZC_VLOG(2) << "commands::Output: " << std::endl
                << MOZC_LOG_PROTOBUF(*output);
 
+  if (persistent) {
+    ipc_client_ = std::move(client);
+  }
   return true;
 }
 
@@ -821,6 +831,7 @@ bool Client::CheckVersionOrRestartServerInternal(const commands::Input &input,
 }
 
 void Client::Reset() {
+  ipc_client_.reset();
   server_status_ = SERVER_UNKNOWN;
   server_protocol_version_ = 0;
   server_process_id_ = 0;
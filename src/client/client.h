@@ -102,6 +102,14 @@ class Client : public ClientInterface {
 
   void SetIPCClientFactory(IPCClientFactoryInterface *client_factory) override {
     client_factory_ = client_factory;
+    ipc_client_.reset();
+  }
+
+  // Keeps the connection to the server open across calls if the server
+  // supports it, instead of connecting for each call. Disabled by default.
+  void set_use_persistent_connection(bool use) {
+    use_persistent_connection_ = use;
+    ipc_client_.reset();
   }
 
   // set ServerLauncher.
@@ -254,6 +262,9 @@ class Client : public ClientInterface {
 
   uint64_t id_;
   IPCClientFactoryInterface *client_factory_;
+  bool use_persistent_connection_;
+  // The persistent connection kept after the last successful call.
+  std::unique_ptr<IPCClientInterface> ipc_client_;
   std::unique_ptr<ServerLauncherInterface> server_launcher_;
   std::unique_ptr<config::Config> preferences_;
   std::unique_ptr<commands::Request> request_;
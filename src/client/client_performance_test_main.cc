@@ -64,6 +64,8 @@
 
 ABSL_FLAG(std::string, server_path, "", "specify server path");
 ABSL_FLAG(std::string, log_path, "", "specify log output file path");
+ABSL_FLAG(int32_t, num_round_trips, 1000,
+          "number of SendKey round trips to measure the IPC transport");
 
 namespace mozc {
 namespace {
@@ -367,6 +369,37 @@ class Conversion : public TestScenarioInterface {
   }
 };
 
+// Measures the round trips of SendKey in the direct mode, where the server
+// returns immediately, so that the IPC transport dominates the time.
+class SendKeyRoundTrip : public TestScenarioInterface {
+ public:
+  explicit SendKeyRoundTrip(bool persistent_connection)
+      : persistent_connection_(persistent_connection) {
+    client_.set_use_persistent_connection(persistent_connection);
+  }
+
+  Result Run() override {
+    Result result;
+    result.test_name = persistent_connection_
+                           ? "send_key_round_trip_persistent"
+                           : "send_key_round_trip_one_shot";
+    IMEOff();
+    commands::KeyEvent key;
+    key.set_key_code('a');
+    for (int i = 0; i < absl::GetFlag(FLAGS_num_round_trips); ++i) {
+      Stopwatch stopwatch;
+      stopwatch.Start();
+      client_.SendKey(key, &output_);
+      stopwatch.Stop();
+      result.operations_times.push_back(stopwatch.GetElapsed());
+    }
+    return result;
+  }
+
+ private:
+  const bool persistent_connection_;
+};
+
 void Run(std::ostream &os) {
   std::vector<std::unique_ptr<TestScenarioInterface>> tests;
   tests.push_back(std::make_unique<PreeditWithoutSuggestion>());
@@ -374,6 +407,8 @@ void Run(std::ostream &os) {
   tests.push_back(std::make_unique<Conversion>());
   tests.push_back(std::make_unique<PredictionWithOneChar>());
   tests.push_back(std::make_unique<PredictionWithTwoChars>());
+  tests.push_back(std::make_unique<SendKeyRoundTrip>(false));
+  tests.push_back(std::make_unique<SendKeyRoundTrip>(true));
 
   std::vector<Result> results;
   results.reserve(tests.size());
@@ -272,6 +272,36 @@ TEST_F(ClientTest, SendKey) {
   EXPECT_EQ(input.type(), commands::Input::SEND_KEY);
 }
 
+TEST_F(ClientTest, PersistentConnection) {
+  const int mock_id = 123;
+  client_factory_->SetPersistentConnection(true);
+  client_->set_use_persistent_connection(true);
+  EXPECT_TRUE(SetupConnection(mock_id));
+  const int num_clients = client_factory_->num_clients();
+
+  commands::KeyEvent key_event;
+  key_event.set_special_key(commands::KeyEvent::ENTER);
+  for (const bool consumed : {true, false, true}) {
+    commands::Output mock_output;
+    mock_output.set_id(mock_id);
+    mock_output.set_consumed(consumed);
+    SetMockOutput(mock_output);
+
+    commands::Output output;
+    EXPECT_TRUE(client_->SendKey(key_event, &output));
+    EXPECT_EQ(output.consumed(), consumed);
+  }
+  // Only the first call connects to the server.
+  EXPECT_EQ(client_factory_->num_clients(), num_clients + 1);
+
+  // A connection is made for each call without the option.
+  client_->set_use_persistent_connection(false);
+  commands::Output output;
+  EXPECT_TRUE(client_->SendKey(key_event, &output));
+  EXPECT_TRUE(client_->SendKey(key_event, &output));
+  EXPECT_EQ(client_factory_->num_clients(), num_clients + 3);
+}
+
 TEST_F(ClientTest, SendKeyWithContext) {
   const int mock_id = 123;
   EXPECT_TRUE(SetupConnection(mock_id));
@@ -31,6 +31,7 @@
 
 #include "composer/composer.h"
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <optional>
@@ -906,11 +907,22 @@ void Composer::GetSubTransliteration(
 void Composer::GetSubTransliterations(
     const size_t position, const size_t size,
     transliteration::Transliterations *transliterations) const {
+  // Several types share a transliterator (e.g. the HALF_ASCII variants), so
+  // the text is extracted once per transliterator.
+  std::array<std::optional<std::string>, Transliterators::NUM_OF_TRANSLITERATOR>
+      texts;
   std::string t13n;
   for (size_t i = 0; i < transliteration::NUM_T13N_TYPES; ++i) {
     const transliteration::TransliterationType t13n_type =
         transliteration::TransliterationTypeArray[i];
-    GetSubTransliteration(t13n_type, position, size, &t13n);
+    const Transliterators::Transliterator t12r = GetTransliterator(t13n_type);
+    std::optional<std::string> &text = texts[t12r];
+    if (!text.has_value()) {
+      text.emplace();
+      GetTransliteratedText(t12r, position, size, &*text);
+    }
+    t13n.clear();
+    Transliterate(t13n_type, *text, &t13n);
     transliterations->push_back(t13n);
   }
 }
@@ -0,0 +1,190 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark of the transliterations of long compositions.
+//
+//  - "type": types a romaji text key by key and gets the transliterations
+//    after every key, as the transliteration rewriter does for each request.
+//  - "transliterations": gets the transliterations of an unchanged
+//    composition repeatedly.
+//  - "edit": inserts and deletes a character in the middle of the
+//    composition, getting the transliterations after each edit.
+//
+// Each of them is measured for several composition lengths and reports the
+// heap allocations per operation as well.
+//
+// Usage:
+//   composer_benchmark --iterations=1000
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/stopwatch.h"
+#include "composer/composer.h"
+#include "composer/table.h"
+#include "protocol/commands.pb.h"
+#include "protocol/config.pb.h"
+#include "testing/allocation_counter.h"
+#include "testing/benchmark_result.h"
+#include "transliteration/transliteration.h"
+
+ABSL_FLAG(int32_t, iterations, 1000, "Number of iterations for each length.");
+ABSL_FLAG(std::string, table, "system://romanji-hiragana.tsv",
+          "preedit conversion table file.");
+
+namespace mozc {
+namespace composer {
+namespace {
+
+using ::mozc::commands::Request;
+using ::mozc::config::Config;
+
+// Lengths of the compositions in characters.
+constexpr size_t kLengths[] = {16, 64, 200};
+
+constexpr absl::string_view kText =
+    "kyouhatenkigayoinodekoueniitteomoshiroihonwoyomimashita";
+
+Composer MakeComposer(const Table &table, size_t length) {
+  Composer composer(&table, &Request::default_instance(),
+                    &Config::default_instance());
+  composer.set_max_length(length + 1);
+  return composer;
+}
+
+// Returns the keys which compose a text of |length| characters.
+std::vector<std::string> MakeKeys(const Table &table, size_t length) {
+  Composer composer = MakeComposer(table, length);
+  std::vector<std::string> keys;
+  for (size_t i = 0; composer.GetLength() < length; ++i) {
+    std::string key(1, kText[i % kText.size()]);
+    keys.push_back(key);
+    composer.InsertCharacter(std::move(key));
+  }
+  return keys;
+}
+
+void RunType(const Table &table, size_t length) {
+  const std::vector<std::string> keys = MakeKeys(table, length);
+  const int iterations = absl::GetFlag(FLAGS_iterations);
+  transliteration::Transliterations t13ns;
+  size_t total = 0;
+  Stopwatch stopwatch;
+  testing::AllocationCounter counter;
+  for (int i = 0; i < iterations; ++i) {
+    Composer composer = MakeComposer(table, length);
+    stopwatch.Start();
+    for (const std::string &key : keys) {
+      composer.InsertCharacter(key);
+      t13ns.clear();
+      composer.GetTransliterations(&t13ns);
+      total += t13ns.front().size();
+    }
+    stopwatch.Stop();
+  }
+  testing::PrintBenchmarkResult(
+      absl::StrCat("type/len=", length), stopwatch.GetElapsed(),
+      static_cast<int64_t>(iterations) * keys.size(), counter.allocations());
+  VLOG(1) << total;
+}
+
+void RunTransliterations(const Table &table, size_t length) {
+  Composer composer = MakeComposer(table, length);
+  for (const std::string &key : MakeKeys(table, length)) {
+    composer.InsertCharacter(key);
+  }
+  const int iterations = absl::GetFlag(FLAGS_iterations);
+  transliteration::Transliterations t13ns;
+  size_t total = 0;
+  testing::AllocationCounter counter;
+  const Stopwatch stopwatch = Stopwatch::StartNew();
+  for (int i = 0; i < iterations; ++i) {
+    t13ns.clear();
+    composer.GetTransliterations(&t13ns);
+    total += t13ns.front().size();
+  }
+  testing::PrintBenchmarkResult(absl::StrCat("transliterations/len=", length),
+                                stopwatch.GetElapsed(), iterations,
+                                counter.allocations());
+  VLOG(1) << total;
+}
+
+void RunEdit(const Table &table, size_t length) {
+  Composer composer = MakeComposer(table, length);
+  for (const std::string &key : MakeKeys(table, length)) {
+    composer.InsertCharacter(key);
+  }
+  composer.MoveCursorTo(length / 2);
+  const int iterations = absl::GetFlag(FLAGS_iterations);
+  transliteration::Transliterations t13ns;
+  size_t total = 0;
+  testing::AllocationCounter counter;
+  const Stopwatch stopwatch = Stopwatch::StartNew();
+  for (int i = 0; i < iterations; ++i) {
+    composer.InsertCharacter("a");
+    t13ns.clear();
+    composer.GetTransliterations(&t13ns);
+    total += t13ns.front().size();
+    composer.Backspace();
+    t13ns.clear();
+    composer.GetTransliterations(&t13ns);
+    total += t13ns.front().size();
+  }
+  testing::PrintBenchmarkResult(
+      absl::StrCat("edit/len=", length), stopwatch.GetElapsed(),
+      2 * static_cast<int64_t>(iterations), counter.allocations());
+  VLOG(1) << total;
+}
+
+}  // namespace
+}  // namespace composer
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+
+  mozc::composer::Table table;
+  CHECK(table.LoadFromFile(absl::GetFlag(FLAGS_table).c_str()))
+      << "Failed to load " << absl::GetFlag(FLAGS_table);
+
+  for (const size_t length : mozc::composer::kLengths) {
+    mozc::composer::RunType(table, length);
+    mozc::composer::RunTransliterations(table, length);
+    mozc::composer::RunEdit(table, length);
+  }
+  return 0;
+}
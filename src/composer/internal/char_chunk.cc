@@ -29,6 +29,7 @@
 
 #include "composer/internal/char_chunk.h"
 
+#include <cstdint>
 #include <set>
 #include <string>
 #include <tuple>
@@ -114,7 +115,7 @@ CharChunk::CharChunk(Transliterators::Transliterator transliterator,
     : table_(table),
       transliterator_(transliterator),
       attributes_(NO_TABLE_ATTRIBUTE),
-      local_length_cache_(std::string::npos) {
+      cached_results_(0) {
   DCHECK_NE(Transliterators::LOCAL, transliterator);
 }
 
@@ -123,29 +124,16 @@ void CharChunk::Clear() {
   conversion_.clear();
   pending_.clear();
   ambiguous_.clear();
-  local_length_cache_ = std::string::npos;
+  InvalidateResults();
 }
 
 size_t CharChunk::GetLength(Transliterators::Transliterator t12r) const {
-  if (t12r == Transliterators::LOCAL &&
-      local_length_cache_ != std::string::npos) {
-    return local_length_cache_;
-  }
-  const std::string t13n = Transliterate(
-      t12r, DeleteSpecialKeys(raw_), DeleteSpecialKeys(conversion_ + pending_));
-  size_t length = Util::CharsLen(t13n);
-  if (t12r == Transliterators::LOCAL) {
-    local_length_cache_ = length;
-  }
-  return length;
+  return Util::CharsLen(GetResult(t12r));
 }
 
 void CharChunk::AppendResult(Transliterators::Transliterator t12r,
                              std::string *result) const {
-  const std::string t13n =
-      Transliterate(t12r, DeleteSpecialKeys(raw_),
-                    DeleteSpecialKeys(absl::StrCat(conversion_, pending_)));
-  result->append(t13n);
+  result->append(GetResult(t12r));
 }
 
 void CharChunk::AppendTrimedResult(Transliterators::Transliterator t12r,
@@ -166,21 +154,19 @@ void CharChunk::AppendTrimedResult(Transliterators::Transliterator t12r,
 
 void CharChunk::AppendFixedResult(Transliterators::Transliterator t12r,
                                   std::string *result) const {
-  std::string converted;
-  if (!ambiguous_.empty()) {
-    // Add the |ambiguous_| value as a fixed value.  |ambiguous_|
-    // contains an undetermined result string like "ん" converted
-    // from a single 'n'.
-    converted = absl::StrCat(conversion_, ambiguous_);
-  } else {
+  if (ambiguous_.empty()) {
     // If |pending_| exists but |ambiguous_| does not exist,
-    // |pending_| is appended.  If |ambiguous_| exists, the value of
-    // |pending_| is usually equal to |ambiguous_| so it is not
-    // appended.
-    converted = absl::StrCat(conversion_, pending_);
+    // |pending_| is appended, which is the same as AppendResult().
+    result->append(GetResult(t12r));
+    return;
   }
-  result->append(Transliterate(t12r, DeleteSpecialKeys(raw_),
-                               DeleteSpecialKeys(converted)));
+  // Add the |ambiguous_| value as a fixed value.  |ambiguous_| contains an
+  // undetermined result string like "ん" converted from a single 'n'.  The
+  // value of |pending_| is usually equal to |ambiguous_| so it is not
+  // appended.
+  result->append(Transliterate(
+      t12r, DeleteSpecialKeys(raw_),
+      DeleteSpecialKeys(absl::StrCat(conversion_, ambiguous_))));
 }
 
 // If we have the rule (roman),
@@ -279,7 +265,7 @@ bool CharChunk::IsConvertible(Transliterators::Transliterator t12r,
 void CharChunk::Combine(const CharChunk &left_chunk) {
   conversion_ = left_chunk.conversion_ + conversion_;
   raw_ = left_chunk.raw_ + raw_;
-  local_length_cache_ = std::string::npos;
+  InvalidateResults();
   // TODO(komatsu): This is a hacky way.  We should look up the
   // conversion table with the new |raw_| value.
   if (left_chunk.ambiguous_.empty()) {
@@ -303,7 +289,7 @@ std::pair<bool, absl::string_view> CharChunk::AddInputInternal(
   bool fixed = false;
   std::string key = absl::StrCat(pending_, input);
   const Entry *entry = table_->LookUpPrefix(key, &used_key_length, &fixed);
-  local_length_cache_ = std::string::npos;
+  InvalidateResults();
 
   if (entry == nullptr) {
     if (used_key_length == 0) {
@@ -422,7 +408,7 @@ void CharChunk::AddInput(std::string *input) {
 }
 
 void CharChunk::AddInputAndConvertedChar(CompositionInput *input) {
-  local_length_cache_ = std::string::npos;
+  InvalidateResults();
 
   if (input->is_asis()) {
     if (raw_.empty() && pending_.empty() && conversion_.empty()) {
@@ -520,7 +506,7 @@ bool CharChunk::ShouldInsertNewChunk(const CompositionInput &input) const {
 }
 
 void CharChunk::AddCompositionInput(CompositionInput *input) {
-  local_length_cache_ = std::string::npos;
+  InvalidateResults();
   if (!input->conversion().empty()) {
     AddInputAndConvertedChar(input);
     return;
@@ -539,13 +525,13 @@ void CharChunk::SetTransliterator(
     // Just ignore.
     return;
   }
-  local_length_cache_ = std::string::npos;
+  InvalidateResults();
   transliterator_ = transliterator;
 }
 
 void CharChunk::set_attributes(TableAttributes attributes) {
   attributes_ = attributes;
-  local_length_cache_ = std::string::npos;
+  InvalidateResults();
 }
 
 absl::StatusOr<CharChunk> CharChunk::SplitChunk(
@@ -555,7 +541,7 @@ absl::StatusOr<CharChunk> CharChunk::SplitChunk(
         absl::StrCat("Invalid position: ", position));
   }
 
-  local_length_cache_ = std::string::npos;
+  InvalidateResults();
   std::string raw_lhs, raw_rhs, converted_lhs, converted_rhs;
   Transliterators::GetTransliterator(GetTransliterator(t12r))
       ->Split(position, DeleteSpecialKeys(raw_),
@@ -602,6 +588,21 @@ Transliterators::Transliterator CharChunk::GetTransliterator(
   return transliterator;
 }
 
+const std::string &CharChunk::GetResult(
+    Transliterators::Transliterator t12r) const {
+  const Transliterators::Transliterator resolved = GetTransliterator(t12r);
+  DCHECK_NE(Transliterators::LOCAL, resolved);
+  const uint8_t bit = 1 << resolved;
+  std::string &result = result_cache_[resolved];
+  if ((cached_results_ & bit) == 0) {
+    result = Transliterators::GetTransliterator(resolved)->Transliterate(
+        DeleteSpecialKeys(raw_),
+        DeleteSpecialKeys(absl::StrCat(conversion_, pending_)));
+    cached_results_ |= bit;
+  }
+  return result;
+}
+
 std::string CharChunk::Transliterate(
     Transliterators::Transliterator transliterator, const absl::string_view raw,
     const absl::string_view converted) const {
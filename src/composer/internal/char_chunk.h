@@ -30,6 +30,8 @@
 #ifndef MOZC_COMPOSER_INTERNAL_CHAR_CHUNK_H_
 #define MOZC_COMPOSER_INTERNAL_CHAR_CHUNK_H_
 
+#include <array>
+#include <cstdint>
 #include <set>
 #include <string>
 #include <tuple>
@@ -144,28 +146,28 @@ class CharChunk final {
   template <typename String>
   void set_raw(String &&raw) {
     strings::Assign(raw_, std::forward<String>(raw));
-    local_length_cache_ = std::string::npos;
+    InvalidateResults();
   }
 
   const std::string &conversion() const { return conversion_; }
   template <typename String>
   void set_conversion(String &&conversion) {
     strings::Assign(conversion_, std::forward<String>(conversion));
-    local_length_cache_ = std::string::npos;
+    InvalidateResults();
   }
 
   const std::string &pending() const { return pending_; }
   template <typename String>
   void set_pending(String &&pending) {
     strings::Assign(pending_, std::forward<String>(pending));
-    local_length_cache_ = std::string::npos;
+    InvalidateResults();
   }
 
   const std::string &ambiguous() const { return ambiguous_; }
   template <typename String>
   void set_ambiguous(String &&ambiguous) {
     strings::Assign(ambiguous_, std::forward<String>(ambiguous));
-    local_length_cache_ = std::string::npos;
+    InvalidateResults();
   }
 
   TableAttributes attributes() const { return attributes_; }
@@ -198,6 +200,13 @@ class CharChunk final {
  private:
   void AddInputAndConvertedChar(CompositionInput *composition_input);
 
+  // Returns the transliteration of raw_ and conversion_ + pending_ with
+  // |t12r|.  The result is cached per resolved transliterator until this
+  // chunk is modified, so repeated GetLength() and AppendResult() calls over
+  // an unchanged chunk do not run the transliterator again.
+  const std::string &GetResult(Transliterators::Transliterator t12r) const;
+  void InvalidateResults() { cached_results_ = 0; }
+
   const Table *table_;
 
   // There are four variables to represent a composing text:
@@ -230,7 +239,10 @@ class CharChunk final {
   std::string ambiguous_;
   Transliterators::Transliterator transliterator_;
   TableAttributes attributes_;
-  mutable size_t local_length_cache_;
+  // Bit i of cached_results_ is set when result_cache_[i] holds the result
+  // for the transliterator i.  LOCAL is always resolved before the lookup.
+  mutable uint8_t cached_results_;
+  mutable std::array<std::string, Transliterators::LOCAL> result_cache_;
 };
 
 }  // namespace composer
@@ -249,6 +249,54 @@ TEST(CharChunkTest, GetLength) {
   EXPECT_EQ(chunk3.GetLength(Transliterators::HALF_ASCII), 2);
 }
 
+TEST(CharChunkTest, CachedResultIsUpdatedOnModification) {
+  Table table;
+  table.AddRule("ka", "か", "");
+  table.AddRule("n", "ん", "");
+  table.AddRule("na", "な", "");
+
+  CharChunk chunk(Transliterators::CONVERSION_STRING, &table);
+  std::string input = "ka";
+  chunk.AddInput(&input);
+
+  std::string result;
+  chunk.AppendResult(Transliterators::HALF_ASCII, &result);
+  EXPECT_EQ(result, "ka");
+  EXPECT_EQ(chunk.GetLength(Transliterators::FULL_KATAKANA), 1);
+
+  chunk.set_raw("ga");
+  chunk.set_conversion("が");
+  result.clear();
+  chunk.AppendResult(Transliterators::HALF_ASCII, &result);
+  chunk.AppendResult(Transliterators::FULL_KATAKANA, &result);
+  EXPECT_EQ(result, "gaガ");
+
+  // LOCAL follows the local transliterator.
+  chunk.SetTransliterator(Transliterators::HALF_KATAKANA);
+  EXPECT_EQ(chunk.GetLength(Transliterators::LOCAL), 2);
+  chunk.SetTransliterator(Transliterators::HIRAGANA);
+  EXPECT_EQ(chunk.GetLength(Transliterators::LOCAL), 1);
+
+  chunk.Clear();
+  input = "n";
+  chunk.AddInput(&input);
+  result.clear();
+  chunk.AppendResult(Transliterators::CONVERSION_STRING, &result);
+  EXPECT_EQ(result, "n");
+  result.clear();
+  chunk.AppendFixedResult(Transliterators::CONVERSION_STRING, &result);
+  EXPECT_EQ(result, "ん");
+
+  // A copy keeps the cached results of the source and its own ones are
+  // invalidated independently.
+  CharChunk copy = chunk;
+  copy.set_pending("x");
+  result.clear();
+  chunk.AppendResult(Transliterators::CONVERSION_STRING, &result);
+  copy.AppendResult(Transliterators::CONVERSION_STRING, &result);
+  EXPECT_EQ(result, "nx");
+}
+
 TEST(CharChunkTest, AddCompositionInput) {
   Table table;
   table.AddRule("す゛", "ず", "");
@@ -30,6 +30,7 @@
 #include "composer/internal/composition.h"
 
 #include <iterator>
+#include <optional>
 #include <set>
 #include <string>
 #include <utility>
@@ -50,7 +51,10 @@
 namespace mozc {
 namespace composer {
 
-void Composition::Erase() { chunks_.clear(); }
+void Composition::Erase() {
+  InvalidateStringCache();
+  chunks_.clear();
+}
 
 size_t Composition::InsertAt(size_t pos, std::string input) {
   CompositionInput composition_input;
@@ -67,6 +71,7 @@ size_t Composition::InsertKeyAndPreeditAt(const size_t pos, std::string key,
 }
 
 size_t Composition::InsertInput(size_t pos, CompositionInput input) {
+  InvalidateStringCache();
   if (input.Empty()) {
     return pos;
   }
@@ -102,6 +107,7 @@ size_t Composition::InsertInput(size_t pos, CompositionInput input) {
 
 // Deletes a right-hand character of the composition at the position.
 size_t Composition::DeleteAt(const size_t position) {
+  InvalidateStringCache();
   const size_t original_size = GetLength();
   size_t new_position = position;
   // We have to perform deletion repeatedly because there might be 0-length
@@ -196,6 +202,7 @@ size_t Composition::SetDisplayMode(
 void Composition::SetTransliterator(
     const size_t position_from, const size_t position_to,
     Transliterators::Transliterator transliterator) {
+  InvalidateStringCache();
   if (position_from > position_to) {
     LOG(ERROR) << "position_from should not be greater than position_to.";
     return;
@@ -308,7 +315,12 @@ void Composition::GetString(std::string *composition) const {
 
 void Composition::GetStringWithTransliterator(
     Transliterators::Transliterator transliterator, std::string *output) const {
-  GetStringWithModes(transliterator, FIX, output);
+  std::optional<std::string> &cache = string_cache_[transliterator];
+  if (!cache.has_value()) {
+    cache.emplace();
+    GetStringWithModes(transliterator, FIX, &*cache);
+  }
+  *output = *cache;
 }
 
 void Composition::GetStringWithTrimMode(const TrimMode trim_mode,
@@ -325,12 +337,20 @@ void Composition::GetPreedit(size_t position, std::string *left,
   Util::Utf8SubString(composition, position + 1, std::string::npos, right);
 }
 
-// This function is essentially a const function, but it cannot be const because
-// it outputs a mutable CharChunkList::iterator.  Const version is provided
-// below.
 CharChunkList::iterator Composition::GetChunkAt(
     const size_t position, Transliterators::Transliterator transliterator,
     size_t *inner_position) {
+  // The caller may modify the returned chunk.
+  InvalidateStringCache();
+  const CharChunkList::const_iterator it =
+      std::as_const(*this).GetChunkAt(position, transliterator, inner_position);
+  // Converts the const_iterator to an iterator without modifying the list.
+  return chunks_.erase(it, it);
+}
+
+CharChunkList::const_iterator Composition::GetChunkAt(
+    const size_t position, Transliterators::Transliterator transliterator,
+    size_t *inner_position) const {
   if (chunks_.empty()) {
     *inner_position = 0;
     return chunks_.begin();
@@ -353,14 +373,6 @@ CharChunkList::iterator Composition::GetChunkAt(
   return it;
 }
 
-CharChunkList::const_iterator Composition::GetChunkAt(
-    size_t position, Transliterators::Transliterator transliterator,
-    size_t *inner_position) const {
-  // This const_cast is safe as GetChunkAt() above doesn't mutate any members.
-  return const_cast<Composition *>(this)->GetChunkAt(position, transliterator,
-                                                     inner_position);
-}
-
 size_t Composition::GetPosition(Transliterators::Transliterator transliterator,
                                 CharChunkList::const_iterator cur_it) const {
   size_t position = 0;
@@ -374,6 +386,7 @@ size_t Composition::GetPosition(Transliterators::Transliterator transliterator,
 // Return the iterator to the right side CharChunk at the `position`.
 // If the `position` is in the middle of a CharChunk, that CharChunk is split.
 CharChunkList::iterator Composition::MaybeSplitChunkAt(const size_t position) {
+  InvalidateStringCache();
   size_t inner_position;
   CharChunkList::iterator it =
       GetChunkAt(position, Transliterators::LOCAL, &inner_position);
@@ -396,6 +409,7 @@ CharChunkList::iterator Composition::MaybeSplitChunkAt(const size_t position) {
 
 void Composition::CombinePendingChunks(CharChunkList::iterator it,
                                        const CompositionInput &input) {
+  InvalidateStringCache();
   // If the input is asis, pending chunks are not related with this input.
   if (input.is_asis()) {
     return;
@@ -420,6 +434,7 @@ void Composition::CombinePendingChunks(CharChunkList::iterator it,
 // Insert a chunk to the prev of it.
 CharChunkList::iterator Composition::InsertChunk(
     CharChunkList::const_iterator it) {
+  InvalidateStringCache();
   return chunks_.insert(it, CharChunk(input_t12r_, table_));
 }
 
@@ -433,6 +448,7 @@ bool Composition::ShouldCommit() const {
 // Return charchunk to be inserted and iterator of the *next* char chunk.
 CharChunkList::iterator Composition::GetInsertionChunk(
     CharChunkList::iterator it) {
+  InvalidateStringCache();
   if (it == chunks_.begin()) {
     return InsertChunk(it);
   }
@@ -450,6 +466,12 @@ void Composition::SetInputMode(Transliterators::Transliterator transliterator) {
 
 void Composition::SetTable(const Table *table) { table_ = table; }
 
+void Composition::InvalidateStringCache() {
+  for (std::optional<std::string> &cache : string_cache_) {
+    cache.reset();
+  }
+}
+
 bool Composition::IsToggleable(size_t position) const {
   size_t inner_position = 0;
   const auto it = GetChunkAt(position, Transliterators::LOCAL, &inner_position);
@@ -30,7 +30,9 @@
 #ifndef MOZC_COMPOSER_INTERNAL_COMPOSITION_H_
 #define MOZC_COMPOSER_INTERNAL_COMPOSITION_H_
 
+#include <array>
 #include <list>
+#include <optional>
 #include <set>
 #include <string>
 #include <tuple>
@@ -124,6 +126,9 @@ class Composition final {
 
   size_t GetLength() const;
   void GetString(std::string *composition) const;
+  // The result is cached per transliterator until the chunks are modified.
+  // As the cache is filled by this const method, a composition must not be
+  // read from multiple threads at a time.
   void GetStringWithTransliterator(
       Transliterators::Transliterator transliterator,
       std::string *output) const;
@@ -219,9 +224,20 @@ class Composition final {
   void GetStringWithModes(Transliterators::Transliterator transliterator,
                           TrimMode trim_mode, std::string *composition) const;
 
+  // Called by every method which may modify the chunks.  Chunks modified
+  // through an iterator obtained before a later GetStringWithTransliterator()
+  // call are not tracked, so modify chunks only right after obtaining them.
+  void InvalidateStringCache();
+
   const Table *table_;
   CharChunkList chunks_;
   Transliterators::Transliterator input_t12r_;
+  // Results of GetStringWithTransliterator() indexed by the transliterator.
+  // Each chunk caches its own transliterations as well, so refilling an entry
+  // after a keystroke only transliterates the modified chunks.
+  mutable std::array<std::optional<std::string>,
+                     Transliterators::NUM_OF_TRANSLITERATOR>
+      string_cache_;
 };
 
 }  // namespace composer
@@ -1734,6 +1734,53 @@ TEST_F(CompositionTest, Copy) {
   EXPECT_EQ(copy2, src);
 }
 
+TEST_F(CompositionTest, CachedStringIsUpdatedOnModification) {
+  table_.AddRule("ka", "か", "");
+  table_.AddRule("ki", "き", "");
+  table_.AddRule("n", "ん", "");
+  table_.AddRule("na", "な", "");
+
+  size_t pos = 0;
+  pos = composition_.InsertAt(pos, "k");
+  pos = composition_.InsertAt(pos, "a");
+  EXPECT_EQ(GetRawString(composition_), "ka");
+
+  pos = composition_.InsertAt(pos, "n");
+  EXPECT_EQ(GetRawString(composition_), "kan");
+  std::string output;
+  composition_.GetStringWithTransliterator(Transliterators::FULL_KATAKANA,
+                                           &output);
+  EXPECT_EQ(output, "カン");
+
+  pos = composition_.InsertAt(pos, "a");
+  EXPECT_EQ(GetRawString(composition_), "kana");
+  composition_.GetStringWithTransliterator(Transliterators::FULL_KATAKANA,
+                                           &output);
+  EXPECT_EQ(output, "カナ");
+
+  // Insertion in the middle.
+  composition_.InsertAt(1, "ki");
+  composition_.GetStringWithTransliterator(Transliterators::HIRAGANA, &output);
+  EXPECT_EQ(output, "かきな");
+
+  composition_.DeleteAt(0);
+  composition_.GetStringWithTransliterator(Transliterators::HIRAGANA, &output);
+  EXPECT_EQ(output, "きな");
+
+  composition_.SetDisplayMode(0, Transliterators::HALF_ASCII);
+  composition_.GetStringWithTransliterator(Transliterators::LOCAL, &output);
+  EXPECT_EQ(output, "kina");
+
+  // A chunk modified through the iterator of GetChunkAt().
+  size_t inner_position = 0;
+  composition_.GetChunkAt(0, Transliterators::LOCAL, &inner_position)
+      ->set_raw("gi");
+  EXPECT_EQ(GetRawString(composition_), "gina");
+
+  composition_.Erase();
+  EXPECT_EQ(GetRawString(composition_), "");
+}
+
 TEST_F(CompositionTest, IsToggleable) {
   constexpr int kAttrs =
       TableAttribute::NEW_CHUNK | TableAttribute::NO_TRANSLITERATION;
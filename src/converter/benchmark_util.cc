@@ -0,0 +1,92 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "converter/benchmark_util.h"
+
+#include <memory>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+#include "converter/connector.h"
+#include "converter/immutable_converter.h"
+#include "converter/segmenter.h"
+#include "dictionary/dictionary_impl.h"
+#include "dictionary/pos_group.h"
+#include "dictionary/suffix_dictionary.h"
+#include "dictionary/system/system_dictionary.h"
+#include "dictionary/system/value_dictionary.h"
+#include "prediction/suggestion_filter.h"
+
+namespace mozc {
+
+using ::mozc::dictionary::DictionaryImpl;
+using ::mozc::dictionary::PosGroup;
+using ::mozc::dictionary::SuffixDictionary;
+using ::mozc::dictionary::SystemDictionary;
+using ::mozc::dictionary::ValueDictionary;
+
+ImmutableConverterResources::ImmutableConverterResources() {
+  pos_matcher_.Set(data_manager_.GetPosMatcherData());
+
+  const char *dictionary_data = nullptr;
+  int dictionary_size = 0;
+  data_manager_.GetSystemDictionaryData(&dictionary_data, &dictionary_size);
+  std::unique_ptr<SystemDictionary> sysdic =
+      SystemDictionary::Builder(dictionary_data, dictionary_size)
+          .Build()
+          .value();
+  auto value_dic =
+      std::make_unique<ValueDictionary>(pos_matcher_, &sysdic->value_trie());
+  dictionary_ = std::make_unique<DictionaryImpl>(
+      std::move(sysdic), std::move(value_dic), &user_dictionary_stub_,
+      &suppression_dictionary_, &pos_matcher_);
+
+  absl::string_view suffix_key_array_data, suffix_value_array_data;
+  const uint32_t *token_array;
+  data_manager_.GetSuffixDictionaryData(
+      &suffix_key_array_data, &suffix_value_array_data, &token_array);
+  suffix_dictionary_ = std::make_unique<SuffixDictionary>(
+      suffix_key_array_data, suffix_value_array_data, token_array);
+
+  connector_ = Connector::CreateFromDataManager(data_manager_).value();
+  segmenter_ = Segmenter::CreateFromDataManager(data_manager_);
+  pos_group_ = std::make_unique<PosGroup>(data_manager_.GetPosGroupData());
+  suggestion_filter_ =
+      SuggestionFilter::CreateOrDie(data_manager_.GetSuggestionFilterData());
+}
+
+std::unique_ptr<ImmutableConverterImpl>
+ImmutableConverterResources::CreateConverter(const Connector &connector) const {
+  return std::make_unique<ImmutableConverterImpl>(
+      dictionary_.get(), suffix_dictionary_.get(), &suppression_dictionary_,
+      connector, segmenter_.get(), &pos_matcher_, pos_group_.get(),
+      suggestion_filter_);
+}
+
+}  // namespace mozc
@@ -0,0 +1,89 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Utilities shared by the benchmarks in converter/.
+
+#ifndef MOZC_CONVERTER_BENCHMARK_UTIL_H_
+#define MOZC_CONVERTER_BENCHMARK_UTIL_H_
+
+#include <memory>
+
+#include "converter/connector.h"
+#include "converter/immutable_converter.h"
+#include "converter/segmenter.h"
+#include "data_manager/testing/mock_data_manager.h"
+#include "dictionary/dictionary_impl.h"
+#include "dictionary/pos_group.h"
+#include "dictionary/pos_matcher.h"
+#include "dictionary/suffix_dictionary.h"
+#include "dictionary/suppression_dictionary.h"
+#include "dictionary/user_dictionary_stub.h"
+#include "prediction/suggestion_filter.h"
+
+namespace mozc {
+
+// Resources to build ImmutableConverterImpl from the mock data. The connector
+// is passed separately so that benchmarks can compare connector variants.
+class ImmutableConverterResources {
+ public:
+  ImmutableConverterResources();
+  ImmutableConverterResources(const ImmutableConverterResources &) = delete;
+  ImmutableConverterResources &operator=(const ImmutableConverterResources &) =
+      delete;
+
+  const testing::MockDataManager &data_manager() const {
+    return data_manager_;
+  }
+  const Connector &connector() const { return connector_; }
+
+  // Creates a converter using `connector`, which must outlive the converter.
+  std::unique_ptr<ImmutableConverterImpl> CreateConverter(
+      const Connector &connector) const;
+
+  // Creates a converter using connector().
+  std::unique_ptr<ImmutableConverterImpl> CreateConverter() const {
+    return CreateConverter(connector_);
+  }
+
+ private:
+  testing::MockDataManager data_manager_;
+  dictionary::PosMatcher pos_matcher_;
+  dictionary::SuppressionDictionary suppression_dictionary_;
+  dictionary::UserDictionaryStub user_dictionary_stub_;
+  std::unique_ptr<dictionary::DictionaryImpl> dictionary_;
+  std::unique_ptr<dictionary::SuffixDictionary> suffix_dictionary_;
+  Connector connector_;
+  std::unique_ptr<const Segmenter> segmenter_;
+  std::unique_ptr<const dictionary::PosGroup> pos_group_;
+  SuggestionFilter suggestion_filter_;
+};
+
+}  // namespace mozc
+
+#endif  // MOZC_CONVERTER_BENCHMARK_UTIL_H_
@@ -0,0 +1,219 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark of the latency to commit a conversion.
+//
+// On commit, ConverterImpl::CompletePosIds() fills the POS ids of the top
+// candidates that have none (e.g. those from the predictors and the
+// rewriters). This benchmark measures it in two ways, with and without the
+// constrained dictionary lookup (--resolve_pos_ids_by_lookup):
+//  - "resolve/*": resolving the POS ids of the top candidate of each segment
+//    of the test sentences with the immutable converter alone.
+//  - "commit/*": FinishConversion() of the engine built from the mock data,
+//    which also runs the Finish() of the rewriters and the predictors.
+//
+// Usage:
+//   commit_latency_benchmark --iterations=3
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "base/file/temp_dir.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/status.h"
+#include "base/stopwatch.h"
+#include "base/system_util.h"
+#include "converter/benchmark_util.h"
+#include "converter/converter_interface.h"
+#include "converter/immutable_converter.h"
+#include "converter/segments.h"
+#include "engine/engine_interface.h"
+#include "engine/mock_data_engine_factory.h"
+#include "request/conversion_request.h"
+#include "session/random_keyevents_generator.h"
+#include "testing/benchmark_result.h"
+
+ABSL_FLAG(int32_t, iterations, 3, "Number of times to commit all sentences.");
+ABSL_DECLARE_FLAG(bool, resolve_pos_ids_by_lookup);
+
+namespace mozc {
+namespace {
+
+// Converts the test sentences and returns the results, whose top candidates
+// have no POS ids as if they came from the predictors.
+std::vector<Segments> ConvertSentences(const ConverterInterface &converter,
+                                       absl::Span<const char *> sentences) {
+  std::vector<Segments> results;
+  for (const char *sentence : sentences) {
+    Segments segments;
+    if (!converter.StartConversion(&segments, sentence)) {
+      LOG(ERROR) << "Failed to convert: " << sentence;
+      continue;
+    }
+    for (size_t i = 0; i < segments.conversion_segments_size(); ++i) {
+      Segment *segment = segments.mutable_conversion_segment(i);
+      if (segment->candidates_size() == 0) {
+        continue;
+      }
+      segment->mutable_candidate(0)->lid = 0;
+      segment->mutable_candidate(0)->rid = 0;
+    }
+    results.push_back(std::move(segments));
+  }
+  return results;
+}
+
+// Same as the fallback of ConverterImpl::CompletePosIds().
+bool ResolveByPrediction(const ImmutableConverterImpl &immutable_converter,
+                         Segment::Candidate *candidate) {
+  ConversionRequest request;
+  request.set_request_type(ConversionRequest::PREDICTION);
+  for (const size_t size : {5, 55}) {
+    Segments segments;
+    segments.add_segment()->set_key(candidate->key);
+    request.set_max_conversion_candidates_size(size);
+    if (!immutable_converter.ConvertForRequest(request, &segments)) {
+      return false;
+    }
+    const Segment &segment = segments.conversion_segment(0);
+    for (size_t i = 0; i < segment.candidates_size(); ++i) {
+      if (segment.candidate(i).value == candidate->value) {
+        candidate->lid = segment.candidate(i).lid;
+        candidate->rid = segment.candidate(i).rid;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void RunResolve(const ImmutableConverterImpl &immutable_converter,
+                absl::Span<const Segments> committed) {
+  for (const bool by_lookup : {false, true}) {
+    int64_t candidates = 0;
+    int64_t resolved = 0;
+    absl::Duration elapsed;
+    for (int i = 0; i < absl::GetFlag(FLAGS_iterations); ++i) {
+      for (const Segments &segments : committed) {
+        for (size_t j = 0; j < segments.conversion_segments_size(); ++j) {
+          const Segment &segment = segments.conversion_segment(j);
+          if (segment.candidates_size() == 0) {
+            continue;
+          }
+          Segment::Candidate candidate;
+          candidate.key = segment.candidate(0).key;
+          candidate.value = segment.candidate(0).value;
+          const ConversionRequest request;
+          const Stopwatch stopwatch = Stopwatch::StartNew();
+          const bool result =
+              by_lookup
+                  ? immutable_converter.ResolvePosIds(request, &candidate)
+                  : ResolveByPrediction(immutable_converter, &candidate);
+          elapsed += stopwatch.GetElapsed();
+          ++candidates;
+          resolved += result ? 1 : 0;
+        }
+      }
+    }
+    testing::PrintBenchmarkResult(
+        by_lookup ? "resolve/lookup" : "resolve/prediction", elapsed,
+        candidates);
+    std::cout << absl::StrFormat("  resolved: %d / %d", resolved, candidates)
+              << std::endl;
+  }
+}
+
+void RunCommit(absl::Span<const char *> sentences) {
+  for (const bool by_lookup : {false, true}) {
+    absl::SetFlag(&FLAGS_resolve_pos_ids_by_lookup, by_lookup);
+    // Uses a fresh engine so that both modes start from the same history.
+    const std::unique_ptr<EngineInterface> engine =
+        MockDataEngineFactory::Create().value();
+    const ConverterInterface *converter = engine->GetConverter();
+    const std::vector<Segments> committed =
+        ConvertSentences(*converter, sentences);
+
+    int64_t commits = 0;
+    absl::Duration elapsed;
+    const ConversionRequest request;
+    for (int i = 0; i < absl::GetFlag(FLAGS_iterations); ++i) {
+      for (const Segments &prepared : committed) {
+        Segments segments = prepared;
+        const Stopwatch stopwatch = Stopwatch::StartNew();
+        converter->FinishConversion(request, &segments);
+        elapsed += stopwatch.GetElapsed();
+        ++commits;
+      }
+    }
+    testing::PrintBenchmarkResult(
+        by_lookup ? "commit/lookup" : "commit/prediction", elapsed, commits);
+  }
+}
+
+void Run() {
+  // Keeps the user history of the rewriters away from the real one.
+  absl::StatusOr<TempDirectory> temp_dir =
+      TempDirectory::Default().CreateTempDirectory();
+  CHECK_OK(temp_dir);
+  SystemUtil::SetUserProfileDirectory(temp_dir->path());
+
+  const absl::Span<const char *> sentences =
+      session::RandomKeyEventsGenerator::GetTestSentences();
+  {
+    const std::unique_ptr<EngineInterface> engine =
+        MockDataEngineFactory::Create().value();
+    const ImmutableConverterResources resources;
+    const std::unique_ptr<ImmutableConverterImpl> immutable_converter =
+        resources.CreateConverter();
+    RunResolve(*immutable_converter,
+               ConvertSentences(*engine->GetConverter(), sentences));
+  }
+  RunCommit(sentences);
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  mozc::Run();
+  return 0;
+}
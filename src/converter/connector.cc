@@ -29,16 +29,17 @@
 
 #include "converter/connector.h"
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <limits>
+#include <memory>
 #include <new>
 #include <optional>
 #include <string>
 #include <utility>
 #include <vector>
 
-#include "absl/algorithm/container.h"
 #include "absl/base/attributes.h"
 #include "absl/base/const_init.h"
 #include "absl/status/status.h"
@@ -58,6 +59,13 @@ constexpr uint32_t kInvalidCacheKey = 0xFFFFFFFF;
 constexpr uint16_t kConnectorMagicNumber = 0xCDAB;
 constexpr uint8_t kInvalid1ByteCostValue = 255;
 
+// States of a row of the dense table in DenseTableMode::LAZY.
+enum DenseRowState : uint8_t {
+  kDenseRowEmpty = 0,
+  kDenseRowFilling = 1,
+  kDenseRowReady = 2,
+};
+
 inline uint32_t GetHashValue(uint16_t rid, uint16_t lid, uint32_t hash_mask) {
   return (3 * static_cast<uint32_t>(rid) + lid) & hash_mask;
   // Note: The above value is equivalent to
@@ -71,6 +79,10 @@ inline uint32_t EncodeKey(uint16_t rid, uint16_t lid) {
   return (static_cast<uint32_t>(rid) << 16) | lid;
 }
 
+inline uint64_t EncodeCacheEntry(uint32_t key, int value) {
+  return (static_cast<uint64_t>(key) << 32) | static_cast<uint32_t>(value);
+}
+
 absl::Status IsMemoryAligned32(const void *ptr) {
   const auto addr = reinterpret_cast<std::uintptr_t>(ptr);
   const auto alignment = addr % 4;
@@ -186,6 +198,27 @@ absl::StatusOr<Connector> Connector::CreateFromDataManager(
   return Create(connection_data, connection_data_size, kCacheSize);
 }
 
+absl::StatusOr<Connector> Connector::CreateDenseFromDataManager(
+    const DataManagerInterface &data_manager, DenseTableMode mode) {
+  const char *connection_data = nullptr;
+  size_t connection_data_size = 0;
+  data_manager.GetConnectorData(&connection_data, &connection_data_size);
+  return CreateDense(connection_data, connection_data_size, mode);
+}
+
+absl::StatusOr<Connector> Connector::CreateDense(const char *connection_data,
+                                                 size_t connection_size,
+                                                 DenseTableMode mode) {
+  // The hash cache is not used by the dense table, so use the minimum size.
+  absl::StatusOr<Connector> connector =
+      Create(connection_data, connection_size, 1);
+  if (!connector.ok()) {
+    return connector;
+  }
+  connector->InitDenseTable(mode);
+  return connector;
+}
+
 absl::StatusOr<Connector> Connector::Create(const char *connection_data,
                                             size_t connection_size,
                                             int cache_size) {
@@ -206,8 +239,7 @@ absl::Status Connector::Init(const char *connection_data,
         "connector.cc: Cache size must be 2^n: size=", cache_size));
   }
   cache_hash_mask_ = cache_size - 1;
-  cache_key_.resize(cache_size);
-  cache_value_.resize(cache_size);
+  cache_ = std::make_unique<std::atomic<uint64_t>[]>(cache_size);
 
   absl::StatusOr<Metadata> metadata =
       ParseMetadata(connection_data, connection_size);
@@ -311,19 +343,84 @@ absl::Status Connector::Init(const char *connection_data,
 }
 
 
+void Connector::InitDenseTable(DenseTableMode mode) {
+  dense_row_size_ = rows_.size();
+  dense_costs_.assign(rows_.size() * dense_row_size_, kDenseOverflowCost);
+  if (mode == DenseTableMode::LAZY) {
+    dense_row_states_ =
+        std::make_unique<std::atomic<uint8_t>[]>(rows_.size());
+    for (size_t rid = 0; rid < rows_.size(); ++rid) {
+      dense_row_states_[rid].store(kDenseRowEmpty, std::memory_order_relaxed);
+    }
+    return;
+  }
+  for (size_t rid = 0; rid < rows_.size(); ++rid) {
+    FillDenseRow(static_cast<uint16_t>(rid));
+  }
+}
+
+void Connector::FillDenseRow(uint16_t rid) const {
+  uint16_t *row = &dense_costs_[rid * dense_row_size_];
+  for (size_t lid = 0; lid < dense_row_size_; ++lid) {
+    const int cost = LookupCost(rid, static_cast<uint16_t>(lid));
+    row[lid] = (cost >= 0 && cost < kDenseOverflowCost)
+                   ? static_cast<uint16_t>(cost)
+                   : kDenseOverflowCost;
+  }
+}
+
+int Connector::GetDenseTransitionCost(uint16_t rid, uint16_t lid) const {
+  if (dense_row_states_ != nullptr) {
+    // A row is filled by the first thread that touches it. Other threads
+    // decode the compressed row until it becomes ready, so lookups never
+    // block.
+    std::atomic<uint8_t> &state = dense_row_states_[rid];
+    uint8_t current = state.load(std::memory_order_acquire);
+    if (current != kDenseRowReady) {
+      if (current == kDenseRowEmpty &&
+          state.compare_exchange_strong(current, kDenseRowFilling,
+                                        std::memory_order_acquire)) {
+        FillDenseRow(rid);
+        state.store(kDenseRowReady, std::memory_order_release);
+      } else {
+        return LookupCost(rid, lid);
+      }
+    }
+  }
+  const uint16_t cost = dense_costs_[rid * dense_row_size_ + lid];
+  if (cost == kDenseOverflowCost) {
+    return LookupCost(rid, lid);
+  }
+  return cost;
+}
+
 int Connector::GetTransitionCost(uint16_t rid, uint16_t lid) const {
+  if (IsDense()) {
+    return GetDenseTransitionCost(rid, lid);
+  }
   const uint32_t index = EncodeKey(rid, lid);
   const uint32_t bucket = GetHashValue(rid, lid, cache_hash_mask_);
-  if (cache_key_[bucket] == index) {
-    return cache_value_[bucket];
+  // Relaxed ordering is enough as the entry is self-contained; the cache only
+  // has to be tear-free, not to be consistent across threads.
+  const uint64_t entry = cache_[bucket].load(std::memory_order_relaxed);
+  if (static_cast<uint32_t>(entry >> 32) == index) {
+    return static_cast<int32_t>(static_cast<uint32_t>(entry));
   }
   const int value = LookupCost(rid, lid);
-  cache_key_[bucket] = index;
-  cache_value_[bucket] = value;
+  cache_[bucket].store(EncodeCacheEntry(index, value),
+                       std::memory_order_relaxed);
   return value;
 }
 
-void Connector::ClearCache() { absl::c_fill(cache_key_, kInvalidCacheKey); }
+void Connector::ClearCache() {
+  if (cache_ == nullptr) {
+    return;
+  }
+  for (uint32_t i = 0; i <= cache_hash_mask_; ++i) {
+    cache_[i].store(EncodeCacheEntry(kInvalidCacheKey, 0),
+                    std::memory_order_relaxed);
+  }
+}
 
 int Connector::LookupCost(uint16_t rid, uint16_t lid) const {
   std::optional<uint16_t> value = rows_[rid].GetValue(lid);
@@ -30,8 +30,10 @@
 #ifndef MOZC_CONVERTER_CONNECTOR_H_
 #define MOZC_CONVERTER_CONNECTOR_H_
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -53,9 +55,32 @@ class Connector final {
                                           size_t connection_size,
                                           int cache_size);
 
+  // How the dense transition-cost table is populated.
+  enum class DenseTableMode {
+    // All rows are expanded when the connector is created.
+    EAGER,
+    // Each row is expanded on its first lookup.
+    LAZY,
+  };
+
+  // Creates a connector that expands the connection matrix into a flat
+  // rid x lid table of 16-bit costs, so that a transition cost is a single
+  // load instead of a decode of the compressed row. The table takes
+  // 2 * rsize * lsize bytes, which is a few tens of megabytes for the
+  // production data. The hash cache is not used in this mode.
+  static absl::StatusOr<Connector> CreateDenseFromDataManager(
+      const DataManagerInterface &data_manager, DenseTableMode mode);
+
+  static absl::StatusOr<Connector> CreateDense(const char *connection_data,
+                                               size_t connection_size,
+                                               DenseTableMode mode);
+
+  // Thread-safe. A connector can be shared by concurrent conversions.
   int GetTransitionCost(uint16_t rid, uint16_t lid) const;
   int GetResolution() const { return resolution_; }
 
+  bool IsDense() const { return !dense_costs_.empty(); }
+
   void ClearCache();
 
  private:
@@ -63,15 +88,32 @@ class Connector final {
 
   absl::Status Init(const char *connection_data, size_t connection_size,
                     int cache_size);
+  void InitDenseTable(DenseTableMode mode);
 
   int LookupCost(uint16_t rid, uint16_t lid) const;
+  int GetDenseTransitionCost(uint16_t rid, uint16_t lid) const;
+  void FillDenseRow(uint16_t rid) const;
 
   std::vector<Row> rows_;
   const uint16_t *default_cost_ = nullptr;
   int resolution_ = 0;
   uint32_t cache_hash_mask_ = 0;
-  mutable std::vector<uint32_t> cache_key_;
-  mutable std::vector<int> cache_value_;
+  // Each entry packs the key (rid << 16 | lid) in the upper 32 bits and the
+  // cost in the lower 32 bits. As an entry is read and written as a single
+  // atomic word, a reader never sees a key paired with another key's cost,
+  // and a connector can be shared by concurrent conversions without locks.
+  std::unique_ptr<std::atomic<uint64_t>[]> cache_;
+
+  // Dense table used by connectors created by CreateDense(). The row of rid
+  // starts at dense_costs_[rid * dense_row_size_]. Costs that don't fit in 16
+  // bits (invalid connections in 1-byte quantized data) are stored as
+  // kDenseOverflowCost and decoded from the compressed row.
+  static constexpr uint16_t kDenseOverflowCost = 0xFFFF;
+  size_t dense_row_size_ = 0;
+  mutable std::vector<uint16_t> dense_costs_;
+  // For DenseTableMode::LAZY, the state of each row (see connector.cc). Null
+  // when all rows are filled.
+  std::unique_ptr<std::atomic<uint8_t>[]> dense_row_states_;
 };
 
 class Connector::Row final {
@@ -0,0 +1,155 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark comparing the compact and the dense transition-cost tables of
+// Connector.
+//
+// Two workloads are measured for each connector:
+//  * Random lookups over the whole matrix.
+//  * Conversion of the test sentences with ImmutableConverterImpl, which is
+//    the access pattern of Viterbi.
+//
+// Usage:
+//   connector_benchmark --iterations=10
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/random/random.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/stopwatch.h"
+#include "converter/benchmark_util.h"
+#include "converter/connector.h"
+#include "converter/immutable_converter.h"
+#include "converter/segments.h"
+#include "request/conversion_request.h"
+#include "session/random_keyevents_generator.h"
+#include "testing/benchmark_result.h"
+
+ABSL_FLAG(int32_t, iterations, 10, "Number of iterations of each workload.");
+ABSL_FLAG(int32_t, random_lookups, 1000000,
+          "Number of lookups per iteration of the random workload.");
+
+namespace mozc {
+namespace {
+
+void RunRandomLookups(absl::string_view name, const Connector &connector,
+                      absl::Span<const std::pair<uint16_t, uint16_t>> pairs) {
+  int64_t checksum = 0;
+  const Stopwatch stopwatch = Stopwatch::StartNew();
+  for (int i = 0; i < absl::GetFlag(FLAGS_iterations); ++i) {
+    for (const auto &[rid, lid] : pairs) {
+      checksum += connector.GetTransitionCost(rid, lid);
+    }
+  }
+  testing::PrintBenchmarkResult(name, stopwatch.GetElapsed(),
+                                static_cast<int64_t>(pairs.size()) *
+                                    absl::GetFlag(FLAGS_iterations));
+  VLOG(1) << "checksum: " << checksum;
+}
+
+void RunConversions(absl::string_view name,
+                    const ImmutableConverterResources &res,
+                    const Connector &connector,
+                    absl::Span<const char *> sentences) {
+  std::unique_ptr<ImmutableConverterImpl> converter =
+      res.CreateConverter(connector);
+  const ConversionRequest request;
+  int64_t conversions = 0;
+  const Stopwatch stopwatch = Stopwatch::StartNew();
+  for (int i = 0; i < absl::GetFlag(FLAGS_iterations); ++i) {
+    for (const char *sentence : sentences) {
+      Segments segments;
+      segments.add_segment()->set_key(sentence);
+      if (!converter->ConvertForRequest(request, &segments)) {
+        LOG(ERROR) << "Failed to convert: " << sentence;
+      }
+      ++conversions;
+    }
+  }
+  testing::PrintBenchmarkResult(name, stopwatch.GetElapsed(), conversions);
+}
+
+void Run() {
+  const ImmutableConverterResources res;
+  const Connector &compact = res.connector();
+
+  Stopwatch stopwatch = Stopwatch::StartNew();
+  const Connector dense_eager =
+      Connector::CreateDenseFromDataManager(res.data_manager(),
+                                            Connector::DenseTableMode::EAGER)
+          .value();
+  std::cout << "Dense table construction: " << stopwatch.GetElapsed()
+            << std::endl;
+  const Connector dense_lazy =
+      Connector::CreateDenseFromDataManager(res.data_manager(),
+                                            Connector::DenseTableMode::LAZY)
+          .value();
+
+  // The connection data starts with uint16 magic, resolution, rsize and lsize.
+  const char *connection_data = nullptr;
+  size_t connection_size = 0;
+  res.data_manager().GetConnectorData(&connection_data, &connection_size);
+  const uint16_t matrix_size =
+      reinterpret_cast<const uint16_t *>(connection_data)[2];
+
+  absl::BitGen gen;
+  std::vector<std::pair<uint16_t, uint16_t>> pairs(
+      absl::GetFlag(FLAGS_random_lookups));
+  for (auto &[rid, lid] : pairs) {
+    rid = absl::Uniform<uint16_t>(gen, 0, matrix_size);
+    lid = absl::Uniform<uint16_t>(gen, 0, matrix_size);
+  }
+  RunRandomLookups("random/compact", compact, pairs);
+  RunRandomLookups("random/dense_eager", dense_eager, pairs);
+  RunRandomLookups("random/dense_lazy", dense_lazy, pairs);
+
+  const absl::Span<const char *> sentences =
+      session::RandomKeyEventsGenerator::GetTestSentences();
+  RunConversions("conversion/compact", res, compact, sentences);
+  RunConversions("conversion/dense_eager", res, dense_eager, sentences);
+  RunConversions("conversion/dense_lazy", res, dense_lazy, sentences);
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  mozc::Run();
+  return 0;
+}
@@ -38,6 +38,7 @@
 #include "absl/random/random.h"
 #include "base/logging.h"
 #include "base/mmap.h"
+#include "base/thread.h"
 #include "data_manager/connection_file_reader.h"
 #include "testing/gmock.h"
 #include "testing/gunit.h"
@@ -91,6 +92,89 @@ TEST(ConnectorTest, CompareWithRawData) {
   }
 }
 
+TEST(ConnectorTest, DenseTableIsIdenticalToCompact) {
+  const std::string path = testing::GetSourceFileOrDie(
+      {MOZC_SRC_COMPONENTS("data_manager"), "testing", "connection.data"});
+  absl::StatusOr<Mmap> cmmap = Mmap::Map(path);
+  ASSERT_OK(cmmap) << cmmap.status();
+  absl::StatusOr<Connector> compact =
+      Connector::Create(cmmap->begin(), cmmap->size(), 256);
+  ASSERT_OK(compact);
+  EXPECT_FALSE(compact->IsDense());
+
+  const std::string connection_text_path = testing::GetSourceFileOrDie(
+      {MOZC_DICT_DIR_COMPONENTS, "test", "dictionary",
+       "connection_single_column.txt"});
+  std::vector<ConnectionDataEntry> data;
+  for (ConnectionFileReader reader(connection_text_path); !reader.done();
+       reader.Next()) {
+    ConnectionDataEntry entry;
+    entry.rid = reader.rid_of_left_node();
+    entry.lid = reader.lid_of_right_node();
+    entry.cost = reader.cost();
+    data.push_back(entry);
+  }
+
+  for (const Connector::DenseTableMode mode :
+       {Connector::DenseTableMode::EAGER, Connector::DenseTableMode::LAZY}) {
+    absl::StatusOr<Connector> dense =
+        Connector::CreateDense(cmmap->begin(), cmmap->size(), mode);
+    ASSERT_OK(dense);
+    EXPECT_TRUE(dense->IsDense());
+    EXPECT_EQ(dense->GetResolution(), compact->GetResolution());
+
+    absl::BitGen urbg;
+    std::shuffle(data.begin(), data.end(), urbg);
+    for (const ConnectionDataEntry &entry : data) {
+      EXPECT_EQ(dense->GetTransitionCost(entry.rid, entry.lid), entry.cost);
+      EXPECT_EQ(dense->GetTransitionCost(entry.rid, entry.lid),
+                compact->GetTransitionCost(entry.rid, entry.lid));
+    }
+  }
+}
+
+TEST(ConnectorTest, ConcurrentLookups) {
+  const std::string path = testing::GetSourceFileOrDie(
+      {MOZC_SRC_COMPONENTS("data_manager"), "testing", "connection.data"});
+  absl::StatusOr<Mmap> cmmap = Mmap::Map(path);
+  ASSERT_OK(cmmap) << cmmap.status();
+  // A small cache to make threads overwrite each other's entries.
+  absl::StatusOr<Connector> connector =
+      Connector::Create(cmmap->begin(), cmmap->size(), 16);
+  ASSERT_OK(connector);
+
+  const std::string connection_text_path = testing::GetSourceFileOrDie(
+      {MOZC_DICT_DIR_COMPONENTS, "test", "dictionary",
+       "connection_single_column.txt"});
+  std::vector<ConnectionDataEntry> data;
+  for (ConnectionFileReader reader(connection_text_path); !reader.done();
+       reader.Next()) {
+    ConnectionDataEntry entry;
+    entry.rid = reader.rid_of_left_node();
+    entry.lid = reader.lid_of_right_node();
+    entry.cost = reader.cost();
+    data.push_back(entry);
+  }
+
+  constexpr int kNumThreads = 8;
+  std::vector<Thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    // Each thread looks up in its own random order.
+    std::vector<ConnectionDataEntry> shuffled = data;
+    absl::BitGen urbg;
+    std::shuffle(shuffled.begin(), shuffled.end(), urbg);
+    threads.emplace_back([&connector, shuffled = std::move(shuffled)] {
+      for (const ConnectionDataEntry &entry : shuffled) {
+        EXPECT_EQ(connector->GetTransitionCost(entry.rid, entry.lid),
+                  entry.cost);
+      }
+    });
+  }
+  for (Thread &thread : threads) {
+    thread.Join();
+  }
+}
+
 TEST(ConnectorTest, BrokenData) {
   const std::string path = testing::GetSourceFileOrDie(
       {MOZC_SRC_COMPONENTS("data_manager"), "testing", "connection.data"});
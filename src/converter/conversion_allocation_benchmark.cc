@@ -0,0 +1,130 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark of the heap allocations of a full conversion cycle.
+//
+// Each test sentence is converted with the engine built from the mock data,
+// which runs the immutable converter and all the rewriters, with the same
+// Segments as a session does. The heap allocations per conversion are
+// reported with and without retaining the segments and the candidates of the
+// Segments across conversions.
+//
+// Usage:
+//   conversion_allocation_benchmark --iterations=3
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+
+#include "absl/flags/flag.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "base/file/temp_dir.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/status.h"
+#include "base/stopwatch.h"
+#include "base/system_util.h"
+#include "converter/converter_interface.h"
+#include "converter/segments.h"
+#include "engine/engine_interface.h"
+#include "engine/mock_data_engine_factory.h"
+#include "session/random_keyevents_generator.h"
+#include "testing/allocation_counter.h"
+#include "testing/benchmark_result.h"
+
+ABSL_FLAG(int32_t, iterations, 3, "Number of times to convert all sentences.");
+
+namespace mozc {
+namespace {
+
+void RunConversions(absl::string_view name,
+                    const ConverterInterface &converter,
+                    absl::Span<const char *> sentences, bool retain_capacity) {
+  Segments segments;
+  segments.set_retain_capacity(retain_capacity);
+
+  int64_t conversions = 0;
+  int64_t candidates = 0;
+  absl::Duration elapsed;
+  testing::AllocationCounter counter;
+  for (int i = 0; i < absl::GetFlag(FLAGS_iterations); ++i) {
+    for (const char *sentence : sentences) {
+      const Stopwatch stopwatch = Stopwatch::StartNew();
+      if (!converter.StartConversion(&segments, sentence)) {
+        LOG(ERROR) << "Failed to convert: " << sentence;
+      }
+      elapsed += stopwatch.GetElapsed();
+      ++conversions;
+      for (size_t j = 0; j < segments.conversion_segments_size(); ++j) {
+        candidates += segments.conversion_segment(j).candidates_size();
+      }
+    }
+  }
+  const int64_t allocations = counter.allocations();
+
+  testing::PrintBenchmarkResult(name, elapsed, conversions);
+  std::cout << absl::StrFormat(
+                   "  allocations/conversion: %.1f  bytes/conversion: %.1f  "
+                   "candidates/conversion: %.1f",
+                   static_cast<double>(allocations) / conversions,
+                   static_cast<double>(counter.allocated_bytes()) /
+                       conversions,
+                   static_cast<double>(candidates) / conversions)
+            << std::endl;
+}
+
+void Run() {
+  // Keeps the user history of the rewriters away from the real one.
+  absl::StatusOr<TempDirectory> temp_dir =
+      TempDirectory::Default().CreateTempDirectory();
+  CHECK_OK(temp_dir);
+  SystemUtil::SetUserProfileDirectory(temp_dir->path());
+
+  const std::unique_ptr<EngineInterface> engine =
+      MockDataEngineFactory::Create().value();
+  const ConverterInterface *converter = engine->GetConverter();
+  const absl::Span<const char *> sentences =
+      session::RandomKeyEventsGenerator::GetTestSentences();
+  RunConversions("conversion/release_on_clear", *converter, sentences, false);
+  RunConversions("conversion/retain_capacity", *converter, sentences, true);
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  mozc::Run();
+  return 0;
+}
@@ -37,6 +37,7 @@
 #include <utility>
 #include <vector>
 
+#include "absl/flags/flag.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "base/japanese_util.h"
@@ -55,6 +56,11 @@
 #include "transliteration/transliteration.h"
 #include "usage_stats/usage_stats.h"
 
+ABSL_FLAG(bool, resolve_pos_ids_by_lookup, true,
+          "Complete POS ids of committed candidates by a dictionary lookup "
+          "constrained to the key and value before running the prediction "
+          "conversion.");
+
 namespace mozc {
 namespace {
 
@@ -870,6 +876,17 @@ void ConverterImpl::CompletePosIds(Segment::Candidate *candidate) const {
     return;
   }
 
+  // Most of the committed values are spelled out by dictionary words, for
+  // which the constrained lookup is much cheaper than the conversion below.
+  if (absl::GetFlag(FLAGS_resolve_pos_ids_by_lookup)) {
+    const ConversionRequest request;
+    if (immutable_converter_->ResolvePosIds(request, candidate)) {
+      VLOG(1) << "Set LID: " << candidate->lid;
+      VLOG(1) << "Set RID: " << candidate->rid;
+      return;
+    }
+  }
+
   // Use general noun,  unknown word ("サ変") tend to produce
   // "する" "して", which are not always acceptable for non-sahen words.
   candidate->lid = general_noun_id_;
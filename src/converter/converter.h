@@ -133,6 +133,7 @@ class ConverterImpl final : public ConverterInterface {
 
  private:
   FRIEND_TEST(ConverterTest, CompletePosIds);
+  FRIEND_TEST(ConverterTest, CompletePosIdsByLookupMatchesConversion);
   FRIEND_TEST(ConverterTest, DefaultPredictor);
   FRIEND_TEST(ConverterTest, MaybeSetConsumedKeySizeToSegment);
   FRIEND_TEST(ConverterTest, GetLastConnectivePart);
@@ -108,6 +108,7 @@
       'sources': [
         'immutable_converter.cc',
         'key_corrector.cc',
+        'viterbi_kernel.cc',
       ],
       'dependencies': [
         '<(mozc_oss_src_dir)/base/base.gyp:base',
@@ -28,6 +28,7 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
@@ -41,19 +42,24 @@
 #include "absl/flags/flag.h"
 #include "absl/log/check.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "base/file_stream.h"
 #include "base/file_util.h"
 #include "base/init_mozc.h"
 #include "base/logging.h"
+#include "base/mmap.h"
 #include "base/number_util.h"
 #include "base/protobuf/text_format.h"
 #include "base/singleton.h"
+#include "base/stopwatch.h"
 #include "base/system_util.h"
+#include "base/thread.h"
 #include "composer/composer.h"
 #include "composer/table.h"
 #include "config/config_handler.h"
@@ -67,6 +73,7 @@
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
 #include "request/conversion_request.h"
+#include "rewriter/rewriter_profiler.h"
 #include "session/request_test_util.h"
 
 #ifndef NDEBUG
@@ -98,6 +105,19 @@ ABSL_FLAG(std::string, decoder_experiment_params, "",
           "If nonempty, a DecoderExperimentParams is parsed from this text "
           "format and it is merged to the default value.");
 
+// Batch mode. If --batch_input is set, each line of the file is converted as a
+// reading, instead of reading commands from stdin.
+ABSL_FLAG(std::string, batch_input, "",
+          "Reading corpus to convert in batch mode, one reading per line.");
+ABSL_FLAG(std::string, batch_output, "",
+          "Output file of batch mode. The results are written to stdout if "
+          "empty.");
+ABSL_FLAG(int32_t, batch_threads, 1,
+          "Number of worker threads in batch mode. The results don't depend "
+          "on the number of threads.");
+ABSL_FLAG(bool, batch_predict, false,
+          "If true, batch mode also runs prediction for each reading.");
+
 namespace mozc {
 namespace {
 
@@ -376,6 +396,20 @@ bool ExecCommand(const ConverterInterface &converter, const std::string &line,
     config->set_history_learning_level(config::Config::NO_HISTORY);
   } else if (func == "enableuserhistory") {
     config->set_history_learning_level(config::Config::DEFAULT_HISTORY);
+  } else if (func == "rewriterprofile" || func == "rp") {
+    // rp [enable|disable|reset]
+    commands::RewriterProfileRequest profile_request;
+    if (fields.size() >= 2) {
+      commands::RewriterProfileRequest::Action action;
+      if (!commands::RewriterProfileRequest::Action_Parse(
+              absl::AsciiStrToUpper(fields[1]), &action)) {
+        return false;
+      }
+      profile_request.set_action(action);
+    }
+    commands::RewriterProfile profile;
+    RewriterProfiler::Get()->Execute(profile_request, &profile);
+    std::cout << FormatRewriterProfile(profile);
   } else {
     LOG(WARNING) << "Unknown command: " << func;
     return false;
@@ -423,6 +457,223 @@ std::string SelectIdDefFromName(const std::string &mozc_runfiles_dir,
   return "";
 }
 
+// Creates an engine of --engine_type over the data set |data|. The data set is
+// shared by all the engines, so it must outlive them.
+std::unique_ptr<EngineInterface> CreateEngine(const absl::string_view data) {
+  auto data_manager = std::make_unique<DataManager>();
+  const DataManager::Status status =
+      absl::GetFlag(FLAGS_magic).empty()
+          ? data_manager->InitFromArray(data)
+          : data_manager->InitFromArray(data, absl::GetFlag(FLAGS_magic));
+  CHECK_EQ(status, DataManager::Status::OK)
+      << DataManager::StatusCodeToString(status);
+  if (absl::GetFlag(FLAGS_engine_type) == "mobile") {
+    return Engine::CreateMobileEngine(std::move(data_manager)).value();
+  }
+  return Engine::CreateDesktopEngine(std::move(data_manager)).value();
+}
+
+// Result of a reading in batch mode.
+struct BatchResult {
+  bool converted = false;
+  // Top candidates of the conversion segments, separated by spaces.
+  std::string conversion;
+  // Top candidate of the prediction if --batch_predict.
+  std::string prediction;
+  absl::Duration convert_time;
+  absl::Duration predict_time;
+};
+
+std::string JoinTopCandidates(const Segments &segments) {
+  std::vector<absl::string_view> values;
+  for (size_t i = 0; i < segments.conversion_segments_size(); ++i) {
+    const Segment &segment = segments.conversion_segment(i);
+    if (segment.candidates_size() > 0) {
+      values.push_back(segment.candidate(0).value);
+    }
+  }
+  return absl::StrJoin(values, " ");
+}
+
+void ConvertReading(const ConverterInterface &converter,
+                    const absl::string_view reading,
+                    const commands::Request &request, config::Config *config,
+                    ConversionRequest *conversion_request, Segments *segments,
+                    BatchResult *result) {
+  composer::Composer composer(&composer::Table::GetDefaultTable(), &request,
+                              config);
+  composer.SetPreeditTextForTestOnly(reading);
+  conversion_request->set_composer(&composer);
+
+  // Nothing is committed, so each reading is converted independently of the
+  // others.
+  segments->Clear();
+  Stopwatch stopwatch = Stopwatch::StartNew();
+  result->converted =
+      converter.StartConversionForRequest(*conversion_request, segments);
+  result->convert_time = stopwatch.GetElapsed();
+  if (result->converted) {
+    result->conversion = JoinTopCandidates(*segments);
+  }
+
+  if (absl::GetFlag(FLAGS_batch_predict)) {
+    segments->Clear();
+    stopwatch.Reset();
+    stopwatch.Start();
+    const bool predicted =
+        converter.StartPredictionForRequest(*conversion_request, segments);
+    result->predict_time = stopwatch.GetElapsed();
+    if (predicted) {
+      result->prediction = JoinTopCandidates(*segments);
+    }
+  }
+  conversion_request->set_composer(nullptr);
+}
+
+// Prints the latency distribution of a stage.
+void PrintLatencies(const absl::string_view stage,
+                    std::vector<absl::Duration> latencies, std::ostream *os) {
+  if (latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  absl::Duration total;
+  for (const absl::Duration latency : latencies) {
+    total += latency;
+  }
+  // Nearest-rank percentile.
+  const auto percentile = [&latencies](int p) {
+    const size_t rank = (latencies.size() * p + 99) / 100;
+    return absl::ToDoubleMicroseconds(latencies[std::max<size_t>(rank, 1) - 1]);
+  };
+  (*os) << absl::StrFormat(
+      "%-10s total: %10.1f ms  mean: %8.1f us  p50: %8.1f us  p90: %8.1f us  "
+      "p99: %8.1f us  max: %8.1f us\n",
+      stage, absl::ToDoubleMilliseconds(total),
+      absl::ToDoubleMicroseconds(total / latencies.size()), percentile(50),
+      percentile(90), percentile(99), percentile(100));
+}
+
+// Converts the readings of --batch_input on --batch_threads threads, each of
+// which has its own engine over the shared data set |data|. The results are
+// written in the order of the input, and the statistics to stderr.
+void RunBatch(const absl::string_view data, const commands::Request &request,
+              const config::Config &config) {
+  Stopwatch stopwatch = Stopwatch::StartNew();
+  std::vector<std::string> readings;
+  {
+    InputFileStream ifs(absl::GetFlag(FLAGS_batch_input));
+    CHECK(ifs) << "Cannot open " << absl::GetFlag(FLAGS_batch_input);
+    std::string line;
+    while (std::getline(ifs, line)) {
+      absl::StripTrailingAsciiWhitespace(&line);
+      if (!line.empty()) {
+        readings.push_back(std::move(line));
+      }
+    }
+  }
+  const absl::Duration read_time = stopwatch.GetElapsed();
+
+  // Workers take chunks of readings in turn, so that slow readings don't
+  // leave the other workers idle. Each result is stored at the index of its
+  // reading, so the output doesn't depend on the scheduling.
+  constexpr size_t kChunkSize = 64;
+  const int32_t num_threads = std::max(absl::GetFlag(FLAGS_batch_threads), 1);
+  std::vector<BatchResult> results(readings.size());
+  std::atomic<size_t> next_reading = 0;
+  std::atomic<int64_t> setup_time_us = 0;
+  stopwatch.Reset();
+  stopwatch.Start();
+  std::vector<Thread> threads;
+  for (int32_t i = 0; i < num_threads; ++i) {
+    threads.emplace_back([&] {
+      const Stopwatch setup_stopwatch = Stopwatch::StartNew();
+      std::unique_ptr<EngineInterface> engine = CreateEngine(data);
+      // Waits for the user data, which could affect the results otherwise.
+      engine->ReloadAndWait();
+      setup_time_us += absl::ToInt64Microseconds(setup_stopwatch.GetElapsed());
+
+      const ConverterInterface *converter = engine->GetConverter();
+      commands::Request worker_request = request;
+      config::Config worker_config = config;
+      ConversionRequest conversion_request(nullptr, &worker_request,
+                                           &worker_config);
+      conversion_request.set_max_conversion_candidates_size(
+          absl::GetFlag(FLAGS_max_conversion_candidates_size));
+      conversion_request.set_create_partial_candidates(
+          worker_request.auto_partial_suggestion());
+      Segments segments;
+      for (size_t begin = next_reading.fetch_add(kChunkSize);
+           begin < readings.size(); begin = next_reading.fetch_add(kChunkSize)) {
+        const size_t end = std::min(begin + kChunkSize, readings.size());
+        for (size_t j = begin; j < end; ++j) {
+          ConvertReading(*converter, readings[j], worker_request,
+                         &worker_config, &conversion_request, &segments,
+                         &results[j]);
+        }
+      }
+    });
+  }
+  for (Thread &thread : threads) {
+    thread.Join();
+  }
+  const absl::Duration convert_time = stopwatch.GetElapsed();
+
+  stopwatch.Reset();
+  stopwatch.Start();
+  size_t num_failures = 0;
+  {
+    OutputFileStream ofs;
+    std::ostream *os = &std::cout;
+    if (!absl::GetFlag(FLAGS_batch_output).empty()) {
+      ofs.open(absl::GetFlag(FLAGS_batch_output));
+      CHECK(ofs) << "Cannot open " << absl::GetFlag(FLAGS_batch_output);
+      os = &ofs;
+    }
+    for (size_t i = 0; i < readings.size(); ++i) {
+      const BatchResult &result = results[i];
+      if (!result.converted) {
+        ++num_failures;
+      }
+      (*os) << readings[i] << "\t" << result.conversion;
+      if (absl::GetFlag(FLAGS_batch_predict)) {
+        (*os) << "\t" << result.prediction;
+      }
+      (*os) << "\n";
+    }
+    os->flush();
+  }
+  const absl::Duration write_time = stopwatch.GetElapsed();
+
+  std::vector<absl::Duration> convert_latencies, predict_latencies;
+  convert_latencies.reserve(results.size());
+  for (const BatchResult &result : results) {
+    convert_latencies.push_back(result.convert_time);
+    if (absl::GetFlag(FLAGS_batch_predict)) {
+      predict_latencies.push_back(result.predict_time);
+    }
+  }
+
+  std::ostream &os = std::cerr;
+  os << absl::StrFormat(
+      "readings: %d  failures: %d  threads: %d\n"
+      "read: %.1f ms  engine setup (sum over threads): %.1f ms  "
+      "conversion: %.1f ms  write: %.1f ms\n"
+      "throughput: %.1f readings/s\n",
+      readings.size(), num_failures, num_threads,
+      absl::ToDoubleMilliseconds(read_time), setup_time_us / 1000.0,
+      absl::ToDoubleMilliseconds(convert_time),
+      absl::ToDoubleMilliseconds(write_time),
+      readings.size() / absl::ToDoubleSeconds(convert_time));
+  PrintLatencies("convert", std::move(convert_latencies), &os);
+  PrintLatencies("predict", std::move(predict_latencies), &os);
+  if (RewriterProfiler::Get()->enabled()) {
+    commands::RewriterProfile profile;
+    RewriterProfiler::Get()->FillProfile(&profile);
+    os << FormatRewriterProfile(profile);
+  }
+}
+
 bool IsConsistentEngineNameAndType(const std::string &engine_name,
                                    const std::string &engine_type) {
   using NameAndTypeSet = std::set<std::pair<std::string, std::string>>;
@@ -472,26 +723,18 @@ int main(int argc, char **argv) {
             << "\nData file: " << absl::GetFlag(FLAGS_engine_data_path)
             << "\nid.def: " << absl::GetFlag(FLAGS_id_def) << std::endl;
 
-  absl::StatusOr<std::unique_ptr<mozc::DataManager>> data_manager =
-      absl::GetFlag(FLAGS_magic).empty()
-          ? mozc::DataManager::CreateFromFile(
-                absl::GetFlag(FLAGS_engine_data_path))
-          : mozc::DataManager::CreateFromFile(
-                absl::GetFlag(FLAGS_engine_data_path),
-                absl::GetFlag(FLAGS_magic));
-  CHECK_OK(data_manager);
+  // The data set is mapped once and shared by the engines of batch mode.
+  absl::StatusOr<mozc::Mmap> data =
+      mozc::Mmap::Map(absl::GetFlag(FLAGS_engine_data_path));
+  CHECK_OK(data);
+  const absl::string_view data_view(data->begin(), data->size());
 
   mozc::config::Config config = mozc::config::ConfigHandler::DefaultConfig();
   mozc::commands::Request request;
-  std::unique_ptr<mozc::EngineInterface> engine;
-  if (absl::GetFlag(FLAGS_engine_type) == "desktop") {
-    engine =
-        mozc::Engine::CreateDesktopEngine(*std::move(data_manager)).value();
-  } else if (absl::GetFlag(FLAGS_engine_type) == "mobile") {
-    engine = mozc::Engine::CreateMobileEngine(*std::move(data_manager)).value();
+  if (absl::GetFlag(FLAGS_engine_type) == "mobile") {
     mozc::commands::RequestForUnitTest::FillMobileRequest(&request);
     config.set_use_kana_modifier_insensitive_conversion(true);
-  } else {
+  } else if (absl::GetFlag(FLAGS_engine_type) != "desktop") {
     LOG(FATAL) << "Invalid type: --engine_type="
                << absl::GetFlag(FLAGS_engine_type);
     return 0;
@@ -507,14 +750,21 @@ int main(int argc, char **argv) {
               << MOZC_LOG_PROTOBUF(request.decoder_experiment_params());
   }
 
-  mozc::ConverterInterface *converter = engine->GetConverter();
-  CHECK(converter);
-
   if (!mozc::IsConsistentEngineNameAndType(absl::GetFlag(FLAGS_engine_name),
                                            absl::GetFlag(FLAGS_engine_type))) {
     LOG(WARNING) << "Engine name and type do not match.";
   }
 
+  if (!absl::GetFlag(FLAGS_batch_input).empty()) {
+    mozc::RunBatch(data_view, request, config);
+    return 0;
+  }
+
+  std::unique_ptr<mozc::EngineInterface> engine =
+      mozc::CreateEngine(data_view);
+  mozc::ConverterInterface *converter = engine->GetConverter();
+  CHECK(converter);
+
   mozc::Segments segments;
   std::string line;
 
@@ -535,5 +785,12 @@ int main(int argc, char **argv) {
       std::cout << "ExecCommand() return false" << std::endl;
     }
   }
+
+  // Dumps the statistics collected with --profile_rewriters.
+  if (mozc::RewriterProfiler::Get()->enabled()) {
+    mozc::commands::RewriterProfile profile;
+    mozc::RewriterProfiler::Get()->FillProfile(&profile);
+    std::cout << mozc::FormatRewriterProfile(profile);
+  }
   return 0;
 }
@@ -39,6 +39,8 @@
 #include <vector>
 
 #include "absl/container/flat_hash_set.h"
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
 #include "absl/strings/string_view.h"
 #include "base/logging.h"
 #include "base/util.h"
@@ -87,6 +89,8 @@
 #include "usage_stats/usage_stats.h"
 #include "usage_stats/usage_stats_testing_util.h"
 
+ABSL_DECLARE_FLAG(bool, resolve_pos_ids_by_lookup);
+
 namespace mozc {
 namespace {
 
@@ -965,6 +969,46 @@ TEST_F(ConverterTest, CompletePosIds) {
   }
 }
 
+TEST_F(ConverterTest, CompletePosIdsByLookupMatchesConversion) {
+  std::unique_ptr<ConverterAndData> converter_and_data =
+      CreateStubbedConverterAndData();
+  ConverterImpl *converter = converter_and_data->converter.get();
+  const bool original_resolve_pos_ids_by_lookup =
+      absl::GetFlag(FLAGS_resolve_pos_ids_by_lookup);
+
+  for (const absl::string_view key : {"きょうと", "いきます", "うつくしい"}) {
+    Segments segments;
+    Segment *seg = segments.add_segment();
+    seg->set_key(key);
+    seg->set_segment_type(Segment::FREE);
+    ConversionRequest request;
+    request.set_request_type(ConversionRequest::PREDICTION);
+    request.set_max_conversion_candidates_size(20);
+    ASSERT_TRUE(converter_and_data->immutable_converter->ConvertForRequest(
+        request, &segments));
+
+    auto complete_pos_ids = [&](bool resolve_pos_ids_by_lookup) {
+      absl::SetFlag(&FLAGS_resolve_pos_ids_by_lookup,
+                    resolve_pos_ids_by_lookup);
+      Segment::Candidate candidate;
+      candidate.key = segments.segment(0).candidate(0).key;
+      candidate.value = segments.segment(0).candidate(0).value;
+      converter->CompletePosIds(&candidate);
+      return candidate;
+    };
+    const Segment::Candidate expected = complete_pos_ids(false);
+    const Segment::Candidate actual = complete_pos_ids(true);
+    EXPECT_EQ(actual.lid, expected.lid) << key;
+    EXPECT_EQ(actual.rid, expected.rid) << key;
+    EXPECT_EQ(actual.cost, expected.cost) << key;
+    EXPECT_EQ(actual.wcost, expected.wcost) << key;
+    EXPECT_EQ(actual.structure_cost, expected.structure_cost) << key;
+  }
+
+  absl::SetFlag(&FLAGS_resolve_pos_ids_by_lookup,
+                original_resolve_pos_ids_by_lookup);
+}
+
 TEST_F(ConverterTest, Regression3046266) {
   // Shouldn't correct nodes at the beginning of a sentence.
   std::unique_ptr<EngineInterface> engine =
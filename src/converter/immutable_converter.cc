@@ -41,6 +41,7 @@
 #include <vector>
 
 #include "absl/algorithm/container.h"
+#include "absl/flags/flag.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
@@ -48,6 +49,7 @@
 #include "base/container/trie.h"
 #include "base/japanese_util.h"
 #include "base/logging.h"
+#include "base/strings/unicode.h"
 #include "base/util.h"
 #include "converter/connector.h"
 #include "converter/key_corrector.h"
@@ -58,6 +60,7 @@
 #include "converter/node_list_builder.h"
 #include "converter/segmenter.h"
 #include "converter/segments.h"
+#include "converter/viterbi_kernel.h"
 #include "dictionary/dictionary_interface.h"
 #include "dictionary/dictionary_token.h"
 #include "dictionary/pos_group.h"
@@ -68,6 +71,13 @@
 #include "protocol/config.pb.h"
 #include "request/conversion_request.h"
 
+ABSL_FLAG(bool, use_packed_viterbi, false,
+          "Run the best-predecessor search of Viterbi over packed end-node "
+          "arrays with the vectorized kernel.");
+ABSL_FLAG(bool, use_incremental_prediction_viterbi, false,
+          "Keep the lattice prefix shared with the previous key in prediction "
+          "and rerun Viterbi only from the first changed position.");
+
 namespace mozc {
 namespace {
 
@@ -279,6 +289,74 @@ Lattice *GetLattice(Segments *segments, bool is_prediction) {
   return lattice;
 }
 
+// Returns true if |node| is to be inserted at |pos| but is already in
+// |lattice|, i.e., it is not cached by lookup and ends before the position up
+// to which the nodes were retained by Lattice::ResetNodeCostAfterValidPos().
+bool IsRetainedNode(const Lattice &lattice, size_t pos, const Node &node) {
+  if (node.attributes & Node::ENABLE_CACHE) {
+    return false;
+  }
+  const size_t end_pos = std::min(pos + node.key.size(), lattice.key().size());
+  return end_pos < lattice.retained_end_pos();
+}
+
+// Removes the retained nodes from the list |nodes| to be inserted at |pos|.
+Node *DropRetainedNodes(const Lattice &lattice, size_t pos, Node *nodes) {
+  Node *head = nullptr;
+  Node *tail = nullptr;
+  for (Node *node = nodes; node != nullptr; node = node->bnext) {
+    if (IsRetainedNode(lattice, pos, *node)) {
+      continue;
+    }
+    if (tail == nullptr) {
+      head = node;
+    } else {
+      tail->bnext = node;
+    }
+    tail = node;
+  }
+  if (tail != nullptr) {
+    tail->bnext = nullptr;
+  }
+  return head;
+}
+
+// Returns true if the history nodes kept in |lattice| from the previous
+// conversion still match the history segments. Only the nodes ending before
+// the valid Viterbi position are checked as the others are rebuilt.
+bool HasSameHistoryNodes(const Segments &segments, const Lattice &lattice) {
+  const size_t valid_pos = lattice.viterbi_valid_pos();
+  size_t pos = 0;
+  for (size_t i = 0; i < segments.history_segments_size(); ++i) {
+    const Segment &segment = segments.segment(i);
+    if (pos + segment.key().size() >= valid_pos) {
+      break;
+    }
+    if (segment.candidates_size() == 0 || pos >= lattice.key().size()) {
+      return false;
+    }
+    const Segment::Candidate &candidate = segment.candidate(0);
+    bool found = false;
+    for (const Node *node = lattice.begin_nodes(pos); node != nullptr;
+         node = node->bnext) {
+      if (node->node_type != Node::HIS_NODE) {
+        continue;
+      }
+      if (node->key != segment.key() || node->value != candidate.value ||
+          node->lid != candidate.lid ||
+          (node->rid != candidate.rid && node->rid != 0)) {
+        return false;
+      }
+      found = true;
+    }
+    if (!found) {
+      return false;
+    }
+    pos += segment.key().size();
+  }
+  return true;
+}
+
 }  // namespace
 
 ImmutableConverterImpl::ImmutableConverterImpl(
@@ -753,25 +831,50 @@ Node *ImmutableConverterImpl::Lookup(const int begin_pos, const int end_pos,
                                &builder);
     result_node = builder.result();
   } else {
+    std::vector<Node *> results;
+    const size_t begin_positions[] = {static_cast<size_t>(begin_pos)};
+    LookupPrefixBatch(begin_positions, end_pos, request, is_prediction, lattice,
+                      &results);
+    result_node = results.front();
     if (is_prediction) {
-      NodeListBuilderWithCacheEnabled builder(
-          lattice->node_allocator(), lattice->cache_info(begin_pos) + 1,
-          GetSpatialCostParams(request));
-      dictionary_->LookupPrefix(absl::string_view(begin, len), request,
-                                &builder);
-      result_node = builder.result();
       lattice->SetCacheInfo(begin_pos, len);
+    }
+  }
+  return AddCharacterTypeBasedNodes(begin, end, lattice, result_node);
+}
+
+void ImmutableConverterImpl::LookupPrefixBatch(
+    absl::Span<const size_t> begin_positions, size_t end_pos,
+    const ConversionRequest &request, bool is_prediction, Lattice *lattice,
+    std::vector<Node *> *results) const {
+  const absl::string_view key =
+      absl::string_view(lattice->key()).substr(0, end_pos);
+  const SpatialCostParams spatial_cost_params = GetSpatialCostParams(request);
+  lattice->node_allocator()->set_max_nodes_size(8192);
+
+  std::vector<std::unique_ptr<BaseNodeListBuilder>> builders;
+  builders.reserve(begin_positions.size());
+  std::vector<DictionaryInterface::Callback *> callbacks;
+  callbacks.reserve(begin_positions.size());
+  for (const size_t begin_pos : begin_positions) {
+    if (is_prediction) {
+      builders.push_back(std::make_unique<NodeListBuilderWithCacheEnabled>(
+          lattice->node_allocator(), lattice->cache_info(begin_pos) + 1,
+          spatial_cost_params));
     } else {
       // When cache feature is not used, look up normally
-      BaseNodeListBuilder builder(lattice->node_allocator(),
-                                  lattice->node_allocator()->max_nodes_size(),
-                                  GetSpatialCostParams(request));
-      dictionary_->LookupPrefix(absl::string_view(begin, len), request,
-                                &builder);
-      result_node = builder.result();
+      builders.push_back(std::make_unique<BaseNodeListBuilder>(
+          lattice->node_allocator(),
+          lattice->node_allocator()->max_nodes_size(), spatial_cost_params));
     }
+    callbacks.push_back(builders.back().get());
+  }
+  dictionary_->LookupPrefixBatch(key, begin_positions, request, callbacks);
+
+  results->clear();
+  for (const std::unique_ptr<BaseNodeListBuilder> &builder : builders) {
+    results->push_back(builder->result());
   }
-  return AddCharacterTypeBasedNodes(begin, end, lattice, result_node);
 }
 
 Node *ImmutableConverterImpl::AddCharacterTypeBasedNodes(const char *begin,
@@ -967,6 +1070,62 @@ inline void ViterbiInternal(const Connector &connector, size_t pos,
     rnode->cost = best_cost + rnode->wcost;
   }
 }
+
+// Same as ViterbiInternal() but searches the best predecessor over the packed
+// end nodes with the vectorized kernel. The result is identical to
+// ViterbiInternal(). |transition_costs| is a scratch buffer.
+inline void PackedViterbiInternal(const Connector &connector, size_t pos,
+                                  size_t right_boundary, Lattice *lattice,
+                                  std::vector<int32_t> *transition_costs) {
+  static_assert(Lattice::PackedEndNodes::kUnreachableCost >= kVeryBigCost,
+                "Unreachable nodes must not be selected");
+  CachingConnector conn(connector);
+  const Lattice::PackedEndNodes &lnodes = lattice->PackEndNodes(pos);
+  transition_costs->resize(lnodes.size());
+  // Transition costs only depend on rnode->lid, so they are reused while
+  // consecutive rnodes share the same lid.
+  bool has_transition_costs = false;
+  uint16_t transition_costs_lid = 0;
+  for (Node *rnode = lattice->begin_nodes(pos); rnode != nullptr;
+       rnode = rnode->bnext) {
+    if (rnode->end_pos > right_boundary) {
+      // Invalid rnode.
+      rnode->prev = nullptr;
+      continue;
+    }
+
+    conn.ResetCacheIfNecessary(rnode->lid);
+
+    if (rnode->constrained_prev != nullptr) {
+      // Constrained node.
+      if (rnode->constrained_prev->prev == nullptr) {
+        rnode->prev = nullptr;
+      } else {
+        rnode->prev = rnode->constrained_prev;
+        rnode->cost = rnode->prev->cost + rnode->wcost +
+                      conn.GetTransitionCost(rnode->prev->rid, rnode->lid);
+      }
+      continue;
+    }
+
+    if (!has_transition_costs || transition_costs_lid != rnode->lid) {
+      for (size_t i = 0; i < lnodes.size(); ++i) {
+        (*transition_costs)[i] =
+            conn.GetTransitionCost(lnodes.rids[i], rnode->lid);
+      }
+      has_transition_costs = true;
+      transition_costs_lid = rnode->lid;
+    }
+
+    // Find a valid node which connects to the rnode with minimum cost.
+    int32_t best_cost = kVeryBigCost;
+    const int best_index = viterbi_kernel::FindBestPredecessor(
+        lnodes.costs.data(), transition_costs->data(), lnodes.size(),
+        kVeryBigCost, &best_cost);
+    rnode->prev = best_index < 0 ? nullptr : lnodes.nodes[best_index];
+    rnode->cost = best_cost + rnode->wcost;
+  }
+}
 }  // namespace
 
 bool ImmutableConverterImpl::Viterbi(const Segments &segments,
@@ -998,6 +1157,17 @@ bool ImmutableConverterImpl::Viterbi(const Segments &segments,
     }
   }
 
+  const bool use_packed_viterbi = absl::GetFlag(FLAGS_use_packed_viterbi);
+  std::vector<int32_t> transition_costs;
+  auto run_viterbi_at = [&](size_t pos, size_t right_boundary) {
+    if (use_packed_viterbi) {
+      PackedViterbiInternal(connector_, pos, right_boundary, lattice,
+                            &transition_costs);
+    } else {
+      ViterbiInternal(connector_, pos, right_boundary, lattice);
+    }
+  };
+
   size_t left_boundary = 0;
   const size_t segments_size = segments.segments_size();
 
@@ -1008,7 +1178,7 @@ bool ImmutableConverterImpl::Viterbi(const Segments &segments,
     const size_t right_boundary =
         left_boundary + segments.segment(0).key().size();
     for (size_t pos = left_boundary + 1; pos < right_boundary; ++pos) {
-      ViterbiInternal(connector_, pos, right_boundary, lattice);
+      run_viterbi_at(pos, right_boundary);
     }
     left_boundary = right_boundary;
   }
@@ -1019,7 +1189,7 @@ bool ImmutableConverterImpl::Viterbi(const Segments &segments,
     const size_t right_boundary =
         left_boundary + segments.segment(i).key().size();
     for (size_t pos = left_boundary; pos < right_boundary; ++pos) {
-      ViterbiInternal(connector_, pos, right_boundary, lattice);
+      run_viterbi_at(pos, right_boundary);
     }
     left_boundary = right_boundary;
   }
@@ -1092,6 +1262,9 @@ bool ImmutableConverterImpl::Viterbi(const Segments &segments,
 // runs Viterbi for positions between calc_begin_pos and calc_end_pos,
 // inclusive.
 //
+// The nodes ending before Lattice::viterbi_valid_pos() keep the results of
+// the previous run, so only the nodes ending at or after it are updated.
+//
 // We cannot apply this function in suggestion because in suggestion there are
 // WEAK_CONNECTED nodes and this function is not designed for them.
 //
@@ -1106,8 +1279,9 @@ bool ImmutableConverterImpl::PredictionViterbi(const Segments &segments,
   for (size_t i = 0; i < history_segments_size; ++i) {
     history_length += segments.segment(i).key().size();
   }
-  PredictionViterbiInternal(0, history_length, lattice);
-  PredictionViterbiInternal(history_length, key_length, lattice);
+  const size_t min_end_pos = lattice->viterbi_valid_pos();
+  PredictionViterbiInternal(0, history_length, min_end_pos, lattice);
+  PredictionViterbiInternal(history_length, key_length, min_end_pos, lattice);
 
   Node *node = lattice->eos_nodes();
   CHECK(node->bnext == nullptr);
@@ -1123,6 +1297,7 @@ bool ImmutableConverterImpl::PredictionViterbi(const Segments &segments,
     return false;
   }
 
+  lattice->set_viterbi_valid_pos(key_length + 1);
   return true;
 }
 
@@ -1147,8 +1322,16 @@ BestMap::iterator LowerBound(BestMap &best_map,
 
 void ImmutableConverterImpl::PredictionViterbiInternal(int calc_begin_pos,
                                                        int calc_end_pos,
+                                                       int min_end_pos,
                                                        Lattice *lattice) const {
   CHECK_LE(calc_begin_pos, calc_end_pos);
+  if (min_end_pos > calc_end_pos) {
+    return;
+  }
+  // Returns true if the cost of |rnode| is computed in this call.
+  auto is_target = [calc_end_pos, min_end_pos](const Node *rnode) {
+    return rnode->end_pos <= calc_end_pos && rnode->end_pos >= min_end_pos;
+  };
 
   BestMap lbest, rbest;
   lbest.reserve(128);
@@ -1157,6 +1340,18 @@ void ImmutableConverterImpl::PredictionViterbiInternal(int calc_begin_pos,
   const CostAndNode kInvalidValue(INT_MAX, nullptr);
 
   for (size_t pos = calc_begin_pos; pos <= calc_end_pos; ++pos) {
+    Node *rnode_begin = lattice->begin_nodes(pos);
+    if (pos < min_end_pos) {
+      // Skip the position unless some node starting here needs an update.
+      const Node *rnode = rnode_begin;
+      while (rnode != nullptr && !is_target(rnode)) {
+        rnode = rnode->bnext;
+      }
+      if (rnode == nullptr) {
+        continue;
+      }
+    }
+
     lbest.clear();
     for (Node *lnode = lattice->end_nodes(pos); lnode != nullptr;
          lnode = lnode->enext) {
@@ -1177,9 +1372,8 @@ void ImmutableConverterImpl::PredictionViterbiInternal(int calc_begin_pos,
     }
 
     rbest.clear();
-    Node *rnode_begin = lattice->begin_nodes(pos);
     for (Node *rnode = rnode_begin; rnode != nullptr; rnode = rnode->bnext) {
-      if (rnode->end_pos > calc_end_pos) {
+      if (!is_target(rnode)) {
         continue;
       }
       const BestMap::value_type key(rnode->lid, kInvalidValue);
@@ -1207,7 +1401,7 @@ void ImmutableConverterImpl::PredictionViterbiInternal(int calc_begin_pos,
     }
 
     for (Node *rnode = rnode_begin; rnode != nullptr; rnode = rnode->bnext) {
-      if (rnode->end_pos > calc_end_pos) {
+      if (!is_target(rnode)) {
         continue;
       }
       const BestMap::value_type key(rnode->lid, kInvalidValue);
@@ -1316,8 +1510,9 @@ void ImmutableConverterImpl::MakeLatticeNodesForPredictiveNodes(
       suffix_dictionary_->LookupPredictive(
           absl::string_view(key.data() + pos, key.size() - pos), request,
           &builder);
-      if (builder.result() != nullptr) {
-        lattice->Insert(pos, builder.result());
+      Node *nodes = DropRetainedNodes(*lattice, pos, builder.result());
+      if (nodes != nullptr) {
+        lattice->Insert(pos, nodes);
       }
     }
   }
@@ -1347,8 +1542,9 @@ void ImmutableConverterImpl::MakeLatticeNodesForPredictiveNodes(
       dictionary_->LookupPredictive(
           absl::string_view(key.data() + pos, key.size() - pos), request,
           &builder);
-      if (builder.result() != nullptr) {
-        lattice->Insert(pos, builder.result());
+      Node *nodes = DropRetainedNodes(*lattice, pos, builder.result());
+      if (nodes != nullptr) {
+        lattice->Insert(pos, nodes);
       }
     }
   }
@@ -1422,7 +1618,15 @@ bool ImmutableConverterImpl::MakeLattice(const ConversionRequest &request,
 
   const std::string key = history_key + conversion_key;
   lattice->UpdateKey(key);
-  lattice->ResetNodeCost();
+  if (is_prediction &&
+      absl::GetFlag(FLAGS_use_incremental_prediction_viterbi) &&
+      HasSameHistoryNodes(*segments, *lattice)) {
+    // The nodes ending before the first changed position are rebuilt
+    // identically, so keep them with their Viterbi results.
+    lattice->ResetNodeCostAfterValidPos();
+  } else {
+    lattice->ResetNodeCost();
+  }
 
   if (is_reverse) {
     // Reverse lookup for each prefix string in key is slow with current
@@ -1510,7 +1714,9 @@ bool ImmutableConverterImpl::MakeLatticeNodesForHistorySegments(
     rnode->key = segment.key();
     rnode->node_type = Node::HIS_NODE;
     rnode->bnext = nullptr;
-    lattice->Insert(segments_pos, rnode);
+    if (!IsRetainedNode(*lattice, segments_pos, *rnode)) {
+      lattice->Insert(segments_pos, rnode);
+    }
 
     // For the last history segment,  we also insert a new node having
     // EOS part-of-speech. Viterbi algorithm will find the
@@ -1534,7 +1740,9 @@ bool ImmutableConverterImpl::MakeLatticeNodesForHistorySegments(
       rnode2->key = segment.key();
       rnode2->node_type = Node::HIS_NODE;
       rnode2->bnext = nullptr;
-      lattice->Insert(segments_pos, rnode2);
+      if (!IsRetainedNode(*lattice, segments_pos, *rnode2)) {
+        lattice->Insert(segments_pos, rnode2);
+      }
     }
 
     // Dictionary lookup for the candidates which are
@@ -1652,10 +1860,37 @@ void ImmutableConverterImpl::MakeLatticeNodesForConversionSegments(
   const bool is_prediction =
       (request.request_type() == ConversionRequest::SUGGESTION ||
        request.request_type() == ConversionRequest::PREDICTION);
+
+  // Nodes are looked up at the positions reachable from the history, which
+  // are the character boundaries as every lookup adds a single character node.
+  // The dictionary is looked up for all of them at once.
+  std::vector<size_t> begin_positions;
+  std::vector<Node *> batch_results;
+  std::vector<int> batch_index(key.size(), -1);
+  if (!is_reverse) {
+    for (size_t pos = history_key.size(); pos < key.size();
+         pos += strings::OneCharLen(key[pos])) {
+      batch_index[pos] = begin_positions.size();
+      begin_positions.push_back(pos);
+    }
+    LookupPrefixBatch(begin_positions, key.size(), request, is_prediction,
+                      lattice, &batch_results);
+  }
+
   for (size_t pos = history_key.size(); pos < key.size(); ++pos) {
     if (lattice->end_nodes(pos) != nullptr) {
-      Node *rnode =
-          Lookup(pos, key.size(), request, is_reverse, is_prediction, lattice);
+      Node *rnode = nullptr;
+      if (batch_index[pos] >= 0) {
+        rnode = AddCharacterTypeBasedNodes(key.data() + pos,
+                                           key.data() + key.size(), lattice,
+                                           batch_results[batch_index[pos]]);
+        if (is_prediction) {
+          lattice->SetCacheInfo(pos, key.size() - pos);
+        }
+      } else {
+        rnode = Lookup(pos, key.size(), request, is_reverse, is_prediction,
+                       lattice);
+      }
       // If history key is NOT empty and user input seems to starts with
       // a particle ("はにで..."), mark the node as STARTS_WITH_PARTICLE.
       // We change the segment boundary if STARTS_WITH_PARTICLE attribute
@@ -1669,7 +1904,10 @@ void ImmutableConverterImpl::MakeLatticeNodesForConversionSegments(
         }
       }
       CHECK(rnode != nullptr);
-      lattice->Insert(pos, rnode);
+      rnode = DropRetainedNodes(*lattice, pos, rnode);
+      if (rnode != nullptr) {
+        lattice->Insert(pos, rnode);
+      }
       InsertCorrectedNodes(pos, key, request, key_corrector.get(), dictionary_,
                            lattice);
     }
@@ -1680,8 +1918,13 @@ void ImmutableConverterImpl::ApplyPrefixSuffixPenalty(
     const std::string &conversion_key, Lattice *lattice) const {
   const std::string &key = lattice->key();
   DCHECK_LE(conversion_key.size(), key.size());
+  // Retained nodes already have the penalty.
+  const size_t retained_end_pos = lattice->retained_end_pos();
   for (Node *node = lattice->begin_nodes(key.size() - conversion_key.size());
        node != nullptr; node = node->bnext) {
+    if (node->end_pos < retained_end_pos) {
+      continue;
+    }
     // TODO(taku):
     // We might be able to tweak the penalty according to
     // the size of history segments.
@@ -1691,6 +1934,9 @@ void ImmutableConverterImpl::ApplyPrefixSuffixPenalty(
     node->wcost += segmenter_->GetPrefixPenalty(node->lid);
   }
 
+  if (key.size() < retained_end_pos) {
+    return;
+  }
   for (Node *node = lattice->end_nodes(key.size()); node != nullptr;
        node = node->enext) {
     node->wcost += segmenter_->GetSuffixPenalty(node->rid);
@@ -2190,4 +2436,148 @@ bool ImmutableConverterImpl::ConvertForRequest(const ConversionRequest &request,
   return true;
 }
 
+namespace {
+
+// Collects the tokens whose key is exactly the looked-up prefix, i.e., skips
+// the tokens found through key expansion.
+class ExactPrefixTokenCollector : public DictionaryInterface::Callback {
+ public:
+  explicit ExactPrefixTokenCollector(std::vector<Token> *tokens)
+      : tokens_(tokens) {}
+
+  ResultType OnActualKey(absl::string_view key, absl::string_view actual_key,
+                         int num_expanded) override {
+    return num_expanded > 0 ? TRAVERSE_NEXT_KEY : TRAVERSE_CONTINUE;
+  }
+
+  ResultType OnToken(absl::string_view key, absl::string_view actual_key,
+                     const Token &token) override {
+    if (token.key == key && !token.value.empty()) {
+      tokens_->push_back(token);
+    }
+    return TRAVERSE_CONTINUE;
+  }
+
+ private:
+  std::vector<Token> *tokens_;
+};
+
+// A node of the lattice constrained to candidate->key and candidate->value.
+struct ConstrainedNode {
+  uint16_t lid;
+  uint16_t rid;
+  int32_t wcost;
+  size_t value_end;
+  int cost;  // Best cost from BOS to this node, including |wcost|.
+  int prev;  // Index of the best previous node, or -1 for BOS.
+};
+
+}  // namespace
+
+bool ImmutableConverterImpl::ResolvePosIds(
+    const ConversionRequest &request, Segment::Candidate *candidate) const {
+  DCHECK(candidate);
+  const std::string &key = candidate->key;
+  const std::string &value = candidate->value;
+  if (key.empty() || value.empty() || key.size() >= kMaxCharLength) {
+    return false;
+  }
+
+  // nodes_at[pos] holds the indices of |nodes| ending at key position |pos|.
+  // Since every node consumes at least one byte of both the key and the
+  // value, visiting the key positions in order visits the nodes in
+  // topological order.
+  std::vector<ConstrainedNode> nodes;
+  std::vector<std::vector<int>> nodes_at(key.size() + 1);
+  std::vector<Token> tokens;
+  for (size_t begin = 0; begin < key.size(); ++begin) {
+    if (begin > 0 && nodes_at[begin].empty()) {
+      continue;
+    }
+    tokens.clear();
+    ExactPrefixTokenCollector collector(&tokens);
+    dictionary_->LookupPrefix(absl::string_view(key).substr(begin), request,
+                              &collector);
+    for (const Token &token : tokens) {
+      const size_t end = begin + token.key.size();
+      int32_t wcost = token.cost;
+      if (begin == 0) {
+        wcost += segmenter_->GetPrefixPenalty(token.lid);
+      }
+      if (end == key.size()) {
+        wcost += segmenter_->GetSuffixPenalty(token.rid);
+      }
+      auto connect = [&](int prev, int prev_cost, uint16_t prev_rid,
+                         size_t value_begin) {
+        if (value.compare(value_begin, token.value.size(), token.value) != 0) {
+          return;
+        }
+        const size_t value_end = value_begin + token.value.size();
+        if (end == key.size() && value_end != value.size()) {
+          return;
+        }
+        const int cost = prev_cost +
+                         connector_.GetTransitionCost(prev_rid, token.lid) +
+                         wcost;
+        // Keeps only the best node for each (end, value_end, lid, rid).
+        for (const int i : nodes_at[end]) {
+          ConstrainedNode &node = nodes[i];
+          if (node.value_end == value_end && node.lid == token.lid &&
+              node.rid == token.rid) {
+            if (cost < node.cost) {
+              node.wcost = wcost;
+              node.cost = cost;
+              node.prev = prev;
+            }
+            return;
+          }
+        }
+        nodes_at[end].push_back(static_cast<int>(nodes.size()));
+        nodes.push_back({static_cast<uint16_t>(token.lid),
+                         static_cast<uint16_t>(token.rid), wcost, value_end,
+                         cost, prev});
+      };
+      if (begin == 0) {
+        // The BOS node has lid = rid = 0.
+        connect(-1, 0, 0, 0);
+        continue;
+      }
+      for (const int i : nodes_at[begin]) {
+        connect(i, nodes[i].cost, nodes[i].rid, nodes[i].value_end);
+      }
+    }
+  }
+
+  int best_cost = kVeryBigCost;
+  int best = -1;
+  for (const int i : nodes_at[key.size()]) {
+    DCHECK_EQ(nodes[i].value_end, value.size());
+    const int cost =
+        nodes[i].cost + connector_.GetTransitionCost(nodes[i].rid, 0);
+    if (cost < best_cost) {
+      best_cost = cost;
+      best = i;
+    }
+  }
+  if (best < 0) {
+    return false;
+  }
+
+  // Same decomposition as NBestGenerator::MakeCandidateFromBestPath().
+  int total_wcost = 0;
+  int first = best;
+  for (int i = best; i >= 0; i = nodes[i].prev) {
+    total_wcost += nodes[i].wcost;
+    first = i;
+  }
+  const int structure_cost =
+      nodes[best].cost - nodes[first].cost - (total_wcost - nodes[first].wcost);
+  candidate->lid = nodes[first].lid;
+  candidate->rid = nodes[best].rid;
+  candidate->cost = best_cost;
+  candidate->structure_cost = structure_cost;
+  candidate->wcost = total_wcost + structure_cost;
+  return true;
+}
+
 }  // namespace mozc
@@ -71,11 +71,21 @@ class ImmutableConverterImpl : public ImmutableConverterInterface {
   ABSL_MUST_USE_RESULT bool ConvertForRequest(
       const ConversionRequest &request, Segments *segments) const override;
 
+  // Runs Viterbi over the dictionary nodes which spell out candidate->key and
+  // candidate->value exactly.  Nodes from character type based unknown words,
+  // number resegmentation and key correction are not considered, so false is
+  // returned for candidates that need them.
+  ABSL_MUST_USE_RESULT bool ResolvePosIds(
+      const ConversionRequest &request,
+      Segment::Candidate *candidate) const override;
+
  private:
   FRIEND_TEST(ImmutableConverterTest, AddPredictiveNodes);
   FRIEND_TEST(ImmutableConverterTest, DummyCandidatesCost);
   FRIEND_TEST(ImmutableConverterTest, DummyCandidatesInnerSegmentBoundary);
+  FRIEND_TEST(ImmutableConverterTest, IncrementalPredictionViterbi);
   FRIEND_TEST(ImmutableConverterTest, NotConnectedTest);
+  FRIEND_TEST(ImmutableConverterTest, PackedViterbiIsIdenticalToDefault);
   FRIEND_TEST(ImmutableConverterTest, PredictiveNodesOnlyForConversionKey);
   FRIEND_TEST(NBestGeneratorTest, InnerSegmentBoundary);
   FRIEND_TEST(NBestGeneratorTest, MultiSegmentConnectionTest);
@@ -99,6 +109,14 @@ class ImmutableConverterImpl : public ImmutableConverterInterface {
   void InsertDummyCandidates(Segment *segment, size_t expand_size) const;
   Node *Lookup(int begin_pos, int end_pos, const ConversionRequest &request,
                bool is_reverse, bool is_prediction, Lattice *lattice) const;
+  // Looks up the dictionary for the prefixes of the lattice key in
+  // [begin_positions[i], end_pos) for each i at once, and stores the node
+  // lists to |results|.  Unlike Lookup(), neither adds character type based
+  // nodes nor updates the cache info of |lattice|.
+  void LookupPrefixBatch(absl::Span<const size_t> begin_positions,
+                         size_t end_pos, const ConversionRequest &request,
+                         bool is_prediction, Lattice *lattice,
+                         std::vector<Node *> *results) const;
   Node *AddCharacterTypeBasedNodes(const char *begin, const char *end,
                                    Lattice *lattice, Node *nodes) const;
 
@@ -133,8 +151,9 @@ class ImmutableConverterImpl : public ImmutableConverterInterface {
   bool Viterbi(const Segments &segments, Lattice *lattice) const;
 
   bool PredictionViterbi(const Segments &segments, Lattice *lattice) const;
+  // Updates the nodes ending in [min_end_pos, calc_end_pos].
   void PredictionViterbiInternal(int calc_begin_pos, int calc_end_pos,
-                                 Lattice *lattice) const;
+                                 int min_end_pos, Lattice *lattice) const;
 
   // TODO(toshiyuki): Change parameter order for mutable |segments|.
 
@@ -50,4 +50,9 @@ bool ImmutableConverterInterface::ConvertForRequest(
   return false;
 }
 
+bool ImmutableConverterInterface::ResolvePosIds(
+    const ConversionRequest &request, Segment::Candidate *candidate) const {
+  return false;
+}
+
 }  // namespace mozc
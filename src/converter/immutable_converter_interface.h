@@ -55,6 +55,14 @@ class ImmutableConverterInterface {
   ABSL_MUST_USE_RESULT virtual bool ConvertForRequest(
       const ConversionRequest &request, Segments *segments) const;
 
+  // Fills lid, rid, cost, wcost and structure_cost of |candidate| from the
+  // best path whose key and value are exactly candidate->key and
+  // candidate->value, without building the full lattice.  Returns false when
+  // no such path is found; callers should then fall back to
+  // ConvertForRequest.  The default implementation always returns false.
+  ABSL_MUST_USE_RESULT virtual bool ResolvePosIds(
+      const ConversionRequest &request, Segment::Candidate *candidate) const;
+
  protected:
   ImmutableConverterInterface() = default;
 };
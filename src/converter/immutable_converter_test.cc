@@ -38,9 +38,12 @@
 #include <utility>
 #include <vector>
 
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
 #include "absl/strings/match.h"
 #include "absl/strings/string_view.h"
 #include "base/logging.h"
+#include "base/thread.h"
 #include "base/util.h"
 #include "converter/connector.h"
 #include "converter/lattice.h"
@@ -66,6 +69,9 @@
 #include "testing/gmock.h"
 #include "testing/gunit.h"
 
+ABSL_DECLARE_FLAG(bool, use_packed_viterbi);
+ABSL_DECLARE_FLAG(bool, use_incremental_prediction_viterbi);
+
 namespace mozc {
 namespace {
 
@@ -422,6 +428,224 @@ TEST(ImmutableConverterTest, NotConnectedTest) {
   EXPECT_TRUE(tested);
 }
 
+TEST(ImmutableConverterTest, PackedViterbiIsIdenticalToDefault) {
+  std::unique_ptr<MockDataAndImmutableConverter> data_and_converter(
+      new MockDataAndImmutableConverter);
+  ImmutableConverterImpl *converter = data_and_converter->GetConverter();
+  const bool original_use_packed_viterbi =
+      absl::GetFlag(FLAGS_use_packed_viterbi);
+
+  const std::vector<std::vector<std::string>> kTestKeys = {
+      {"わたしのなまえはなかのです"},
+      {"しょうめい", "できる"},
+      {"きょうはいいてんきですね", "あしたもはれるかな"},
+  };
+  for (const std::vector<std::string> &keys : kTestKeys) {
+    Segments segments;
+    std::string key;
+    for (const std::string &segment_key : keys) {
+      Segment *segment = segments.add_segment();
+      segment->set_segment_type(keys.size() == 1 ? Segment::FREE
+                                                 : Segment::FIXED_BOUNDARY);
+      segment->set_key(segment_key);
+      key += segment_key;
+    }
+    Lattice lattice;
+    lattice.SetKey(key);
+    const ConversionRequest request;
+    converter->MakeLattice(request, &segments, &lattice);
+
+    // Runs Viterbi on the same lattice with both modes and compares the
+    // best predecessor and the cost of every node.
+    auto run_viterbi = [&](bool use_packed_viterbi) {
+      absl::SetFlag(&FLAGS_use_packed_viterbi, use_packed_viterbi);
+      EXPECT_TRUE(converter->Viterbi(segments, &lattice));
+      std::vector<std::pair<const Node *, int32_t>> result;
+      for (size_t pos = 0; pos <= key.size(); ++pos) {
+        for (const Node *node = lattice.begin_nodes(pos); node != nullptr;
+             node = node->bnext) {
+          result.emplace_back(node->prev,
+                              node->prev == nullptr ? 0 : node->cost);
+        }
+      }
+      return result;
+    };
+    const auto expected = run_viterbi(false);
+    const auto actual = run_viterbi(true);
+    EXPECT_EQ(actual, expected) << key;
+  }
+
+  absl::SetFlag(&FLAGS_use_packed_viterbi, original_use_packed_viterbi);
+}
+
+TEST(ImmutableConverterTest, ResolvePosIdsMatchesPrediction) {
+  std::unique_ptr<MockDataAndImmutableConverter> data_and_converter(
+      new MockDataAndImmutableConverter);
+  ImmutableConverterImpl *converter = data_and_converter->GetConverter();
+
+  for (const absl::string_view key :
+       {"きょうと", "いきます", "しょうめい", "できる"}) {
+    Segments segments;
+    segments.add_segment()->set_key(key);
+    ConversionRequest request;
+    request.set_request_type(ConversionRequest::PREDICTION);
+    request.set_max_conversion_candidates_size(5);
+    ASSERT_TRUE(converter->ConvertForRequest(request, &segments));
+    // Predictive nodes may extend the key of the top candidates.
+    const Segment &segment = segments.segment(0);
+    size_t index = 0;
+    while (index < segment.candidates_size() &&
+           segment.candidate(index).key != key) {
+      ++index;
+    }
+    ASSERT_LT(index, segment.candidates_size()) << key;
+    const Segment::Candidate &expected = segment.candidate(index);
+
+    Segment::Candidate candidate;
+    candidate.key = expected.key;
+    candidate.value = expected.value;
+    ASSERT_TRUE(converter->ResolvePosIds(ConversionRequest(), &candidate))
+        << expected.value;
+    EXPECT_EQ(candidate.lid, expected.lid) << expected.value;
+    EXPECT_EQ(candidate.rid, expected.rid) << expected.value;
+    EXPECT_EQ(candidate.cost, expected.cost) << expected.value;
+    EXPECT_EQ(candidate.wcost, expected.wcost) << expected.value;
+    EXPECT_EQ(candidate.structure_cost, expected.structure_cost)
+        << expected.value;
+  }
+}
+
+TEST(ImmutableConverterTest, ResolvePosIdsFailsForUnknownValue) {
+  std::unique_ptr<MockDataAndImmutableConverter> data_and_converter(
+      new MockDataAndImmutableConverter);
+  ImmutableConverterImpl *converter = data_and_converter->GetConverter();
+
+  Segment::Candidate candidate;
+  candidate.key = "きょうと";
+  candidate.value = "きょうとXYZ";
+  EXPECT_FALSE(converter->ResolvePosIds(ConversionRequest(), &candidate));
+  EXPECT_EQ(candidate.lid, 0);
+  EXPECT_EQ(candidate.rid, 0);
+}
+
+TEST(ImmutableConverterTest, IncrementalPredictionViterbi) {
+  std::unique_ptr<MockDataAndImmutableConverter> data_and_converter(
+      new MockDataAndImmutableConverter);
+  ImmutableConverterImpl *converter = data_and_converter->GetConverter();
+  const bool original_use_incremental_prediction_viterbi =
+      absl::GetFlag(FLAGS_use_incremental_prediction_viterbi);
+
+  // Types a sentence one character at a time, then deletes and retypes the
+  // tail.
+  std::vector<std::string> keys;
+  {
+    std::vector<std::string> chars;
+    Util::SplitStringToUtf8Chars("わたしのなまえはなかのです", &chars);
+    std::string key;
+    for (const std::string &c : chars) {
+      key += c;
+      keys.push_back(key);
+    }
+    keys.push_back("わたしのなまえはなかの");
+    keys.push_back("わたしのなまえは");
+    keys.push_back("わたしのなまえはたなか");
+    keys.push_back("わたしのなまえはたなかです");
+  }
+
+  ConversionRequest request;
+  request.set_request_type(ConversionRequest::SUGGESTION);
+  auto convert = [&](bool incremental, const std::string &key,
+                     Segments *segments) {
+    absl::SetFlag(&FLAGS_use_incremental_prediction_viterbi, incremental);
+    segments->clear_conversion_segments();
+    segments->add_segment()->set_key(key);
+    EXPECT_TRUE(converter->ConvertForRequest(request, segments));
+    std::vector<std::string> values;
+    const Segment &segment = segments->conversion_segment(0);
+    for (size_t i = 0; i < segment.candidates_size(); ++i) {
+      values.push_back(segment.candidate(i).value);
+    }
+    return values;
+  };
+  auto viterbi_results = [](const Lattice &lattice) {
+    std::vector<std::pair<const Node *, int32_t>> result;
+    for (size_t pos = 0; pos <= lattice.key().size(); ++pos) {
+      for (const Node *node = lattice.begin_nodes(pos); node != nullptr;
+           node = node->bnext) {
+        result.emplace_back(node->prev, node->cost);
+      }
+    }
+    return result;
+  };
+
+  Segments incremental_segments, default_segments;
+  for (const std::string &key : keys) {
+    EXPECT_EQ(convert(true, key, &incremental_segments),
+              convert(false, key, &default_segments))
+        << key;
+
+    // Running Viterbi from scratch on the reused lattice gives the same
+    // results.
+    Lattice *lattice = incremental_segments.mutable_cached_lattice();
+    const auto actual = viterbi_results(*lattice);
+    lattice->set_viterbi_valid_pos(0);
+    EXPECT_TRUE(converter->PredictionViterbi(incremental_segments, lattice));
+    EXPECT_EQ(viterbi_results(*lattice), actual) << key;
+  }
+
+  absl::SetFlag(&FLAGS_use_incremental_prediction_viterbi,
+                original_use_incremental_prediction_viterbi);
+}
+
+TEST(ImmutableConverterTest, ConcurrentConversionsMatchSingleThreaded) {
+  std::unique_ptr<MockDataAndImmutableConverter> data_and_converter(
+      new MockDataAndImmutableConverter);
+  const ImmutableConverterImpl *converter = data_and_converter->GetConverter();
+
+  const std::vector<std::string> kKeys = {
+      "わたしのなまえはなかのです", "きょうはいいてんきですね",
+      "しょうめいできる",           "よろしくおねがいします",
+      "あしたもはれるかな",         "とうきょうとっきょきょかきょく",
+  };
+  auto convert = [converter](const std::string &key) {
+    Segments segments;
+    segments.add_segment()->set_key(key);
+    const ConversionRequest request;
+    EXPECT_TRUE(converter->ConvertForRequest(request, &segments));
+    std::vector<std::string> values;
+    for (size_t s = 0; s < segments.segments_size(); ++s) {
+      const Segment &segment = segments.segment(s);
+      for (size_t i = 0; i < segment.candidates_size(); ++i) {
+        values.push_back(segment.candidate(i).value);
+      }
+      values.push_back("|");
+    }
+    return values;
+  };
+
+  std::vector<std::vector<std::string>> expected;
+  for (const std::string &key : kKeys) {
+    expected.push_back(convert(key));
+  }
+
+  constexpr int kNumThreads = 8;
+  constexpr int kNumIterations = 20;
+  std::vector<Thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < kNumIterations; ++i) {
+        // Each thread starts from a different key so that different keys are
+        // converted at the same time.
+        const size_t index = (t + i) % kKeys.size();
+        EXPECT_EQ(convert(kKeys[index]), expected[index]) << kKeys[index];
+      }
+    });
+  }
+  for (Thread &thread : threads) {
+    thread.Join();
+  }
+}
+
 TEST(ImmutableConverterTest, HistoryKeyLengthIsVeryLong) {
   // "あ..." (100 times)
   const std::string kA100 =
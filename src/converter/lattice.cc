@@ -172,6 +172,7 @@ void Lattice::Insert(size_t pos, Node *node) {
     rnode->cost = 0;
     rnode->enext = end_nodes_[end_pos];
     end_nodes_[end_pos] = rnode;
+    InvalidateViterbi(end_pos);
   }
 
   if (begin_nodes_[pos] == nullptr) {
@@ -187,6 +188,18 @@ void Lattice::Insert(size_t pos, Node *node) {
   }
 }
 
+const Lattice::PackedEndNodes &Lattice::PackEndNodes(size_t pos) {
+  packed_end_nodes_.clear();
+  for (Node *node = end_nodes_[pos]; node != nullptr; node = node->enext) {
+    packed_end_nodes_.nodes.push_back(node);
+    packed_end_nodes_.rids.push_back(node->rid);
+    packed_end_nodes_.costs.push_back(node->prev == nullptr
+                                          ? PackedEndNodes::kUnreachableCost
+                                          : node->cost);
+  }
+  return packed_end_nodes_;
+}
+
 void Lattice::Clear() {
   key_.clear();
   begin_nodes_.clear();
@@ -194,6 +207,17 @@ void Lattice::Clear() {
   node_allocator_->Free();
   cache_info_.clear();
   history_end_pos_ = 0;
+  viterbi_valid_pos_ = 0;
+  retained_end_pos_ = 0;
+}
+
+Lattice::MemoryStats Lattice::GetMemoryStats() const {
+  MemoryStats stats;
+  stats.nodes = node_allocator_->stats();
+  stats.position_bytes = begin_nodes_.capacity() * sizeof(Node *) +
+                         end_nodes_.capacity() * sizeof(Node *) +
+                         cache_info_.capacity() * sizeof(size_t);
+  return stats;
 }
 
 void Lattice::SetDebugDisplayNode(size_t begin_pos, size_t end_pos,
@@ -247,8 +271,13 @@ void Lattice::AddSuffix(const absl::string_view suffix_key) {
   std::fill(end_nodes_.begin() + old_size + 1, end_nodes_.end(),
             static_cast<Node *>(nullptr));
 
-  end_nodes_[0] = InitBOSNode(this, static_cast<uint16_t>(0));
+  // Keep the BOS node so that the Viterbi results of the nodes before
+  // old_size, which point to it, remain valid.
+  if (end_nodes_[0] == nullptr) {
+    end_nodes_[0] = InitBOSNode(this, static_cast<uint16_t>(0));
+  }
   begin_nodes_[new_size] = InitEOSNode(this, static_cast<uint16_t>(new_size));
+  InvalidateViterbi(old_size);
 
   // update cache_info
   cache_info_.resize(new_size + 4, 0);
@@ -292,6 +321,7 @@ void Lattice::ShrinkKey(const size_t new_len) {
     end_nodes_[i] = nullptr;
   }
   begin_nodes_[new_len] = InitEOSNode(this, static_cast<uint16_t>(new_len));
+  InvalidateViterbi(new_len);
 
   // update cache_info
   for (size_t i = 0; i < new_len; ++i) {
@@ -304,60 +334,55 @@ void Lattice::ShrinkKey(const size_t new_len) {
 }
 
 void Lattice::ResetNodeCost() {
+  viterbi_valid_pos_ = 0;
+  ResetNodeCostInternal(0);
+}
+
+void Lattice::ResetNodeCostAfterValidPos() {
+  viterbi_valid_pos_ = std::min(viterbi_valid_pos_, key_.size() + 1);
+  ResetNodeCostInternal(viterbi_valid_pos_);
+}
+
+void Lattice::ResetNodeCostInternal(const size_t retained_end_pos) {
+  retained_end_pos_ = retained_end_pos;
   for (size_t i = 0; i <= key_.size(); ++i) {
-    if (begin_nodes_[i] != nullptr) {
-      Node *prev = nullptr;
-      for (Node *node = begin_nodes_[i]; node != nullptr; node = node->bnext) {
-        // do not process BOS / EOS nodes
-        if (node->node_type == Node::BOS_NODE ||
-            node->node_type == Node::EOS_NODE) {
-          continue;
-        }
-        // if the node has ENABLE_CACHE attribute, then revert its wcost.
-        // Otherwise, erase the node from the lattice.
-        if (node->attributes & Node::ENABLE_CACHE) {
-          node->wcost = node->raw_wcost;
-        } else {
-          if (node == begin_nodes_[i]) {
-            if (node->bnext == nullptr) {
-              begin_nodes_[i] = nullptr;
-            } else {
-              begin_nodes_[i] = node->bnext;
-            }
-          } else {
-            CHECK(prev);
-            CHECK_EQ(prev->bnext, node);
-            prev->next = node->bnext;
-          }
-        }
-        // traverse a next node
+    Node *prev = nullptr;
+    for (Node *node = begin_nodes_[i]; node != nullptr; node = node->bnext) {
+      // do not process BOS / EOS nodes, and keep the retained ones.
+      if (node->node_type == Node::BOS_NODE ||
+          node->node_type == Node::EOS_NODE ||
+          node->end_pos < retained_end_pos) {
         prev = node;
+        continue;
+      }
+      // if the node has ENABLE_CACHE attribute, then revert its wcost.
+      // Otherwise, erase the node from the lattice.
+      if (node->attributes & Node::ENABLE_CACHE) {
+        node->wcost = node->raw_wcost;
+        prev = node;
+      } else if (prev == nullptr) {
+        begin_nodes_[i] = node->bnext;
+      } else {
+        DCHECK_EQ(prev->bnext, node);
+        prev->bnext = node->bnext;
       }
     }
+  }
 
-    if (end_nodes_[i] != nullptr) {
-      Node *prev = nullptr;
-      for (Node *node = end_nodes_[i]; node != nullptr; node = node->enext) {
-        if (node->node_type == Node::BOS_NODE ||
-            node->node_type == Node::EOS_NODE) {
-          continue;
-        }
-        if (node->attributes & Node::ENABLE_CACHE) {
-          node->wcost = node->raw_wcost;
-        } else {
-          if (node == end_nodes_[i]) {
-            if (node->enext == nullptr) {
-              end_nodes_[i] = nullptr;
-            } else {
-              end_nodes_[i] = node->enext;
-            }
-          } else {
-            CHECK(prev);
-            CHECK_EQ(prev->enext, node);
-            prev->next = node->enext;
-          }
-        }
+  for (size_t i = retained_end_pos; i <= key_.size(); ++i) {
+    Node *prev = nullptr;
+    for (Node *node = end_nodes_[i]; node != nullptr; node = node->enext) {
+      if (node->node_type == Node::BOS_NODE ||
+          node->node_type == Node::EOS_NODE ||
+          (node->attributes & Node::ENABLE_CACHE)) {
         prev = node;
+        continue;
+      }
+      if (prev == nullptr) {
+        end_nodes_[i] = node->enext;
+      } else {
+        DCHECK_EQ(prev->enext, node);
+        prev->enext = node->enext;
       }
     }
   }
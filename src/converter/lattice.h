@@ -30,6 +30,10 @@
 #ifndef MOZC_CONVERTER_LATTICE_H_
 #define MOZC_CONVERTER_LATTICE_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
@@ -43,8 +47,40 @@ namespace mozc {
 
 class Lattice {
  public:
+  // Struct-of-arrays view of the nodes ending at a position. Used by the
+  // vectorized Viterbi kernel instead of following Node::enext.
+  struct PackedEndNodes {
+    // Cost stored for nodes that are not reachable from BOS (prev == nullptr).
+    // It is large enough for such nodes to never be selected as a best
+    // predecessor but small enough not to overflow when adding transition
+    // costs.
+    static constexpr int32_t kUnreachableCost =
+        std::numeric_limits<int32_t>::max() >> 2;
+
+    void clear() {
+      nodes.clear();
+      rids.clear();
+      costs.clear();
+    }
+    size_t size() const { return nodes.size(); }
+
+    std::vector<Node *> nodes;
+    std::vector<uint16_t> rids;
+    std::vector<int32_t> costs;
+  };
+
+  // Memory held by the lattice. Capacities are retained across Clear(), so the
+  // numbers reflect the high-water mark of the conversions so far.
+  struct MemoryStats {
+    NodeAllocator::Stats nodes;
+    // Bytes of the per-position vectors (begin_nodes, end_nodes, cache_info).
+    size_t position_bytes = 0;
+  };
+
   Lattice()
       : history_end_pos_(0),
+        viterbi_valid_pos_(0),
+        retained_end_pos_(0),
         node_allocator_(std::make_unique<NodeAllocator>()) {}
 
   NodeAllocator *node_allocator() const { return node_allocator_.get(); }
@@ -72,6 +108,12 @@ class Lattice {
   // To traverse all nodes, use Node::enext member.
   Node *end_nodes(size_t pos) const { return end_nodes_[pos]; }
 
+  // Packs end_nodes(|pos|) into struct-of-arrays form, in the same order as
+  // the enext list. Node::cost and Node::prev are read at the time of the
+  // call, so call this after the nodes ending at |pos| are finalized. The
+  // returned reference is valid until the next call.
+  const PackedEndNodes &PackEndNodes(size_t pos);
+
   // return bos nodes.
   // alias of end_nodes(0).
   Node *bos_nodes() const { return end_nodes_[0]; }
@@ -84,8 +126,11 @@ class Lattice {
   void Insert(size_t pos, Node *node);
 
   // clear all lattice and nodes allocated with NewNode method.
+  // The memory is kept for the next key; see NodeAllocator.
   void Clear();
 
+  MemoryStats GetMemoryStats() const;
+
   // return true if this instance has a valid lattice.
   bool has_lattice() const { return !begin_nodes_.empty(); }
 
@@ -115,6 +160,22 @@ class Lattice {
   // process for some heuristic methods.
   void ResetNodeCost();
 
+  // Same as ResetNodeCost(), but keeps the nodes ending before
+  // viterbi_valid_pos() as they are, including the nodes without
+  // ENABLE_CACHE attribute. Only valid when such nodes would be rebuilt
+  // identically for the current key.
+  void ResetNodeCostAfterValidPos();
+
+  // Node::cost and Node::prev of the nodes ending before this position are
+  // the results of the last Viterbi run and still hold for the current
+  // lattice. Key updates and node insertions move it backward.
+  size_t viterbi_valid_pos() const { return viterbi_valid_pos_; }
+  void set_viterbi_valid_pos(size_t pos) { viterbi_valid_pos_ = pos; }
+
+  // Nodes ending before this position were kept by the last
+  // ResetNodeCostAfterValidPos(). It is 0 after ResetNodeCost().
+  size_t retained_end_pos() const { return retained_end_pos_; }
+
   // Dump the best path and the path that contains the designated string.
   std::string DebugString() const;
 
@@ -129,14 +190,24 @@ class Lattice {
   // TODO(team): Splitting the cache module may make this module simpler.
   std::string key_;
   size_t history_end_pos_;
+  size_t viterbi_valid_pos_;
+  size_t retained_end_pos_;
   std::vector<Node *> begin_nodes_;
   std::vector<Node *> end_nodes_;
   std::unique_ptr<NodeAllocator> node_allocator_;
 
+  // Scratch buffer for PackEndNodes().
+  PackedEndNodes packed_end_nodes_;
+
   // cache_info_ holds cache information about lookup.
   // If cache_info_[pos] equals to len, it means key.substr(pos, k)
   // (1 <= k <= len) is already looked up.
   std::vector<size_t> cache_info_;
+
+  void InvalidateViterbi(size_t pos) {
+    viterbi_valid_pos_ = std::min(viterbi_valid_pos_, pos);
+  }
+  void ResetNodeCostInternal(size_t retained_end_pos);
 };
 
 }  // namespace mozc
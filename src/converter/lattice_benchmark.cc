@@ -0,0 +1,129 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark of the lattice memory usage while typing.
+//
+// Each test sentence is typed one character at a time and converted for
+// suggestion after every keystroke with the same Segments, as a session does.
+// The heap allocations per keystroke are reported with and without retaining
+// the capacity of the node arena across conversions, together with the
+// memory statistics of the lattice.
+//
+// Usage:
+//   lattice_benchmark --iterations=3
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "absl/flags/flag.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/stopwatch.h"
+#include "base/util.h"
+#include "converter/benchmark_util.h"
+#include "converter/immutable_converter.h"
+#include "converter/lattice.h"
+#include "converter/segments.h"
+#include "request/conversion_request.h"
+#include "session/random_keyevents_generator.h"
+#include "testing/allocation_counter.h"
+#include "testing/benchmark_result.h"
+
+ABSL_FLAG(int32_t, iterations, 3, "Number of times to type all sentences.");
+
+namespace mozc {
+namespace {
+
+void RunTyping(absl::string_view name, const ImmutableConverterImpl &converter,
+               absl::Span<const char *> sentences, bool retain_capacity) {
+  ConversionRequest request;
+  request.set_request_type(ConversionRequest::SUGGESTION);
+
+  Segments segments;
+  Lattice *lattice = segments.mutable_cached_lattice();
+  lattice->node_allocator()->set_retain_capacity(retain_capacity);
+
+  int64_t keystrokes = 0;
+  absl::Duration elapsed;
+  testing::AllocationCounter counter;
+  for (int i = 0; i < absl::GetFlag(FLAGS_iterations); ++i) {
+    for (const char *sentence : sentences) {
+      const size_t length = Util::CharsLen(sentence);
+      for (size_t len = 1; len <= length; ++len) {
+        const Stopwatch stopwatch = Stopwatch::StartNew();
+        segments.clear_conversion_segments();
+        segments.add_segment()->set_key(Util::Utf8SubString(sentence, 0, len));
+        if (!converter.ConvertForRequest(request, &segments)) {
+          LOG(ERROR) << "Failed to convert: " << sentence;
+        }
+        elapsed += stopwatch.GetElapsed();
+        ++keystrokes;
+      }
+    }
+  }
+  const int64_t allocations = counter.allocations();
+
+  testing::PrintBenchmarkResult(name, elapsed, keystrokes);
+  const Lattice::MemoryStats stats = lattice->GetMemoryStats();
+  std::cout << absl::StrFormat(
+                   "  allocations/keystroke: %.1f  bytes/keystroke: %.1f\n"
+                   "  peak nodes: %d  chunks: %d  node bytes: %d  "
+                   "position bytes: %d",
+                   static_cast<double>(allocations) / keystrokes,
+                   static_cast<double>(counter.allocated_bytes()) / keystrokes,
+                   stats.nodes.peak_nodes, stats.nodes.chunks,
+                   stats.nodes.bytes, stats.position_bytes)
+            << std::endl;
+}
+
+void Run() {
+  const ImmutableConverterResources res;
+  const std::unique_ptr<ImmutableConverterImpl> converter =
+      res.CreateConverter();
+  const absl::Span<const char *> sentences =
+      session::RandomKeyEventsGenerator::GetTestSentences();
+  RunTyping("typing/release_on_clear", *converter, sentences, false);
+  RunTyping("typing/retain_capacity", *converter, sentences, true);
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  mozc::Run();
+  return 0;
+}
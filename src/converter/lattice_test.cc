@@ -34,6 +34,7 @@
 
 #include "absl/container/btree_set.h"
 #include "converter/node.h"
+#include "converter/node_allocator.h"
 #include "testing/gunit.h"
 
 namespace mozc {
@@ -103,6 +104,53 @@ TEST(LatticeTest, InsertTest) {
   }
 }
 
+TEST(LatticeTest, NodeAllocatorReusesMemory) {
+  NodeAllocator allocator;
+  Node *first = allocator.NewNode();
+  first->value = "value";
+  for (size_t i = 1; i < NodeAllocator::kChunkSize + 1; ++i) {
+    allocator.NewNode();
+  }
+  EXPECT_EQ(allocator.node_count(), NodeAllocator::kChunkSize + 1);
+  EXPECT_EQ(allocator.stats().chunks, 2);
+  EXPECT_EQ(allocator.stats().peak_nodes, NodeAllocator::kChunkSize + 1);
+
+  // The memory is reused after Free().
+  allocator.Free();
+  EXPECT_EQ(allocator.node_count(), 0);
+  EXPECT_EQ(allocator.stats().chunks, 2);
+  Node *node = allocator.NewNode();
+  EXPECT_EQ(node, first);
+  EXPECT_TRUE(node->value.empty());
+  EXPECT_EQ(allocator.stats().peak_nodes, NodeAllocator::kChunkSize + 1);
+
+  allocator.Release();
+  EXPECT_EQ(allocator.node_count(), 0);
+  EXPECT_EQ(allocator.stats().chunks, 0);
+  EXPECT_EQ(allocator.stats().bytes, 0);
+
+  // Free() returns the memory if the capacity is not retained.
+  allocator.set_retain_capacity(false);
+  allocator.NewNode();
+  EXPECT_EQ(allocator.stats().chunks, 1);
+  allocator.Free();
+  EXPECT_EQ(allocator.stats().chunks, 0);
+}
+
+TEST(LatticeTest, MemoryStatsAfterClear) {
+  Lattice lattice;
+  lattice.SetKey("this is a test");
+  const Lattice::MemoryStats stats = lattice.GetMemoryStats();
+  EXPECT_GT(stats.nodes.peak_nodes, 0);
+  EXPECT_GT(stats.nodes.bytes, 0);
+  EXPECT_GT(stats.position_bytes, 0);
+
+  lattice.Clear();
+  const Lattice::MemoryStats cleared = lattice.GetMemoryStats();
+  EXPECT_EQ(cleared.nodes.chunks, stats.nodes.chunks);
+  EXPECT_EQ(cleared.position_bytes, stats.position_bytes);
+}
+
 namespace {
 
 // set cache_info[i] to (key.size() - i)
@@ -221,4 +269,108 @@ TEST(LatticeTest, ShrinkKeyTest) {
     }
   }
 }
+
+namespace {
+
+Node *InsertNode(Lattice *lattice, size_t pos, size_t len, bool cached) {
+  Node *node = lattice->NewNode();
+  node->key.assign(lattice->key(), pos, len);
+  node->wcost = 100;
+  node->raw_wcost = 10;
+  if (cached) {
+    node->attributes |= Node::ENABLE_CACHE;
+  }
+  lattice->Insert(pos, node);
+  return node;
+}
+
+bool HasBeginNode(const Lattice &lattice, size_t pos, const Node *target) {
+  for (Node *node = lattice.begin_nodes(pos); node != nullptr;
+       node = node->bnext) {
+    if (node == target) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HasEndNode(const Lattice &lattice, size_t pos, const Node *target) {
+  for (Node *node = lattice.end_nodes(pos); node != nullptr;
+       node = node->enext) {
+    if (node == target) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+TEST(LatticeTest, ViterbiValidPos) {
+  Lattice lattice;
+  lattice.SetKey("abcd");
+  EXPECT_EQ(lattice.viterbi_valid_pos(), 0);
+
+  lattice.set_viterbi_valid_pos(5);
+  InsertNode(&lattice, 1, 2, true);
+  EXPECT_EQ(lattice.viterbi_valid_pos(), 3);
+
+  lattice.set_viterbi_valid_pos(5);
+  const Node *bos = lattice.bos_nodes();
+  lattice.AddSuffix("ef");
+  EXPECT_EQ(lattice.viterbi_valid_pos(), 4);
+  EXPECT_EQ(lattice.bos_nodes(), bos);
+
+  lattice.set_viterbi_valid_pos(7);
+  lattice.ShrinkKey(5);
+  EXPECT_EQ(lattice.viterbi_valid_pos(), 5);
+
+  lattice.Clear();
+  EXPECT_EQ(lattice.viterbi_valid_pos(), 0);
+}
+
+TEST(LatticeTest, ResetNodeCostRemovesUncachedNodes) {
+  Lattice lattice;
+  lattice.SetKey("abcd");
+  // Uncached nodes behind cached ones in both begin and end lists.
+  Node *uncached1 = InsertNode(&lattice, 0, 2, false);
+  Node *cached1 = InsertNode(&lattice, 0, 2, true);
+  Node *uncached2 = InsertNode(&lattice, 1, 1, false);
+  Node *cached2 = InsertNode(&lattice, 2, 2, true);
+
+  lattice.ResetNodeCost();
+  EXPECT_EQ(lattice.retained_end_pos(), 0);
+  EXPECT_FALSE(HasBeginNode(lattice, 0, uncached1));
+  EXPECT_FALSE(HasEndNode(lattice, 2, uncached1));
+  EXPECT_FALSE(HasBeginNode(lattice, 1, uncached2));
+  EXPECT_FALSE(HasEndNode(lattice, 2, uncached2));
+  EXPECT_TRUE(HasBeginNode(lattice, 0, cached1));
+  EXPECT_TRUE(HasEndNode(lattice, 2, cached1));
+  EXPECT_TRUE(HasEndNode(lattice, 4, cached2));
+  EXPECT_EQ(cached1->wcost, 10);
+  EXPECT_EQ(cached2->wcost, 10);
+}
+
+TEST(LatticeTest, ResetNodeCostAfterValidPos) {
+  Lattice lattice;
+  lattice.SetKey("abcd");
+  Node *kept_uncached = InsertNode(&lattice, 0, 2, false);
+  Node *kept_cached = InsertNode(&lattice, 0, 2, true);
+  Node *reset_uncached = InsertNode(&lattice, 1, 2, false);
+  Node *reset_cached = InsertNode(&lattice, 2, 2, true);
+  lattice.set_viterbi_valid_pos(3);
+
+  lattice.ResetNodeCostAfterValidPos();
+  EXPECT_EQ(lattice.retained_end_pos(), 3);
+  EXPECT_EQ(lattice.viterbi_valid_pos(), 3);
+  EXPECT_TRUE(HasBeginNode(lattice, 0, kept_uncached));
+  EXPECT_TRUE(HasEndNode(lattice, 2, kept_uncached));
+  EXPECT_EQ(kept_uncached->wcost, 100);
+  EXPECT_EQ(kept_cached->wcost, 100);
+  EXPECT_FALSE(HasBeginNode(lattice, 1, reset_uncached));
+  EXPECT_FALSE(HasEndNode(lattice, 3, reset_uncached));
+  EXPECT_TRUE(HasEndNode(lattice, 4, reset_cached));
+  EXPECT_EQ(reset_cached->wcost, 10);
+}
+
 }  // namespace mozc
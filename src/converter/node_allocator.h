@@ -30,30 +30,67 @@
 #ifndef MOZC_CONVERTER_NODE_ALLOCATOR_H_
 #define MOZC_CONVERTER_NODE_ALLOCATOR_H_
 
-#include "base/container/freelist.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
 #include "base/logging.h"
 #include "converter/node.h"
 
 namespace mozc {
 
+// Arena of Node objects.
+//
+// Nodes are carved out of fixed-size chunks with a bump pointer. Free() only
+// resets the pointer, so the chunks, and the string buffers of the nodes in
+// them, are reused by the next conversion instead of being reallocated. The
+// arena keeps the capacity of its high-water mark until Release() is called,
+// unless retention is disabled by set_retain_capacity(false).
 class NodeAllocator {
  public:
-  NodeAllocator()
-      : node_freelist_(1024), max_nodes_size_(8192), node_count_(0) {}
+  static constexpr size_t kChunkSize = 1024;
+
+  struct Stats {
+    // The maximum number of nodes allocated at the same time.
+    size_t peak_nodes = 0;
+    // The number of chunks currently held by the arena.
+    size_t chunks = 0;
+    // Bytes of the chunks. Heap memory owned by the strings of the nodes is
+    // not included.
+    size_t bytes = 0;
+  };
+
+  NodeAllocator() : max_nodes_size_(8192), node_count_(0), peak_nodes_(0) {}
   NodeAllocator(const NodeAllocator &) = delete;
   NodeAllocator &operator=(const NodeAllocator &) = delete;
 
   Node *NewNode() {
-    Node *node = node_freelist_.Alloc();
+    const size_t chunk_index = node_count_ / kChunkSize;
+    if (chunk_index == chunks_.size()) {
+      chunks_.push_back(std::make_unique<Node[]>(kChunkSize));
+    }
+    Node *node = &chunks_[chunk_index][node_count_ % kChunkSize];
     DCHECK(node);
     node->Init();
     ++node_count_;
+    peak_nodes_ = std::max(peak_nodes_, node_count_);
     return node;
   }
 
-  // Frees all nodes allocateed by NewNode().
+  // Frees all nodes allocateed by NewNode(). The memory is kept for reuse if
+  // retain_capacity() is true.
   void Free() {
-    node_freelist_.Free();
+    if (!retain_capacity_) {
+      Release();
+      return;
+    }
+    node_count_ = 0;
+  }
+
+  // Frees all nodes and returns the memory of the arena.
+  void Release() {
+    chunks_.clear();
     node_count_ = 0;
   }
 
@@ -65,10 +102,25 @@ class NodeAllocator {
 
   size_t node_count() const { return node_count_; }
 
+  bool retain_capacity() const { return retain_capacity_; }
+  void set_retain_capacity(bool retain_capacity) {
+    retain_capacity_ = retain_capacity;
+  }
+
+  Stats stats() const {
+    Stats stats;
+    stats.peak_nodes = peak_nodes_;
+    stats.chunks = chunks_.size();
+    stats.bytes = chunks_.size() * kChunkSize * sizeof(Node);
+    return stats;
+  }
+
  private:
-  FreeList<Node> node_freelist_;
+  std::vector<std::unique_ptr<Node[]>> chunks_;
   size_t max_nodes_size_;
   size_t node_count_;
+  size_t peak_nodes_;
+  bool retain_capacity_ = true;
 };
 
 }  // namespace mozc
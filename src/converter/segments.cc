@@ -65,6 +65,7 @@ void Segment::Candidate::Clear() {
   prefix.clear();
   suffix.clear();
   description.clear();
+  a11y_description.clear();
   usage_title.clear();
   usage_description.clear();
   cost = 0;
@@ -75,9 +76,11 @@ void Segment::Candidate::Clear() {
   usage_id = 0;
   attributes = 0;
   source_info = SOURCE_INFO_NONE;
+  category = DEFAULT_CATEGORY;
   style = NumberUtil::NumberString::DEFAULT_STYLE;
   command = DEFAULT_COMMAND;
   inner_segment_boundary.clear();
+  cost_before_rescoring = 0;
 #ifndef NDEBUG
   log.clear();
 #endif  // NDEBUG
@@ -243,22 +246,48 @@ Segment &Segment::operator=(const Segment &x) {
 }
 
 void Segment::clear_candidates() {
+  if (retain_capacity_) {
+    // Erased candidates in |pool_| are also recycled.
+    for (std::unique_ptr<Candidate> &candidate : pool_) {
+      if (free_candidates_.size() >= kMaxRetainedCandidates) {
+        break;
+      }
+      if (candidate == nullptr) {
+        continue;
+      }
+      candidate->Clear();
+      free_candidates_.push_back(std::move(candidate));
+    }
+  }
   pool_.clear();
   candidates_.clear();
 }
 
+void Segment::set_retain_capacity(bool retain_capacity) {
+  retain_capacity_ = retain_capacity;
+  if (!retain_capacity_) {
+    free_candidates_.clear();
+    free_candidates_.shrink_to_fit();
+  }
+}
+
+Segment::Candidate *Segment::NewCandidate() {
+  if (free_candidates_.empty()) {
+    return pool_.emplace_back(std::make_unique<Candidate>()).get();
+  }
+  pool_.push_back(std::move(free_candidates_.back()));
+  free_candidates_.pop_back();
+  return pool_.back().get();
+}
+
 Segment::Candidate *Segment::push_back_candidate() {
-  auto candidate = std::make_unique<Candidate>();
-  Candidate *ptr = candidate.get();
-  pool_.push_back(std::move(candidate));
+  Candidate *ptr = NewCandidate();
   candidates_.push_back(ptr);
   return ptr;
 }
 
 Segment::Candidate *Segment::push_front_candidate() {
-  auto candidate = std::make_unique<Candidate>();
-  Candidate *ptr = candidate.get();
-  pool_.push_back(std::move(candidate));
+  Candidate *ptr = NewCandidate();
   candidates_.push_front(ptr);
   return ptr;
 }
@@ -274,8 +303,7 @@ Segment::Candidate *Segment::insert_candidate(int i) {
                 << candidates_.size();
     i = static_cast<int>(candidates_.size());
   }
-  Candidate *candidate =
-      pool_.emplace_back(std::make_unique<Candidate>()).get();
+  Candidate *candidate = NewCandidate();
   candidates_.insert(candidates_.begin() + i, candidate);
   return candidate;
 }
@@ -405,9 +433,10 @@ void Segment::DeepCopyCandidates(const std::deque<Candidate *> &candidates) {
   DCHECK(pool_.empty());
   pool_.reserve(candidates.size());
   for (const Candidate *cand : candidates) {
-    auto new_cand = std::make_unique<Candidate>(*cand);
-    candidates_.push_back(new_cand.get());
-    pool_.push_back(std::move(new_cand));
+    // Copy-assignment reuses the string buffers of a retained candidate.
+    Candidate *new_cand = NewCandidate();
+    *new_cand = *cand;
+    candidates_.push_back(new_cand);
   }
 }
 
@@ -433,7 +462,8 @@ Segments::Segments(const Segments &x)
       resized_(x.resized_),
       pool_(32),
       revert_entries_(x.revert_entries_),
-      cached_lattice_() {
+      cached_lattice_(),
+      retain_capacity_(x.retain_capacity_) {
   // Deep-copy segments.
   for (const Segment *segment : x.segments_) {
     *add_segment() = *segment;
@@ -448,6 +478,7 @@ Segments &Segments::operator=(const Segments &x) {
 
   max_history_segments_size_ = x.max_history_segments_size_;
   resized_ = x.resized_;
+  retain_capacity_ = x.retain_capacity_;
   // Deep-copy segments.
   for (const Segment *segment : x.segments_) {
     *add_segment() = *segment;
@@ -460,6 +491,7 @@ Segments &Segments::operator=(const Segments &x) {
 
 Segment *Segments::insert_segment(size_t i) {
   Segment *segment = pool_.Alloc();
+  segment->set_retain_capacity(retain_capacity_);
   segment->Clear();
   segments_.insert(segments_.begin() + i, segment);
   return segment;
@@ -467,6 +499,7 @@ Segment *Segments::insert_segment(size_t i) {
 
 Segment *Segments::push_back_segment() {
   Segment *segment = pool_.Alloc();
+  segment->set_retain_capacity(retain_capacity_);
   segment->Clear();
   segments_.push_back(segment);
   return segment;
@@ -474,6 +507,7 @@ Segment *Segments::push_back_segment() {
 
 Segment *Segments::push_front_segment() {
   Segment *segment = pool_.Alloc();
+  segment->set_retain_capacity(retain_capacity_);
   segment->Clear();
   segments_.push_front(segment);
   return segment;
@@ -532,11 +566,25 @@ void Segments::Clear() {
 }
 
 void Segments::clear_segments() {
-  pool_.Free();
+  if (retain_capacity_) {
+    // The segments are cleared when they are allocated again.
+    for (Segment *segment : segments_) {
+      pool_.Release(segment);
+    }
+  } else {
+    pool_.Free();
+  }
   resized_ = false;
   segments_.clear();
 }
 
+void Segments::set_retain_capacity(bool retain_capacity) {
+  retain_capacity_ = retain_capacity;
+  for (Segment *segment : segments_) {
+    segment->set_retain_capacity(retain_capacity);
+  }
+}
+
 void Segments::clear_history_segments() {
   while (!segments_.empty()) {
     Segment *seg = segments_.front();
@@ -288,7 +288,7 @@ class Segment final {
 
     // Clears the Candidate with default values. Note that the default
     // constructor already does the same so you don't need to call Clear
-    // explicitly.
+    // explicitly.  The capacities of the strings are kept.
     void Clear();
 
     // Returns functional key.
@@ -321,7 +321,7 @@ class Segment final {
     }
   };
 
-  Segment() : segment_type_(FREE), pool_(kCandidatesPoolSize) {}
+  Segment() : segment_type_(FREE) {}
 
   Segment(const Segment &x);
   Segment &operator=(const Segment &x);
@@ -368,8 +368,17 @@ class Segment final {
 
   // erase all candidates
   // do not erase meta candidates
+  // The erased candidates are kept for reuse if retain_capacity() is true.
   void clear_candidates();
 
+  // If true (default), the candidates erased by clear_candidates() and Clear()
+  // are recycled by the following push and insert methods, so that repeated
+  // conversions with the same segment reuse the candidates and their string
+  // buffers instead of allocating new ones.  Up to kMaxRetainedCandidates are
+  // kept.
+  bool retain_capacity() const { return retain_capacity_; }
+  void set_retain_capacity(bool retain_capacity);
+
   // meta candidates
   // TODO(toshiyuki): Integrate meta candidates to candidate and delete these
   size_t meta_candidates_size() const { return meta_candidates_.size(); }
@@ -406,7 +415,11 @@ class Segment final {
  private:
   void DeepCopyCandidates(const std::deque<Candidate *> &candidates);
 
-  static constexpr int kCandidatesPoolSize = 16;
+  // Returns a cleared candidate owned by |pool_|, reusing a retained one if
+  // any.
+  Candidate *NewCandidate();
+
+  static constexpr size_t kMaxRetainedCandidates = 256;
 
   // LINT.IfChange
   SegmentType segment_type_;
@@ -422,6 +435,10 @@ class Segment final {
   std::vector<Candidate> meta_candidates_;
   std::vector<std::unique_ptr<Candidate>> pool_;
   // LINT.ThenChange(//converter/segments_matchers.h)
+
+  // Cleared candidates for reuse. Not copied with the segment.
+  std::vector<std::unique_ptr<Candidate>> free_candidates_;
+  bool retain_capacity_ = true;
 };
 
 // Segments is basically an array of Segment.
@@ -528,6 +545,12 @@ class Segments final {
   // clear segments
   void Clear();
 
+  // If true (default), the segments erased by Clear() are kept with their
+  // candidates for reuse, as the other erase methods always do.  This is also
+  // set to the retain_capacity() of the segments.
+  bool retain_capacity() const { return retain_capacity_; }
+  void set_retain_capacity(bool retain_capacity);
+
   // Dump Segments structure
   std::string DebugString() const;
 
@@ -555,6 +578,8 @@ class Segments final {
   std::vector<RevertEntry> revert_entries_;
   Lattice cached_lattice_;
   // LINT.ThenChange(//converter/segments_matchers.h)
+
+  bool retain_capacity_ = true;
 };
 
 // Inlining basic accessors here.
@@ -541,6 +541,88 @@ TEST(SegmentTest, Copy) {
   EXPECT_EQ(dest.meta_candidate(0).key, src.meta_candidate(0).key);
 }
 
+TEST(SegmentTest, RetainCapacity) {
+  Segment segment;
+  EXPECT_TRUE(segment.retain_capacity());
+
+  // Fills every field so that the reused candidate can be checked.
+  Segment::Candidate *candidate = segment.add_candidate();
+  candidate->key = "key";
+  candidate->value = "value";
+  candidate->content_key = "content_key";
+  candidate->content_value = "content_value";
+  candidate->consumed_key_size = 3;
+  candidate->prefix = "prefix";
+  candidate->suffix = "suffix";
+  candidate->description = "description";
+  candidate->a11y_description = "a11y_description";
+  candidate->usage_id = 1;
+  candidate->usage_title = "usage_title";
+  candidate->usage_description = "usage_description";
+  candidate->cost = 2;
+  candidate->wcost = 3;
+  candidate->structure_cost = 4;
+  candidate->lid = 5;
+  candidate->rid = 6;
+  candidate->attributes = Segment::Candidate::USER_DICTIONARY;
+  candidate->source_info = Segment::Candidate::USER_HISTORY_PREDICTOR;
+  candidate->category = Segment::Candidate::SYMBOL;
+  candidate->style = NumberUtil::NumberString::NUMBER_KANJI;
+  candidate->command = Segment::Candidate::ENABLE_INCOGNITO_MODE;
+  candidate->PushBackInnerSegmentBoundary(3, 5, 3, 5);
+  candidate->cost_before_rescoring = 7;
+  segment.add_candidate()->value = "erased";
+  segment.erase_candidate(1);
+
+  // The candidates, including the erased one, are reused after being cleared.
+  segment.Clear();
+  EXPECT_EQ(segment.candidates_size(), 0);
+  const Segment::Candidate *reused1 = segment.add_candidate();
+  const Segment::Candidate *reused2 = segment.push_front_candidate();
+  EXPECT_TRUE(reused1 == candidate || reused2 == candidate);
+  const Segment::Candidate expected;
+  for (const Segment::Candidate *reused : {reused1, reused2}) {
+    EXPECT_EQ(reused->DebugString(), expected.DebugString());
+    EXPECT_TRUE(reused->a11y_description.empty());
+    EXPECT_TRUE(reused->usage_title.empty());
+    EXPECT_TRUE(reused->usage_description.empty());
+    EXPECT_EQ(reused->usage_id, 0);
+    EXPECT_EQ(reused->category, Segment::Candidate::DEFAULT_CATEGORY);
+    EXPECT_EQ(reused->command, Segment::Candidate::DEFAULT_COMMAND);
+    EXPECT_EQ(reused->cost_before_rescoring, 0);
+    EXPECT_TRUE(reused->inner_segment_boundary.empty());
+  }
+
+  // Without retention, new candidates are allocated.
+  segment.set_retain_capacity(false);
+  segment.Clear();
+  segment.add_candidate()->value = "new";
+  EXPECT_EQ(segment.candidate(0).value, "new");
+}
+
+TEST(SegmentsTest, RetainCapacity) {
+  Segments segments;
+  EXPECT_TRUE(segments.retain_capacity());
+  Segment *segment = segments.add_segment();
+  segment->add_candidate()->value = "value";
+
+  // Clear() keeps the segment for the next conversion.
+  segments.Clear();
+  EXPECT_EQ(segments.segments_size(), 0);
+  EXPECT_EQ(segments.add_segment(), segment);
+  EXPECT_EQ(segment->candidates_size(), 0);
+  EXPECT_TRUE(segment->retain_capacity());
+
+  segments.set_retain_capacity(false);
+  EXPECT_FALSE(segment->retain_capacity());
+  EXPECT_FALSE(segments.push_back_segment()->retain_capacity());
+
+  // The setting is copied with the segments.
+  const Segments copied(segments);
+  EXPECT_FALSE(copied.retain_capacity());
+  EXPECT_FALSE(copied.segment(0).retain_capacity());
+}
+
 TEST(SegmentTest, MetaCandidateTest) {
   Segment segment;
 
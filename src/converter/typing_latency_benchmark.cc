@@ -0,0 +1,192 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark of the per-keystroke latency of suggestion conversions.
+//
+// Each test sentence is a typing session: it is typed one character at a
+// time, and after every few characters the last two characters are deleted
+// and typed again. Every keystroke converts the current key for suggestion
+// with the same Segments, as a session does. The latency is reported with
+// and without the incremental Viterbi over the cached lattice, in total and
+// by the length of the key.
+//
+// Usage:
+//   typing_latency_benchmark --iterations=3
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/stopwatch.h"
+#include "base/util.h"
+#include "converter/benchmark_util.h"
+#include "converter/immutable_converter.h"
+#include "converter/segments.h"
+#include "request/conversion_request.h"
+#include "session/random_keyevents_generator.h"
+#include "testing/benchmark_result.h"
+
+ABSL_DECLARE_FLAG(bool, use_incremental_prediction_viterbi);
+
+ABSL_FLAG(int32_t, iterations, 3, "Number of times to type all sentences.");
+ABSL_FLAG(int32_t, backspace_interval, 5,
+          "Deletes and retypes the last two characters every this number of "
+          "characters. 0 disables deletion.");
+
+namespace mozc {
+namespace {
+
+// Returns the keys after each keystroke to type `sentence`.
+std::vector<std::string> MakeTypingSession(absl::string_view sentence) {
+  const int interval = absl::GetFlag(FLAGS_backspace_interval);
+  std::vector<std::string> keys;
+  const size_t length = Util::CharsLen(sentence);
+  for (size_t len = 1; len <= length; ++len) {
+    keys.push_back(std::string(Util::Utf8SubString(sentence, 0, len)));
+    if (interval > 0 && len > 2 && len % interval == 0) {
+      keys.push_back(std::string(Util::Utf8SubString(sentence, 0, len - 1)));
+      keys.push_back(std::string(Util::Utf8SubString(sentence, 0, len - 2)));
+      keys.push_back(std::string(Util::Utf8SubString(sentence, 0, len - 1)));
+      keys.push_back(keys[keys.size() - 4]);
+    }
+  }
+  return keys;
+}
+
+absl::Duration Percentile(absl::Span<const absl::Duration> sorted, double p) {
+  if (sorted.empty()) {
+    return absl::ZeroDuration();
+  }
+  const size_t index = std::min(
+      sorted.size() - 1, static_cast<size_t>(p / 100.0 * sorted.size()));
+  return sorted[index];
+}
+
+void RunTyping(absl::string_view name, const ImmutableConverterImpl &converter,
+               absl::Span<const std::vector<std::string>> sessions,
+               bool incremental) {
+  absl::SetFlag(&FLAGS_use_incremental_prediction_viterbi, incremental);
+  ConversionRequest request;
+  request.set_request_type(ConversionRequest::SUGGESTION);
+
+  // Latencies bucketed by the number of characters in the key.
+  constexpr size_t kBucketWidth = 10;
+  constexpr size_t kNumBuckets = 4;
+  std::array<absl::Duration, kNumBuckets> bucket_elapsed = {};
+  std::array<int64_t, kNumBuckets> bucket_keystrokes = {};
+
+  std::vector<absl::Duration> latencies;
+  absl::Duration elapsed;
+  for (int i = 0; i < absl::GetFlag(FLAGS_iterations); ++i) {
+    for (const std::vector<std::string> &keys : sessions) {
+      Segments segments;
+      for (const std::string &key : keys) {
+        const Stopwatch stopwatch = Stopwatch::StartNew();
+        segments.clear_conversion_segments();
+        segments.add_segment()->set_key(key);
+        if (!converter.ConvertForRequest(request, &segments)) {
+          LOG(ERROR) << "Failed to convert: " << key;
+        }
+        const absl::Duration latency = stopwatch.GetElapsed();
+        elapsed += latency;
+        latencies.push_back(latency);
+        const size_t bucket =
+            std::min(kNumBuckets - 1, (Util::CharsLen(key) - 1) / kBucketWidth);
+        bucket_elapsed[bucket] += latency;
+        ++bucket_keystrokes[bucket];
+      }
+    }
+  }
+
+  testing::PrintBenchmarkResult(name, elapsed, latencies.size());
+  std::sort(latencies.begin(), latencies.end());
+  std::cout << absl::StrFormat(
+                   "  p50: %.1f us  p90: %.1f us  p99: %.1f us",
+                   absl::ToDoubleMicroseconds(Percentile(latencies, 50)),
+                   absl::ToDoubleMicroseconds(Percentile(latencies, 90)),
+                   absl::ToDoubleMicroseconds(Percentile(latencies, 99)))
+            << std::endl;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    if (bucket_keystrokes[i] == 0) {
+      continue;
+    }
+    const std::string range =
+        i + 1 == kNumBuckets
+            ? absl::StrFormat("%d-", i * kBucketWidth + 1)
+            : absl::StrFormat("%d-%d", i * kBucketWidth + 1,
+                              (i + 1) * kBucketWidth);
+    std::cout << absl::StrFormat(
+                     "  key length %s: %.1f us/keystroke (%d keystrokes)",
+                     range,
+                     absl::ToDoubleMicroseconds(bucket_elapsed[i] /
+                                                bucket_keystrokes[i]),
+                     bucket_keystrokes[i])
+              << std::endl;
+  }
+}
+
+void Run() {
+  const ImmutableConverterResources res;
+  const std::unique_ptr<ImmutableConverterImpl> converter =
+      res.CreateConverter();
+  std::vector<std::vector<std::string>> sessions;
+  for (const char *sentence :
+       session::RandomKeyEventsGenerator::GetTestSentences()) {
+    sessions.push_back(MakeTypingSession(sentence));
+  }
+
+  const bool original_incremental =
+      absl::GetFlag(FLAGS_use_incremental_prediction_viterbi);
+  RunTyping("keystroke/full_viterbi", *converter, sessions, false);
+  RunTyping("keystroke/incremental_viterbi", *converter, sessions, true);
+  absl::SetFlag(&FLAGS_use_incremental_prediction_viterbi,
+                original_incremental);
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  mozc::Run();
+  return 0;
+}
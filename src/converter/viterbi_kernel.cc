@@ -0,0 +1,181 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "converter/viterbi_kernel.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "base/logging.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define MOZC_VITERBI_KERNEL_X86
+#include <immintrin.h>
+#endif  // (__x86_64__ || __i386__) && (__GNUC__ || __clang__)
+
+namespace mozc {
+namespace viterbi_kernel {
+namespace {
+
+int FindBestPredecessorScalar(const int32_t *costs,
+                              const int32_t *transition_costs, size_t size,
+                              int32_t upper_bound, int32_t *min_cost) {
+  int best = -1;
+  for (size_t i = 0; i < size; ++i) {
+    const int32_t cost = costs[i] + transition_costs[i];
+    if (cost < upper_bound) {
+      upper_bound = cost;
+      best = static_cast<int>(i);
+    }
+  }
+  if (best >= 0) {
+    *min_cost = upper_bound;
+  }
+  return best;
+}
+
+// The vectorized versions first compute the minimum sum and then locate its
+// first occurrence with a scalar scan, so that ties are broken exactly as in
+// the scalar version.
+int FindFirstIndexOf(const int32_t *costs, const int32_t *transition_costs,
+                     size_t size, int32_t upper_bound, int32_t min,
+                     int32_t *min_cost) {
+  if (min >= upper_bound) {
+    return -1;
+  }
+  for (size_t i = 0; i < size; ++i) {
+    if (costs[i] + transition_costs[i] == min) {
+      *min_cost = min;
+      return static_cast<int>(i);
+    }
+  }
+  LOG(DFATAL) << "The minimum value must be found";
+  return -1;
+}
+
+#ifdef MOZC_VITERBI_KERNEL_X86
+
+__attribute__((target("sse4.1"))) int FindBestPredecessorSse41(
+    const int32_t *costs, const int32_t *transition_costs, size_t size,
+    int32_t upper_bound, int32_t *min_cost) {
+  __m128i vmin = _mm_set1_epi32(upper_bound);
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    const __m128i c =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(costs + i));
+    const __m128i t = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(transition_costs + i));
+    vmin = _mm_min_epi32(vmin, _mm_add_epi32(c, t));
+  }
+  vmin = _mm_min_epi32(vmin, _mm_shuffle_epi32(vmin, _MM_SHUFFLE(1, 0, 3, 2)));
+  vmin = _mm_min_epi32(vmin, _mm_shuffle_epi32(vmin, _MM_SHUFFLE(2, 3, 0, 1)));
+  int32_t min = _mm_cvtsi128_si32(vmin);
+  for (; i < size; ++i) {
+    min = std::min(min, costs[i] + transition_costs[i]);
+  }
+  return FindFirstIndexOf(costs, transition_costs, size, upper_bound, min,
+                          min_cost);
+}
+
+__attribute__((target("avx2"))) int FindBestPredecessorAvx2(
+    const int32_t *costs, const int32_t *transition_costs, size_t size,
+    int32_t upper_bound, int32_t *min_cost) {
+  __m256i vmin = _mm256_set1_epi32(upper_bound);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    const __m256i c =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(costs + i));
+    const __m256i t = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(transition_costs + i));
+    vmin = _mm256_min_epi32(vmin, _mm256_add_epi32(c, t));
+  }
+  __m128i vmin128 = _mm_min_epi32(_mm256_castsi256_si128(vmin),
+                                  _mm256_extracti128_si256(vmin, 1));
+  vmin128 = _mm_min_epi32(vmin128,
+                          _mm_shuffle_epi32(vmin128, _MM_SHUFFLE(1, 0, 3, 2)));
+  vmin128 = _mm_min_epi32(vmin128,
+                          _mm_shuffle_epi32(vmin128, _MM_SHUFFLE(2, 3, 0, 1)));
+  int32_t min = _mm_cvtsi128_si32(vmin128);
+  for (; i < size; ++i) {
+    min = std::min(min, costs[i] + transition_costs[i]);
+  }
+  return FindFirstIndexOf(costs, transition_costs, size, upper_bound, min,
+                          min_cost);
+}
+
+#endif  // MOZC_VITERBI_KERNEL_X86
+
+Isa DetectIsa() {
+#ifdef MOZC_VITERBI_KERNEL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return Isa::AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return Isa::SSE41;
+  }
+#endif  // MOZC_VITERBI_KERNEL_X86
+  return Isa::SCALAR;
+}
+
+}  // namespace
+
+Isa GetBestIsa() {
+  static const Isa kIsa = DetectIsa();
+  return kIsa;
+}
+
+int FindBestPredecessor(const int32_t *costs, const int32_t *transition_costs,
+                        size_t size, int32_t upper_bound, int32_t *min_cost) {
+  return FindBestPredecessorWithIsa(GetBestIsa(), costs, transition_costs, size,
+                                    upper_bound, min_cost);
+}
+
+int FindBestPredecessorWithIsa(Isa isa, const int32_t *costs,
+                               const int32_t *transition_costs, size_t size,
+                               int32_t upper_bound, int32_t *min_cost) {
+  switch (isa) {
+#ifdef MOZC_VITERBI_KERNEL_X86
+    case Isa::AVX2:
+      return FindBestPredecessorAvx2(costs, transition_costs, size,
+                                     upper_bound, min_cost);
+    case Isa::SSE41:
+      return FindBestPredecessorSse41(costs, transition_costs, size,
+                                      upper_bound, min_cost);
+#endif  // MOZC_VITERBI_KERNEL_X86
+    default:
+      return FindBestPredecessorScalar(costs, transition_costs, size,
+                                       upper_bound, min_cost);
+  }
+}
+
+}  // namespace viterbi_kernel
+}  // namespace mozc
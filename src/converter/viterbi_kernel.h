@@ -0,0 +1,83 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Min-reduction kernel for the best-predecessor search in Viterbi.
+//
+// Given the packed costs of the nodes ending at a position and the transition
+// costs from each of them to a right node, the kernel finds the first node
+// that minimizes `cost + transition_cost`. The result is identical to the
+// scalar loop below regardless of the instruction set used:
+//
+//   int best = -1;
+//   for (i = 0; i < size; ++i) {
+//     if (costs[i] + transition_costs[i] < upper_bound) {
+//       upper_bound = costs[i] + transition_costs[i];
+//       best = i;
+//     }
+//   }
+//
+// On x86, SSE4.1 and AVX2 implementations are selected at runtime by CPU
+// detection. Other platforms use the scalar implementation.
+
+#ifndef MOZC_CONVERTER_VITERBI_KERNEL_H_
+#define MOZC_CONVERTER_VITERBI_KERNEL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mozc {
+namespace viterbi_kernel {
+
+enum class Isa {
+  SCALAR,
+  SSE41,
+  AVX2,
+};
+
+// Returns the best instruction set available on this CPU.
+Isa GetBestIsa();
+
+// Returns the index of the first element minimizing
+// `costs[i] + transition_costs[i]` among those whose sum is less than
+// `upper_bound`, or -1 if there is no such element. The minimum sum is stored
+// to `min_cost` when an element is found. The caller must guarantee that the
+// sums do not overflow.
+int FindBestPredecessor(const int32_t *costs, const int32_t *transition_costs,
+                        size_t size, int32_t upper_bound, int32_t *min_cost);
+
+// Same as above but uses the specified instruction set. `isa` must be
+// supported by the CPU. Exposed for tests and benchmarks.
+int FindBestPredecessorWithIsa(Isa isa, const int32_t *costs,
+                               const int32_t *transition_costs, size_t size,
+                               int32_t upper_bound, int32_t *min_cost);
+
+}  // namespace viterbi_kernel
+}  // namespace mozc
+
+#endif  // MOZC_CONVERTER_VITERBI_KERNEL_H_
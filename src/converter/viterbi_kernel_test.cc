@@ -0,0 +1,127 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "converter/viterbi_kernel.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/random/random.h"
+#include "testing/gunit.h"
+
+namespace mozc {
+namespace viterbi_kernel {
+namespace {
+
+constexpr int32_t kUpperBound = INT32_MAX >> 2;
+
+std::vector<Isa> GetSupportedIsas() {
+  std::vector<Isa> isas = {Isa::SCALAR};
+  if (GetBestIsa() == Isa::SSE41 || GetBestIsa() == Isa::AVX2) {
+    isas.push_back(Isa::SSE41);
+  }
+  if (GetBestIsa() == Isa::AVX2) {
+    isas.push_back(Isa::AVX2);
+  }
+  return isas;
+}
+
+TEST(ViterbiKernelTest, Empty) {
+  for (const Isa isa : GetSupportedIsas()) {
+    int32_t min_cost = -1;
+    EXPECT_EQ(FindBestPredecessorWithIsa(isa, nullptr, nullptr, 0, kUpperBound,
+                                         &min_cost),
+              -1);
+    EXPECT_EQ(min_cost, -1);
+  }
+}
+
+TEST(ViterbiKernelTest, FirstMinimumWins) {
+  const std::vector<int32_t> costs = {10, 5, 3, 4, 3, 9, 2, 8, 3, 7, 1};
+  const std::vector<int32_t> transition_costs = {0, 0, 0, 0, 0, 0,
+                                                 1, 0, 0, 0, 2};
+  for (const Isa isa : GetSupportedIsas()) {
+    int32_t min_cost = 0;
+    EXPECT_EQ(FindBestPredecessorWithIsa(isa, costs.data(),
+                                         transition_costs.data(), costs.size(),
+                                         kUpperBound, &min_cost),
+              2);
+    EXPECT_EQ(min_cost, 3);
+  }
+}
+
+TEST(ViterbiKernelTest, UpperBoundIsExclusive) {
+  const std::vector<int32_t> costs = {kUpperBound, 100, kUpperBound};
+  const std::vector<int32_t> transition_costs = {0, 0, 5};
+  for (const Isa isa : GetSupportedIsas()) {
+    int32_t min_cost = 0;
+    EXPECT_EQ(FindBestPredecessorWithIsa(isa, costs.data(),
+                                         transition_costs.data(), costs.size(),
+                                         100, &min_cost),
+              -1);
+    EXPECT_EQ(FindBestPredecessorWithIsa(isa, costs.data(),
+                                         transition_costs.data(), costs.size(),
+                                         101, &min_cost),
+              1);
+    EXPECT_EQ(min_cost, 100);
+  }
+}
+
+TEST(ViterbiKernelTest, RandomInputsMatchScalar) {
+  absl::BitGen gen;
+  for (int trial = 0; trial < 1000; ++trial) {
+    const size_t size = absl::Uniform<size_t>(gen, 0, 100);
+    std::vector<int32_t> costs(size), transition_costs(size);
+    for (size_t i = 0; i < size; ++i) {
+      // Small ranges to produce many ties.
+      costs[i] = absl::Bernoulli(gen, 0.1) ? kUpperBound
+                                           : absl::Uniform<int32_t>(gen, 0, 50);
+      transition_costs[i] = absl::Uniform<int32_t>(gen, 0, 50);
+    }
+    int32_t expected_cost = 0;
+    const int expected = FindBestPredecessorWithIsa(
+        Isa::SCALAR, costs.data(), transition_costs.data(), size, kUpperBound,
+        &expected_cost);
+    for (const Isa isa : GetSupportedIsas()) {
+      int32_t actual_cost = 0;
+      EXPECT_EQ(FindBestPredecessorWithIsa(isa, costs.data(),
+                                           transition_costs.data(), size,
+                                           kUpperBound, &actual_cost),
+                expected);
+      if (expected >= 0) {
+        EXPECT_EQ(actual_cost, expected_cost);
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace viterbi_kernel
+}  // namespace mozc
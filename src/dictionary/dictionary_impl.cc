@@ -29,11 +29,14 @@
 
 #include "dictionary/dictionary_impl.h"
 
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "base/logging.h"
 #include "base/util.h"
 #include "dictionary/dictionary_interface.h"
@@ -170,6 +173,29 @@ void DictionaryImpl::LookupPrefix(absl::string_view key,
   }
 }
 
+void DictionaryImpl::LookupPrefixBatch(
+    absl::string_view key, absl::Span<const size_t> begin_positions,
+    const ConversionRequest &conversion_request,
+    absl::Span<Callback *const> callbacks) const {
+  DCHECK_EQ(begin_positions.size(), callbacks.size());
+  std::vector<CallbackWithFilter> callbacks_with_filter;
+  callbacks_with_filter.reserve(callbacks.size());
+  std::vector<Callback *> callback_ptrs;
+  callback_ptrs.reserve(callbacks.size());
+  for (Callback *callback : callbacks) {
+    callbacks_with_filter.emplace_back(
+        conversion_request.config().use_spelling_correction(),
+        conversion_request.config().use_zip_code_conversion(),
+        conversion_request.config().use_t13n_conversion(), pos_matcher_,
+        suppression_dictionary_, callback);
+    callback_ptrs.push_back(&callbacks_with_filter.back());
+  }
+  for (size_t i = 0; i < dics_.size(); ++i) {
+    dics_[i]->LookupPrefixBatch(key, begin_positions, conversion_request,
+                                callback_ptrs);
+  }
+}
+
 void DictionaryImpl::LookupExact(absl::string_view key,
                                  const ConversionRequest &conversion_request,
                                  Callback *callback) const {
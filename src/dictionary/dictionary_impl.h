@@ -30,11 +30,13 @@
 #ifndef MOZC_DICTIONARY_DICTIONARY_IMPL_H_
 #define MOZC_DICTIONARY_DICTIONARY_IMPL_H_
 
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "dictionary/dictionary_interface.h"
 #include "dictionary/pos_matcher.h"
 #include "dictionary/suppression_dictionary.h"
@@ -72,6 +74,10 @@ class DictionaryImpl : public DictionaryInterface {
   void LookupPrefix(absl::string_view key,
                     const ConversionRequest &conversion_request,
                     Callback *callback) const override;
+  void LookupPrefixBatch(absl::string_view key,
+                         absl::Span<const size_t> begin_positions,
+                         const ConversionRequest &conversion_request,
+                         absl::Span<Callback *const> callbacks) const override;
 
   void LookupExact(absl::string_view key,
                    const ConversionRequest &conversion_request,
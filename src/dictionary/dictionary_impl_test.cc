@@ -237,6 +237,46 @@ TEST_F(DictionaryImplTest, WordSuppressionTest) {
   }
 }
 
+TEST_F(DictionaryImplTest, LookupPrefixBatch) {
+  std::unique_ptr<DictionaryData> data = CreateDictionaryData();
+  DictionaryInterface *d = data->dictionary.get();
+  SuppressionDictionary *s = data->suppression_dictionary.get();
+
+  constexpr char kKey[] = "ぐーぐる";
+  constexpr char kValue[] = "グーグル";
+  // "ぐーぐる" starts at the 4th character.
+  constexpr absl::string_view kQuery = "それはぐーぐるは";
+  const size_t kBeginPositions[] = {0, 9};
+
+  // The entries are filtered for each suffix as with LookupPrefix().
+  s->Lock();
+  s->Clear();
+  s->AddEntry(kKey, kValue);
+  s->UnLock();
+  {
+    CheckKeyValueExistenceCallback callback0(kKey, kValue);
+    CheckKeyValueExistenceCallback callback1(kKey, kValue);
+    DictionaryInterface::Callback *const callbacks[] = {&callback0,
+                                                        &callback1};
+    d->LookupPrefixBatch(kQuery, kBeginPositions, convreq_, callbacks);
+    EXPECT_FALSE(callback0.found());
+    EXPECT_FALSE(callback1.found());
+  }
+
+  s->Lock();
+  s->Clear();
+  s->UnLock();
+  {
+    CheckKeyValueExistenceCallback callback0(kKey, kValue);
+    CheckKeyValueExistenceCallback callback1(kKey, kValue);
+    DictionaryInterface::Callback *const callbacks[] = {&callback0,
+                                                        &callback1};
+    d->LookupPrefixBatch(kQuery, kBeginPositions, convreq_, callbacks);
+    EXPECT_FALSE(callback0.found());
+    EXPECT_TRUE(callback1.found());
+  }
+}
+
 TEST_F(DictionaryImplTest, DisableSpellingCorrectionTest) {
   std::unique_ptr<DictionaryData> data = CreateDictionaryData();
   DictionaryInterface *d = data->dictionary.get();
@@ -30,10 +30,12 @@
 #ifndef MOZC_DICTIONARY_DICTIONARY_INTERFACE_H_
 #define MOZC_DICTIONARY_DICTIONARY_INTERFACE_H_
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "dictionary/dictionary_token.h"
 #include "request/conversion_request.h"
 
@@ -128,6 +130,24 @@ class DictionaryInterface {
                             const ConversionRequest &conversion_request,
                             Callback *callback) const = 0;
 
+  // Looks up values whose keys are prefixes of key.substr(begin_positions[i])
+  // and calls back callbacks[i] for them, for each i.  The results for each
+  // suffix are the same as those of LookupPrefix(); this default implementation
+  // just calls it for each suffix.  Dictionaries that can share work among the
+  // suffixes override this method.
+  // (e.g. key = "abc", begin_positions = {0, 1} -> LookupPrefix("abc") with
+  // callbacks[0] and LookupPrefix("bc") with callbacks[1])
+  // REQUIRES: begin_positions.size() == callbacks.size().
+  virtual void LookupPrefixBatch(absl::string_view key,
+                                 absl::Span<const size_t> begin_positions,
+                                 const ConversionRequest &conversion_request,
+                                 absl::Span<Callback *const> callbacks) const {
+    for (size_t i = 0; i < begin_positions.size(); ++i) {
+      LookupPrefix(key.substr(begin_positions[i]), conversion_request,
+                   callbacks[i]);
+    }
+  }
+
   // Looks up values whose keys are same with the key.
   // (e.g. key = "abc" -> {"abc": "ABC"})
   virtual void LookupExact(absl::string_view key,
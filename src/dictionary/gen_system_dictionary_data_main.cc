@@ -33,7 +33,15 @@
 //  --input="dictionary0.txt dictionary1.txt"
 //  --output="output.h"
 //  --make_header
+//
+// The build is parallelized with --system_dictionary_builder_threads=N, and
+// the time and the peak memory usage of each step are logged.
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif  // _WIN32
 
+#include <cstdint>
 #include <ios>
 #include <memory>
 #include <ostream>
@@ -50,6 +58,7 @@
 #include "base/file_stream.h"
 #include "base/init_mozc.h"
 #include "base/logging.h"
+#include "base/stopwatch.h"
 #include "data_manager/data_manager.h"
 #include "dictionary/pos_matcher.h"
 #include "dictionary/system/system_dictionary_builder.h"
@@ -91,6 +100,29 @@ std::pair<std::string, std::string> GetInputFileName(
           absl::StrJoin(reading_correction_inputs, kDelimiter)};
 }
 
+// Returns the peak resident set size of this process in bytes, or 0 if it's
+// not available.
+int64_t GetPeakRssBytes() {
+#ifdef _WIN32
+  return 0;
+#else   // _WIN32
+  struct rusage usage = {};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else   // __APPLE__
+  return static_cast<int64_t>(usage.ru_maxrss) * 1024;
+#endif  // __APPLE__
+#endif  // _WIN32
+}
+
+void LogStep(absl::string_view step, const Stopwatch &stopwatch) {
+  LOG(INFO) << step << ": " << stopwatch.GetElapsed()
+            << ", peak RSS: " << GetPeakRssBytes() / (1024 * 1024) << " MiB";
+}
+
 }  // namespace
 }  // namespace mozc
 
@@ -114,15 +146,23 @@ int main(int argc, char **argv) {
   const mozc::dictionary::PosMatcher pos_matcher(
       data_manager.GetPosMatcherData());
 
+  mozc::Stopwatch stopwatch = mozc::Stopwatch::StartNew();
   mozc::dictionary::TextDictionaryLoader loader(pos_matcher);
   loader.Load(system_dictionary_input, reading_correction_input);
+  mozc::LogStep("Load", stopwatch);
 
+  stopwatch.Reset();
+  stopwatch.Start();
   mozc::dictionary::SystemDictionaryBuilder builder;
   builder.BuildFromTokens(loader.tokens());
+  mozc::LogStep("Build", stopwatch);
 
+  stopwatch.Reset();
+  stopwatch.Start();
   std::unique_ptr<std::ostream> output_stream(new mozc::OutputFileStream(
       absl::GetFlag(FLAGS_output), std::ios::out | std::ios::binary));
   builder.WriteToStream(absl::GetFlag(FLAGS_output), output_stream.get());
+  mozc::LogStep("Write", stopwatch);
 
   return 0;
 }
@@ -62,9 +62,11 @@
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "base/japanese_util.h"
 #include "base/logging.h"
 #include "base/mmap.h"
+#include "base/strings/unicode.h"
 #include "base/util.h"
 #include "dictionary/dictionary_interface.h"
 #include "dictionary/dictionary_token.h"
@@ -78,6 +80,7 @@
 #include "request/conversion_request.h"
 #include "storage/louds/bit_vector_based_array.h"
 #include "storage/louds/louds_trie.h"
+#include "storage/louds/simple_succinct_bit_vector_index.h"
 
 namespace mozc {
 namespace dictionary {
@@ -432,8 +435,7 @@ SystemDictionary::Builder::Build() {
       return absl::InvalidArgumentError("Invalid spec type");
   }
 
-  if (!instance->OpenDictionaryFile(
-          (spec_->options & ENABLE_REVERSE_LOOKUP_INDEX) != 0)) {
+  if (!instance->OpenDictionaryFile(spec_->options)) {
     return absl::UnknownError("Failed to create system dictionary");
   }
 
@@ -449,14 +451,18 @@ SystemDictionary::SystemDictionary(
 
 SystemDictionary::~SystemDictionary() = default;
 
-bool SystemDictionary::OpenDictionaryFile(bool enable_reverse_lookup_index) {
+bool SystemDictionary::OpenDictionaryFile(Options options) {
+  using IndexType = storage::louds::SimpleSuccinctBitVectorIndex::IndexType;
+  const IndexType index_type = (options & ENABLE_TWO_LEVEL_BIT_VECTOR_INDEX)
+                                   ? IndexType::kTwoLevel
+                                   : IndexType::kChunk;
   int len;
 
   const uint8_t *key_image = reinterpret_cast<const uint8_t *>(
       dictionary_file_->GetSection(codec_->GetSectionNameForKey(), &len));
   if (!key_trie_.Open(key_image, kKeyTrieLb0CacheSize, kKeyTrieLb1CacheSize,
                       kKeyTrieSelect0CacheSize, kKeyTrieSelect1CacheSize,
-                      kKeyTrieTermvecCacheSize)) {
+                      kKeyTrieTermvecCacheSize, index_type)) {
     LOG(ERROR) << "cannot open key trie";
     return false;
   }
@@ -468,7 +474,7 @@ bool SystemDictionary::OpenDictionaryFile(bool enable_reverse_lookup_index) {
   if (!value_trie_.Open(value_image, kValueTrieLb0CacheSize,
                         kValueTrieLb1CacheSize, kValueTrieSelect0CacheSize,
                         kValueTrieSelect1CacheSize,
-                        kValueTrieTermvecCacheSize)) {
+                        kValueTrieTermvecCacheSize, index_type)) {
     LOG(ERROR) << "can not open value trie";
     return false;
   }
@@ -484,7 +490,7 @@ bool SystemDictionary::OpenDictionaryFile(bool enable_reverse_lookup_index) {
     return false;
   }
 
-  if (enable_reverse_lookup_index) {
+  if (options & ENABLE_REVERSE_LOOKUP_INDEX) {
     InitReverseLookupIndex();
   }
 
@@ -948,6 +954,57 @@ void SystemDictionary::LookupPrefix(absl::string_view key,
       LoudsTrie::Node(), 0, false, actual_key_buffer, &actual_prefix);
 }
 
+void SystemDictionary::LookupPrefixBatch(
+    absl::string_view key, absl::Span<const size_t> begin_positions,
+    const ConversionRequest &conversion_request,
+    absl::Span<Callback *const> callbacks) const {
+  DCHECK_EQ(begin_positions.size(), callbacks.size());
+  // The codec encodes each character independently, so the encoded suffix of
+  // |key| from a character boundary is the suffix of the encoded |key|.
+  // |encoded_offsets[pos]| is the offset in |encoded_key| for the boundary at
+  // |pos|, or -1 if |pos| is not a boundary.
+  std::string encoded_key;
+  codec_->EncodeKey(key, &encoded_key);
+  std::vector<int> encoded_offsets(key.size() + 1, -1);
+  size_t encoded_pos = 0;
+  for (size_t pos = 0; pos < key.size();) {
+    const size_t char_len =
+        std::min<size_t>(strings::OneCharLen(key[pos]), key.size() - pos);
+    encoded_offsets[pos] = encoded_pos;
+    encoded_pos += codec_->GetEncodedKeyLength(key.substr(pos, char_len));
+    pos += char_len;
+  }
+  encoded_offsets[key.size()] = encoded_pos;
+  const bool has_encoded_offsets = encoded_pos == encoded_key.size();
+
+  const bool use_key_expansion =
+      conversion_request.IsKanaModifierInsensitiveConversion();
+  char actual_key_buffer[LoudsTrie::kMaxDepth + 1];
+  std::string actual_prefix;
+  for (size_t i = 0; i < begin_positions.size(); ++i) {
+    const size_t begin = begin_positions[i];
+    DCHECK_LE(begin, key.size());
+    if (!has_encoded_offsets || encoded_offsets[begin] < 0) {
+      // Not a character boundary.
+      LookupPrefix(key.substr(begin), conversion_request, callbacks[i]);
+      continue;
+    }
+    const absl::string_view encoded_suffix =
+        absl::string_view(encoded_key).substr(encoded_offsets[begin]);
+    if (!use_key_expansion) {
+      RunCallbackOnEachPrefix(key_trie_, value_trie_, token_array_, codec_,
+                              frequent_pos_, key.data() + begin,
+                              encoded_suffix, callbacks[i], SelectAllTokens());
+      continue;
+    }
+    actual_prefix.reserve((key.size() - begin) * 3);
+    LookupPrefixWithKeyExpansionImpl(
+        key.data() + begin, encoded_suffix, hiragana_expansion_table_,
+        callbacks[i], LoudsTrie::Node(), 0, false, actual_key_buffer,
+        &actual_prefix);
+  }
+}
+
 void SystemDictionary::LookupExact(absl::string_view key,
                                    const ConversionRequest &conversion_request,
                                    Callback *callback) const {
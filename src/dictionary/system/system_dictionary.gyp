@@ -92,6 +92,7 @@
         'system_dictionary_builder.cc',
       ],
       'dependencies': [
+        '<(mozc_oss_src_dir)/base/base.gyp:base',
         '<(mozc_oss_src_dir)/base/base.gyp:base_core',
         '<(mozc_oss_src_dir)/base/base.gyp:japanese_util',
         '<(mozc_oss_src_dir)/storage/louds/louds.gyp:bit_vector_based_array_builder',
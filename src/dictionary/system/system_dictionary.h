@@ -30,6 +30,7 @@
 #ifndef MOZC_DICTIONARY_SYSTEM_SYSTEM_DICTIONARY_H_
 #define MOZC_DICTIONARY_SYSTEM_SYSTEM_DICTIONARY_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <set>
@@ -39,6 +40,7 @@
 #include "absl/container/btree_set.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "dictionary/dictionary_interface.h"
 #include "dictionary/file/codec_interface.h"
 #include "dictionary/file/dictionary_file.h"
@@ -61,6 +63,10 @@ class SystemDictionary : public DictionaryInterface {
     // from the id in value trie to the id in key trie.
     // That consumes more memory but we can perform reverse lookup more quickly.
     ENABLE_REVERSE_LOOKUP_INDEX = 1,
+    // If ENABLE_TWO_LEVEL_BIT_VECTOR_INDEX is set, the key and value tries use
+    // the two-level rank/select index, which makes lookups faster at the cost
+    // of more memory.
+    ENABLE_TWO_LEVEL_BIT_VECTOR_INDEX = 2,
   };
 
   // Builder class for system dictionary
@@ -146,6 +152,12 @@ class SystemDictionary : public DictionaryInterface {
                     const ConversionRequest &conversion_request,
                     Callback *callback) const override;
 
+  // Encodes |key| only once for all the suffixes.
+  void LookupPrefixBatch(absl::string_view key,
+                         absl::Span<const size_t> begin_positions,
+                         const ConversionRequest &conversion_request,
+                         absl::Span<Callback *const> callbacks) const override;
+
   void LookupExact(absl::string_view key,
                    const ConversionRequest &conversion_request,
                    Callback *callback) const override;
@@ -165,7 +177,7 @@ class SystemDictionary : public DictionaryInterface {
   SystemDictionary(const SystemDictionaryCodecInterface *codec,
                    const DictionaryFileCodecInterface *file_codec);
 
-  bool OpenDictionaryFile(bool enable_reverse_lookup_index);
+  bool OpenDictionaryFile(Options options);
 
   void RegisterReverseLookupTokensForT13N(absl::string_view value,
                                           Callback *callback) const;
@@ -27,3 +27,438 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+// Benchmark of the system dictionary.
+//
+// Rank and Select on the bit vectors of the key and value tries are measured
+// with random arguments for each index type of SimpleSuccinctBitVectorIndex,
+// followed by the trie traversals and the dictionary lookups with the tries
+// opened with each index type.  The child search by label is measured over
+// all the keys against the sibling-by-sibling scan.  The tries are also
+// rebuilt with dense child tables for the top levels to measure the prefix
+// searches on each layout.  The dictionary lookups report the heap
+// allocations per lookup as well.
+// The dictionary in the mock data set is used unless --dataset is given.
+//
+// Usage:
+//   system_dictionary_benchmark --num_queries=1000000
+//   system_dictionary_benchmark --dataset=/path/to/mozc.data
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/random/random.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "base/bits.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/status.h"
+#include "base/stopwatch.h"
+#include "base/strings/unicode.h"
+#include "data_manager/data_manager.h"
+#include "data_manager/testing/mock_data_manager.h"
+#include "dictionary/dictionary_interface.h"
+#include "dictionary/dictionary_token.h"
+#include "dictionary/file/codec_factory.h"
+#include "dictionary/file/dictionary_file.h"
+#include "dictionary/system/codec_interface.h"
+#include "dictionary/system/system_dictionary.h"
+#include "request/conversion_request.h"
+#include "storage/louds/louds_trie.h"
+#include "storage/louds/louds_trie_builder.h"
+#include "storage/louds/simple_succinct_bit_vector_index.h"
+#include "testing/allocation_counter.h"
+#include "testing/benchmark_result.h"
+
+ABSL_FLAG(int32_t, num_queries, 1000000,
+          "Number of rank/select queries for each bit vector.");
+ABSL_FLAG(int32_t, num_keys, 100000,
+          "Number of keys for the trie and dictionary lookups.");
+ABSL_FLAG(std::string, dataset, "",
+          "Data set file to read the dictionary from. The mock data set is "
+          "used if empty.");
+
+namespace mozc {
+namespace dictionary {
+namespace {
+
+using ::mozc::storage::louds::LoudsTrie;
+using ::mozc::storage::louds::LoudsTrieBuilder;
+using ::mozc::storage::louds::SimpleSuccinctBitVectorIndex;
+using IndexType = SimpleSuccinctBitVectorIndex::IndexType;
+
+constexpr IndexType kIndexTypes[] = {IndexType::kChunk, IndexType::kTwoLevel};
+
+absl::string_view IndexTypeName(IndexType index_type) {
+  return index_type == IndexType::kChunk ? "chunk" : "two_level";
+}
+
+// Bit vector images in a trie section; see louds_trie.cc for the format.
+struct TrieImage {
+  const uint8_t *louds;
+  int louds_size;
+  const uint8_t *terminal;
+  int terminal_size;
+};
+
+TrieImage ParseTrieImage(const uint8_t *image) {
+  TrieImage result;
+  result.louds_size = LoadUnalignedAdvance<uint32_t>(image);
+  result.terminal_size = LoadUnalignedAdvance<uint32_t>(image);
+  image += 8;  // Skips num character bits and edge character size.
+  result.louds = image;
+  result.terminal = image + result.louds_size;
+  return result;
+}
+
+// Returns random arguments in [min, max].
+std::vector<int> RandomArgs(absl::BitGen &gen, int min, int max) {
+  std::vector<int> args(absl::GetFlag(FLAGS_num_queries));
+  for (int &arg : args) {
+    arg = absl::Uniform<int>(absl::IntervalClosed, gen, min, max);
+  }
+  return args;
+}
+
+// The results are accumulated so that the calls are not optimized out.
+template <typename Func>
+void RunQueries(absl::string_view name, const std::vector<int> &args,
+                Func func) {
+  int64_t sum = 0;
+  const Stopwatch stopwatch = Stopwatch::StartNew();
+  for (const int arg : args) {
+    sum += func(arg);
+  }
+  testing::PrintBenchmarkResult(name, stopwatch.GetElapsed(), args.size());
+  VLOG(1) << name << ": " << sum;
+}
+
+void RunRankSelect(absl::string_view name, const uint8_t *data, int length) {
+  absl::BitGen gen;
+  for (const IndexType index_type : kIndexTypes) {
+    SimpleSuccinctBitVectorIndex index;
+    index.Init(data, length, 1024, 1024, index_type);
+    const std::string prefix =
+        absl::StrCat(name, "/", IndexTypeName(index_type));
+    const std::vector<int> rank_args = RandomArgs(gen, 0, 8 * length);
+    const std::vector<int> select0_args =
+        RandomArgs(gen, 1, index.GetNum0Bits());
+    const std::vector<int> select1_args =
+        RandomArgs(gen, 1, index.GetNum1Bits());
+    RunQueries(absl::StrCat(prefix, "/rank1"), rank_args,
+               [&index](int n) { return index.Rank1(n); });
+    RunQueries(absl::StrCat(prefix, "/select0"), select0_args,
+               [&index](int n) { return index.Select0(n); });
+    RunQueries(absl::StrCat(prefix, "/select1"), select1_args,
+               [&index](int n) { return index.Select1(n); });
+  }
+}
+
+// Picks random keys from the trie.
+std::vector<std::string> SampleKeys(const uint8_t *image) {
+  LoudsTrie trie;
+  CHECK(trie.Open(image));
+  const TrieImage trie_image = ParseTrieImage(image);
+  SimpleSuccinctBitVectorIndex terminal;
+  terminal.Init(trie_image.terminal, trie_image.terminal_size);
+
+  absl::BitGen gen;
+  std::vector<std::string> keys(absl::GetFlag(FLAGS_num_keys));
+  char buf[LoudsTrie::kMaxDepth + 1];
+  for (std::string &key : keys) {
+    const int key_id = absl::Uniform<int>(gen, 0, terminal.GetNum1Bits());
+    key = std::string(trie.RestoreKeyString(key_id, buf));
+  }
+  return keys;
+}
+
+void RunTrie(absl::string_view name, const uint8_t *image) {
+  const std::vector<std::string> keys = SampleKeys(image);
+  for (const IndexType index_type : kIndexTypes) {
+    LoudsTrie trie;
+    CHECK(trie.Open(image, 1024, 1024, 4096, 4096, 1024, index_type));
+    const std::string prefix =
+        absl::StrCat(name, "/", IndexTypeName(index_type));
+
+    std::vector<int> key_ids;
+    key_ids.reserve(keys.size());
+    int64_t sum = 0;
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    for (const std::string &key : keys) {
+      key_ids.push_back(trie.ExactSearch(key));
+    }
+    testing::PrintBenchmarkResult(absl::StrCat(prefix, "/exact_search"),
+                                  stopwatch.GetElapsed(), keys.size());
+
+    char buf[LoudsTrie::kMaxDepth + 1];
+    stopwatch = Stopwatch::StartNew();
+    for (const int key_id : key_ids) {
+      sum += trie.RestoreKeyString(key_id, buf).size();
+    }
+    testing::PrintBenchmarkResult(absl::StrCat(prefix, "/restore_key"),
+                                  stopwatch.GetElapsed(), key_ids.size());
+    VLOG(1) << prefix << ": " << sum;
+  }
+}
+
+// Returns all the keys in the trie in the order of key ID.
+std::vector<std::string> RestoreAllKeys(const uint8_t *image) {
+  LoudsTrie trie;
+  CHECK(trie.Open(image));
+  const TrieImage trie_image = ParseTrieImage(image);
+  SimpleSuccinctBitVectorIndex terminal;
+  terminal.Init(trie_image.terminal, trie_image.terminal_size);
+  std::vector<std::string> keys(terminal.GetNum1Bits());
+  char buf[LoudsTrie::kMaxDepth + 1];
+  for (int key_id = 0; key_id < keys.size(); ++key_id) {
+    keys[key_id] = std::string(trie.RestoreKeyString(key_id, buf));
+  }
+  return keys;
+}
+
+// Moves |node| to its child by scanning the siblings one by one, which is
+// the reference for LoudsTrie::MoveToChildByLabel.
+bool ScanChildByLabel(const LoudsTrie &trie, char label,
+                      LoudsTrie::Node *node) {
+  trie.MoveToFirstChild(node);
+  while (trie.IsValidNode(*node)) {
+    if (trie.GetEdgeLabelToParentNode(*node) == label) {
+      return true;
+    }
+    LoudsTrie::MoveToNextSibling(node);
+  }
+  return false;
+}
+
+// Traverses the trie for all the keys with the sibling scan and with
+// LoudsTrie::MoveToChildByLabel, and checks that both reach the same nodes.
+void RunChildSearch(absl::string_view name, const uint8_t *image) {
+  const std::vector<std::string> keys = RestoreAllKeys(image);
+  LoudsTrie trie;
+  CHECK(trie.Open(image));
+
+  std::vector<LoudsTrie::Node> expected(keys.size());
+  Stopwatch stopwatch = Stopwatch::StartNew();
+  for (int i = 0; i < keys.size(); ++i) {
+    for (const char c : keys[i]) {
+      ScanChildByLabel(trie, c, &expected[i]);
+    }
+  }
+  testing::PrintBenchmarkResult(absl::StrCat(name, "/all_keys/scan_siblings"),
+                                stopwatch.GetElapsed(), keys.size());
+
+  std::vector<LoudsTrie::Node> actual(keys.size());
+  stopwatch = Stopwatch::StartNew();
+  for (int i = 0; i < keys.size(); ++i) {
+    trie.Traverse(keys[i], &actual[i]);
+  }
+  testing::PrintBenchmarkResult(
+      absl::StrCat(name, "/all_keys/move_to_child_by_label"),
+      stopwatch.GetElapsed(), keys.size());
+  CHECK(actual == expected);
+}
+
+// Rebuilds the trie with each number of dense levels and measures the prefix
+// and exact searches on it.
+void RunDenseLevels(absl::string_view name, const uint8_t *image) {
+  const std::vector<std::string> all_keys = RestoreAllKeys(image);
+  const std::vector<std::string> keys = SampleKeys(image);
+
+  for (int dense_levels = 0; dense_levels <= 2; ++dense_levels) {
+    LoudsTrieBuilder builder;
+    for (const std::string &key : all_keys) {
+      builder.Add(key);
+    }
+    builder.set_dense_levels(dense_levels);
+    builder.Build();
+    LoudsTrie dense_trie;
+    CHECK(dense_trie.Open(
+        reinterpret_cast<const uint8_t *>(builder.image().data())));
+    const std::string prefix =
+        absl::StrCat(name, "/dense_levels_", dense_levels);
+    std::cout << absl::StrFormat("%-48s %12d bytes",
+                                 absl::StrCat(prefix, "/image_size"),
+                                 builder.image().size())
+              << std::endl;
+
+    int64_t sum = 0;
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    for (const std::string &key : keys) {
+      dense_trie.PrefixSearch(
+          key, [&sum](absl::string_view key, size_t prefix_len,
+                      const LoudsTrie &trie, LoudsTrie::Node node) {
+            sum += trie.GetKeyIdOfTerminalNode(node);
+          });
+    }
+    testing::PrintBenchmarkResult(absl::StrCat(prefix, "/prefix_search"),
+                                  stopwatch.GetElapsed(), keys.size());
+
+    stopwatch = Stopwatch::StartNew();
+    for (const std::string &key : keys) {
+      sum += dense_trie.ExactSearch(key);
+    }
+    testing::PrintBenchmarkResult(absl::StrCat(prefix, "/exact_search"),
+                                  stopwatch.GetElapsed(), keys.size());
+    VLOG(1) << prefix << ": " << sum;
+  }
+}
+
+class CountingCallback : public DictionaryInterface::Callback {
+ public:
+  ResultType OnToken(absl::string_view key, absl::string_view expanded_key,
+                     const Token &token_info) override {
+    ++num_tokens_;
+    return TRAVERSE_CONTINUE;
+  }
+
+  int64_t num_tokens() const { return num_tokens_; }
+
+ private:
+  int64_t num_tokens_ = 0;
+};
+
+void RunLookup(absl::string_view data, const uint8_t *key_image) {
+  const std::vector<std::string> keys = SampleKeys(key_image);
+  // Sentences of four keys and the character boundaries in them.
+  std::vector<std::string> sentences;
+  std::vector<std::vector<size_t>> begin_positions;
+  for (size_t i = 0; i + 4 <= keys.size(); i += 4) {
+    sentences.push_back(
+        absl::StrCat(keys[i], keys[i + 1], keys[i + 2], keys[i + 3]));
+    std::vector<size_t> &positions = begin_positions.emplace_back();
+    for (const absl::string_view c : Utf8AsChars(sentences.back())) {
+      positions.push_back(c.data() - sentences.back().data());
+    }
+  }
+  const ConversionRequest request;
+  for (const IndexType index_type : kIndexTypes) {
+    const SystemDictionary::Options options =
+        index_type == IndexType::kTwoLevel
+            ? SystemDictionary::ENABLE_TWO_LEVEL_BIT_VECTOR_INDEX
+            : SystemDictionary::NONE;
+    std::unique_ptr<SystemDictionary> dictionary =
+        SystemDictionary::Builder(data.data(), data.size())
+            .SetOptions(options)
+            .Build()
+            .value();
+    const std::string prefix =
+        absl::StrCat("dictionary/", IndexTypeName(index_type));
+
+    CountingCallback callback;
+    testing::AllocationCounter counter;
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    for (const std::string &key : keys) {
+      dictionary->LookupExact(key, request, &callback);
+    }
+    testing::PrintBenchmarkResult(absl::StrCat(prefix, "/lookup_exact"),
+                                  stopwatch.GetElapsed(), keys.size(),
+                                  counter.allocations());
+
+    counter.Reset();
+    stopwatch = Stopwatch::StartNew();
+    for (const std::string &key : keys) {
+      dictionary->LookupPrefix(key, request, &callback);
+    }
+    testing::PrintBenchmarkResult(absl::StrCat(prefix, "/lookup_prefix"),
+                                  stopwatch.GetElapsed(), keys.size(),
+                                  counter.allocations());
+
+    counter.Reset();
+    stopwatch = Stopwatch::StartNew();
+    for (const std::string &key : keys) {
+      dictionary->LookupPredictive(key, request, &callback);
+    }
+    testing::PrintBenchmarkResult(absl::StrCat(prefix, "/lookup_predictive"),
+                                  stopwatch.GetElapsed(), keys.size(),
+                                  counter.allocations());
+
+    // Looks up all the suffixes of the sentences, as the converter does.
+    int64_t num_suffixes = 0;
+    counter.Reset();
+    stopwatch = Stopwatch::StartNew();
+    for (size_t i = 0; i < sentences.size(); ++i) {
+      for (const size_t begin : begin_positions[i]) {
+        dictionary->LookupPrefix(absl::string_view(sentences[i]).substr(begin),
+                                 request, &callback);
+        ++num_suffixes;
+      }
+    }
+    testing::PrintBenchmarkResult(
+        absl::StrCat(prefix, "/lookup_prefix_suffixes"), stopwatch.GetElapsed(),
+        num_suffixes, counter.allocations());
+
+    std::vector<CountingCallback> batch_callbacks;
+    std::vector<DictionaryInterface::Callback *> callback_ptrs;
+    counter.Reset();
+    stopwatch = Stopwatch::StartNew();
+    for (size_t i = 0; i < sentences.size(); ++i) {
+      batch_callbacks.assign(begin_positions[i].size(), CountingCallback());
+      callback_ptrs.clear();
+      for (CountingCallback &batch_callback : batch_callbacks) {
+        callback_ptrs.push_back(&batch_callback);
+      }
+      dictionary->LookupPrefixBatch(sentences[i], begin_positions[i], request,
+                                    callback_ptrs);
+    }
+    testing::PrintBenchmarkResult(absl::StrCat(prefix, "/lookup_prefix_batch"),
+                                  stopwatch.GetElapsed(), num_suffixes,
+                                  counter.allocations());
+    VLOG(1) << prefix << ": " << callback.num_tokens();
+  }
+}
+
+void Run() {
+  std::unique_ptr<DataManager> data_manager;
+  if (absl::GetFlag(FLAGS_dataset).empty()) {
+    data_manager = std::make_unique<testing::MockDataManager>();
+  } else {
+    data_manager = DataManager::CreateFromFile(absl::GetFlag(FLAGS_dataset))
+                       .value();
+  }
+  const char *data = nullptr;
+  int size = 0;
+  data_manager->GetSystemDictionaryData(&data, &size);
+
+  DictionaryFile file(DictionaryFileCodecFactory::GetCodec());
+  CHECK_OK(file.OpenFromImage(data, size));
+  const SystemDictionaryCodecInterface *codec =
+      SystemDictionaryCodecFactory::GetCodec();
+  int len = 0;
+  const uint8_t *key_image = reinterpret_cast<const uint8_t *>(
+      file.GetSection(codec->GetSectionNameForKey(), &len));
+  const uint8_t *value_image = reinterpret_cast<const uint8_t *>(
+      file.GetSection(codec->GetSectionNameForValue(), &len));
+
+  const TrieImage key_trie = ParseTrieImage(key_image);
+  const TrieImage value_trie = ParseTrieImage(value_image);
+  RunRankSelect("key_trie/louds", key_trie.louds, key_trie.louds_size);
+  RunRankSelect("key_trie/terminal", key_trie.terminal,
+                key_trie.terminal_size);
+  RunRankSelect("value_trie/louds", value_trie.louds, value_trie.louds_size);
+  RunRankSelect("value_trie/terminal", value_trie.terminal,
+                value_trie.terminal_size);
+
+  RunTrie("key_trie", key_image);
+  RunTrie("value_trie", value_image);
+  RunChildSearch("key_trie", key_image);
+  RunChildSearch("value_trie", value_image);
+  RunDenseLevels("key_trie", key_image);
+  RunDenseLevels("value_trie", value_image);
+  RunLookup(absl::string_view(data, size), key_image);
+}
+
+}  // namespace
+}  // namespace dictionary
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  mozc::dictionary::Run();
+  return 0;
+}
@@ -30,9 +30,11 @@
 #include "dictionary/system/system_dictionary_builder.h"
 
 #include <algorithm>
+#include <atomic>
 #include <climits>
 #include <cstdint>
 #include <cstring>
+#include <functional>
 #include <ios>
 #include <map>
 #include <memory>
@@ -45,13 +47,17 @@
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/flags/flag.h"
+#include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "base/file_stream.h"
 #include "base/file_util.h"
 #include "base/japanese_util.h"
 #include "base/logging.h"
+#include "base/stopwatch.h"
+#include "base/thread.h"
 #include "base/util.h"
 #include "dictionary/dictionary_token.h"
 #include "dictionary/file/codec_interface.h"
@@ -65,6 +71,15 @@ ABSL_FLAG(bool, preserve_intermediate_dictionary, false,
           "preserve inetemediate dictionary file.");
 ABSL_FLAG(int32_t, min_key_length_to_use_small_cost_encoding, 6,
           "minimum key length to use 1 byte cost encoding.");
+ABSL_FLAG(int32_t, louds_trie_dense_levels, 0,
+          "number of the top levels of the key and value tries whose children "
+          "are stored in dense tables (0 to 2).");
+ABSL_FLAG(int32_t, system_dictionary_builder_threads, 1,
+          "number of threads to build the system dictionary with. The output "
+          "doesn't depend on the number of threads.");
+ABSL_FLAG(bool, system_dictionary_builder_sorted_input, false,
+          "the input tokens are already sorted by key, e.g. by an external "
+          "sort, so the builder only checks the order instead of sorting.");
 
 namespace mozc {
 namespace dictionary {
@@ -85,6 +100,54 @@ struct TokenGreaterThan {
   }
 };
 
+int GetNumThreads() {
+  return std::max(absl::GetFlag(FLAGS_system_dictionary_builder_threads), 1);
+}
+
+// Runs |tasks| on GetNumThreads() threads at most, and waits for them.
+void RunTasks(absl::Span<const std::function<void()>> tasks) {
+  const size_t num_threads =
+      std::min<size_t>(GetNumThreads(), tasks.size());
+  if (num_threads <= 1) {
+    for (const std::function<void()> &task : tasks) {
+      task();
+    }
+    return;
+  }
+  std::atomic<size_t> next_task = 0;
+  std::vector<Thread> threads;
+  threads.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads.emplace_back([tasks, &next_task] {
+      for (size_t j = next_task++; j < tasks.size(); j = next_task++) {
+        tasks[j]();
+      }
+    });
+  }
+  for (Thread &thread : threads) {
+    thread.Join();
+  }
+}
+
+// Calls |func(i)| for every i in [0, size), splitting the range into a chunk
+// per thread.
+void ParallelFor(size_t size, absl::FunctionRef<void(size_t)> func) {
+  const size_t num_chunks =
+      std::max<size_t>(std::min<size_t>(GetNumThreads(), size), 1);
+  const size_t chunk_size = (size + num_chunks - 1) / num_chunks;
+  std::vector<std::function<void()>> tasks;
+  tasks.reserve(num_chunks);
+  for (size_t begin = 0; begin < size; begin += chunk_size) {
+    const size_t end = std::min(begin + chunk_size, size);
+    tasks.push_back([func, begin, end] {
+      for (size_t i = begin; i < end; ++i) {
+        func(i);
+      }
+    });
+  }
+  RunTasks(tasks);
+}
+
 void WriteSectionToFile(const DictionaryFileSection &section,
                         const std::string &filename) {
   if (absl::Status s = FileUtil::SetContents(
@@ -108,20 +171,31 @@ void SystemDictionaryBuilder::BuildFromTokens(
 
 void SystemDictionaryBuilder::BuildFromTokensInternal(
     std::vector<Token *> tokens) {
+  LOG(INFO) << "Building the system dictionary with " << GetNumThreads()
+            << " threads.";
+  Stopwatch stopwatch = Stopwatch::StartNew();
   KeyInfoList key_info_list = ReadTokens(std::move(tokens));
-
-  BuildFrequentPos(key_info_list);
-  BuildValueTrie(key_info_list);
-  BuildKeyTrie(key_info_list);
-
-  SetIdForValue(&key_info_list);
-  SetIdForKey(&key_info_list);
-  SortTokenInfo(&key_info_list);
-  SetCostType(&key_info_list);
-  SetPosType(&key_info_list);
-  SetValueType(&key_info_list);
-
+  LOG(INFO) << "ReadTokens: " << stopwatch.GetElapsed();
+
+  stopwatch.Reset();
+  stopwatch.Start();
+  RunTasks({
+      [&] { BuildValueTrie(key_info_list); },
+      [&] { BuildKeyTrie(key_info_list); },
+      [&] { BuildFrequentPos(key_info_list); },
+  });
+  LOG(INFO) << "BuildValueTrie, BuildKeyTrie, BuildFrequentPos: "
+            << stopwatch.GetElapsed();
+
+  stopwatch.Reset();
+  stopwatch.Start();
+  SetTokenInfo(&key_info_list);
+  LOG(INFO) << "SetTokenInfo: " << stopwatch.GetElapsed();
+
+  stopwatch.Reset();
+  stopwatch.Start();
   BuildTokenArray(key_info_list);
+  LOG(INFO) << "BuildTokenArray: " << stopwatch.GetElapsed();
 }
 
 void SystemDictionaryBuilder::WriteToFile(
@@ -242,9 +316,15 @@ SystemDictionaryBuilder::KeyInfoList SystemDictionaryBuilder::ReadTokens(
   //    [KeyInfo(key:aaa)[Token 1][Token 2]][KeyInfo(key:abc)[Token 3]][...]
 
   // Step 1.
-  std::stable_sort(
-      tokens.begin(), tokens.end(),
-      [](const Token *l, const Token *r) { return l->key < r->key; });
+  const auto key_less = [](const Token *l, const Token *r) {
+    return l->key < r->key;
+  };
+  if (absl::GetFlag(FLAGS_system_dictionary_builder_sorted_input)) {
+    CHECK(std::is_sorted(tokens.begin(), tokens.end(), key_less))
+        << "input tokens are not sorted by key";
+  } else {
+    std::stable_sort(tokens.begin(), tokens.end(), key_less);
+  }
 
   // Step 2.
   KeyInfoList key_info_list;
@@ -327,27 +407,12 @@ void SystemDictionaryBuilder::BuildValueTrie(const KeyInfoList &key_info_list) {
       value_trie_builder_.Add(value_str);
     }
   }
+  value_trie_builder_.set_dense_levels(
+      absl::GetFlag(FLAGS_louds_trie_dense_levels));
   value_trie_builder_.Build();
 }
 
-void SystemDictionaryBuilder::SetIdForValue(KeyInfoList *key_info_list) const {
-  for (KeyInfo &key_info : *key_info_list) {
-    for (TokenInfo &token_info : key_info.tokens) {
-      std::string value_str;
-      codec_->EncodeValue(token_info.token->value, &value_str);
-      token_info.id_in_value_trie = value_trie_builder_.GetId(value_str);
-    }
-  }
-}
-
-void SystemDictionaryBuilder::SortTokenInfo(KeyInfoList *key_info_list) const {
-  for (KeyInfo &key_info : *key_info_list) {
-    std::sort(key_info.tokens.begin(), key_info.tokens.end(),
-              TokenGreaterThan());
-  }
-}
-
-void SystemDictionaryBuilder::SetCostType(KeyInfoList *key_info_list) const {
+void SystemDictionaryBuilder::SetTokenInfo(KeyInfoList *key_info_list) const {
   // Values that have multiple keys.
   absl::flat_hash_set<absl::string_view> heterophone_values;
   {
@@ -372,64 +437,86 @@ void SystemDictionaryBuilder::SetCostType(KeyInfoList *key_info_list) const {
     }
   }
 
+  ParallelFor(key_info_list->size(), [&](size_t i) {
+    KeyInfo *key_info = &(*key_info_list)[i];
+    SetIdForValue(key_info);
+    SetIdForKey(key_info);
+    SortTokenInfo(key_info);
+    SetCostType(heterophone_values, key_info);
+    SetPosType(key_info);
+    SetValueType(key_info);
+  });
+}
+
+void SystemDictionaryBuilder::SetIdForValue(KeyInfo *key_info) const {
+  std::string value_str;
+  for (TokenInfo &token_info : key_info->tokens) {
+    value_str.clear();
+    codec_->EncodeValue(token_info.token->value, &value_str);
+    token_info.id_in_value_trie = value_trie_builder_.GetId(value_str);
+  }
+}
+
+void SystemDictionaryBuilder::SortTokenInfo(KeyInfo *key_info) const {
+  std::sort(key_info->tokens.begin(), key_info->tokens.end(),
+            TokenGreaterThan());
+}
+
+void SystemDictionaryBuilder::SetCostType(
+    const absl::flat_hash_set<absl::string_view> &heterophone_values,
+    KeyInfo *key_info) const {
   const int min_key_len =
       absl::GetFlag(FLAGS_min_key_length_to_use_small_cost_encoding);
-  for (KeyInfo &key_info : *key_info_list) {
-    if (Util::CharsLen(key_info.key) < min_key_len) {
-      // Do not use small cost encoding for short keys.
-      continue;
-    }
-    if (HasHomonymsInSamePos(key_info)) {
-      continue;
-    }
-    if (HasHeterophones(key_info, heterophone_values)) {
-      // We want to keep the cost order for LookupReverse().
-      continue;
-    }
+  if (Util::CharsLen(key_info->key) < min_key_len) {
+    // Do not use small cost encoding for short keys.
+    return;
+  }
+  if (HasHomonymsInSamePos(*key_info)) {
+    return;
+  }
+  if (HasHeterophones(*key_info, heterophone_values)) {
+    // We want to keep the cost order for LookupReverse().
+    return;
+  }
 
-    for (TokenInfo &token_info : key_info.tokens) {
-      if (token_info.token->cost < 0x100) {
-        // Small cost encoding ignores lower 8 bits.
-        continue;
-      }
-      token_info.cost_type = TokenInfo::CAN_USE_SMALL_ENCODING;
+  for (TokenInfo &token_info : key_info->tokens) {
+    if (token_info.token->cost < 0x100) {
+      // Small cost encoding ignores lower 8 bits.
+      continue;
     }
+    token_info.cost_type = TokenInfo::CAN_USE_SMALL_ENCODING;
   }
 }
 
-void SystemDictionaryBuilder::SetPosType(KeyInfoList *key_info_list) const {
-  for (KeyInfo &key_info : *key_info_list) {
-    for (size_t i = 0; i < key_info.tokens.size(); ++i) {
-      TokenInfo *token_info = &(key_info.tokens[i]);
-      const uint32_t pos =
-          GetCombinedPos(token_info->token->lid, token_info->token->rid);
-      if (auto iter = frequent_pos_.find(pos); iter != frequent_pos_.end()) {
-        token_info->pos_type = TokenInfo::FREQUENT_POS;
-        token_info->id_in_frequent_pos_map = iter->second;
-      }
-      if (i >= 1) {
-        const TokenInfo &prev_token_info = key_info.tokens[i - 1];
-        const uint32_t prev_pos = GetCombinedPos(prev_token_info.token->lid,
-                                                 prev_token_info.token->rid);
-        if (prev_pos == pos) {
-          // we can overwrite FREQUENT_POS
-          token_info->pos_type = TokenInfo::SAME_AS_PREV_POS;
-        }
+void SystemDictionaryBuilder::SetPosType(KeyInfo *key_info) const {
+  for (size_t i = 0; i < key_info->tokens.size(); ++i) {
+    TokenInfo *token_info = &(key_info->tokens[i]);
+    const uint32_t pos =
+        GetCombinedPos(token_info->token->lid, token_info->token->rid);
+    if (auto iter = frequent_pos_.find(pos); iter != frequent_pos_.end()) {
+      token_info->pos_type = TokenInfo::FREQUENT_POS;
+      token_info->id_in_frequent_pos_map = iter->second;
+    }
+    if (i >= 1) {
+      const TokenInfo &prev_token_info = key_info->tokens[i - 1];
+      const uint32_t prev_pos = GetCombinedPos(prev_token_info.token->lid,
+                                               prev_token_info.token->rid);
+      if (prev_pos == pos) {
+        // we can overwrite FREQUENT_POS
+        token_info->pos_type = TokenInfo::SAME_AS_PREV_POS;
       }
     }
   }
 }
 
-void SystemDictionaryBuilder::SetValueType(KeyInfoList *key_info_list) const {
-  for (KeyInfo &key_info : *key_info_list) {
-    for (size_t i = 1; i < key_info.tokens.size(); ++i) {
-      const TokenInfo &prev_token_info = key_info.tokens[i - 1];
-      TokenInfo *token_info = &(key_info.tokens[i]);
-      if (token_info->value_type != TokenInfo::AS_IS_HIRAGANA &&
-          token_info->value_type != TokenInfo::AS_IS_KATAKANA &&
-          (token_info->token->value == prev_token_info.token->value)) {
-        token_info->value_type = TokenInfo::SAME_AS_PREV_VALUE;
-      }
+void SystemDictionaryBuilder::SetValueType(KeyInfo *key_info) const {
+  for (size_t i = 1; i < key_info->tokens.size(); ++i) {
+    const TokenInfo &prev_token_info = key_info->tokens[i - 1];
+    TokenInfo *token_info = &(key_info->tokens[i]);
+    if (token_info->value_type != TokenInfo::AS_IS_HIRAGANA &&
+        token_info->value_type != TokenInfo::AS_IS_KATAKANA &&
+        (token_info->token->value == prev_token_info.token->value)) {
+      token_info->value_type = TokenInfo::SAME_AS_PREV_VALUE;
     }
   }
 }
@@ -440,15 +527,15 @@ void SystemDictionaryBuilder::BuildKeyTrie(const KeyInfoList &key_info_list) {
     codec_->EncodeKey(key_info.key, &key_str);
     key_trie_builder_.Add(key_str);
   }
+  key_trie_builder_.set_dense_levels(
+      absl::GetFlag(FLAGS_louds_trie_dense_levels));
   key_trie_builder_.Build();
 }
 
-void SystemDictionaryBuilder::SetIdForKey(KeyInfoList *key_info_list) const {
-  for (KeyInfo &key_info : *key_info_list) {
-    std::string key_str;
-    codec_->EncodeKey(key_info.key, &key_str);
-    key_info.id_in_key_trie = key_trie_builder_.GetId(key_str);
-  }
+void SystemDictionaryBuilder::SetIdForKey(KeyInfo *key_info) const {
+  std::string key_str;
+  codec_->EncodeKey(key_info->key, &key_str);
+  key_info->id_in_key_trie = key_trie_builder_.GetId(key_str);
 }
 
 void SystemDictionaryBuilder::BuildTokenArray(
@@ -463,10 +550,15 @@ void SystemDictionaryBuilder::BuildTokenArray(
       id_to_keyinfo_table[id] = &key_info;
     }
 
-    for (const KeyInfo *key_info : id_to_keyinfo_table) {
-      std::string tokens_str;
-      codec_->EncodeTokens(key_info->tokens, &tokens_str);
+    // Encoding is done in parallel, while the encoded tokens are added in the
+    // order of the ids.
+    std::vector<std::string> tokens_strs(id_to_keyinfo_table.size());
+    ParallelFor(id_to_keyinfo_table.size(), [&](size_t id) {
+      codec_->EncodeTokens(id_to_keyinfo_table[id]->tokens, &tokens_strs[id]);
+    });
+    for (std::string &tokens_str : tokens_strs) {
       token_array_builder_.Add(tokens_str);
+      std::string().swap(tokens_str);
     }
   }
 
@@ -38,6 +38,7 @@
 #include <string>
 #include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/string_view.h"
 #include "dictionary/dictionary_token.h"
 #include "dictionary/file/codec_factory.h"
@@ -90,18 +91,29 @@ class SystemDictionaryBuilder final {
 
   KeyInfoList ReadTokens(std::vector<Token *> tokens) const;
 
+  // The following three stages are independent of each other, so they are
+  // run in parallel if --system_dictionary_builder_threads > 1.
   void BuildFrequentPos(const KeyInfoList &key_info_list);
   void BuildValueTrie(const KeyInfoList &key_info_list);
   void BuildKeyTrie(const KeyInfoList &key_info_list);
+
+  // Encodes the tokens with the ids from both tries, so this runs after the
+  // stages above.
   void BuildTokenArray(const KeyInfoList &key_info_list);
 
-  void SetIdForValue(KeyInfoList *key_info_list) const;
-  void SetIdForKey(KeyInfoList *key_info_list) const;
-  void SortTokenInfo(KeyInfoList *key_info_list) const;
+  // Sets the ids and the encoding types of every KeyInfo. Each KeyInfo is
+  // processed independently, so the list is split among the threads.
+  void SetTokenInfo(KeyInfoList *key_info_list) const;
+
+  void SetIdForValue(KeyInfo *key_info) const;
+  void SetIdForKey(KeyInfo *key_info) const;
+  void SortTokenInfo(KeyInfo *key_info) const;
 
-  void SetCostType(KeyInfoList *key_info_list) const;
-  void SetPosType(KeyInfoList *key_info_list) const;
-  void SetValueType(KeyInfoList *key_info_list) const;
+  void SetCostType(
+      const absl::flat_hash_set<absl::string_view> &heterophone_values,
+      KeyInfo *key_info) const;
+  void SetPosType(KeyInfo *key_info) const;
+  void SetValueType(KeyInfo *key_info) const;
 
   storage::louds::LoudsTrieBuilder value_trie_builder_;
   storage::louds::LoudsTrieBuilder key_trie_builder_;
@@ -43,6 +43,7 @@
 #include "absl/container/btree_set.h"
 #include "absl/flags/declare.h"
 #include "absl/flags/flag.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
@@ -59,6 +60,7 @@
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
 #include "request/conversion_request.h"
+#include "testing/gmock.h"
 #include "testing/gunit.h"
 #include "testing/mozctest.h"
 
@@ -67,6 +69,9 @@ ABSL_FLAG(int32_t, dictionary_test_size, 100000,
 ABSL_FLAG(int32_t, dictionary_reverse_lookup_test_size, 1000,
           "Number of tokens to run reverse lookup test.");
 ABSL_DECLARE_FLAG(int32_t, min_key_length_to_use_small_cost_encoding);
+ABSL_DECLARE_FLAG(int32_t, louds_trie_dense_levels);
+ABSL_DECLARE_FLAG(int32_t, system_dictionary_builder_threads);
+ABSL_DECLARE_FLAG(bool, system_dictionary_builder_sorted_input);
 
 namespace mozc {
 namespace dictionary {
@@ -458,6 +463,52 @@ TEST_F(SystemDictionaryTest, LookupPrefix) {
   }
 }
 
+TEST_F(SystemDictionaryTest, LookupPrefixBatch) {
+  const std::vector<std::unique_ptr<Token>> &source_tokens =
+      text_dict_.tokens();
+  std::unique_ptr<SystemDictionary> system_dic =
+      BuildSystemDictionary(MakeTokenPointers(&source_tokens), 10000);
+  ASSERT_TRUE(system_dic);
+
+  // Concatenates some keys and looks up all the suffixes, including the ones
+  // not starting at a character boundary.
+  std::string key;
+  for (int i = 0; i < 10000; i += 997) {
+    absl::StrAppend(&key, source_tokens[i]->key);
+  }
+  absl::StrAppend(&key, "ab1");
+  std::vector<size_t> begin_positions;
+  for (size_t pos = 0; pos <= key.size(); ++pos) {
+    begin_positions.push_back(pos);
+  }
+
+  for (const bool kana_modifier_insensitive : {false, true}) {
+    request_.set_kana_modifier_insensitive_conversion(
+        kana_modifier_insensitive);
+    config_.set_use_kana_modifier_insensitive_conversion(
+        kana_modifier_insensitive);
+    std::vector<CollectTokenCallback> batch_callbacks(begin_positions.size());
+    std::vector<DictionaryInterface::Callback *> callback_ptrs;
+    for (CollectTokenCallback &callback : batch_callbacks) {
+      callback_ptrs.push_back(&callback);
+    }
+    system_dic->LookupPrefixBatch(key, begin_positions, convreq_,
+                                  callback_ptrs);
+
+    for (size_t i = 0; i < begin_positions.size(); ++i) {
+      CollectTokenCallback callback;
+      system_dic->LookupPrefix(absl::string_view(key).substr(begin_positions[i]),
+                               convreq_, &callback);
+      const std::vector<Token> &expected = callback.tokens();
+      const std::vector<Token> &actual = batch_callbacks[i].tokens();
+      ASSERT_EQ(actual.size(), expected.size()) << begin_positions[i];
+      for (size_t j = 0; j < expected.size(); ++j) {
+        EXPECT_TOKEN_EQ(expected[j], actual[j]);
+      }
+    }
+  }
+}
+
 TEST_F(SystemDictionaryTest, LookupPredictive) {
   Token tokens[] = {
       {"まみむめもや", "value0", 0, 0, 0, Token::NONE},
@@ -665,6 +716,98 @@ TEST_F(SystemDictionaryTest, LookupReverseIndex) {
   }
 }
 
+TEST_F(SystemDictionaryTest, TwoLevelBitVectorIndex) {
+  const std::vector<std::unique_ptr<Token>> &source_tokens =
+      text_dict_.tokens();
+  BuildAndWriteSystemDictionary(MakeTokenPointers(&source_tokens),
+                                absl::GetFlag(FLAGS_dictionary_test_size),
+                                dic_fn_);
+
+  std::unique_ptr<SystemDictionary> system_dic_chunk =
+      SystemDictionary::Builder(dic_fn_)
+          .SetOptions(SystemDictionary::NONE)
+          .Build()
+          .value();
+  ASSERT_TRUE(system_dic_chunk)
+      << "Failed to open dictionary source:" << dic_fn_;
+  std::unique_ptr<SystemDictionary> system_dic_two_level =
+      SystemDictionary::Builder(dic_fn_)
+          .SetOptions(SystemDictionary::ENABLE_TWO_LEVEL_BIT_VECTOR_INDEX)
+          .Build()
+          .value();
+  ASSERT_TRUE(system_dic_two_level)
+      << "Failed to open dictionary source:" << dic_fn_;
+
+  int size = absl::GetFlag(FLAGS_dictionary_reverse_lookup_test_size);
+  for (auto it = source_tokens.begin(); size > 0 && it != source_tokens.end();
+       ++it, --size) {
+    const Token &t = **it;
+    CollectTokenCallback prefix1, prefix2, reverse1, reverse2;
+    system_dic_chunk->LookupPrefix(t.key, convreq_, &prefix1);
+    system_dic_two_level->LookupPrefix(t.key, convreq_, &prefix2);
+    system_dic_chunk->LookupReverse(t.value, convreq_, &reverse1);
+    system_dic_two_level->LookupReverse(t.value, convreq_, &reverse2);
+
+    ASSERT_EQ(prefix1.tokens().size(), prefix2.tokens().size());
+    for (size_t i = 0; i < prefix1.tokens().size(); ++i) {
+      EXPECT_TOKEN_EQ(prefix1.tokens()[i], prefix2.tokens()[i]);
+    }
+    ASSERT_EQ(reverse1.tokens().size(), reverse2.tokens().size());
+    for (size_t i = 0; i < reverse1.tokens().size(); ++i) {
+      EXPECT_TOKEN_EQ(reverse1.tokens()[i], reverse2.tokens()[i]);
+    }
+  }
+}
+
+TEST_F(SystemDictionaryTest, DenseLevels) {
+  const std::vector<std::unique_ptr<Token>> &source_tokens =
+      text_dict_.tokens();
+  std::unique_ptr<SystemDictionary> system_dic =
+      BuildSystemDictionary(MakeTokenPointers(&source_tokens),
+                            absl::GetFlag(FLAGS_dictionary_test_size));
+  ASSERT_TRUE(system_dic);
+
+  const int32_t original_dense_levels =
+      absl::GetFlag(FLAGS_louds_trie_dense_levels);
+  absl::SetFlag(&FLAGS_louds_trie_dense_levels, 2);
+  const std::string dense_dic_fn =
+      FileUtil::JoinPath(temp_dir_.path(), "mozc_dense.dic");
+  BuildAndWriteSystemDictionary(MakeTokenPointers(&source_tokens),
+                                absl::GetFlag(FLAGS_dictionary_test_size),
+                                dense_dic_fn);
+  absl::SetFlag(&FLAGS_louds_trie_dense_levels, original_dense_levels);
+  std::unique_ptr<SystemDictionary> dense_system_dic =
+      SystemDictionary::Builder(dense_dic_fn).Build().value();
+  ASSERT_TRUE(dense_system_dic);
+
+  int size = absl::GetFlag(FLAGS_dictionary_reverse_lookup_test_size);
+  for (auto it = source_tokens.begin(); size > 0 && it != source_tokens.end();
+       ++it, --size) {
+    const Token &t = **it;
+    CollectTokenCallback prefix1, prefix2, predictive1, predictive2, reverse1,
+        reverse2;
+    system_dic->LookupPrefix(t.key, convreq_, &prefix1);
+    dense_system_dic->LookupPrefix(t.key, convreq_, &prefix2);
+    system_dic->LookupPredictive(t.key, convreq_, &predictive1);
+    dense_system_dic->LookupPredictive(t.key, convreq_, &predictive2);
+    system_dic->LookupReverse(t.value, convreq_, &reverse1);
+    dense_system_dic->LookupReverse(t.value, convreq_, &reverse2);
+
+    ASSERT_EQ(prefix1.tokens().size(), prefix2.tokens().size());
+    for (size_t i = 0; i < prefix1.tokens().size(); ++i) {
+      EXPECT_TOKEN_EQ(prefix1.tokens()[i], prefix2.tokens()[i]);
+    }
+    ASSERT_EQ(predictive1.tokens().size(), predictive2.tokens().size());
+    for (size_t i = 0; i < predictive1.tokens().size(); ++i) {
+      EXPECT_TOKEN_EQ(predictive1.tokens()[i], predictive2.tokens()[i]);
+    }
+    ASSERT_EQ(reverse1.tokens().size(), reverse2.tokens().size());
+    for (size_t i = 0; i < reverse1.tokens().size(); ++i) {
+      EXPECT_TOKEN_EQ(reverse1.tokens()[i], reverse2.tokens()[i]);
+    }
+  }
+}
+
 TEST_F(SystemDictionaryTest, LookupReverseWithCache) {
   const std::string kDoraemon = "ドラえもん";
 
@@ -869,6 +1012,49 @@ TEST_F(SystemDictionaryTest, ShouldNotUseSmallCostEncodingForHeteronyms) {
   }
 }
 
+TEST_F(SystemDictionaryTest, ParallelBuildIsIdentical) {
+  // Use small cost encoding too, as it depends on all the tokens.
+  absl::SetFlag(&FLAGS_min_key_length_to_use_small_cost_encoding, 3);
+  const std::vector<std::unique_ptr<Token>> &source_tokens =
+      text_dict_.tokens();
+  std::vector<Token *> tokens = MakeTokenPointers(&source_tokens);
+  BuildAndWriteSystemDictionary(tokens,
+                                absl::GetFlag(FLAGS_dictionary_test_size),
+                                dic_fn_);
+  const absl::StatusOr<std::string> expected = FileUtil::GetContents(dic_fn_);
+  ASSERT_OK(expected);
+
+  const int32_t original_threads =
+      absl::GetFlag(FLAGS_system_dictionary_builder_threads);
+  const std::string parallel_dic_fn =
+      FileUtil::JoinPath(temp_dir_.path(), "mozc_parallel.dic");
+  for (const int32_t threads : {2, 3, 8}) {
+    absl::SetFlag(&FLAGS_system_dictionary_builder_threads, threads);
+    BuildAndWriteSystemDictionary(tokens,
+                                  absl::GetFlag(FLAGS_dictionary_test_size),
+                                  parallel_dic_fn);
+    const absl::StatusOr<std::string> actual =
+        FileUtil::GetContents(parallel_dic_fn);
+    ASSERT_OK(actual);
+    EXPECT_TRUE(*actual == *expected) << "threads=" << threads;
+  }
+
+  // Tokens that are already sorted by key give the same result too.
+  tokens.resize(std::min<size_t>(tokens.size(),
+                                 absl::GetFlag(FLAGS_dictionary_test_size)));
+  std::stable_sort(
+      tokens.begin(), tokens.end(),
+      [](const Token *l, const Token *r) { return l->key < r->key; });
+  absl::SetFlag(&FLAGS_system_dictionary_builder_sorted_input, true);
+  BuildAndWriteSystemDictionary(tokens, tokens.size(), parallel_dic_fn);
+  absl::SetFlag(&FLAGS_system_dictionary_builder_sorted_input, false);
+  absl::SetFlag(&FLAGS_system_dictionary_builder_threads, original_threads);
+  const absl::StatusOr<std::string> actual =
+      FileUtil::GetContents(parallel_dic_fn);
+  ASSERT_OK(actual);
+  EXPECT_TRUE(*actual == *expected);
+}
+
 }  // namespace
 }  // namespace dictionary
 }  // namespace mozc
@@ -48,6 +48,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "base/file_util.h"
 #include "base/hash.h"
 #include "base/logging.h"
@@ -401,7 +402,25 @@ void UserDictionary::LookupPrefix(absl::string_view key,
                                   const ConversionRequest &conversion_request,
                                   Callback *callback) const {
   absl::ReaderMutexLock l(&mutex_);
+  LookupPrefixLocked(key, conversion_request, callback);
+}
 
+// Takes the lock only once for all the suffixes.
+void UserDictionary::LookupPrefixBatch(
+    absl::string_view key, absl::Span<const size_t> begin_positions,
+    const ConversionRequest &conversion_request,
+    absl::Span<Callback *const> callbacks) const {
+  DCHECK_EQ(begin_positions.size(), callbacks.size());
+  absl::ReaderMutexLock l(&mutex_);
+  for (size_t i = 0; i < begin_positions.size(); ++i) {
+    LookupPrefixLocked(key.substr(begin_positions[i]), conversion_request,
+                       callbacks[i]);
+  }
+}
+
+void UserDictionary::LookupPrefixLocked(
+    absl::string_view key, const ConversionRequest &conversion_request,
+    Callback *callback) const {
   if (key.empty()) {
     LOG(WARNING) << "string of length zero is passed.";
     return;
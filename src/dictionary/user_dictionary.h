@@ -30,6 +30,7 @@
 #ifndef MOZC_DICTIONARY_USER_DICTIONARY_H_
 #define MOZC_DICTIONARY_USER_DICTIONARY_H_
 
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <vector>
@@ -37,6 +38,7 @@
 #include "absl/base/thread_annotations.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "dictionary/dictionary_interface.h"
 #include "dictionary/dictionary_token.h"
 #include "dictionary/pos_matcher.h"
@@ -70,6 +72,10 @@ class UserDictionary : public DictionaryInterface {
   void LookupPrefix(absl::string_view key,
                     const ConversionRequest &conversion_request,
                     Callback *callback) const override;
+  void LookupPrefixBatch(absl::string_view key,
+                         absl::Span<const size_t> begin_positions,
+                         const ConversionRequest &conversion_request,
+                         absl::Span<Callback *const> callbacks) const override;
   void LookupExact(absl::string_view key,
                    const ConversionRequest &conversion_request,
                    Callback *callback) const override;
@@ -116,6 +122,12 @@ class UserDictionary : public DictionaryInterface {
   // Swaps internal tokens index to |new_tokens|.
   void Swap(std::unique_ptr<TokensIndex> new_tokens);
 
+  // Implementation of LookupPrefix() for the caller holding the lock.
+  void LookupPrefixLocked(absl::string_view key,
+                          const ConversionRequest &conversion_request,
+                          Callback *callback) const
+      ABSL_SHARED_LOCKS_REQUIRED(mutex_);
+
   std::unique_ptr<UserDictionaryReloader> reloader_;
   std::unique_ptr<const UserPosInterface> user_pos_;
   const PosMatcher pos_matcher_;
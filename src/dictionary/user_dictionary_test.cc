@@ -452,6 +452,32 @@ TEST_F(UserDictionaryTest, TestLookupPrefix) {
   EXPECT_THAT(LookupPrefix("starting", *dic), IsEmpty());
 }
 
+TEST_F(UserDictionaryTest, TestLookupPrefixBatch) {
+  std::unique_ptr<UserDictionary> dic(CreateDictionaryWithMockPos());
+  // Wait for async reload called from the constructor.
+  dic->WaitForReloader();
+
+  {
+    UserDictionaryStorage storage("");
+    LoadFromString(kUserDictionary0, &storage);
+    dic->Load(storage.GetProto());
+  }
+
+  // Each callback gets the same entries as LookupPrefix() for its suffix.
+  constexpr absl::string_view kKey = "restarting";
+  const size_t kBeginPositions[] = {0, 2, 10};
+  EntryCollector collectors[3];
+  DictionaryInterface::Callback *const callbacks[] = {
+      &collectors[0], &collectors[1], &collectors[2]};
+  dic->LookupPrefixBatch(kKey, kBeginPositions, convreq_, callbacks);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_THAT(std::move(collectors[i]).entries(),
+                UnorderedElementsAreArray(
+                    LookupPrefix(kKey.substr(kBeginPositions[i]), *dic)))
+        << i;
+  }
+}
+
 TEST_F(UserDictionaryTest, TestLookupExact) {
   std::unique_ptr<UserDictionary> dic(CreateDictionaryWithMockPos());
   // Wait for async reload called from the constructor.
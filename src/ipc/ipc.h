@@ -33,6 +33,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/notification.h"
@@ -56,6 +57,12 @@ inline constexpr size_t IPC_INITIAL_READ_BUFFER_SIZE = 16 * 16384;
 // increment this value if protocol has changed.
 inline constexpr int IPC_PROTOCOL_VERSION = 3;
 
+// Version of the framed transport, where each request and response is
+// prefixed with its size so that a connection can carry more than one call.
+// Unlike IPC_PROTOCOL_VERSION, the server keeps accepting clients sending one
+// call per connection, so this version doesn't need to match between them.
+inline constexpr int IPC_TRANSPORT_VERSION = 1;
+
 enum IPCErrorType {
   IPC_NO_ERROR,
   IPC_NO_CONNECTION,
@@ -83,6 +90,12 @@ class IPCClientInterface {
 
   // return last error
   virtual IPCErrorType GetLastIPCError() const = 0;
+
+  // Keeps the connection open after Call() so that Call() can be invoked
+  // again, if both the client and the server support it. Call this before
+  // the first Call(). Returns true if the connection is persistent; Connected()
+  // then returns false once the server has closed the connection.
+  virtual bool EnablePersistentConnection() { return false; }
 };
 
 #ifdef __APPLE__
@@ -141,12 +154,18 @@ class IPCClient : public IPCClientInterface {
   // When Server doesn't send response within timeout, 'Call' returns false.
   // When timeout (in msec) is set -1, 'Call' waits forever.
   // Note that on Linux and Windows, Call() closes the socket_. This means you
-  // cannot call the Call() function more than once.
+  // cannot call the Call() function more than once, unless
+  // EnablePersistentConnection() returned true.
   bool Call(const std::string &request, std::string *response,
             absl::Duration timeout) override;
 
   IPCErrorType GetLastIPCError() const override { return last_ipc_error_; }
 
+#if !defined(_WIN32) && !defined(__APPLE__)
+  // Only the Unix domain socket transport supports persistent connections.
+  bool EnablePersistentConnection() override;
+#endif  // !_WIN32 && !__APPLE__
+
   // terminate the server process named |name|
   // Do not use it unless version mismatch happens
   static bool TerminateServer(absl::string_view name);
@@ -169,6 +188,8 @@ class IPCClient : public IPCClientInterface {
   MachPortManagerInterface *mach_port_manager_;
 #else   // _WIN32
   int socket_;
+  bool persistent_;
+  bool handshake_sent_;
 #endif  // _WIN32
   bool connected_;
   IPCPathManager *ipc_path_manager_;
@@ -204,6 +225,9 @@ class IPCClientFactory : public IPCClientFactoryInterface {
 };
 
 // Synchronous, Single-thread IPC Server
+// On Linux, clients may keep their connections open with the framed transport
+// (see IPC_TRANSPORT_VERSION). The server polls them together with the
+// listening socket and still processes one request at a time.
 // Usage:
 // class MyEchoServer: public IPCServer {
 //  public:
@@ -234,8 +258,22 @@ class IPCServer {
 
   // Implement a server algorithm in subclass.
   // If 'Process' return false, server finishes select loop
+  // With worker threads, it is called concurrently and must be thread-safe.
   virtual bool Process(absl::string_view request, std::string *response) = 0;
 
+  // Returns the key to order the requests with worker threads.  Requests with
+  // the same key are processed one at a time in the order of arrival, while
+  // ones with different keys may be processed concurrently.
+  virtual uint64_t GetRequestKey(absl::string_view request) const { return 0; }
+
+  // Processes the requests on |num_threads| worker threads, while the loop
+  // thread only accepts connections and reads requests.  Zero, the default,
+  // processes them on the loop thread.  Must be called before Loop().
+  // Only the Unix domain socket server supports worker threads.
+  void set_num_worker_threads(int num_threads) {
+    num_worker_threads_ = num_threads;
+  }
+
   // Start select loop. It goes into infinite loop.
   void Loop();
 
@@ -276,9 +314,32 @@ class IPCServer {
 #else   // _WIN32
   int socket_;
   std::string server_address_;
+  // Connections of the framed transport, from the least recently used.
+  std::vector<int> persistent_sockets_;
+
+  // Dispatches the requests to the worker threads.
+  class WorkerPool;
+  std::unique_ptr<WorkerPool> worker_pool_;
+
+  // Accepts a connection and processes its first request. Returns false if
+  // Process() returned false.
+  bool AcceptAndProcess();
+  // Processes a request on the persistent connection |index|. Returns false
+  // if Process() returned false.
+  bool ProcessPersistent(size_t index);
+  void ClosePersistentSockets();
+  // Loop() with worker threads.
+  void LoopWithWorkers();
+  // Reads a request from a new connection and dispatches it.
+  void AcceptAndDispatch();
+  // Reads a request on the persistent connection |index| and dispatches it.
+  void DispatchPersistent(size_t index);
+  // Keeps |sock| as the most recently used persistent connection.
+  void AddPersistentSocket(int sock);
 #endif  // _WIN32
 
   absl::Duration timeout_;
+  int num_worker_threads_ = 0;
 };
 
 }  // namespace mozc
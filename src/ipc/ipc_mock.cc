@@ -47,7 +47,8 @@ IPCClientMock::IPCClientMock(IPCClientFactoryMock *caller)
       server_protocol_version_(0),
       server_product_version_(Version::GetMozcVersion()),
       server_process_id_(0),
-      result_(false) {}
+      result_(false),
+      persistent_(false) {}
 
 bool IPCClientMock::Connected() const { return connected_; }
 
@@ -69,14 +70,16 @@ bool IPCClientMock::Call(const std::string &request, std::string *response,
   if (!connected_ || !result_) {
     return false;
   }
-  response->assign(response_);
+  response->assign(persistent_ ? caller_->GetMockResponse() : response_);
   return true;
 }
 
 IPCClientFactoryMock::IPCClientFactoryMock()
     : connection_(false),
       result_(false),
-      server_protocol_version_(IPC_PROTOCOL_VERSION) {}
+      server_protocol_version_(IPC_PROTOCOL_VERSION),
+      persistent_(false),
+      num_clients_(0) {}
 
 std::unique_ptr<IPCClientInterface> IPCClientFactoryMock::NewClient(
     const std::string &unused_name, const std::string &path_name) {
@@ -121,6 +124,10 @@ void IPCClientFactoryMock::SetServerProcessId(
   server_process_id_ = server_process_id;
 }
 
+void IPCClientFactoryMock::SetPersistentConnection(const bool persistent) {
+  persistent_ = persistent;
+}
+
 std::unique_ptr<IPCClientMock> IPCClientFactoryMock::NewClientMock() {
   auto client = std::make_unique<IPCClientMock>(this);
   client->set_connection(connection_);
@@ -128,6 +135,8 @@ std::unique_ptr<IPCClientMock> IPCClientFactoryMock::NewClientMock() {
   client->set_response(response_);
   client->set_server_protocol_version(server_protocol_version_);
   client->set_server_product_version(server_product_version_);
+  client->set_persistent(persistent_);
+  ++num_clients_;
   return client;
 }
 
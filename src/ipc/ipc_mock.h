@@ -55,6 +55,8 @@ class IPCClientMock : public IPCClientInterface {
 
   IPCErrorType GetLastIPCError() const override { return IPC_NO_ERROR; }
 
+  bool EnablePersistentConnection() override { return persistent_; }
+
   void set_connection(const bool connection) { connected_ = connection; }
   void set_result(const bool result) { result_ = result; }
   void set_server_protocol_version(const uint32_t server_protocol_version) {
@@ -67,6 +69,7 @@ class IPCClientMock : public IPCClientInterface {
     server_process_id_ = server_process_id;
   }
   void set_response(const std::string &response) { response_ = response; }
+  void set_persistent(const bool persistent) { persistent_ = persistent; }
 
  private:
   IPCClientFactoryMock *caller_;
@@ -76,6 +79,9 @@ class IPCClientMock : public IPCClientInterface {
   uint32_t server_process_id_;
   bool result_;
   std::string response_;
+  // A persistent client responds with the latest mock response of |caller_|
+  // as it's reused across calls.
+  bool persistent_;
 };
 
 class IPCClientFactoryMock : public IPCClientFactoryInterface {
@@ -114,6 +120,16 @@ class IPCClientFactoryMock : public IPCClientFactoryInterface {
   // This function is for unit tests.
   void SetServerProcessId(uint32_t server_process_id);
 
+  // This function is for unit tests.
+  void SetPersistentConnection(bool persistent);
+
+  // This function is for IPCClientMock.
+  const std::string &GetMockResponse() const { return response_; }
+
+  // This function is for unit tests.
+  // Returns the number of clients created so far.
+  int num_clients() const { return num_clients_; }
+
  private:
   std::unique_ptr<IPCClientMock> NewClientMock();
 
@@ -122,6 +138,8 @@ class IPCClientFactoryMock : public IPCClientFactoryInterface {
   uint32_t server_protocol_version_;
   std::string server_product_version_;
   uint32_t server_process_id_;
+  bool persistent_;
+  int num_clients_;
   std::string request_;
   std::string response_;
 };
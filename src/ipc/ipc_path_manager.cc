@@ -205,6 +205,10 @@ bool IPCPathManager::SavePathName() {
   // set the server version
   ipc_path_info_.set_protocol_version(IPC_PROTOCOL_VERSION);
   ipc_path_info_.set_product_version(Version::GetMozcVersion());
+#if defined(__linux__) && !defined(__ANDROID__)
+  // Only the server in unix_ipc.cc implements the framed transport.
+  ipc_path_info_.set_transport_version(IPC_TRANSPORT_VERSION);
+#endif  // __linux__ && !__ANDROID__
 
 #ifdef _WIN32
   ipc_path_info_.set_process_id(static_cast<uint32_t>(::GetCurrentProcessId()));
@@ -298,6 +302,10 @@ uint32_t IPCPathManager::GetServerProtocolVersion() const {
   return ipc_path_info_.protocol_version();
 }
 
+uint32_t IPCPathManager::GetServerTransportVersion() const {
+  return ipc_path_info_.transport_version();
+}
+
 const std::string &IPCPathManager::GetServerProductVersion() const {
   return ipc_path_info_.product_version();
 }
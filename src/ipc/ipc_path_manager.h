@@ -87,6 +87,10 @@ class IPCPathManager {
   // return 0 if protocol version is not defined.
   uint32_t GetServerProtocolVersion() const;
 
+  // return the version of the framed transport the server accepts.
+  // return 0 if the server only accepts one call per connection.
+  uint32_t GetServerTransportVersion() const;
+
   // return product version.
   // return "0.0.0.0" if product version is not defined
   const std::string &GetServerProductVersion() const;
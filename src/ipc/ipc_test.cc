@@ -31,10 +31,15 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "base/thread.h"
@@ -45,6 +50,16 @@
 #include "ipc/ipc_test_util.h"
 #endif  // __APPLE__
 
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "ipc/ipc_path_manager.h"
+#endif  // __linux__
+
 namespace mozc {
 namespace {
 
@@ -163,5 +178,233 @@ TEST_F(IPCTest, IPCTest) {
   con.Wait();
 }
 
+#ifdef __linux__
+// IPCPathManager keeps the path of the first server for each name in the
+// process, so this test needs another name.
+constexpr char kPersistentServerAddress[] = "test_persistent_echo_server";
+
+TEST_F(IPCTest, PersistentConnection) {
+  EchoServer con(kPersistentServerAddress, 10, absl::Milliseconds(1000));
+  con.LoopAndReturn();
+
+  // Clients of both transports are served at the same time.
+  std::vector<Thread> cons;
+  for (int i = 0; i < kNumThreads; ++i) {
+    const bool persistent = i % 2 == 0;
+    cons.push_back(Thread([persistent] {
+      absl::SleepFor(absl::Milliseconds(100));
+      std::unique_ptr<IPCClient> con;
+      for (int i = 0; i < kNumRequests; ++i) {
+        if (con == nullptr || !persistent) {
+          con = std::make_unique<IPCClient>(kPersistentServerAddress, "");
+          ASSERT_TRUE(con->Connected());
+          if (persistent) {
+            ASSERT_TRUE(con->EnablePersistentConnection());
+          }
+        }
+        ASSERT_TRUE(con->Connected());
+        const std::string input = GenerateInputData(i);
+        std::string output;
+        ASSERT_TRUE(con->Call(input, &output, absl::Milliseconds(1000)))
+            << "size=" << input.size();
+        EXPECT_EQ(output, input);
+      }
+    }));
+  }
+  for (Thread &con : cons) {
+    con.Join();
+  }
+
+  // The server closes the least recently used connections when it has too
+  // many of them, which the clients find out.
+  std::vector<std::unique_ptr<IPCClient>> clients;
+  for (int i = 0; i < 100; ++i) {
+    auto client = std::make_unique<IPCClient>(kPersistentServerAddress, "");
+    ASSERT_TRUE(client->EnablePersistentConnection());
+    std::string output;
+    ASSERT_TRUE(client->Call("ping", &output, absl::Milliseconds(1000)));
+    EXPECT_EQ(output, "ping");
+    clients.push_back(std::move(client));
+  }
+  EXPECT_FALSE(clients.front()->Connected());
+  EXPECT_TRUE(clients.back()->Connected());
+  std::string output;
+  EXPECT_TRUE(clients.back()->Call("pong", &output, absl::Milliseconds(1000)));
+  EXPECT_EQ(output, "pong");
+
+  IPCClient kill(kPersistentServerAddress, "");
+  ASSERT_TRUE(kill.EnablePersistentConnection());
+  kill.Call("kill", &output, absl::Milliseconds(1000));
+  con.Wait();
+}
+
+#ifdef __linux__
+constexpr char kStalledServerAddress[] = "test_stalled_echo_server";
+
+TEST_F(IPCTest, StalledClient) {
+  EchoServer con(kStalledServerAddress, 10, absl::Milliseconds(200));
+  con.LoopAndReturn();
+  absl::SleepFor(absl::Milliseconds(100));
+
+  std::string path;
+  IPCPathManager *manager =
+      IPCPathManager::GetIPCPathManager(kStalledServerAddress);
+  ASSERT_TRUE(manager->LoadPathName());
+  ASSERT_TRUE(manager->GetPathName(&path));
+  sockaddr_un address = {};
+  ASSERT_LT(path.size(), sizeof(address.sun_path));
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, path.data(), path.size());
+  const int sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_GE(sock, 0);
+  ASSERT_EQ(::connect(sock, reinterpret_cast<const sockaddr *>(&address),
+                      sizeof(address.sun_family) + path.size()),
+            0);
+  // A part of the magic of the framed transport, which is neither followed
+  // by the rest nor half-closed.
+  ASSERT_EQ(::send(sock, "\0MO", 3, 0), 3);
+
+  // The server gives up the stalled connection by the timeout and serves the
+  // others.
+  IPCClient client(kStalledServerAddress, "");
+  std::string output;
+  EXPECT_TRUE(client.Call("ping", &output, absl::Milliseconds(2000)));
+  EXPECT_EQ(output, "ping");
+  ::close(sock);
+
+  IPCClient kill(kStalledServerAddress, "");
+  kill.Call("kill", &output, absl::Milliseconds(1000));
+  con.Wait();
+}
+#endif  // __linux__
+
+constexpr char kWorkerServerAddress[] = "test_worker_echo_server";
+
+// Echo server keyed by the first byte of the requests.  "<key>wait" blocks
+// until Release() is called.
+class KeyedEchoServer : public IPCServer {
+ public:
+  KeyedEchoServer(const std::string &path, int32_t num_connections,
+                  absl::Duration timeout)
+      : IPCServer(path, num_connections, timeout) {}
+
+  bool Process(absl::string_view input, std::string *output) override {
+    if (input == "kill") {
+      output->clear();
+      return false;
+    }
+    const char key = input.empty() ? '\0' : input[0];
+    {
+      absl::MutexLock lock(&mutex_);
+      if (running_[key]++ > 0) {
+        overlapped_ = true;
+      }
+    }
+    if (input.substr(1) == "wait") {
+      release_.WaitForNotificationWithTimeout(absl::Seconds(5));
+    }
+    {
+      absl::MutexLock lock(&mutex_);
+      --running_[key];
+    }
+    output->assign(input.data(), input.size());
+    return true;
+  }
+
+  uint64_t GetRequestKey(absl::string_view input) const override {
+    return input.empty() ? 0 : input[0];
+  }
+
+  void Release() { release_.Notify(); }
+
+  bool overlapped() {
+    absl::MutexLock lock(&mutex_);
+    return overlapped_;
+  }
+
+ private:
+  absl::Mutex mutex_;
+  absl::flat_hash_map<char, int> running_ ABSL_GUARDED_BY(mutex_);
+  bool overlapped_ ABSL_GUARDED_BY(mutex_) = false;
+  absl::Notification release_;
+};
+
+TEST_F(IPCTest, WorkerThreads) {
+  KeyedEchoServer con(kWorkerServerAddress, 10, absl::Milliseconds(1000));
+  con.set_num_worker_threads(2);
+  con.LoopAndReturn();
+
+  auto call = [](const std::string &input, bool persistent) {
+    IPCClient client(kWorkerServerAddress, "");
+    if (persistent) {
+      EXPECT_TRUE(client.EnablePersistentConnection());
+    }
+    std::string output;
+    EXPECT_TRUE(client.Call(input, &output, absl::Milliseconds(5000)));
+    EXPECT_EQ(output, input);
+  };
+
+  // The second request of the key "a" waits for the first one, while the key
+  // "b" is processed on the other worker.
+  Thread blocked([&] { call("await", true); });
+  absl::SleepFor(absl::Milliseconds(100));
+  Thread queued([&] { call("a1", false); });
+  absl::SleepFor(absl::Milliseconds(100));
+  const absl::Time start = absl::Now();
+  call("b1", true);
+  call("b2", false);
+  EXPECT_LT(absl::Now() - start, absl::Seconds(1));
+  con.Release();
+  blocked.Join();
+  queued.Join();
+  EXPECT_FALSE(con.overlapped());
+
+  std::vector<Thread> cons;
+  for (int i = 0; i < kNumThreads; ++i) {
+    const bool persistent = i % 2 == 0;
+    const char key = 'c' + i % 2;
+    cons.push_back(Thread([persistent, key] {
+      std::unique_ptr<IPCClient> con;
+      for (int i = 0; i < kNumRequests; ++i) {
+        if (con == nullptr || !persistent) {
+          con = std::make_unique<IPCClient>(kWorkerServerAddress, "");
+          if (persistent) {
+            ASSERT_TRUE(con->EnablePersistentConnection());
+          }
+        }
+        const std::string input = key + GenerateInputData(i);
+        std::string output;
+        ASSERT_TRUE(con->Call(input, &output, absl::Milliseconds(1000)));
+        EXPECT_EQ(output, input);
+      }
+    }));
+  }
+  for (Thread &con : cons) {
+    con.Join();
+  }
+  EXPECT_FALSE(con.overlapped());
+
+  // The least recently used connections are closed as in the single thread
+  // loop, and the ones given back by the workers keep being served.
+  std::vector<std::unique_ptr<IPCClient>> clients;
+  std::string output;
+  for (int i = 0; i < 100; ++i) {
+    auto client = std::make_unique<IPCClient>(kWorkerServerAddress, "");
+    ASSERT_TRUE(client->EnablePersistentConnection());
+    ASSERT_TRUE(client->Call("eping", &output, absl::Milliseconds(1000)));
+    EXPECT_EQ(output, "eping");
+    clients.push_back(std::move(client));
+  }
+  EXPECT_FALSE(clients.front()->Connected());
+  EXPECT_TRUE(clients.back()->Connected());
+  EXPECT_TRUE(clients.back()->Call("epong", &output, absl::Milliseconds(1000)));
+  EXPECT_EQ(output, "epong");
+
+  IPCClient kill(kWorkerServerAddress, "");
+  kill.Call("kill", &output, absl::Milliseconds(1000));
+  con.Wait();
+}
+#endif  // __linux__
+
 }  // namespace
 }  // namespace mozc
@@ -31,6 +31,8 @@
 #if defined(__linux__)
 
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
@@ -38,18 +40,30 @@
 #include <sys/un.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <deque>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
+#include "absl/strings/match.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "base/bits.h"
 #include "base/file_util.h"
 #include "base/logging.h"
+#include "base/thread.h"
 #include "base/vlog.h"
 #include "ipc/ipc.h"
 #include "ipc/ipc_path_manager.h"
@@ -63,6 +77,21 @@ namespace {
 
 constexpr int kInvalidSocket = -1;
 
+// A client of the framed transport starts the connection with this magic.
+// Requests of the other clients never start with it, as protocol buffers
+// can't start with a zero byte.
+constexpr absl::string_view kFramedTransportMagic("\0MOZCIPC\x01", 9);
+
+// Each frame starts with the payload size in uint32_t of the host byte order.
+constexpr size_t kFrameHeaderSize = sizeof(uint32_t);
+
+// Frames larger than this are treated as broken.
+constexpr uint32_t kMaxFrameSize = 64 * 1024 * 1024;
+
+// The server closes the least recently used persistent connection if it has
+// more than this number.  The client reconnects when it finds it closed.
+constexpr size_t kMaxPersistentConnections = 64;
+
 absl::Status mkdir_p(const std::string &dirname) {
   const std::string parent_dir = FileUtil::Dirname(dirname);
   struct stat st;
@@ -138,7 +167,7 @@ bool IsPeerValid(int socket, pid_t *pid) {
   return true;
 }
 
-IPCErrorType SendMessage(int socket, const std::string &msg,
+IPCErrorType SendMessage(int socket, absl::string_view msg,
                          absl::Duration timeout) {
   int offset = 0;
   while (msg.size() != offset) {
@@ -191,6 +220,117 @@ IPCErrorType RecvMessage(int socket, std::string *msg, absl::Duration timeout) {
   return IPC_NO_ERROR;
 }
 
+// Reads exactly |size| bytes into |buf|.  Returns IPC_NO_CONNECTION if the
+// peer closed the connection before sending any byte.
+IPCErrorType RecvExactly(int socket, char *buf, size_t size,
+                         absl::Duration timeout) {
+  size_t offset = 0;
+  while (offset < size) {
+    if (IsReadTimeout(socket, timeout)) {
+      LOG(WARNING) << "Read timeout " << timeout;
+      return IPC_TIMEOUT_ERROR;
+    }
+    const ssize_t read_length =
+        ::recv(socket, buf + offset, size - offset, /* flags */ 0);
+    if (read_length < 0) {
+      LOG(ERROR) << "an error occurred during recv(): " << strerror(errno);
+      return IPC_READ_ERROR;
+    }
+    if (read_length == 0) {
+      return offset == 0 ? IPC_NO_CONNECTION : IPC_READ_ERROR;
+    }
+    offset += read_length;
+  }
+  return IPC_NO_ERROR;
+}
+
+// Sends |msg| as a frame, after |prefix| if any.
+IPCErrorType SendFrame(int socket, absl::string_view prefix,
+                       absl::string_view msg, absl::Duration timeout) {
+  if (msg.size() > kMaxFrameSize) {
+    LOG(ERROR) << "Too large frame: " << msg.size();
+    return IPC_WRITE_ERROR;
+  }
+  std::string frame;
+  frame.reserve(prefix.size() + kFrameHeaderSize + msg.size());
+  frame.append(prefix.data(), prefix.size());
+  frame.resize(prefix.size() + kFrameHeaderSize);
+  StoreUnaligned<uint32_t>(static_cast<uint32_t>(msg.size()),
+                           frame.data() + prefix.size());
+  frame.append(msg.data(), msg.size());
+  return SendMessage(socket, frame, timeout);
+}
+
+IPCErrorType RecvFrame(int socket, std::string *msg, absl::Duration timeout) {
+  char header[kFrameHeaderSize];
+  if (const IPCErrorType error =
+          RecvExactly(socket, header, sizeof(header), timeout);
+      error != IPC_NO_ERROR) {
+    msg->clear();
+    return error;
+  }
+  const uint32_t size = LoadUnaligned<uint32_t>(header);
+  if (size > kMaxFrameSize) {
+    LOG(ERROR) << "Too large frame: " << size;
+    msg->clear();
+    return IPC_READ_ERROR;
+  }
+  msg->resize(size);
+  if (const IPCErrorType error = RecvExactly(socket, msg->data(), size, timeout);
+      error != IPC_NO_ERROR) {
+    msg->clear();
+    return error == IPC_NO_CONNECTION ? IPC_READ_ERROR : error;
+  }
+  MOZC_VLOG(1) << size << " bytes received";
+  return IPC_NO_ERROR;
+}
+
+// Returns true if the connection starts with kFramedTransportMagic, which is
+// consumed then.  Otherwise nothing is consumed.  Waits for the magic for
+// |timeout| in total, and returns false if it doesn't arrive by then, so that
+// the following read of the one-shot request fails by the timeout as well.
+bool ReadFramedTransportMagic(int socket, absl::Duration timeout) {
+  const absl::Time deadline = timeout < absl::ZeroDuration()
+                                  ? absl::InfiniteFuture()
+                                  : absl::Now() + timeout;
+  char buf[kFramedTransportMagic.size()];
+  while (true) {
+    const absl::Duration remaining =
+        timeout < absl::ZeroDuration()
+            ? timeout
+            : std::max(deadline - absl::Now(), absl::ZeroDuration());
+    if (IsReadTimeout(socket, remaining)) {
+      return false;
+    }
+    const ssize_t peeked =
+        ::recv(socket, buf, sizeof(buf), MSG_PEEK | MSG_DONTWAIT);
+    if (peeked < 0 && (errno == EINTR || errno == EAGAIN)) {
+      continue;
+    }
+    if (peeked <= 0 || !absl::StartsWith(kFramedTransportMagic,
+                                         absl::string_view(buf, peeked))) {
+      return false;
+    }
+    if (peeked == sizeof(buf)) {
+      return ::recv(socket, buf, sizeof(buf), /* flags */ 0) == sizeof(buf);
+    }
+    // Only a part of the magic has arrived.  The socket stays readable with
+    // the peeked bytes, so sleep a moment instead of waiting for readability.
+    if (absl::Now() >= deadline) {
+      return false;
+    }
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+}
+
+// Returns true if the peer has closed the idle connection, or it is broken.
+// The server never sends data without a request, so an idle connection
+// becomes readable only in that case.
+bool IsClosedByPeer(int socket) {
+  pollfd fd = {socket, POLLIN, 0};
+  return ::poll(&fd, 1, /* timeout */ 0) != 0;
+}
+
 void SetCloseOnExecFlag(int fd) {
   int flags = ::fcntl(fd, F_GETFD, 0);
   if (flags < 0) {
@@ -215,6 +355,8 @@ bool IsAbstractSocket(const std::string &address) {
 // Client
 IPCClient::IPCClient(const absl::string_view name)
     : socket_(kInvalidSocket),
+      persistent_(false),
+      handshake_sent_(false),
       connected_(false),
       ipc_path_manager_(nullptr),
       last_ipc_error_(IPC_NO_ERROR) {
@@ -224,6 +366,8 @@ IPCClient::IPCClient(const absl::string_view name)
 IPCClient::IPCClient(const absl::string_view name,
                      const absl::string_view server_path)
     : socket_(kInvalidSocket),
+      persistent_(false),
+      handshake_sent_(false),
       connected_(false),
       ipc_path_manager_(nullptr),
       last_ipc_error_(IPC_NO_ERROR) {
@@ -302,6 +446,15 @@ IPCClient::~IPCClient() {
   MOZC_VLOG(1) << "connection closed (IPCClient destructed)";
 }
 
+bool IPCClient::EnablePersistentConnection() {
+  if (!connected_ || handshake_sent_ || ipc_path_manager_ == nullptr ||
+      ipc_path_manager_->GetServerTransportVersion() < IPC_TRANSPORT_VERSION) {
+    return persistent_;
+  }
+  persistent_ = true;
+  return true;
+}
+
 // RPC call
 bool IPCClient::Call(const std::string &request, std::string *response,
                      absl::Duration timeout) {
@@ -309,6 +462,31 @@ bool IPCClient::Call(const std::string &request, std::string *response,
     LOG(ERROR) << "Call failed: not connected";
     return false;
   }
+
+  if (persistent_) {
+    // The first frame follows the magic in the same message.
+    last_ipc_error_ =
+        SendFrame(socket_, handshake_sent_ ? "" : kFramedTransportMagic,
+                  request, timeout);
+    handshake_sent_ = true;
+    if (last_ipc_error_ == IPC_NO_ERROR) {
+      last_ipc_error_ = RecvFrame(socket_, response, timeout);
+      if (last_ipc_error_ == IPC_NO_CONNECTION) {
+        // The server closed the connection without a response.
+        last_ipc_error_ = IPC_READ_ERROR;
+      }
+    }
+    if (last_ipc_error_ != IPC_NO_ERROR) {
+      LOG(ERROR) << "Call on the persistent connection failed: "
+                 << last_ipc_error_;
+      // The connection may be left in the middle of a frame.
+      connected_ = false;
+      return false;
+    }
+    MOZC_VLOG(1) << "Call succeeded";
+    return true;
+  }
+
   last_ipc_error_ = SendMessage(socket_, request, timeout);
   if (last_ipc_error_ != IPC_NO_ERROR) {
     LOG(ERROR) << "SendMessage failed";
@@ -317,10 +495,7 @@ bool IPCClient::Call(const std::string &request, std::string *response,
 
   // Half-close the socket so that mozc_server could know the length of the
   // request data. Without this, RecvMessage() in mozc_server would fail with
-  // timeout.
-  // TODO(yusukes): It would be also possible to modify Send and RecvMessage()
-  // so that they send/recv the payload size explicitly together with the actual
-  // data. Will revisit later.
+  // timeout. The framed transport above sends the payload size instead.
   ::shutdown(socket_, SHUT_WR);
 
   last_ipc_error_ = RecvMessage(socket_, response, timeout);
@@ -332,9 +507,163 @@ bool IPCClient::Call(const std::string &request, std::string *response,
   return true;
 }
 
-bool IPCClient::Connected() const { return connected_; }
+bool IPCClient::Connected() const {
+  if (persistent_ && handshake_sent_ && connected_) {
+    return !IsClosedByPeer(socket_);
+  }
+  return connected_;
+}
 
 // Server
+
+// Runs Process() on the worker threads.  The tasks with the same key form a
+// strand: only one of them is processed at a time, in the order of Dispatch().
+// The loop thread owns the sockets.  It gets them back through TakeResults()
+// when it is woken up by wakeup_fd().
+class IPCServer::WorkerPool {
+ public:
+  struct Task {
+    int sock;
+    bool persistent;
+    std::string request;
+  };
+
+  struct Result {
+    int sock;
+    bool persistent;
+    // True if the persistent connection can take the next request.
+    bool reusable;
+    // True if Process() returned false.
+    bool stop;
+  };
+
+  WorkerPool(IPCServer *server, int num_threads) : server_(server) {
+    if (::pipe(wakeup_pipe_) != 0) {
+      LOG(FATAL) << "pipe() failed: " << strerror(errno);
+    }
+    for (const int fd : wakeup_pipe_) {
+      SetCloseOnExecFlag(fd);
+      ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+    threads_.reserve(num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+      threads_.emplace_back([this] { Run(); });
+    }
+  }
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  // Waits for the running tasks and closes the sockets of the others.
+  ~WorkerPool() {
+    {
+      absl::MutexLock lock(&mutex_);
+      stopping_ = true;
+      cond_.SignalAll();
+    }
+    for (Thread &thread : threads_) {
+      thread.Join();
+    }
+    for (const auto &[key, tasks] : strands_) {
+      for (const Task &task : tasks) {
+        ::close(task.sock);
+      }
+    }
+    for (const Result &result : results_) {
+      ::close(result.sock);
+    }
+    ::close(wakeup_pipe_[0]);
+    ::close(wakeup_pipe_[1]);
+  }
+
+  // Becomes readable when TakeResults() has something to return.
+  int wakeup_fd() const { return wakeup_pipe_[0]; }
+
+  void Dispatch(Task task) {
+    const uint64_t key = server_->GetRequestKey(task.request);
+    absl::MutexLock lock(&mutex_);
+    std::deque<Task> &strand = strands_[key];
+    strand.push_back(std::move(task));
+    // Otherwise the worker running the strand picks it up.
+    if (strand.size() == 1) {
+      ready_keys_.push_back(key);
+      cond_.Signal();
+    }
+  }
+
+  std::vector<Result> TakeResults() {
+    char buf[64];
+    while (::read(wakeup_pipe_[0], buf, sizeof(buf)) > 0) {
+    }
+    absl::MutexLock lock(&mutex_);
+    return std::exchange(results_, {});
+  }
+
+ private:
+  void Run() {
+    std::string response;
+    absl::MutexLock lock(&mutex_);
+    while (true) {
+      while (!stopping_ && ready_keys_.empty()) {
+        cond_.Wait(&mutex_);
+      }
+      if (stopping_) {
+        return;
+      }
+      const uint64_t key = ready_keys_.front();
+      ready_keys_.pop_front();
+      // The moved-from task stays in the strand while running so that
+      // Dispatch() queues the following ones behind it.
+      const Task task = std::move(strands_[key].front());
+
+      Result result = {task.sock, task.persistent, false, false};
+      mutex_.Unlock();
+      response.clear();
+      if (!server_->Process(task.request, &response)) {
+        LOG(WARNING) << "Process() failed";
+        result.stop = true;
+      } else if (response.empty()) {
+        LOG(WARNING) << "response is empty";
+      } else if (task.persistent) {
+        result.reusable =
+            SendFrame(task.sock, "", response, server_->timeout_) ==
+            IPC_NO_ERROR;
+        LOG_IF(WARNING, !result.reusable) << "SendFrame() failed";
+      } else if (SendMessage(task.sock, response, server_->timeout_) !=
+                 IPC_NO_ERROR) {
+        LOG(WARNING) << "SendMessage() failed";
+      }
+      mutex_.Lock();
+
+      auto it = strands_.find(key);
+      it->second.pop_front();
+      if (it->second.empty()) {
+        strands_.erase(it);
+      } else {
+        ready_keys_.push_back(key);
+        cond_.Signal();
+      }
+      results_.push_back(result);
+      const char c = 0;
+      // The pipe may be full only if the loop has been woken up already.
+      [[maybe_unused]] const ssize_t written = ::write(wakeup_pipe_[1], &c, 1);
+    }
+  }
+
+  IPCServer *server_;
+  int wakeup_pipe_[2];
+  absl::Mutex mutex_;
+  absl::CondVar cond_;
+  bool stopping_ ABSL_GUARDED_BY(mutex_) = false;
+  // Pending tasks by key.  The front one is running if the key isn't in
+  // |ready_keys_|.
+  absl::flat_hash_map<uint64_t, std::deque<Task>> strands_
+      ABSL_GUARDED_BY(mutex_);
+  std::deque<uint64_t> ready_keys_ ABSL_GUARDED_BY(mutex_);
+  std::vector<Result> results_ ABSL_GUARDED_BY(mutex_);
+  std::vector<Thread> threads_;
+};
+
 IPCServer::IPCServer(const std::string &name, int32_t num_connections,
                      absl::Duration timeout)
     : connected_(false), socket_(kInvalidSocket), timeout_(timeout) {
@@ -404,6 +733,7 @@ IPCServer::IPCServer(const std::string &name, int32_t num_connections,
 
 IPCServer::~IPCServer() {
   Terminate();
+  ClosePersistentSockets();
   ::shutdown(socket_, SHUT_RDWR);
   ::close(socket_);
   if (!IsAbstractSocket(server_address_)) {
@@ -418,54 +748,279 @@ IPCServer::~IPCServer() {
 bool IPCServer::Connected() const { return connected_; }
 
 void IPCServer::Loop() {
-  // The most portable and straightforward single-thread server
-  bool error = false;
+  if (num_worker_threads_ > 0) {
+    LoopWithWorkers();
+  } else {
+    // The most portable and straightforward single-thread server.  The
+    // persistent connections are polled together with the listening socket.
+    bool error = false;
+    std::vector<pollfd> fds;
+    while (!error && !terminate_.HasBeenNotified()) {
+      fds.clear();
+      fds.push_back({socket_, POLLIN, 0});
+      for (const int persistent_socket : persistent_sockets_) {
+        fds.push_back({persistent_socket, POLLIN, 0});
+      }
+      if (::poll(fds.data(), fds.size(), /* timeout */ -1) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        LOG(FATAL) << "poll() failed: " << strerror(errno);
+        return;
+      }
+
+      // Iterates backward as ProcessPersistent() may move or remove the socket.
+      for (size_t i = persistent_sockets_.size(); !error && i > 0; --i) {
+        if (fds[i].revents != 0) {
+          error = !ProcessPersistent(i - 1);
+        }
+      }
+      if (!error && fds[0].revents != 0) {
+        error = !AcceptAndProcess();
+      }
+    }
+  }
+
+  ClosePersistentSockets();
+  ::shutdown(socket_, SHUT_RDWR);
+  ::close(socket_);
+  if (!IsAbstractSocket(server_address_)) {
+    // When abstract namespace is used, unlink() is not necessary.
+    ::unlink(server_address_.c_str());
+  }
+  connected_ = false;
+  socket_ = kInvalidSocket;
+}
+
+bool IPCServer::AcceptAndProcess() {
+  const int new_sock = ::accept(socket_, nullptr, nullptr);
+  if (new_sock < 0) {
+    // Transient failures like EMFILE or ECONNABORTED shouldn't stop the
+    // server.  Backs off a moment, as the listening socket stays readable
+    // while the pending connection is left.
+    LOG(ERROR) << "accept() failed: " << strerror(errno);
+    absl::SleepFor(absl::Milliseconds(10));
+    return true;
+  }
   pid_t pid = 0;
+  if (!IsPeerValid(new_sock, &pid)) {
+    ::close(new_sock);
+    return true;
+  }
+
+  if (ReadFramedTransportMagic(new_sock, timeout_)) {
+    AddPersistentSocket(new_sock);
+    // The first frame follows the magic.
+    return ProcessPersistent(persistent_sockets_.size() - 1);
+  }
+
   std::string request;
   std::string response;
-  while (!error && !terminate_.HasBeenNotified()) {
-    const int new_sock = ::accept(socket_, nullptr, nullptr);
-    if (new_sock < 0) {
-      LOG(FATAL) << "accept() failed: " << strerror(errno);
-      return;
-    }
-    if (!IsPeerValid(new_sock, &pid)) {
-      continue;
+  if (RecvMessage(new_sock, &request, timeout_) != IPC_NO_ERROR) {
+    LOG(WARNING) << "RecvMessage() failed";
+    ::close(new_sock);
+    return true;
+  }
+
+  if (!Process(request, &response)) {
+    LOG(WARNING) << "Process() failed";
+    ::close(new_sock);
+    return false;
+  }
+
+  if (response.empty()) {
+    LOG(WARNING) << "response is empty";
+    ::close(new_sock);
+    return true;
+  }
+
+  if (SendMessage(new_sock, response, timeout_) != IPC_NO_ERROR) {
+    LOG(WARNING) << "SendMessage() failed";
+  }
+  ::close(new_sock);
+  return true;
+}
+
+bool IPCServer::ProcessPersistent(size_t index) {
+  const int sock = persistent_sockets_[index];
+  persistent_sockets_.erase(persistent_sockets_.begin() + index);
+
+  std::string request;
+  std::string response;
+  if (const IPCErrorType error = RecvFrame(sock, &request, timeout_);
+      error != IPC_NO_ERROR) {
+    if (error != IPC_NO_CONNECTION) {
+      LOG(WARNING) << "RecvFrame() failed";
     }
+    ::close(sock);
+    return true;
+  }
 
-    if (RecvMessage(new_sock, &request, timeout_) != IPC_NO_ERROR) {
-      LOG(WARNING) << "RecvMessage() failed";
-      ::close(new_sock);
-      continue;
+  if (!Process(request, &response)) {
+    LOG(WARNING) << "Process() failed";
+    ::close(sock);
+    return false;
+  }
+
+  // As with the one-shot transport, an empty response closes the connection.
+  if (response.empty()) {
+    LOG(WARNING) << "response is empty";
+    ::close(sock);
+    return true;
+  }
+
+  if (SendFrame(sock, "", response, timeout_) != IPC_NO_ERROR) {
+    LOG(WARNING) << "SendFrame() failed";
+    ::close(sock);
+    return true;
+  }
+  // Now the most recently used.
+  persistent_sockets_.push_back(sock);
+  return true;
+}
+
+void IPCServer::LoopWithWorkers() {
+  // Same as Loop(), except that the requests are processed on the workers and
+  // the sockets are watched by epoll.  A connection is removed from the epoll
+  // set while its request is being processed, and the workers give it back
+  // through the wakeup fd.
+  const int epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    LOG(FATAL) << "epoll_create1() failed: " << strerror(errno);
+    return;
+  }
+  auto watch = [epoll_fd](int fd) {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      LOG(FATAL) << "epoll_ctl() failed: " << strerror(errno);
     }
+  };
 
-    if (!Process(request, &response)) {
-      LOG(WARNING) << "Process() failed";
-      ::close(new_sock);
-      error = true;
-      continue;
+  worker_pool_ = std::make_unique<WorkerPool>(this, num_worker_threads_);
+  watch(socket_);
+  watch(worker_pool_->wakeup_fd());
+  for (const int persistent_socket : persistent_sockets_) {
+    watch(persistent_socket);
+  }
+
+  bool error = false;
+  epoll_event events[kMaxPersistentConnections + 2];
+  std::vector<int> readable_sockets;
+  while (!error && !terminate_.HasBeenNotified()) {
+    const int num_events =
+        ::epoll_wait(epoll_fd, events, std::size(events), /* timeout */ -1);
+    if (num_events < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(FATAL) << "epoll_wait() failed: " << strerror(errno);
+      break;
     }
 
-    if (response.empty()) {
-      LOG(WARNING) << "response is empty";
-      ::close(new_sock);
-      continue;
+    bool accept = false;
+    bool wakeup = false;
+    readable_sockets.clear();
+    for (int i = 0; i < num_events; ++i) {
+      const int fd = events[i].data.fd;
+      if (fd == socket_) {
+        accept = true;
+      } else if (fd == worker_pool_->wakeup_fd()) {
+        wakeup = true;
+      } else {
+        readable_sockets.push_back(fd);
+      }
     }
 
-    if (SendMessage(new_sock, response, timeout_) != IPC_NO_ERROR) {
-      LOG(WARNING) << "SendMessage() failed";
+    for (const int sock : readable_sockets) {
+      const auto it = std::find(persistent_sockets_.begin(),
+                                persistent_sockets_.end(), sock);
+      if (it == persistent_sockets_.end()) {
+        continue;
+      }
+      // The worker owns the socket until it is given back.
+      ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, sock, nullptr);
+      DispatchPersistent(it - persistent_sockets_.begin());
+    }
+    if (accept) {
+      AcceptAndDispatch();
     }
+    if (wakeup) {
+      for (const WorkerPool::Result &result : worker_pool_->TakeResults()) {
+        error |= result.stop;
+        if (result.persistent && result.reusable) {
+          // Closing an evicted socket also removes it from the epoll set.
+          AddPersistentSocket(result.sock);
+          watch(result.sock);
+        } else {
+          ::close(result.sock);
+        }
+      }
+    }
+  }
+
+  // Waits for the running requests.
+  worker_pool_.reset();
+  ::close(epoll_fd);
+}
+
+void IPCServer::AcceptAndDispatch() {
+  const int new_sock = ::accept(socket_, nullptr, nullptr);
+  if (new_sock < 0) {
+    // Same as AcceptAndProcess().
+    LOG(ERROR) << "accept() failed: " << strerror(errno);
+    absl::SleepFor(absl::Milliseconds(10));
+    return;
+  }
+  pid_t pid = 0;
+  if (!IsPeerValid(new_sock, &pid)) {
     ::close(new_sock);
+    return;
   }
 
-  ::shutdown(socket_, SHUT_RDWR);
-  ::close(socket_);
-  if (!IsAbstractSocket(server_address_)) {
-    // When abstract namespace is used, unlink() is not necessary.
-    ::unlink(server_address_.c_str());
+  const bool persistent = ReadFramedTransportMagic(new_sock, timeout_);
+  std::string request;
+  // The first frame follows the magic.
+  if ((persistent ? RecvFrame(new_sock, &request, timeout_)
+                  : RecvMessage(new_sock, &request, timeout_)) !=
+      IPC_NO_ERROR) {
+    LOG(WARNING) << "Failed to receive the request";
+    ::close(new_sock);
+    return;
   }
-  connected_ = false;
-  socket_ = kInvalidSocket;
+  worker_pool_->Dispatch({new_sock, persistent, std::move(request)});
+}
+
+void IPCServer::DispatchPersistent(size_t index) {
+  const int sock = persistent_sockets_[index];
+  persistent_sockets_.erase(persistent_sockets_.begin() + index);
+
+  std::string request;
+  if (const IPCErrorType error = RecvFrame(sock, &request, timeout_);
+      error != IPC_NO_ERROR) {
+    if (error != IPC_NO_CONNECTION) {
+      LOG(WARNING) << "RecvFrame() failed";
+    }
+    ::close(sock);
+    return;
+  }
+  worker_pool_->Dispatch({sock, true, std::move(request)});
+}
+
+void IPCServer::AddPersistentSocket(int sock) {
+  persistent_sockets_.push_back(sock);
+  if (persistent_sockets_.size() > kMaxPersistentConnections) {
+    ::close(persistent_sockets_.front());
+    persistent_sockets_.erase(persistent_sockets_.begin());
+  }
+}
+
+void IPCServer::ClosePersistentSockets() {
+  for (const int sock : persistent_sockets_) {
+    ::close(sock);
+  }
+  persistent_sockets_.clear();
 }
 
 void IPCServer::Terminate() {
@@ -35,6 +35,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <ios>
 #include <limits>
 #include <memory>
 #include <optional>
@@ -43,8 +44,12 @@
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/flags/flag.h"
 #include "absl/hash/hash.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/ascii.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
@@ -56,10 +61,13 @@
 #include "base/config_file_stream.h"
 #include "base/container/freelist.h"
 #include "base/container/trie.h"
+#include "base/file_stream.h"
+#include "base/file_util.h"
 #include "base/hash.h"
 #include "base/japanese_util.h"
 #include "base/logging.h"
 #include "base/protobuf/message.h"
+#include "base/random.h"
 #include "base/thread.h"
 #include "base/util.h"
 #include "composer/composer.h"
@@ -76,6 +84,10 @@
 #include "storage/lru_cache.h"
 #include "usage_stats/usage_stats.h"
 
+ABSL_FLAG(bool, use_user_history_index, true,
+          "Look up the user history by the key and value index instead of "
+          "scanning the LRU list.");
+
 namespace mozc::prediction {
 namespace {
 
@@ -117,12 +129,41 @@ constexpr char kFileName[] = "user://history.db";
 constexpr char kFileName[] = "user://.history.db";
 #endif  // _WIN32
 
+// The journal is stored next to the history file with this suffix. It starts
+// with the magic and the generation of the snapshot, followed by the records
+// of the size and the encrypted UserHistory.
+constexpr absl::string_view kJournalSuffix = ".journal";
+constexpr absl::string_view kJournalMagic = "MZHJ";
+constexpr size_t kJournalHeaderSize = 4 + sizeof(uint64_t);
+
+// Sync writes a new snapshot instead of appending to the journal when the
+// journal has at least as many entries as the history and as this number.
+constexpr size_t kMinJournalSizeToCompact = 1000;
+
 // Uses '\t' as a key/value delimiter
 constexpr absl::string_view kDelimiter = "\t";
 constexpr absl::string_view kEmojiDescription = "絵文字";
 
 constexpr absl::Duration k62Days = absl::Hours(62 * 24);
 
+// Stale items in EntryIndex are removed only by rebuilding it, which happens
+// when it has more than twice as many items as the LRU plus this margin.
+constexpr size_t kMinIndexRebuildSize = 1024;
+
+// Sorts the LRU elements from the most recently used one.
+template <typename Element>
+void SortByRecency(std::vector<const Element *> *elements) {
+  std::sort(elements->begin(), elements->end(),
+            [](const Element *lhs, const Element *rhs) {
+              return lhs->seq > rhs->seq;
+            });
+}
+
+// Returns true if |str[pos]| is the first byte of a UTF-8 character.
+bool IsCharBoundary(absl::string_view str, size_t pos) {
+  return (static_cast<uint8_t>(str[pos]) & 0xC0) != 0x80;
+}
+
 // TODO(peria, hidehiko): Unify this checker and IsEmojiCandidate in
 //     EmojiRewriter.  If you make similar functions before the merging in
 //     case, put a similar note to avoid twisted dependency.
@@ -237,6 +278,10 @@ bool UserHistoryPredictor::IsPrivacySensitive(const Segments *segments) const {
   return kNonSensitive;
 }
 
+UserHistoryStorage::UserHistoryStorage(const absl::string_view filename)
+    : storage_(filename),
+      journal_filename_(absl::StrCat(filename, kJournalSuffix)) {}
+
 bool UserHistoryStorage::Load() {
   std::string input;
   if (!storage_.Load(&input)) {
@@ -249,6 +294,8 @@ bool UserHistoryStorage::Load() {
     return false;
   }
 
+  ReplayJournal();
+
   const int num_deleted = DeleteEntriesUntouchedFor62Days();
   LOG_IF(INFO, num_deleted > 0)
       << num_deleted << " old entries were not loaded "
@@ -258,6 +305,94 @@ bool UserHistoryStorage::Load() {
   return true;
 }
 
+void UserHistoryStorage::ReplayJournal() {
+  journal_size_ = 0;
+  journal_broken_ = false;
+
+  absl::StatusOr<std::string> journal =
+      FileUtil::GetContents(journal_filename_);
+  if (!journal.ok()) {
+    // Nothing has been appended since the snapshot.
+    return;
+  }
+  absl::string_view data = *journal;
+  if (data.size() < kJournalHeaderSize ||
+      !absl::StartsWith(data, kJournalMagic)) {
+    LOG(ERROR) << "The journal header is broken";
+    journal_broken_ = true;
+    return;
+  }
+  const uint64_t generation =
+      LoadUnaligned<uint64_t>(data.data() + kJournalMagic.size());
+  if (generation == 0 || generation != proto_.journal_generation()) {
+    // The journal of an older snapshot, left when the process exited before
+    // deleting it.
+    LOG(WARNING) << "The journal is not for the snapshot";
+    journal_broken_ = true;
+    return;
+  }
+  data.remove_prefix(kJournalHeaderSize);
+
+  // Entries in the order of the LRU, oldest first. |positions| holds the
+  // index of the live ones by the fingerprint.
+  std::vector<UserHistoryPredictor::Entry> entries;
+  std::vector<bool> live;
+  absl::flat_hash_map<uint32_t, size_t> positions;
+  // Adds |entry| as the most recent one, replacing the old one if any.
+  auto upsert = [&](UserHistoryPredictor::Entry &entry) {
+    const auto [it, inserted] = positions.emplace(
+        UserHistoryPredictor::EntryFingerprint(entry), entries.size());
+    if (!inserted) {
+      live[it->second] = false;
+      it->second = entries.size();
+    }
+    entries.push_back(std::move(entry));
+    live.push_back(true);
+  };
+  entries.reserve(proto_.entries_size());
+  for (UserHistoryPredictor::Entry &entry : *proto_.mutable_entries()) {
+    upsert(entry);
+  }
+
+  std::string payload;
+  mozc::user_history_predictor::UserHistory record;
+  while (!data.empty()) {
+    if (data.size() < sizeof(uint32_t)) {
+      journal_broken_ = true;
+      break;
+    }
+    const uint32_t record_size = LoadUnaligned<uint32_t>(data.data());
+    data.remove_prefix(sizeof(uint32_t));
+    if (data.size() < record_size ||
+        !storage_.DecryptRecord(data.substr(0, record_size), &payload) ||
+        !record.ParseFromString(payload)) {
+      journal_broken_ = true;
+      break;
+    }
+    data.remove_prefix(record_size);
+
+    for (const uint32_t fp : record.removed_entries()) {
+      if (const auto it = positions.find(fp); it != positions.end()) {
+        live[it->second] = false;
+        positions.erase(it);
+      }
+    }
+    for (UserHistoryPredictor::Entry &entry : *record.mutable_entries()) {
+      upsert(entry);
+    }
+    journal_size_ += record.entries_size() + record.removed_entries_size();
+  }
+  LOG_IF(WARNING, journal_broken_)
+      << "The rest of the journal is broken and discarded";
+
+  proto_.clear_entries();
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (live[i]) {
+      *proto_.add_entries() = std::move(entries[i]);
+    }
+  }
+}
+
 bool UserHistoryStorage::Save() {
   if (proto_.entries_size() == 0) {
     LOG(WARNING) << "etries size is 0. Not saved";
@@ -268,6 +403,16 @@ bool UserHistoryStorage::Save() {
   LOG_IF(INFO, num_deleted > 0)
       << num_deleted << " old entries were removed before save";
 
+  // A new generation invalidates the journal of the previous snapshot, even
+  // if it is left after a crash.
+  uint64_t generation = 0;
+  Random random;
+  while (generation == 0) {
+    generation = random();
+  }
+  proto_.set_journal_generation(generation);
+  proto_.clear_removed_entries();
+
   std::string output;
   if (!proto_.AppendToString(&output)) {
     LOG(ERROR) << "AppendToString failed";
@@ -279,6 +424,72 @@ bool UserHistoryStorage::Save() {
     return false;
   }
 
+  if (absl::Status s = FileUtil::UnlinkIfExists(journal_filename_); !s.ok()) {
+    LOG(WARNING) << "Can't delete the journal: " << s;
+  }
+
+  return true;
+}
+
+bool UserHistoryStorage::Append() {
+  const uint64_t generation = proto_.journal_generation();
+  if (generation == 0) {
+    return false;
+  }
+
+  std::string header(kJournalMagic);
+  header.resize(kJournalHeaderSize);
+  StoreUnaligned<uint64_t>(generation, header.begin() + kJournalMagic.size());
+
+  std::string output;
+  if (FileUtil::FileExists(journal_filename_).ok()) {
+    InputFileStream ifs(journal_filename_, std::ios::in | std::ios::binary);
+    std::string current_header(kJournalHeaderSize, '\0');
+    ifs.read(current_header.data(), current_header.size());
+    if (!ifs || current_header != header) {
+      LOG(WARNING) << "The journal is not for the snapshot";
+      return false;
+    }
+  } else {
+    output = std::move(header);
+  }
+
+  std::string serialized;
+  if (!proto_.AppendToString(&serialized)) {
+    LOG(ERROR) << "AppendToString failed";
+    return false;
+  }
+  std::string record;
+  if (!storage_.EncryptRecord(serialized, &record)) {
+    LOG(ERROR) << "Can't encrypt user history data.";
+    return false;
+  }
+  const size_t record_offset = output.size();
+  output.resize(record_offset + sizeof(uint32_t));
+  StoreUnaligned<uint32_t>(static_cast<uint32_t>(record.size()),
+                           output.begin() + record_offset);
+  output.append(record);
+
+  {
+    OutputFileStream ofs(journal_filename_,
+                         std::ios::out | std::ios::binary | std::ios::app);
+    if (!ofs) {
+      LOG(ERROR) << "failed to write: " << journal_filename_;
+      return false;
+    }
+    VLOG(1) << "Appending user history to: " << journal_filename_;
+    ofs.write(output.data(), output.size());
+    if (!ofs.flush()) {
+      LOG(ERROR) << "failed to write: " << journal_filename_;
+      return false;
+    }
+  }
+#ifdef _WIN32
+  if (record_offset > 0 && !FileUtil::HideFile(journal_filename_)) {
+    LOG(ERROR) << "Cannot make hidden: " << journal_filename_;
+  }
+#endif  // _WIN32
+
   return true;
 }
 
@@ -342,6 +553,88 @@ UserHistoryPredictor::EntryPriorityQueue::NewEntry() {
   return pool_.Alloc();
 }
 
+void UserHistoryPredictor::EntryIndex::Sync(const DicCache &dic) {
+  if (&dic != dic_ || keys_.size() > 2 * dic.Size() + kMinIndexRebuildSize ||
+      values_.size() > 2 * dic.Size() + kMinIndexRebuildSize) {
+    Clear();
+    dic_ = &dic;
+  }
+  const DicElement *head = dic.Head();
+  if (head == nullptr) {
+    return;
+  }
+  // Elements are sorted by |seq| in descending order, so the ones not
+  // indexed yet are at the head.
+  for (const DicElement *elm = head; elm != nullptr && elm->seq > synced_seq_;
+       elm = elm->next) {
+    if (!elm->value.key().empty()) {
+      keys_.emplace(elm->value.key(), elm->key);
+    }
+    if (!elm->value.value().empty()) {
+      values_.emplace(elm->value.value(), elm->key);
+    }
+  }
+  synced_seq_ = head->seq;
+}
+
+void UserHistoryPredictor::EntryIndex::Clear() {
+  dic_ = nullptr;
+  synced_seq_ = 0;
+  keys_.clear();
+  values_.clear();
+}
+
+// static
+void UserHistoryPredictor::EntryIndex::Collect(
+    const DicCache &dic, const Index &index, bool by_key,
+    absl::string_view str, bool prefix,
+    std::vector<const DicElement *> *elements) {
+  for (auto it = index.lower_bound(std::make_pair(std::string(str), 0u));
+       it != index.end(); ++it) {
+    if (prefix ? !absl::StartsWith(it->first, str) : it->first != str) {
+      break;
+    }
+    // The entry may have been evicted, or overwritten by another one with
+    // the same fingerprint, after it was indexed.
+    const DicElement *elm = dic.FindElement(it->second);
+    if (elm == nullptr ||
+        (by_key ? elm->value.key() : elm->value.value()) != it->first) {
+      continue;
+    }
+    elements->push_back(elm);
+  }
+}
+
+std::vector<const UserHistoryPredictor::DicElement *>
+UserHistoryPredictor::EntryIndex::LookupKey(const DicCache &dic,
+                                            absl::string_view key) const {
+  std::vector<const DicElement *> elements;
+  if (key.empty()) {
+    return elements;
+  }
+  Collect(dic, keys_, true, key, true, &elements);
+  for (size_t len = 1; len < key.size(); ++len) {
+    if (IsCharBoundary(key, len)) {
+      Collect(dic, keys_, true, key.substr(0, len), false, &elements);
+    }
+  }
+  SortByRecency(&elements);
+  return elements;
+}
+
+std::vector<const UserHistoryPredictor::DicElement *>
+UserHistoryPredictor::EntryIndex::LookupValueSuffix(
+    const DicCache &dic, absl::string_view str) const {
+  std::vector<const DicElement *> elements;
+  for (size_t pos = 0; pos < str.size(); ++pos) {
+    if (IsCharBoundary(str, pos)) {
+      Collect(dic, values_, false, str.substr(pos), false, &elements);
+    }
+  }
+  SortByRecency(&elements);
+  return elements;
+}
+
 UserHistoryPredictor::UserHistoryPredictor(
     const DictionaryInterface *dictionary, const PosMatcher *pos_matcher,
     const SuppressionDictionary *suppression_dictionary,
@@ -458,6 +751,17 @@ bool UserHistoryPredictor::Load(const UserHistoryStorage &history) {
     dic_->Insert(EntryFingerprint(entry), entry);
   }
 
+  // A broken journal is replaced by a new snapshot at the next save.
+  journal_generation_ =
+      history.journal_broken() ? 0 : history.GetProto().journal_generation();
+  journal_size_ = history.journal_size();
+  saved_seq_ = dic_->Head() == nullptr ? 0 : dic_->Head()->seq;
+  saved_entries_.clear();
+  for (const DicElement *elm = dic_->Head(); elm != nullptr; elm = elm->next) {
+    saved_entries_.insert(elm->key);
+  }
+  modified_entries_.clear();
+
   VLOG(1) << "Loaded user history, size=" << history.GetProto().entries_size();
 
   return true;
@@ -471,30 +775,87 @@ bool UserHistoryPredictor::Save() {
   // Do not check incognito_mode or use_history_suggest in Config here.
   // The input data should not have been inserted when those flags are on.
 
-  const DicElement *tail = dic_->Tail();
-  if (tail == nullptr) {
+  if (dic_->Tail() == nullptr) {
     return true;
   }
 
-  const std::string filename = GetUserHistoryFileName();
+  // Removes the entries untouched for 62 days, which are not saved.
+  const uint64_t expiry_time = absl::ToUnixSeconds(
+      std::max(Clock::GetAbslTime() - k62Days, absl::UnixEpoch()));
+  std::vector<uint32_t> expired_keys;
+  for (const DicElement *elm = dic_->Head(); elm != nullptr; elm = elm->next) {
+    if (elm->value.entry_type() == Entry::DEFAULT_ENTRY &&
+        elm->value.last_access_time() < expiry_time) {
+      expired_keys.push_back(elm->key);
+    }
+  }
+  for (const uint32_t key : expired_keys) {
+    dic_->Erase(key);
+  }
 
-  UserHistoryStorage history(filename);
-  for (const DicElement *elm = tail; elm != nullptr; elm = elm->prev) {
-    *history.GetProto().add_entries() = elm->value;
+  const std::string filename = GetUserHistoryFileName();
+  const bool compact =
+      journal_generation_ == 0 ||
+      journal_size_ >= std::max(dic_->Size(), kMinJournalSizeToCompact);
+  if ((compact || !SaveJournal(filename)) && !SaveSnapshot(filename)) {
+    return false;
   }
+  saved_seq_ = dic_->Head() == nullptr ? 0 : dic_->Head()->seq;
+  modified_entries_.clear();
 
   // Updates usage stats here.
   UsageStats::SetInteger("UserHistoryPredictorEntrySize",
-                         static_cast<int>(history.GetProto().entries_size()));
+                         static_cast<int>(dic_->Size()));
+
+  updated_ = false;
+
+  return true;
+}
+
+bool UserHistoryPredictor::SaveSnapshot(const std::string &filename) {
+  UserHistoryStorage history(filename);
+  absl::flat_hash_set<uint32_t> entries;
+  entries.reserve(dic_->Size());
+  for (const DicElement *elm = dic_->Tail(); elm != nullptr; elm = elm->prev) {
+    *history.GetProto().add_entries() = elm->value;
+    entries.insert(elm->key);
+  }
 
   if (!history.Save()) {
     LOG(ERROR) << "UserHistoryStorage::Save() failed";
     return false;
   }
-  Load(history);
+  journal_generation_ = history.GetProto().journal_generation();
+  journal_size_ = 0;
+  saved_entries_ = std::move(entries);
+  return true;
+}
 
-  updated_ = false;
+bool UserHistoryPredictor::SaveJournal(const std::string &filename) {
+  UserHistoryStorage history(filename);
+  mozc::user_history_predictor::UserHistory &proto = history.GetProto();
+  proto.set_journal_generation(journal_generation_);
+  absl::flat_hash_set<uint32_t> entries;
+  entries.reserve(dic_->Size());
+  for (const DicElement *elm = dic_->Tail(); elm != nullptr; elm = elm->prev) {
+    entries.insert(elm->key);
+    if (elm->seq > saved_seq_ || modified_entries_.contains(elm->key)) {
+      *proto.add_entries() = elm->value;
+    }
+  }
+  for (const uint32_t key : saved_entries_) {
+    if (!entries.contains(key)) {
+      proto.add_removed_entries(key);
+    }
+  }
 
+  const size_t size = proto.entries_size() + proto.removed_entries_size();
+  if (size > 0 && !history.Append()) {
+    LOG(WARNING) << "UserHistoryStorage::Append() failed";
+    return false;
+  }
+  journal_size_ += size;
+  saved_entries_ = std::move(entries);
   return true;
 }
 
@@ -506,6 +867,9 @@ bool UserHistoryPredictor::ClearAllHistory() {
   // Renews DicCache as LruCache tries to reuse the internal value by
   // using FreeList
   dic_ = std::make_unique<DicCache>(UserHistoryPredictor::cache_size());
+  index_.Clear();
+  // All the entries are replaced, so the journal is not worth appending to.
+  journal_generation_ = 0;
 
   // insert a dummy event entry.
   InsertEvent(Entry::CLEAN_ALL_EVENT);
@@ -618,6 +982,7 @@ UserHistoryPredictor::RemoveNgramChain(
           // |entry| is the second-to-the-last node. So cut the link to the
           // child entry.
           EraseNextEntries(fp, entry);
+          modified_entries_.insert(EntryFingerprint(*entry));
           return DONE;
         default:
           break;
@@ -661,6 +1026,7 @@ bool UserHistoryPredictor::ClearHistoryEntry(const absl::string_view key,
       entry->set_suggestion_freq(0);
       entry->set_conversion_freq(0);
       entry->set_removed(true);
+      modified_entries_.insert(Fingerprint(key, value));
       // We don't clear entry->next_entries() so that we can generate prediction
       // by chaining.
       deleted = true;
@@ -1244,20 +1610,37 @@ const UserHistoryPredictor::Entry *UserHistoryPredictor::LookupPrevEntry(
     const std::string &prev_value = prev_entry == nullptr
                                         ? history_segment.candidate(0).value
                                         : prev_entry->value();
+    // entry->value() equals to the prev_value or
+    // entry->value() is a SUFFIX of prev_value.
+    // length of entry->value() must be >= 2, as single-length
+    // match would be noisy.
+    auto is_prev_entry = [&](const Entry *entry) {
+      return IsValidEntry(*entry) && entry != prev_entry &&
+             entry->next_entries_size() > 0 &&
+             Util::CharsLen(entry->value()) >= 2 &&
+             (entry->value() == prev_value ||
+              absl::EndsWith(prev_value, entry->value()));
+    };
     int trial = 0;
+    if (absl::GetFlag(FLAGS_use_user_history_index)) {
+      // The index only returns the entries whose value is a suffix of
+      // |prev_value|, so |kMaxPrevValueTrial| bounds the matches.
+      index_.Sync(*dic_);
+      for (const DicElement *elm :
+           index_.LookupValueSuffix(*dic_, prev_value)) {
+        if (trial++ >= kMaxPrevValueTrial) {
+          break;
+        }
+        if (is_prev_entry(&elm->value)) {
+          return &elm->value;
+        }
+      }
+      return prev_entry;
+    }
     for (const DicElement *elm = dic_->Head();
          trial++ < kMaxPrevValueTrial && elm != nullptr; elm = elm->next) {
-      const Entry *entry = &(elm->value);
-      // entry->value() equals to the prev_value or
-      // entry->value() is a SUFFIX of prev_value.
-      // length of entry->value() must be >= 2, as single-length
-      // match would be noisy.
-      if (IsValidEntry(*entry) && entry != prev_entry &&
-          entry->next_entries_size() > 0 &&
-          Util::CharsLen(entry->value()) >= 2 &&
-          (entry->value() == prev_value ||
-           absl::EndsWith(prev_value, entry->value()))) {
-        prev_entry = entry;
+      if (is_prev_entry(&elm->value)) {
+        prev_entry = &elm->value;
         break;
       }
     }
@@ -1300,31 +1683,65 @@ void UserHistoryPredictor::GetResultsFromHistoryDictionary(
 
   const absl::Time now = Clock::GetAbslTime();
   int trial = 0;
-  for (const DicElement *elm = dic_->Head(); elm != nullptr; elm = elm->next) {
-    if (!IsValidEntryIgnoringRemovedField(elm->value)) {
-      continue;
+  // Returns false when no more entries need to be checked.
+  auto lookup = [&](const Entry &entry) {
+    if (!IsValidEntryIgnoringRemovedField(entry)) {
+      return true;
     }
-    if (absl::FromUnixSeconds(elm->value.last_access_time()) + k62Days < now) {
+    if (absl::FromUnixSeconds(entry.last_access_time()) + k62Days < now) {
       updated_ = true;  // We found an entry to be deleted at next save.
-      continue;
+      return true;
     }
     if (request.request_type() == ConversionRequest::SUGGESTION &&
         trial++ >= kMaxSuggestionTrial) {
       VLOG(2) << "too many trials";
-      break;
+      return false;
     }
 
     // Lookup key from elm_value and prev_entry.
     // If a new entry is found, the entry is pushed to the results.
     // TODO(team): make KanaFuzzyLookupEntry().
-    if (!LookupEntry(request_type, input_key, base_key, expanded.get(),
-                     &(elm->value), prev_entry, results) &&
-        !RomanFuzzyLookupEntry(roman_input_key, &(elm->value), results)) {
-      continue;
+    if (!LookupEntry(request_type, input_key, base_key, expanded.get(), &entry,
+                     prev_entry, results) &&
+        !RomanFuzzyLookupEntry(roman_input_key, &entry, results)) {
+      return true;
     }
 
     // already found enough results.
-    if (results->size() >= max_results_size) {
+    return results->size() < max_results_size;
+  };
+
+  // With a non-empty |base_key|, only the entries whose key starts with
+  // |base_key| or is a prefix of it can match, so they are looked up from
+  // the index. Without any input, only the next entries of |prev_entry| can
+  // match. The expanded keys for an empty |base_key| and the fuzzy roman
+  // lookup still need to check every entry.
+  if (absl::GetFlag(FLAGS_use_user_history_index) &&
+      (!base_key.empty() || expanded == nullptr) && roman_input_key.empty()) {
+    std::vector<const DicElement *> elements;
+    if (!base_key.empty()) {
+      index_.Sync(*dic_);
+      elements = index_.LookupKey(*dic_, base_key);
+    } else if (prev_entry != nullptr) {
+      for (const NextEntry &next_entry : prev_entry->next_entries()) {
+        const DicElement *elm = dic_->FindElement(next_entry.entry_fp());
+        if (elm != nullptr &&
+            std::find(elements.begin(), elements.end(), elm) ==
+                elements.end()) {
+          elements.push_back(elm);
+        }
+      }
+      SortByRecency(&elements);
+    }
+    for (const DicElement *elm : elements) {
+      if (!lookup(elm->value)) {
+        break;
+      }
+    }
+    return;
+  }
+  for (const DicElement *elm = dic_->Head(); elm != nullptr; elm = elm->next) {
+    if (!lookup(elm->value)) {
       break;
     }
   }
@@ -1854,9 +2271,10 @@ void UserHistoryPredictor::InsertHistory(RequestType request_type,
          Util::CharsLen(conversion_segment.value) > 1)) {
       return;
     }
-    Entry *history_entry = dic_->MutableLookupWithoutInsert(
-        LearningSegmentFingerprint(history_segment));
+    const uint32_t history_fp = LearningSegmentFingerprint(history_segment);
+    Entry *history_entry = dic_->MutableLookupWithoutInsert(history_fp);
     if (history_entry) {
+      modified_entries_.insert(history_fp);
       NextEntry next_entry;
       if (!is_suggestion_selected) {
         next_entry.set_entry_fp(LearningSegmentFingerprint(conversion_segment));
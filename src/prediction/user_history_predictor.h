@@ -40,6 +40,7 @@
 #include <utility>
 #include <vector>
 
+#include "absl/container/btree_set.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/string_view.h"
 #include "base/container/freelist.h"
@@ -59,17 +60,30 @@
 namespace mozc::prediction {
 
 // Added serialization method for UserHistory.
+//
+// The history is stored as an encrypted snapshot and an append-only journal
+// next to it. Each record of the journal is encrypted separately and holds
+// the entries updated and removed since the previous record, so that a sync
+// writes only the changes. The journal starts with the generation of the
+// snapshot it belongs to, and is replayed on load only if it matches the
+// snapshot. A broken record at the end, e.g. written partially on a crash, is
+// discarded with the rest of the journal after it.
 class UserHistoryStorage {
  public:
-  explicit UserHistoryStorage(const absl::string_view filename)
-      : storage_(filename) {}
+  explicit UserHistoryStorage(absl::string_view filename);
 
-  // Loads from encrypted file.
+  // Loads from encrypted file, and replays the journal on it.
   bool Load();
 
-  // Saves history into encrypted file.
+  // Saves history into encrypted file as a new snapshot, and deletes the
+  // journal.
   bool Save();
 
+  // Appends the entries and the removed_entries of the proto to the journal
+  // as a record. Fails if the journal_generation of the proto is not the one
+  // of the snapshot on the disk, in which case Save() needs to be used.
+  bool Append();
+
   // Deletes entries before the given timestamp.  Returns the number of deleted
   // entries.
   int DeleteEntriesBefore(uint64_t timestamp);
@@ -83,9 +97,24 @@ class UserHistoryStorage {
     return proto_;
   }
 
+  // Returns the number of entries and removals replayed from the journal by
+  // Load().
+  size_t journal_size() const { return journal_size_; }
+
+  // Returns true if Load() found a broken record in the journal.
+  bool journal_broken() const { return journal_broken_; }
+
+  const std::string &journal_filename() const { return journal_filename_; }
+
  private:
+  // Replays the records of the journal on |proto_|.
+  void ReplayJournal();
+
   storage::EncryptedStringStorage storage_;
+  const std::string journal_filename_;
   mozc::user_history_predictor::UserHistory proto_;
+  size_t journal_size_ = 0;
+  bool journal_broken_ = false;
 };
 
 // UserHistoryPredictor is NOT thread safe.
@@ -250,9 +279,16 @@ class UserHistoryPredictor : public PredictorInterface {
   // Loads user history data to an on-memory LRU.
   bool Load(const UserHistoryStorage &history);
 
-  // Saves user history data in LRU to local file
+  // Saves user history data in LRU to local file. Only the changes since the
+  // last save are appended to the journal until it grows as large as the
+  // history.
   bool Save();
 
+  // Writes all the entries as a new snapshot, or appends the changes since
+  // the last save to the journal.
+  bool SaveSnapshot(const std::string &filename);
+  bool SaveJournal(const std::string &filename);
+
   // non-blocking version of Load
   // This makes a new thread and call Load()
   bool AsyncSave();
@@ -327,6 +363,44 @@ class UserHistoryPredictor : public PredictorInterface {
   typedef mozc::storage::LruCache<uint32_t, Entry> DicCache;
   typedef DicCache::Element DicElement;
 
+  // Index of |dic_| by the keys and the values of the entries, so that the
+  // lookups per key event are proportional to the number of matches rather
+  // than to the size of the history. The index follows |dic_| lazily:
+  // Sync() adds the elements pushed to the head of the LRU list since the
+  // last call, and the elements evicted or overwritten since then are
+  // filtered out at lookup time.
+  class EntryIndex final {
+   public:
+    void Sync(const DicCache &dic);
+    void Clear();
+
+    // Returns the elements whose key starts with |key| or is a prefix of
+    // |key|, most recently used first.
+    std::vector<const DicElement *> LookupKey(const DicCache &dic,
+                                              absl::string_view key) const;
+
+    // Returns the elements whose value is a suffix of |str|, most recently
+    // used first.
+    std::vector<const DicElement *> LookupValueSuffix(
+        const DicCache &dic, absl::string_view str) const;
+
+   private:
+    // Pairs of the key (or value) and the fingerprint of the entry.
+    typedef absl::btree_set<std::pair<std::string, uint32_t>> Index;
+
+    // Appends the live elements indexed by |str| in |index| to |elements|.
+    // When |prefix| is true, the ones indexed by strings starting with |str|
+    // are also appended.
+    static void Collect(const DicCache &dic, const Index &index, bool by_key,
+                        absl::string_view str, bool prefix,
+                        std::vector<const DicElement *> *elements);
+
+    const DicCache *dic_ = nullptr;
+    uint64_t synced_seq_ = 0;
+    Index keys_;
+    Index values_;
+  };
+
   bool CheckSyncerAndDelete() const;
 
   // If |entry| is the target of prediction,
@@ -474,6 +548,20 @@ class UserHistoryPredictor : public PredictorInterface {
   bool content_word_learning_enabled_;
   mutable std::atomic<bool> updated_;
   std::unique_ptr<DicCache> dic_;
+  mutable EntryIndex index_;
+
+  // What the files on the disk hold, so that Save() appends only the changes
+  // to the journal. |journal_generation_| is the generation of the snapshot,
+  // or 0 to write a new snapshot at the next save.
+  uint64_t journal_generation_ = 0;
+  size_t journal_size_ = 0;
+  // |seq| of the head of |dic_| at the last save, and the fingerprints of the
+  // entries saved then.
+  uint64_t saved_seq_ = 0;
+  absl::flat_hash_set<uint32_t> saved_entries_;
+  // Fingerprints of the entries modified without moving to the head of |dic_|
+  // since the last save.
+  absl::flat_hash_set<uint32_t> modified_entries_;
   mutable std::optional<BackgroundFuture<void>> sync_;
 };
 
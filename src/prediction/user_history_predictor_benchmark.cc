@@ -0,0 +1,266 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark of the per-keystroke lookup of UserHistoryPredictor.
+//
+// The history is filled with --num_entries random words learned by Finish().
+// Then sampled words are typed one character at a time, and every keystroke
+// runs a suggestion and a prediction. Zero query suggestions after each word
+// are measured as well. The latency is reported with and without the key
+// and value index of the history.
+//
+// Usage:
+//   user_history_predictor_benchmark --num_entries=10000 --num_words=300
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
+#include "absl/random/random.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "base/file/temp_dir.h"
+#include "base/init_mozc.h"
+#include "base/japanese_util.h"
+#include "base/logging.h"
+#include "base/status.h"
+#include "base/stopwatch.h"
+#include "base/system_util.h"
+#include "base/util.h"
+#include "composer/composer.h"
+#include "composer/table.h"
+#include "config/config_handler.h"
+#include "converter/segments.h"
+#include "data_manager/testing/mock_data_manager.h"
+#include "dictionary/pos_matcher.h"
+#include "dictionary/suppression_dictionary.h"
+#include "dictionary/user_dictionary_stub.h"
+#include "prediction/user_history_predictor.h"
+#include "protocol/commands.pb.h"
+#include "protocol/config.pb.h"
+#include "request/conversion_request.h"
+
+ABSL_DECLARE_FLAG(bool, use_user_history_index);
+
+ABSL_FLAG(int32_t, num_entries, 10000, "Number of words in the history.");
+ABSL_FLAG(int32_t, num_words, 300, "Number of words to type.");
+
+namespace mozc {
+namespace prediction {
+namespace {
+
+// Returns a random hiragana word of 2 to 8 characters.
+std::string RandomWord(absl::BitGen &gen) {
+  const int length = absl::Uniform<int>(absl::IntervalClosed, gen, 2, 8);
+  std::string word;
+  for (int i = 0; i < length; ++i) {
+    Util::Ucs4ToUtf8Append(
+        absl::Uniform<char32_t>(absl::IntervalClosed, gen, 0x3042, 0x3093),
+        &word);
+  }
+  return word;
+}
+
+absl::Duration Percentile(absl::Span<const absl::Duration> sorted, double p) {
+  if (sorted.empty()) {
+    return absl::ZeroDuration();
+  }
+  const size_t index = std::min(
+      sorted.size() - 1, static_cast<size_t>(p / 100.0 * sorted.size()));
+  return sorted[index];
+}
+
+void PrintResult(absl::string_view name, std::vector<absl::Duration> latencies,
+                 int64_t num_results) {
+  absl::Duration total;
+  for (const absl::Duration latency : latencies) {
+    total += latency;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  std::cout << absl::StrFormat(
+                   "%-32s %10.3f ms  p50: %7.1f us  p99: %7.1f us  "
+                   "(%d lookups, %d candidates)",
+                   name, absl::ToDoubleMilliseconds(total),
+                   absl::ToDoubleMicroseconds(Percentile(latencies, 50)),
+                   absl::ToDoubleMicroseconds(Percentile(latencies, 99)),
+                   latencies.size(), num_results)
+            << std::endl;
+}
+
+class Benchmark {
+ public:
+  Benchmark()
+      : composer_(&table_, &request_, &config_),
+        convreq_(&composer_, &request_, &config_) {
+    config::ConfigHandler::GetDefaultConfig(&config_);
+    request_.set_zero_query_suggestion(true);
+    pos_matcher_.Set(data_manager_.GetPosMatcherData());
+    predictor_ = std::make_unique<UserHistoryPredictor>(
+        &dictionary_, &pos_matcher_, &suppression_dictionary_, false);
+    predictor_->Wait();
+    predictor_->ClearAllHistory();
+    predictor_->Wait();
+  }
+
+  // Learns |words| as a sequence, so that each word is also learned as the
+  // next entry of the previous one.
+  void Learn(absl::Span<const std::string> words) {
+    Segments segments;
+    for (size_t i = 0; i < words.size(); ++i) {
+      segments.Clear();
+      if (i > 0) {
+        AddSegment(words[i - 1], Segment::HISTORY, &segments);
+      }
+      AddSegment(words[i], Segment::FIXED_VALUE, &segments);
+      composer_.Reset();
+      composer_.SetPreeditTextForTestOnly(words[i]);
+      convreq_.set_request_type(ConversionRequest::CONVERSION);
+      predictor_->Finish(convreq_, &segments);
+    }
+  }
+
+  void Run(absl::string_view name, absl::Span<const std::string> words,
+           bool use_index) {
+    absl::SetFlag(&FLAGS_use_user_history_index, use_index);
+    std::vector<absl::Duration> suggestion, prediction, zero_query;
+    int64_t num_suggestions = 0, num_predictions = 0, num_zero_query = 0;
+    Segments segments;
+    for (const std::string &word : words) {
+      std::string key;
+      for (const char32_t c : Util::Utf8ToUtf32(word)) {
+        Util::Ucs4ToUtf8Append(c, &key);
+        num_suggestions += Lookup(ConversionRequest::SUGGESTION, key, "",
+                                  &segments, &suggestion);
+        num_predictions += Lookup(ConversionRequest::PREDICTION, key, "",
+                                  &segments, &prediction);
+      }
+      num_zero_query += Lookup(ConversionRequest::SUGGESTION, "", word,
+                               &segments, &zero_query);
+    }
+    PrintResult(absl::StrFormat("%s/suggestion", name), std::move(suggestion),
+                num_suggestions);
+    PrintResult(absl::StrFormat("%s/prediction", name), std::move(prediction),
+                num_predictions);
+    PrintResult(absl::StrFormat("%s/zero_query", name), std::move(zero_query),
+                num_zero_query);
+  }
+
+ private:
+  // Adds a segment whose candidate is the katakana of |key|.
+  static void AddSegment(const std::string &key, Segment::SegmentType type,
+                         Segments *segments) {
+    Segment *segment = segments->add_segment();
+    segment->set_key(key);
+    segment->set_segment_type(type);
+    Segment::Candidate *candidate = segment->add_candidate();
+    candidate->key = key;
+    candidate->content_key = key;
+    candidate->value = japanese_util::HiraganaToKatakana(key);
+    candidate->content_value = candidate->value;
+  }
+
+  // Looks up |key| after the history segment of |history| if not empty, and
+  // returns the number of candidates.
+  size_t Lookup(ConversionRequest::RequestType type, const std::string &key,
+                const std::string &history, Segments *segments,
+                std::vector<absl::Duration> *latencies) {
+    segments->Clear();
+    if (!history.empty()) {
+      AddSegment(history, Segment::HISTORY, segments);
+    }
+    composer_.Reset();
+    composer_.SetPreeditTextForTestOnly(key);
+    convreq_.set_request_type(type);
+    Segment *segment = segments->add_segment();
+    segment->set_key(key);
+    segment->set_segment_type(Segment::FIXED_VALUE);
+
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    predictor_->PredictForRequest(convreq_, segments);
+    latencies->push_back(stopwatch.GetElapsed());
+    return segments->conversion_segment(0).candidates_size();
+  }
+
+  testing::MockDataManager data_manager_;
+  dictionary::UserDictionaryStub dictionary_;
+  dictionary::PosMatcher pos_matcher_;
+  dictionary::SuppressionDictionary suppression_dictionary_;
+  commands::Request request_;
+  config::Config config_;
+  composer::Table table_;
+  composer::Composer composer_;
+  ConversionRequest convreq_;
+  std::unique_ptr<UserHistoryPredictor> predictor_;
+};
+
+void Run() {
+  // Keeps the user history of the benchmark away from the real one.
+  absl::StatusOr<TempDirectory> temp_dir =
+      TempDirectory::Default().CreateTempDirectory();
+  CHECK_OK(temp_dir);
+  SystemUtil::SetUserProfileDirectory(temp_dir->path());
+
+  absl::BitGen gen;
+  std::vector<std::string> history(absl::GetFlag(FLAGS_num_entries));
+  for (std::string &word : history) {
+    word = RandomWord(gen);
+  }
+  // Types the words learned at any time, with some unknown ones.
+  std::vector<std::string> words(absl::GetFlag(FLAGS_num_words));
+  for (std::string &word : words) {
+    word = absl::Bernoulli(gen, 0.2)
+               ? RandomWord(gen)
+               : history[absl::Uniform<size_t>(gen, 0, history.size())];
+  }
+
+  Benchmark benchmark;
+  benchmark.Learn(history);
+  benchmark.Run("scan", words, false);
+  benchmark.Run("index", words, true);
+}
+
+}  // namespace
+}  // namespace prediction
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  mozc::prediction::Run();
+  return 0;
+}
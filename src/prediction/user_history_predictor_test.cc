@@ -38,17 +38,22 @@
 #include <string>
 #include <vector>
 
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
 #include "absl/random/random.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "base/clock.h"
 #include "base/clock_mock.h"
 #include "base/container/trie.h"
 #include "base/file/temp_dir.h"
 #include "base/file_util.h"
+#include "base/japanese_util.h"
 #include "base/logging.h"
 #include "base/random.h"
 #include "base/system_util.h"
@@ -74,6 +79,8 @@
 #include "usage_stats/usage_stats.h"
 #include "usage_stats/usage_stats_testing_util.h"
 
+ABSL_DECLARE_FLAG(bool, use_user_history_index);
+
 namespace mozc::prediction {
 namespace {
 
@@ -2310,6 +2317,204 @@ TEST_F(UserHistoryPredictorTest, UserHistoryStorageContainingInvalidEntries) {
   }
 }
 
+namespace {
+
+void AddHistoryEntry(absl::string_view key, absl::string_view value,
+                     user_history_predictor::UserHistory *history) {
+  UserHistoryPredictor::Entry *entry = history->add_entries();
+  entry->set_key(std::string(key));
+  entry->set_value(std::string(value));
+  entry->set_last_access_time(absl::ToUnixSeconds(Clock::GetAbslTime()));
+}
+
+std::vector<std::string> GetHistoryValues(
+    const user_history_predictor::UserHistory &history) {
+  std::vector<std::string> values;
+  for (const UserHistoryPredictor::Entry &entry : history.entries()) {
+    values.push_back(entry.value());
+  }
+  return values;
+}
+
+}  // namespace
+
+TEST_F(UserHistoryPredictorTest, UserHistoryStorageJournal) {
+  TempDirectory temp_dir = testing::MakeTempDirectoryOrDie();
+  const std::string filename = FileUtil::JoinPath(temp_dir.path(), "history");
+
+  UserHistoryStorage snapshot(filename);
+  AddHistoryEntry("a", "A", &snapshot.GetProto());
+  AddHistoryEntry("b", "B", &snapshot.GetProto());
+  AddHistoryEntry("c", "C", &snapshot.GetProto());
+  ASSERT_TRUE(snapshot.Save());
+  const uint64_t generation = snapshot.GetProto().journal_generation();
+  EXPECT_NE(generation, 0);
+  const absl::StatusOr<std::string> snapshot_contents =
+      FileUtil::GetContents(filename);
+  ASSERT_OK(snapshot_contents);
+
+  // Updates "b" and removes "c".
+  {
+    UserHistoryStorage journal(filename);
+    journal.GetProto().set_journal_generation(generation);
+    AddHistoryEntry("b", "B", &journal.GetProto());
+    journal.GetProto().mutable_entries(0)->set_conversion_freq(2);
+    journal.GetProto().add_removed_entries(
+        UserHistoryPredictor::Fingerprint("c", "C"));
+    ASSERT_TRUE(journal.Append());
+  }
+  {
+    UserHistoryStorage journal(filename);
+    journal.GetProto().set_journal_generation(generation);
+    AddHistoryEntry("d", "D", &journal.GetProto());
+    ASSERT_TRUE(journal.Append());
+  }
+  // The snapshot is not rewritten by appends.
+  EXPECT_EQ(FileUtil::GetContents(filename).value(), *snapshot_contents);
+
+  UserHistoryStorage loaded(filename);
+  ASSERT_TRUE(loaded.Load());
+  EXPECT_FALSE(loaded.journal_broken());
+  EXPECT_EQ(loaded.journal_size(), 3);
+  EXPECT_THAT(GetHistoryValues(loaded.GetProto()),
+              ::testing::ElementsAre("A", "B", "D"));
+  EXPECT_EQ(loaded.GetProto().entries(1).conversion_freq(), 2);
+
+  // Appending to the journal of another snapshot fails.
+  {
+    UserHistoryStorage journal(filename);
+    journal.GetProto().set_journal_generation(generation + 1);
+    AddHistoryEntry("e", "E", &journal.GetProto());
+    EXPECT_FALSE(journal.Append());
+  }
+
+  // A new snapshot includes the journal and deletes it.
+  ASSERT_TRUE(loaded.Save());
+  EXPECT_NE(loaded.GetProto().journal_generation(), generation);
+  EXPECT_FALSE(FileUtil::FileExists(loaded.journal_filename()).ok());
+  UserHistoryStorage reloaded(filename);
+  ASSERT_TRUE(reloaded.Load());
+  EXPECT_EQ(reloaded.journal_size(), 0);
+  EXPECT_THAT(GetHistoryValues(reloaded.GetProto()),
+              ::testing::ElementsAre("A", "B", "D"));
+}
+
+TEST_F(UserHistoryPredictorTest, UserHistoryStorageJournalCrash) {
+  TempDirectory temp_dir = testing::MakeTempDirectoryOrDie();
+  const std::string filename = FileUtil::JoinPath(temp_dir.path(), "history");
+
+  UserHistoryStorage snapshot(filename);
+  AddHistoryEntry("a", "A", &snapshot.GetProto());
+  AddHistoryEntry("b", "B", &snapshot.GetProto());
+  ASSERT_TRUE(snapshot.Save());
+  const uint64_t generation = snapshot.GetProto().journal_generation();
+  const std::string journal_filename = snapshot.journal_filename();
+
+  {
+    UserHistoryStorage journal(filename);
+    journal.GetProto().set_journal_generation(generation);
+    AddHistoryEntry("c", "C", &journal.GetProto());
+    ASSERT_TRUE(journal.Append());
+  }
+  const size_t first_record_end =
+      FileUtil::GetContents(journal_filename).value().size();
+  {
+    UserHistoryStorage journal(filename);
+    journal.GetProto().set_journal_generation(generation);
+    AddHistoryEntry("d", "D", &journal.GetProto());
+    journal.GetProto().add_removed_entries(
+        UserHistoryPredictor::Fingerprint("a", "A"));
+    ASSERT_TRUE(journal.Append());
+  }
+  const std::string journal_contents =
+      FileUtil::GetContents(journal_filename).value();
+
+  // Writes stopped at any byte of the journal lose only the last record.
+  constexpr size_t kJournalHeaderSize = 12;  // Magic and generation.
+  for (size_t size = 0; size < journal_contents.size(); ++size) {
+    SCOPED_TRACE(absl::StrCat("size: ", size));
+    ASSERT_OK(FileUtil::SetContents(journal_filename,
+                                    journal_contents.substr(0, size)));
+    UserHistoryStorage loaded(filename);
+    ASSERT_TRUE(loaded.Load());
+    EXPECT_EQ(loaded.journal_broken(),
+              size != kJournalHeaderSize && size != first_record_end);
+    if (size < first_record_end) {
+      EXPECT_THAT(GetHistoryValues(loaded.GetProto()),
+                  ::testing::ElementsAre("A", "B"));
+    } else {
+      EXPECT_THAT(GetHistoryValues(loaded.GetProto()),
+                  ::testing::ElementsAre("A", "B", "C"));
+    }
+  }
+
+  // A corrupted record is discarded with the rest of the journal.
+  {
+    std::string corrupted = journal_contents;
+    corrupted[first_record_end - 1] ^= 0xFF;
+    ASSERT_OK(FileUtil::SetContents(journal_filename, corrupted));
+    UserHistoryStorage loaded(filename);
+    ASSERT_TRUE(loaded.Load());
+    EXPECT_TRUE(loaded.journal_broken());
+    EXPECT_THAT(GetHistoryValues(loaded.GetProto()),
+                ::testing::ElementsAre("A", "B"));
+  }
+
+  // The journal of the previous snapshot, left when the process exited
+  // between writing a new snapshot and deleting the journal, is ignored.
+  ASSERT_OK(FileUtil::SetContents(journal_filename, journal_contents));
+  {
+    UserHistoryStorage loaded(filename);
+    ASSERT_TRUE(loaded.Load());
+    EXPECT_FALSE(loaded.journal_broken());
+    EXPECT_THAT(GetHistoryValues(loaded.GetProto()),
+                ::testing::ElementsAre("B", "C", "D"));
+    ASSERT_TRUE(loaded.Save());
+  }
+  ASSERT_OK(FileUtil::SetContents(journal_filename, journal_contents));
+  {
+    UserHistoryStorage loaded(filename);
+    ASSERT_TRUE(loaded.Load());
+    EXPECT_TRUE(loaded.journal_broken());
+    EXPECT_EQ(loaded.journal_size(), 0);
+    EXPECT_THAT(GetHistoryValues(loaded.GetProto()),
+                ::testing::ElementsAre("B", "C", "D"));
+  }
+}
+
+TEST_F(UserHistoryPredictorTest, SaveAppendsToJournal) {
+  UserHistoryPredictor *predictor = GetUserHistoryPredictorWithClearedHistory();
+  const std::string filename = UserHistoryPredictor::GetUserHistoryFileName();
+  const std::string journal_filename =
+      UserHistoryStorage(filename).journal_filename();
+  // Clearing the history writes a new snapshot.
+  EXPECT_OK(FileUtil::FileExists(filename));
+  EXPECT_FALSE(FileUtil::FileExists(journal_filename).ok());
+  const std::string snapshot_contents = FileUtil::GetContents(filename).value();
+
+  Segments segments;
+  for (const absl::string_view key : {"とうきょう", "おおさか", "きょうと"}) {
+    SetUpInputForConversion(key, composer_.get(), &segments);
+    AddCandidate(japanese_util::HiraganaToKatakana(key), &segments);
+    predictor->Finish(*convreq_, &segments);
+    predictor->Sync();
+    WaitForSyncer(predictor);
+  }
+  EXPECT_TRUE(predictor->ClearHistoryEntry("おおさか", "オオサカ"));
+  predictor->Sync();
+  WaitForSyncer(predictor);
+
+  // Only the journal has been written.
+  EXPECT_EQ(FileUtil::GetContents(filename).value(), snapshot_contents);
+  EXPECT_OK(FileUtil::FileExists(journal_filename));
+
+  predictor->Reload();
+  WaitForSyncer(predictor);
+  EXPECT_TRUE(IsSuggested(predictor, "とうき", "トウキョウ"));
+  EXPECT_TRUE(IsSuggested(predictor, "きょう", "キョウト"));
+  EXPECT_FALSE(IsSuggested(predictor, "おおさ", "オオサカ"));
+}
+
 TEST_F(UserHistoryPredictorTest, RomanFuzzyPrefixMatch) {
   // same
   EXPECT_FALSE(UserHistoryPredictor::RomanFuzzyPrefixMatch("abc", "abc"));
@@ -4260,4 +4465,58 @@ TEST_F(UserHistoryPredictorTest, MaxPredictionCandidatesSizeForZeroQuery) {
   }
 }
 
+TEST_F(UserHistoryPredictorTest, IndexedLookupOverLargeHistory) {
+  UserHistoryPredictor *predictor = GetUserHistoryPredictorWithClearedHistory();
+  request_->set_zero_query_suggestion(true);
+
+  Segments segments;
+  SetUpInputForConversion("こうもく", composer_.get(), &segments);
+  AddCandidate(0, "項目", &segments);
+  AddSegmentForConversion("せってい", &segments);
+  AddCandidate(1, "設定", &segments);
+  predictor->Finish(*convreq_, &segments);
+  WaitForSyncer(predictor);
+
+  // Pushes the entries above out of the range checked by the linear scans.
+  const uint64_t now = absl::ToUnixSeconds(Clock::GetAbslTime());
+  for (int i = 0; i < 5000; ++i) {
+    InsertEntry(predictor, absl::StrFormat("てすと%d", i),
+                absl::StrFormat("テスト%d", i))
+        ->set_last_access_time(now);
+  }
+
+  const bool original_use_user_history_index =
+      absl::GetFlag(FLAGS_use_user_history_index);
+  for (const bool use_index : {true, false}) {
+    SCOPED_TRACE(absl::StrCat("use_index: ", use_index));
+    absl::SetFlag(&FLAGS_use_user_history_index, use_index);
+
+    // Lookup by the key.
+    EXPECT_TRUE(IsPredicted(predictor, "てすと4999", "テスト4999"));
+    EXPECT_TRUE(IsPredicted(predictor, "てすと432", "テスト4321"));
+    EXPECT_FALSE(IsPredicted(predictor, "てすとい", "テスト4321"));
+    SetUpInputForSuggestion("こう", composer_.get(), &segments);
+    EXPECT_EQ(predictor->PredictForRequest(*convreq_, &segments) &&
+                  FindCandidateByValue("項目", segments),
+              use_index);
+
+    // Bigram fallback from the entry whose value is a suffix of the history.
+    SetUpInputForSuggestionWithHistory("", "ぜんこうもく", "全項目",
+                                       composer_.get(), &segments);
+    EXPECT_EQ(predictor->PredictForRequest(*convreq_, &segments), use_index);
+    if (use_index) {
+      EXPECT_TRUE(FindCandidateByValue("設定", segments));
+    }
+  }
+  absl::SetFlag(&FLAGS_use_user_history_index,
+                original_use_user_history_index);
+
+  // The index follows the updates of the LRU.
+  InsertEntry(predictor, "てすとあ", "テストア")->set_last_access_time(now);
+  EXPECT_TRUE(IsPredicted(predictor, "てすとあ", "テストア"));
+  predictor->ClearAllHistory();
+  WaitForSyncer(predictor);
+  EXPECT_FALSE(IsPredicted(predictor, "てすと4321", "テスト4321"));
+}
+
 }  // namespace mozc::prediction
@@ -0,0 +1,156 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark of saving and loading the user history by history size.
+//
+// For each size, the history is saved as a snapshot, which rewrites the whole
+// file as every sync did before the journal. Then --num_syncs syncs of
+// --entries_per_sync updated entries are appended to the journal, and the
+// history is loaded with the journal replayed on the snapshot.
+//
+// Usage:
+//   user_history_storage_benchmark --sizes=1000,10000,50000
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/time.h"
+#include "base/clock.h"
+#include "base/file/temp_dir.h"
+#include "base/file_util.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "base/status.h"
+#include "base/stopwatch.h"
+#include "base/system_util.h"
+#include "prediction/user_history_predictor.h"
+#include "prediction/user_history_predictor.pb.h"
+#include "testing/benchmark_result.h"
+
+ABSL_FLAG(std::vector<std::string>, sizes,
+          std::vector<std::string>({"1000", "10000", "50000"}),
+          "Numbers of entries in the history.");
+ABSL_FLAG(int32_t, num_syncs, 100, "Number of syncs appended to the journal.");
+ABSL_FLAG(int32_t, entries_per_sync, 10,
+          "Number of entries updated by each sync.");
+
+namespace mozc {
+namespace prediction {
+namespace {
+
+using ::mozc::user_history_predictor::UserHistory;
+
+void AddRandomEntry(Random &random, UserHistory *history) {
+  UserHistoryPredictor::Entry *entry = history->add_entries();
+  entry->set_key(random.Utf8StringRandomLen(8, 0x3042, 0x3093));
+  entry->set_value(random.Utf8StringRandomLen(8, 0x4E00, 0x9FFF));
+  entry->set_conversion_freq(1);
+  entry->set_last_access_time(absl::ToUnixSeconds(Clock::GetAbslTime()));
+  entry->add_next_entries()->set_entry_fp(random());
+}
+
+void RunSize(const std::string &filename, int size) {
+  Random random;
+  UserHistoryStorage snapshot(filename);
+  for (int i = 0; i < size; ++i) {
+    AddRandomEntry(random, &snapshot.GetProto());
+  }
+
+  {
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    CHECK(snapshot.Save());
+    testing::PrintBenchmarkResult(absl::StrFormat("%d/snapshot_save", size),
+                                  stopwatch.GetElapsed(), 1);
+  }
+  {
+    UserHistoryStorage history(filename);
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    CHECK(history.Load());
+    testing::PrintBenchmarkResult(absl::StrFormat("%d/snapshot_load", size),
+                                  stopwatch.GetElapsed(), 1);
+  }
+
+  const int num_syncs = absl::GetFlag(FLAGS_num_syncs);
+  absl::Duration elapsed;
+  for (int i = 0; i < num_syncs; ++i) {
+    UserHistoryStorage journal(filename);
+    journal.GetProto().set_journal_generation(
+        snapshot.GetProto().journal_generation());
+    for (int j = 0; j < absl::GetFlag(FLAGS_entries_per_sync); ++j) {
+      AddRandomEntry(random, &journal.GetProto());
+    }
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    CHECK(journal.Append());
+    elapsed += stopwatch.GetElapsed();
+  }
+  testing::PrintBenchmarkResult(absl::StrFormat("%d/journal_append", size),
+                                elapsed, num_syncs);
+
+  {
+    UserHistoryStorage history(filename);
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    CHECK(history.Load());
+    testing::PrintBenchmarkResult(absl::StrFormat("%d/load_with_journal", size),
+                                  stopwatch.GetElapsed(), 1);
+    CHECK_EQ(history.journal_size(),
+             num_syncs * absl::GetFlag(FLAGS_entries_per_sync));
+  }
+}
+
+void Run() {
+  // Keeps the files and the password of the benchmark away from the real
+  // ones.
+  absl::StatusOr<TempDirectory> temp_dir =
+      TempDirectory::Default().CreateTempDirectory();
+  CHECK_OK(temp_dir);
+  SystemUtil::SetUserProfileDirectory(temp_dir->path());
+  const std::string filename = FileUtil::JoinPath(temp_dir->path(), "history");
+
+  for (const std::string &size : absl::GetFlag(FLAGS_sizes)) {
+    int value = 0;
+    CHECK(absl::SimpleAtoi(size, &value)) << size;
+    RunSize(filename, value);
+  }
+}
+
+}  // namespace
+}  // namespace prediction
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  mozc::prediction::Run();
+  return 0;
+}
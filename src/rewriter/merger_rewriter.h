@@ -30,16 +30,20 @@
 #ifndef MOZC_REWRITER_MERGER_REWRITER_H_
 #define MOZC_REWRITER_MERGER_REWRITER_H_
 
+#include <cstddef>
 #include <memory>
 #include <utility>
 #include <vector>
 
+#include "absl/strings/string_view.h"
+#include "base/stopwatch.h"
 #include "config/config_handler.h"
 #include "converter/segments.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
 #include "request/conversion_request.h"
 #include "rewriter/rewriter_interface.h"
+#include "rewriter/rewriter_profiler.h"
 
 namespace mozc {
 
@@ -80,17 +84,41 @@ class MergerRewriter : public RewriterInterface {
   }
 
   void AddRewriter(std::unique_ptr<RewriterInterface> rewriter) {
+    AddRewriter(std::move(rewriter), "");
+  }
+
+  // |name| identifies the rewriter in RewriterProfiler. Rewriters without a
+  // name are not profiled.
+  void AddRewriter(std::unique_ptr<RewriterInterface> rewriter,
+                   absl::string_view name) {
     DCHECK(rewriter);
     rewriters_.push_back(std::move(rewriter));
+    profiler_entries_.push_back(
+        name.empty() ? nullptr : RewriterProfiler::Get()->GetEntry(name));
   }
 
   bool Rewrite(const ConversionRequest &request,
                Segments *segments) const override {
+    const bool profile = RewriterProfiler::Get()->enabled();
     bool result = false;
-    for (const std::unique_ptr<RewriterInterface> &rewriter : rewriters_) {
-      if (CheckCapability(request, segments, *rewriter)) {
-        result |= rewriter->Rewrite(request, segments);
+    for (size_t i = 0; i < rewriters_.size(); ++i) {
+      const RewriterInterface &rewriter = *rewriters_[i];
+      RewriterProfiler::Entry *entry =
+          profile ? profiler_entries_[i] : nullptr;
+      if (!CheckCapability(request, segments, rewriter)) {
+        if (entry != nullptr) {
+          entry->RecordSkip();
+        }
+        continue;
+      }
+      if (entry == nullptr) {
+        result |= rewriter.Rewrite(request, segments);
+        continue;
       }
+      const Stopwatch stopwatch = Stopwatch::StartNew();
+      const bool rewritten = rewriter.Rewrite(request, segments);
+      entry->RecordRewrite(stopwatch.GetElapsed(), rewritten);
+      result |= rewritten;
     }
 
     if (request.request_type() == ConversionRequest::SUGGESTION &&
@@ -155,6 +183,8 @@ class MergerRewriter : public RewriterInterface {
 
  private:
   std::vector<std::unique_ptr<RewriterInterface>> rewriters_;
+  // Parallel to |rewriters_|. nullptr for the rewriters without a name.
+  std::vector<RewriterProfiler::Entry *> profiler_entries_;
 };
 
 }  // namespace mozc
@@ -34,8 +34,10 @@
 
 #include "absl/strings/string_view.h"
 #include "converter/segments.h"
+#include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
 #include "request/conversion_request.h"
+#include "rewriter/rewriter_profiler.h"
 #include "testing/gunit.h"
 #include "testing/mozctest.h"
 
@@ -127,6 +129,65 @@ TEST_F(MergerRewriterTest, Rewrite) {
             "d.Rewrite();");
 }
 
+TEST_F(MergerRewriterTest, RewriteWithProfiler) {
+  std::string call_result;
+  MergerRewriter merger;
+  Segments segments;
+  const ConversionRequest request;
+  RewriterProfiler *profiler = RewriterProfiler::Get();
+  const bool original_enabled = profiler->enabled();
+  profiler->Reset();
+
+  merger.AddRewriter(std::make_unique<TestRewriter>(&call_result, "a", false),
+                     "MergerRewriterTest.A");
+  merger.AddRewriter(
+      std::make_unique<TestRewriter>(&call_result, "b", true,
+                                     RewriterInterface::CONVERSION),
+      "MergerRewriterTest.B");
+  merger.AddRewriter(
+      std::make_unique<TestRewriter>(&call_result, "c", true,
+                                     RewriterInterface::SUGGESTION),
+      "MergerRewriterTest.C");
+
+  // Nothing is recorded while disabled.
+  profiler->set_enabled(false);
+  EXPECT_TRUE(merger.Rewrite(request, &segments));
+  profiler->set_enabled(true);
+  EXPECT_TRUE(merger.Rewrite(request, &segments));
+  EXPECT_TRUE(merger.Rewrite(request, &segments));
+  EXPECT_EQ(call_result,
+            "a.Rewrite();b.Rewrite();"
+            "a.Rewrite();b.Rewrite();"
+            "a.Rewrite();b.Rewrite();");
+
+  commands::RewriterProfile profile;
+  profiler->FillProfile(&profile);
+  auto find_entry = [&](absl::string_view name) {
+    for (const commands::RewriterProfile::Entry &entry : profile.entries()) {
+      if (entry.name() == name) {
+        return entry;
+      }
+    }
+    return commands::RewriterProfile::Entry();
+  };
+  const commands::RewriterProfile::Entry a =
+      find_entry("MergerRewriterTest.A");
+  EXPECT_EQ(a.calls(), 2);
+  EXPECT_EQ(a.rewritten(), 0);
+  EXPECT_EQ(a.skipped(), 0);
+  const commands::RewriterProfile::Entry b =
+      find_entry("MergerRewriterTest.B");
+  EXPECT_EQ(b.calls(), 2);
+  EXPECT_EQ(b.rewritten(), 2);
+  const commands::RewriterProfile::Entry c =
+      find_entry("MergerRewriterTest.C");
+  EXPECT_EQ(c.calls(), 0);
+  EXPECT_EQ(c.skipped(), 2);
+
+  profiler->Reset();
+  profiler->set_enabled(original_enabled);
+}
+
 TEST_F(MergerRewriterTest, RewriteSuggestion) {
   std::string call_result;
   MergerRewriter merger;
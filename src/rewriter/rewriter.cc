@@ -98,52 +98,72 @@ RewriterImpl::RewriterImpl(const ConverterInterface *parent_converter,
   DCHECK(pos_group);
   // |dictionary| can be NULL
 
-  AddRewriter(std::make_unique<UserDictionaryRewriter>());
-  AddRewriter(std::make_unique<FocusCandidateRewriter>(data_manager));
-  AddRewriter(
-      std::make_unique<LanguageAwareRewriter>(pos_matcher_, dictionary));
-  AddRewriter(std::make_unique<TransliterationRewriter>(pos_matcher_));
-  AddRewriter(std::make_unique<EnglishVariantsRewriter>(pos_matcher_));
-  AddRewriter(std::make_unique<NumberRewriter>(data_manager));
-  AddRewriter(CollocationRewriter::Create(*data_manager));
-  AddRewriter(std::make_unique<SingleKanjiRewriter>(*data_manager));
-  AddRewriter(std::make_unique<IvsVariantsRewriter>());
-  AddRewriter(std::make_unique<EmojiRewriter>(*data_manager));
-  AddRewriter(EmoticonRewriter::CreateFromDataManager(*data_manager));
-  AddRewriter(std::make_unique<CalculatorRewriter>(parent_converter));
-  AddRewriter(std::make_unique<SymbolRewriter>(parent_converter, data_manager));
-  AddRewriter(std::make_unique<UnicodeRewriter>(parent_converter));
-  AddRewriter(std::make_unique<VariantsRewriter>(pos_matcher_));
-  AddRewriter(std::make_unique<ZipcodeRewriter>(pos_matcher_));
-  AddRewriter(std::make_unique<DiceRewriter>());
-  AddRewriter(std::make_unique<SmallLetterRewriter>(parent_converter));
+  AddRewriter(std::make_unique<UserDictionaryRewriter>(),
+              "UserDictionaryRewriter");
+  AddRewriter(std::make_unique<FocusCandidateRewriter>(data_manager),
+              "FocusCandidateRewriter");
+  AddRewriter(std::make_unique<LanguageAwareRewriter>(pos_matcher_, dictionary),
+              "LanguageAwareRewriter");
+  AddRewriter(std::make_unique<TransliterationRewriter>(pos_matcher_),
+              "TransliterationRewriter");
+  AddRewriter(std::make_unique<EnglishVariantsRewriter>(pos_matcher_),
+              "EnglishVariantsRewriter");
+  AddRewriter(std::make_unique<NumberRewriter>(data_manager), "NumberRewriter");
+  AddRewriter(CollocationRewriter::Create(*data_manager),
+              "CollocationRewriter");
+  AddRewriter(std::make_unique<SingleKanjiRewriter>(*data_manager),
+              "SingleKanjiRewriter");
+  AddRewriter(std::make_unique<IvsVariantsRewriter>(), "IvsVariantsRewriter");
+  AddRewriter(std::make_unique<EmojiRewriter>(*data_manager), "EmojiRewriter");
+  AddRewriter(EmoticonRewriter::CreateFromDataManager(*data_manager),
+              "EmoticonRewriter");
+  AddRewriter(std::make_unique<CalculatorRewriter>(parent_converter),
+              "CalculatorRewriter");
+  AddRewriter(std::make_unique<SymbolRewriter>(parent_converter, data_manager),
+              "SymbolRewriter");
+  AddRewriter(std::make_unique<UnicodeRewriter>(parent_converter),
+              "UnicodeRewriter");
+  AddRewriter(std::make_unique<VariantsRewriter>(pos_matcher_),
+              "VariantsRewriter");
+  AddRewriter(std::make_unique<ZipcodeRewriter>(pos_matcher_),
+              "ZipcodeRewriter");
+  AddRewriter(std::make_unique<DiceRewriter>(), "DiceRewriter");
+  AddRewriter(std::make_unique<SmallLetterRewriter>(parent_converter),
+              "SmallLetterRewriter");
 
   if (absl::GetFlag(FLAGS_use_history_rewriter)) {
+    AddRewriter(std::make_unique<UserBoundaryHistoryRewriter>(parent_converter),
+                "UserBoundaryHistoryRewriter");
     AddRewriter(
-        std::make_unique<UserBoundaryHistoryRewriter>(parent_converter));
-    AddRewriter(
-        std::make_unique<UserSegmentHistoryRewriter>(&pos_matcher_, pos_group));
+        std::make_unique<UserSegmentHistoryRewriter>(&pos_matcher_, pos_group),
+        "UserSegmentHistoryRewriter");
   }
 
-  AddRewriter(std::make_unique<DateRewriter>(dictionary));
-  AddRewriter(std::make_unique<FortuneRewriter>());
+  AddRewriter(std::make_unique<DateRewriter>(dictionary), "DateRewriter");
+  AddRewriter(std::make_unique<FortuneRewriter>(), "FortuneRewriter");
 #if !(defined(__ANDROID__) || (defined(TARGET_OS_IPHONE) && TARGET_OS_IPHONE))
   // CommandRewriter is not tested well on Android or iOS.
   // So we temporarily disable it.
   // TODO(yukawa, team): Enable CommandRewriter on Android if necessary.
-  AddRewriter(std::make_unique<CommandRewriter>());
+  AddRewriter(std::make_unique<CommandRewriter>(), "CommandRewriter");
 #endif  // !(__ANDROID__ || TARGET_OS_IPHONE)
 #ifndef NO_USAGE_REWRITER
-  AddRewriter(std::make_unique<UsageRewriter>(data_manager, dictionary));
+  AddRewriter(std::make_unique<UsageRewriter>(data_manager, dictionary),
+              "UsageRewriter");
 #endif  // NO_USAGE_REWRITER
-  AddRewriter(
-      std::make_unique<VersionRewriter>(data_manager->GetDataVersion()));
-  AddRewriter(CorrectionRewriter::CreateCorrectionRewriter(data_manager));
-  AddRewriter(std::make_unique<T13nPromotionRewriter>());
-  AddRewriter(std::make_unique<EnvironmentalFilterRewriter>(*data_manager));
-  AddRewriter(std::make_unique<RemoveRedundantCandidateRewriter>());
-  AddRewriter(std::make_unique<OrderRewriter>());
-  AddRewriter(std::make_unique<A11yDescriptionRewriter>(data_manager));
+  AddRewriter(std::make_unique<VersionRewriter>(data_manager->GetDataVersion()),
+              "VersionRewriter");
+  AddRewriter(CorrectionRewriter::CreateCorrectionRewriter(data_manager),
+              "CorrectionRewriter");
+  AddRewriter(std::make_unique<T13nPromotionRewriter>(),
+              "T13nPromotionRewriter");
+  AddRewriter(std::make_unique<EnvironmentalFilterRewriter>(*data_manager),
+              "EnvironmentalFilterRewriter");
+  AddRewriter(std::make_unique<RemoveRedundantCandidateRewriter>(),
+              "RemoveRedundantCandidateRewriter");
+  AddRewriter(std::make_unique<OrderRewriter>(), "OrderRewriter");
+  AddRewriter(std::make_unique<A11yDescriptionRewriter>(data_manager),
+              "A11yDescriptionRewriter");
 }
 
 }  // namespace mozc
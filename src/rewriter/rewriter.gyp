@@ -65,6 +65,7 @@
         'order_rewriter.cc',
         'remove_redundant_candidate_rewriter.cc',
         'rewriter.cc',
+        'rewriter_profiler.cc',
         'rewriter_util.cc',
         'single_kanji_rewriter.cc',
         'small_letter_rewriter.cc',
@@ -0,0 +1,182 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "rewriter/rewriter_profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "absl/flags/flag.h"
+#include "absl/numeric/bits.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "base/singleton.h"
+#include "protocol/commands.pb.h"
+
+ABSL_FLAG(bool, profile_rewriters, false,
+          "Collect per-rewriter statistics of the conversions from the start. "
+          "They can also be enabled with GET_REWRITER_PROFILE.");
+
+namespace mozc {
+namespace {
+
+// Returns the index of the histogram bucket for |elapsed_us| microseconds.
+size_t GetBucket(uint64_t elapsed_us) {
+  // bit_width(0) = 0, bit_width(1) = 1, bit_width(2..3) = 2, ...
+  return std::min<size_t>(absl::bit_width(elapsed_us),
+                          RewriterProfiler::kHistogramSize - 1);
+}
+
+}  // namespace
+
+void RewriterProfiler::Entry::RecordSkip() {
+  skipped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RewriterProfiler::Entry::RecordRewrite(absl::Duration elapsed,
+                                            bool rewritten) {
+  const uint64_t elapsed_us = static_cast<uint64_t>(
+      std::max<int64_t>(absl::ToInt64Microseconds(elapsed), 0));
+  calls_.fetch_add(1, std::memory_order_relaxed);
+  if (rewritten) {
+    rewritten_.fetch_add(1, std::memory_order_relaxed);
+  }
+  total_time_us_.fetch_add(elapsed_us, std::memory_order_relaxed);
+  time_histogram_[GetBucket(elapsed_us)].fetch_add(1,
+                                                   std::memory_order_relaxed);
+}
+
+void RewriterProfiler::Entry::Reset() {
+  calls_.store(0, std::memory_order_relaxed);
+  rewritten_.store(0, std::memory_order_relaxed);
+  skipped_.store(0, std::memory_order_relaxed);
+  total_time_us_.store(0, std::memory_order_relaxed);
+  for (std::atomic<uint64_t> &count : time_histogram_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+}
+
+void RewriterProfiler::Entry::FillEntry(
+    commands::RewriterProfile::Entry *entry) const {
+  entry->set_name(name_);
+  entry->set_calls(calls_.load(std::memory_order_relaxed));
+  entry->set_rewritten(rewritten_.load(std::memory_order_relaxed));
+  entry->set_skipped(skipped_.load(std::memory_order_relaxed));
+  entry->set_total_time_us(total_time_us_.load(std::memory_order_relaxed));
+  for (const std::atomic<uint64_t> &count : time_histogram_) {
+    entry->add_time_histogram(count.load(std::memory_order_relaxed));
+  }
+}
+
+RewriterProfiler::RewriterProfiler()
+    : enabled_(absl::GetFlag(FLAGS_profile_rewriters)) {}
+
+RewriterProfiler *RewriterProfiler::Get() {
+  return Singleton<RewriterProfiler>::get();
+}
+
+RewriterProfiler::Entry *RewriterProfiler::GetEntry(absl::string_view name) {
+  absl::MutexLock lock(&mutex_);
+  for (Entry &entry : entries_) {
+    if (entry.name() == name) {
+      return &entry;
+    }
+  }
+  return &entries_.emplace_back(name);
+}
+
+void RewriterProfiler::Reset() {
+  absl::MutexLock lock(&mutex_);
+  for (Entry &entry : entries_) {
+    entry.Reset();
+  }
+}
+
+void RewriterProfiler::FillProfile(commands::RewriterProfile *profile) const {
+  profile->Clear();
+  profile->set_enabled(enabled());
+  absl::MutexLock lock(&mutex_);
+  for (const Entry &entry : entries_) {
+    entry.FillEntry(profile->add_entries());
+  }
+}
+
+void RewriterProfiler::Execute(const commands::RewriterProfileRequest &request,
+                               commands::RewriterProfile *profile) {
+  switch (request.action()) {
+    case commands::RewriterProfileRequest::ENABLE:
+      set_enabled(true);
+      break;
+    case commands::RewriterProfileRequest::DISABLE:
+      set_enabled(false);
+      break;
+    case commands::RewriterProfileRequest::RESET:
+      Reset();
+      break;
+    case commands::RewriterProfileRequest::GET:
+    default:
+      break;
+  }
+  FillProfile(profile);
+}
+
+std::string FormatRewriterProfile(const commands::RewriterProfile &profile) {
+  std::string result = absl::StrFormat(
+      "%-36s %10s %10s %10s %12s %10s %10s\n", "rewriter", "calls",
+      "rewritten", "skipped", "total_us", "avg_us", "max_bucket");
+  for (const commands::RewriterProfile::Entry &entry : profile.entries()) {
+    // Upper bound of the slowest non-empty bucket, e.g. "<1024us".
+    std::string max_bucket = "-";
+    for (int i = entry.time_histogram_size() - 1; i >= 0; --i) {
+      if (entry.time_histogram(i) == 0) {
+        continue;
+      }
+      max_bucket = i + 1 == entry.time_histogram_size()
+                       ? absl::StrFormat(">=%dus", uint64_t{1} << (i - 1))
+                       : absl::StrFormat("<%dus", uint64_t{1} << i);
+      break;
+    }
+    absl::StrAppendFormat(
+        &result, "%-36s %10d %10d %10d %12d %10.1f %10s\n", entry.name(),
+        entry.calls(), entry.rewritten(), entry.skipped(),
+        entry.total_time_us(),
+        entry.calls() == 0 ? 0.0
+                           : static_cast<double>(entry.total_time_us()) /
+                                 entry.calls(),
+        max_bucket);
+  }
+  return result;
+}
+
+}  // namespace mozc
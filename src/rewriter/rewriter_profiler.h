@@ -0,0 +1,131 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MOZC_REWRITER_REWRITER_PROFILER_H_
+#define MOZC_REWRITER_REWRITER_PROFILER_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "protocol/commands.pb.h"
+
+namespace mozc {
+
+// Collects per-rewriter statistics of MergerRewriter::Rewrite() for
+// debugging. The statistics are keyed by the name given to
+// MergerRewriter::AddRewriter() and shared by all the MergerRewriter
+// instances, so that they survive engine reloads. While disabled, which is
+// the default, MergerRewriter only checks enabled() per conversion.
+//
+// This class is thread-safe.
+class RewriterProfiler {
+ public:
+  // Number of the buckets of the wall time histogram. See
+  // commands::RewriterProfile::Entry::time_histogram for the bucket ranges.
+  static constexpr size_t kHistogramSize = 16;
+
+  // Statistics of a rewriter. Updated without locks.
+  class Entry {
+   public:
+    explicit Entry(absl::string_view name) : name_(name) {}
+    Entry(const Entry &) = delete;
+    Entry &operator=(const Entry &) = delete;
+
+    const std::string &name() const { return name_; }
+
+    // Records that the rewriter was not called for lack of capability.
+    void RecordSkip();
+    // Records a call of Rewrite() which took |elapsed| and returned
+    // |rewritten|.
+    void RecordRewrite(absl::Duration elapsed, bool rewritten);
+
+   private:
+    friend class RewriterProfiler;
+
+    void Reset();
+    void FillEntry(commands::RewriterProfile::Entry *entry) const;
+
+    const std::string name_;
+    std::atomic<uint64_t> calls_ = 0;
+    std::atomic<uint64_t> rewritten_ = 0;
+    std::atomic<uint64_t> skipped_ = 0;
+    std::atomic<uint64_t> total_time_us_ = 0;
+    std::array<std::atomic<uint64_t>, kHistogramSize> time_histogram_ = {};
+  };
+
+  // Enabled if --profile_rewriters is set.
+  RewriterProfiler();
+  RewriterProfiler(const RewriterProfiler &) = delete;
+  RewriterProfiler &operator=(const RewriterProfiler &) = delete;
+
+  // Returns the process-wide instance.
+  static RewriterProfiler *Get();
+
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+  void set_enabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  // Returns the entry for |name|, creating it if necessary. The entry is
+  // valid as long as this profiler.
+  Entry *GetEntry(absl::string_view name) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Clears the statistics of all the entries.
+  void Reset() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Fills |profile| with the statistics, in the order of GetEntry() calls.
+  void FillProfile(commands::RewriterProfile *profile) const
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Handles GET_REWRITER_PROFILE: applies the action of |request| and fills
+  // |profile| with the resulting statistics.
+  void Execute(const commands::RewriterProfileRequest &request,
+               commands::RewriterProfile *profile);
+
+ private:
+  std::atomic<bool> enabled_;
+  mutable absl::Mutex mutex_;
+  // std::deque doesn't move the elements on emplace_back().
+  std::deque<Entry> entries_ ABSL_GUARDED_BY(mutex_);
+};
+
+// Formats |profile| as a table for the command line tools.
+std::string FormatRewriterProfile(const commands::RewriterProfile &profile);
+
+}  // namespace mozc
+
+#endif  // MOZC_REWRITER_REWRITER_PROFILER_H_
@@ -0,0 +1,125 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "rewriter/rewriter_profiler.h"
+
+#include <string>
+
+#include "absl/time/time.h"
+#include "protocol/commands.pb.h"
+#include "testing/gmock.h"
+#include "testing/gunit.h"
+
+namespace mozc {
+namespace {
+
+using ::testing::HasSubstr;
+
+TEST(RewriterProfilerTest, RecordAndFill) {
+  RewriterProfiler profiler;
+  RewriterProfiler::Entry *foo = profiler.GetEntry("Foo");
+  RewriterProfiler::Entry *bar = profiler.GetEntry("Bar");
+  EXPECT_EQ(profiler.GetEntry("Foo"), foo);
+
+  foo->RecordRewrite(absl::ZeroDuration(), true);
+  foo->RecordRewrite(absl::Microseconds(1), false);
+  foo->RecordRewrite(absl::Microseconds(3), true);
+  foo->RecordRewrite(absl::Seconds(10), false);
+  bar->RecordSkip();
+
+  commands::RewriterProfile profile;
+  profiler.FillProfile(&profile);
+  ASSERT_EQ(profile.entries_size(), 2);
+
+  const commands::RewriterProfile::Entry &foo_entry = profile.entries(0);
+  EXPECT_EQ(foo_entry.name(), "Foo");
+  EXPECT_EQ(foo_entry.calls(), 4);
+  EXPECT_EQ(foo_entry.rewritten(), 2);
+  EXPECT_EQ(foo_entry.skipped(), 0);
+  EXPECT_EQ(foo_entry.total_time_us(), 10000004);
+  ASSERT_EQ(foo_entry.time_histogram_size(), RewriterProfiler::kHistogramSize);
+  // [0, 1), [1, 2), [2, 4), ... and the last bucket for the longer calls.
+  EXPECT_EQ(foo_entry.time_histogram(0), 1);
+  EXPECT_EQ(foo_entry.time_histogram(1), 1);
+  EXPECT_EQ(foo_entry.time_histogram(2), 1);
+  EXPECT_EQ(foo_entry.time_histogram(RewriterProfiler::kHistogramSize - 1), 1);
+
+  const commands::RewriterProfile::Entry &bar_entry = profile.entries(1);
+  EXPECT_EQ(bar_entry.name(), "Bar");
+  EXPECT_EQ(bar_entry.calls(), 0);
+  EXPECT_EQ(bar_entry.skipped(), 1);
+
+  profiler.Reset();
+  profiler.FillProfile(&profile);
+  ASSERT_EQ(profile.entries_size(), 2);
+  EXPECT_EQ(profile.entries(0).calls(), 0);
+  EXPECT_EQ(profile.entries(0).total_time_us(), 0);
+  EXPECT_EQ(profile.entries(1).skipped(), 0);
+}
+
+TEST(RewriterProfilerTest, Execute) {
+  RewriterProfiler profiler;
+  profiler.GetEntry("Foo")->RecordRewrite(absl::Microseconds(5), true);
+
+  commands::RewriterProfileRequest request;
+  commands::RewriterProfile profile;
+  request.set_action(commands::RewriterProfileRequest::ENABLE);
+  profiler.Execute(request, &profile);
+  EXPECT_TRUE(profiler.enabled());
+  EXPECT_TRUE(profile.enabled());
+  ASSERT_EQ(profile.entries_size(), 1);
+  EXPECT_EQ(profile.entries(0).calls(), 1);
+
+  request.set_action(commands::RewriterProfileRequest::RESET);
+  profiler.Execute(request, &profile);
+  EXPECT_TRUE(profile.enabled());
+  EXPECT_EQ(profile.entries(0).calls(), 0);
+
+  request.set_action(commands::RewriterProfileRequest::DISABLE);
+  profiler.Execute(request, &profile);
+  EXPECT_FALSE(profiler.enabled());
+  EXPECT_FALSE(profile.enabled());
+}
+
+TEST(RewriterProfilerTest, FormatRewriterProfile) {
+  RewriterProfiler profiler;
+  profiler.GetEntry("Foo")->RecordRewrite(absl::Microseconds(100), true);
+  profiler.GetEntry("Bar");
+  commands::RewriterProfile profile;
+  profiler.FillProfile(&profile);
+
+  const std::string table = FormatRewriterProfile(profile);
+  EXPECT_THAT(table, HasSubstr("rewriter"));
+  EXPECT_THAT(table, HasSubstr("Foo"));
+  EXPECT_THAT(table, HasSubstr("<128us"));
+  EXPECT_THAT(table, HasSubstr("Bar"));
+}
+
+}  // namespace
+}  // namespace mozc
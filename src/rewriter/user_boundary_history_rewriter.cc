@@ -39,6 +39,7 @@
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "base/config_file_stream.h"
 #include "base/file_util.h"
 #include "base/logging.h"
@@ -58,6 +59,9 @@ using ::mozc::storage::LruStorage;
 constexpr int kValueSize = 4;
 constexpr uint32_t kLruSize = 5000;
 constexpr uint32_t kSeedValue = 0x761fea81;
+// The storage is written back to the file at Sync(), or at the first update
+// after this interval has passed since the last write.
+constexpr absl::Duration kFlushInterval = absl::Minutes(1);
 
 constexpr char kFileName[] = "user://boundary.db";
 
@@ -112,6 +116,7 @@ UserBoundaryHistoryRewriter::UserBoundaryHistoryRewriter(
     : parent_converter_(parent_converter),
       storage_(std::make_unique<LruStorage>()) {
   DCHECK(parent_converter_);
+  storage_->EnableAsyncFlush(kFlushInterval);
   Reload();
 }
 
@@ -196,6 +201,7 @@ bool UserBoundaryHistoryRewriter::Rewrite(const ConversionRequest &request,
 bool UserBoundaryHistoryRewriter::Sync() {
   if (storage_) {
     storage_->DeleteElementsUntouchedFor62Days();
+    storage_->Sync();
   }
   return true;
 }
@@ -215,6 +221,8 @@ bool UserBoundaryHistoryRewriter::Reload() {
   // merge pending file does not always exist.
   if (absl::Status s = FileUtil::FileExists(merge_pending_file); s.ok()) {
     storage_->Merge(merge_pending_file.c_str());
+    // The merged data have to be in the file before the pending one is gone.
+    storage_->Flush();
     FileUtil::UnlinkOrLogError(merge_pending_file);
   } else if (!absl::IsNotFound(s)) {
     LOG(ERROR) << "Cannot check if " << merge_pending_file << " exists: " << s;
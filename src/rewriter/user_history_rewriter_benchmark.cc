@@ -0,0 +1,226 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark of Finish() of UserSegmentHistoryRewriter and
+// UserBoundaryHistoryRewriter, which learn the committed segments into
+// their LruStorage files.
+//
+// --num_commits conversions of 3 segments are committed, and Sync() is called
+// every --sync_interval commits.  The latency is reported with the storage
+// files mapped and updated in place, and with the asynchronous flush mode of
+// LruStorage.
+//
+// Usage:
+//   user_history_rewriter_benchmark --num_commits=20000 --num_words=30000
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
+#include "absl/random/random.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "base/file/temp_dir.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/status.h"
+#include "base/stopwatch.h"
+#include "base/system_util.h"
+#include "base/util.h"
+#include "config/config_handler.h"
+#include "converter/converter_mock.h"
+#include "converter/segments.h"
+#include "data_manager/testing/mock_data_manager.h"
+#include "dictionary/pos_group.h"
+#include "dictionary/pos_matcher.h"
+#include "protocol/config.pb.h"
+#include "request/conversion_request.h"
+#include "rewriter/user_boundary_history_rewriter.h"
+#include "rewriter/user_segment_history_rewriter.h"
+
+ABSL_DECLARE_FLAG(bool, lru_storage_async_flush);
+
+ABSL_FLAG(int32_t, num_commits, 20000, "Number of conversions to commit.");
+ABSL_FLAG(int32_t, num_words, 30000, "Number of distinct segment keys.");
+ABSL_FLAG(int32_t, sync_interval, 100, "Number of commits between syncs.");
+
+namespace mozc {
+namespace {
+
+// Returns a random hiragana word of 2 to 6 characters.
+std::string RandomWord(absl::BitGen &gen) {
+  const int length = absl::Uniform<int>(absl::IntervalClosed, gen, 2, 6);
+  std::string word;
+  for (int i = 0; i < length; ++i) {
+    Util::Ucs4ToUtf8Append(
+        absl::Uniform<char32_t>(absl::IntervalClosed, gen, 0x3042, 0x3093),
+        &word);
+  }
+  return word;
+}
+
+// Returns committed segments of the given keys, where the user has chosen
+// the third candidate of every segment.
+Segments MakeCommittedSegments(absl::Span<const std::string> keys) {
+  Segments segments;
+  for (const std::string &key : keys) {
+    Segment *segment = segments.add_segment();
+    segment->set_key(key);
+    segment->set_segment_type(Segment::FIXED_VALUE);
+    for (int i = 0; i < 5; ++i) {
+      Segment::Candidate *candidate = segment->add_candidate();
+      candidate->key = key;
+      candidate->content_key = key;
+      candidate->value = absl::StrFormat("%s%d", key, i);
+      candidate->content_value = candidate->value;
+      candidate->lid = candidate->rid = 1;
+    }
+    segment->move_candidate(2, 0);
+    segment->mutable_candidate(0)->attributes |=
+        Segment::Candidate::RERANKED;
+  }
+  // Makes UserBoundaryHistoryRewriter learn the boundaries as well.
+  segments.set_resized(true);
+  return segments;
+}
+
+absl::Duration Percentile(absl::Span<const absl::Duration> sorted, double p) {
+  if (sorted.empty()) {
+    return absl::ZeroDuration();
+  }
+  const size_t index = std::min(
+      sorted.size() - 1, static_cast<size_t>(p / 100.0 * sorted.size()));
+  return sorted[index];
+}
+
+void PrintResult(absl::string_view name,
+                 std::vector<absl::Duration> latencies) {
+  absl::Duration total;
+  for (const absl::Duration latency : latencies) {
+    total += latency;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  std::cout << absl::StrFormat(
+                   "%-24s %10.3f ms  p50: %7.1f us  p99: %7.1f us  "
+                   "max: %8.1f us  (%d calls)",
+                   name, absl::ToDoubleMilliseconds(total),
+                   absl::ToDoubleMicroseconds(Percentile(latencies, 50)),
+                   absl::ToDoubleMicroseconds(Percentile(latencies, 99)),
+                   absl::ToDoubleMicroseconds(Percentile(latencies, 100)),
+                   latencies.size())
+            << std::endl;
+}
+
+void Run(absl::string_view name, bool async_flush,
+         absl::Span<const Segments> commits) {
+  // Each run starts from new files in its own profile directory.
+  absl::StatusOr<TempDirectory> temp_dir =
+      TempDirectory::Default().CreateTempDirectory();
+  CHECK_OK(temp_dir);
+  SystemUtil::SetUserProfileDirectory(temp_dir->path());
+  absl::SetFlag(&FLAGS_lru_storage_async_flush, async_flush);
+
+  const testing::MockDataManager data_manager;
+  const dictionary::PosMatcher pos_matcher(data_manager.GetPosMatcherData());
+  const dictionary::PosGroup pos_group(data_manager.GetPosGroupData());
+  MockConverter converter;
+  config::Config config;
+  config::ConfigHandler::GetDefaultConfig(&config);
+  ConversionRequest request;
+  request.set_config(&config);
+
+  auto segment_rewriter =
+      std::make_unique<UserSegmentHistoryRewriter>(&pos_matcher, &pos_group);
+  auto boundary_rewriter =
+      std::make_unique<UserBoundaryHistoryRewriter>(&converter);
+  const int sync_interval = absl::GetFlag(FLAGS_sync_interval);
+  std::vector<absl::Duration> finish, sync;
+  for (size_t i = 0; i < commits.size(); ++i) {
+    Segments segments = commits[i];
+    {
+      const Stopwatch stopwatch = Stopwatch::StartNew();
+      segment_rewriter->Finish(request, &segments);
+      boundary_rewriter->Finish(request, &segments);
+      finish.push_back(stopwatch.GetElapsed());
+    }
+    if ((i + 1) % sync_interval == 0) {
+      const Stopwatch stopwatch = Stopwatch::StartNew();
+      segment_rewriter->Sync();
+      boundary_rewriter->Sync();
+      sync.push_back(stopwatch.GetElapsed());
+    }
+  }
+  // The destructors wait for the pending writes.
+  const Stopwatch stopwatch = Stopwatch::StartNew();
+  segment_rewriter.reset();
+  boundary_rewriter.reset();
+  const absl::Duration close = stopwatch.GetElapsed();
+
+  PrintResult(absl::StrFormat("%s/finish", name), std::move(finish));
+  PrintResult(absl::StrFormat("%s/sync", name), std::move(sync));
+  PrintResult(absl::StrFormat("%s/close", name), {close});
+}
+
+void Run() {
+  absl::BitGen gen;
+  std::vector<std::string> words(absl::GetFlag(FLAGS_num_words));
+  for (std::string &word : words) {
+    word = RandomWord(gen);
+  }
+  std::vector<Segments> commits(absl::GetFlag(FLAGS_num_commits));
+  for (Segments &segments : commits) {
+    std::vector<std::string> keys(3);
+    for (std::string &key : keys) {
+      key = words[absl::Uniform<size_t>(gen, 0, words.size())];
+    }
+    segments = MakeCommittedSegments(keys);
+  }
+
+  Run("mmap", false, commits);
+  Run("async", true, commits);
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  mozc::Run();
+  return 0;
+}
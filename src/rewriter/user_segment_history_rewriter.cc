@@ -44,6 +44,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "base/config_file_stream.h"
 #include "base/file_util.h"
 #include "base/logging.h"
@@ -73,6 +74,9 @@ using ::mozc::storage::LruStorage;
 constexpr uint32_t kValueSize = 4;
 constexpr uint32_t kLruSize = 20000;
 constexpr uint32_t kSeedValue = 0xf28defe3;
+// The storage is written back to the file at Sync(), or at the first update
+// after this interval has passed since the last write.
+constexpr absl::Duration kFlushInterval = absl::Minutes(1);
 constexpr uint32_t kMaxCandidatesSize = 255;
 // Size of candidates to be reranked to the top at one sorting operation.
 // Note, if sorting operation is called twice, up to 10 (= 5 * 2) candidates
@@ -489,6 +493,7 @@ UserSegmentHistoryRewriter::UserSegmentHistoryRewriter(
     : storage_(std::make_unique<LruStorage>()),
       pos_matcher_(pos_matcher),
       pos_group_(pos_group) {
+  storage_->EnableAsyncFlush(kFlushInterval);
   Reload();
 
   CHECK_EQ(sizeof(uint32_t), sizeof(FeatureValue));
@@ -789,6 +794,7 @@ void UserSegmentHistoryRewriter::Finish(const ConversionRequest &request,
 bool UserSegmentHistoryRewriter::Sync() {
   if (storage_) {
     storage_->DeleteElementsUntouchedFor62Days();
+    storage_->Sync();
   }
   return true;
 }
@@ -808,6 +814,8 @@ bool UserSegmentHistoryRewriter::Reload() {
   // merge pending file does not always exist.
   if (absl::Status s = FileUtil::FileExists(merge_pending_file); s.ok()) {
     storage_->Merge(merge_pending_file.c_str());
+    // The merged data have to be in the file before the pending one is gone.
+    storage_->Flush();
     FileUtil::UnlinkOrLogError(merge_pending_file);
   } else if (!absl::IsNotFound(s)) {
     LOG(ERROR) << "Cannot check if " << merge_pending_file << " exists: " << s;
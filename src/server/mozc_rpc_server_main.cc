@@ -27,6 +27,29 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+// Standalone RPC server of SessionHandler over TCP.
+//
+// Each request is a serialized commands::Input prefixed with its size in a
+// 32-bit integer of the network byte order, and so is the response of
+// commands::Output.  Connections are kept alive, so a client can send the
+// next request after receiving the response.
+//
+// The server polls non-blocking sockets on a single thread and evaluates the
+// requests on --num_workers threads.  A connection has at most one request
+// in evaluation; the following ones stay in the socket until it's answered,
+// and a connection sending more bytes than the largest request is closed.
+// When --max_pending_requests are waiting for the workers, the server stops
+// reading the sockets, which pushes back on the clients through TCP.  The
+// requests waiting longer than --rpc_timeout are answered with
+// SESSION_FAILURE without being evaluated.  The framing and the queue are in
+// server/rpc_util.h.
+//
+// SessionHandler serializes the commands using the engine, which isn't
+// thread-safe, so the workers evaluate the key events of different sessions
+// one at a time.  More workers keep the other commands, e.g. creating
+// sessions, from waiting behind a slow conversion, but don't make the
+// conversions themselves parallel.
+
 #include <cstdint>
 #ifdef _WIN32
 #include <windows.h>
@@ -34,26 +57,44 @@
 #pragma comment(lib, "ws2_32.lib")
 using ssize_t = SSIZE_T;
 #else  // _WIN32
+#include <arpa/inet.h>
 #include <fcntl.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <unistd.h>
+
+#include <cerrno>
 #endif  // _WIN32
 
+#include <algorithm>
 #include <cstddef>
-#include <cstring>
+#include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/flags/flag.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "base/init_mozc.h"
+#include "base/logging.h"
 #include "base/protobuf/message.h"
 #include "base/singleton.h"
 #include "base/system_util.h"
+#include "base/thread.h"
+#include "base/vlog.h"
 #include "engine/engine_factory.h"
 #include "protocol/commands.pb.h"
+#include "server/rpc_util.h"
 #include "session/random_keyevents_generator.h"
 #include "session/session_handler.h"
 #include "session/session_usage_observer.h"
@@ -62,62 +103,170 @@ ABSL_FLAG(std::string, host, "localhost", "server host name");
 ABSL_FLAG(bool, server, true, "server mode");
 ABSL_FLAG(bool, client, false, "client mode");
 ABSL_FLAG(int32_t, client_test_size, 100, "client test size");
+ABSL_FLAG(int32_t, client_threads, 1,
+          "number of concurrent sessions in client mode");
+ABSL_FLAG(bool, client_keep_alive, true,
+          "reuse the connection for the requests in client mode");
 ABSL_FLAG(int32_t, port, 8000, "port of RPC server");
-ABSL_FLAG(int32_t, rpc_timeout, 60000, "timeout");
+ABSL_FLAG(int32_t, rpc_timeout, 60000, "timeout in msec");
+ABSL_FLAG(int32_t, num_workers, 4, "number of threads evaluating requests");
+ABSL_FLAG(int32_t, max_pending_requests, 256,
+          "number of requests waiting for the workers before the server "
+          "stops reading the sockets");
+ABSL_FLAG(int32_t, max_connections, 1024,
+          "number of connections before the server stops accepting new ones");
 ABSL_FLAG(std::string, user_profile_directory, "", "user profile directory");
 
 namespace mozc {
 
 namespace {
 
+using ::mozc::server::AppendRpcFrame;
+using ::mozc::server::kRpcHeaderSize;
+using ::mozc::server::PeekRpcFrameSize;
+using ::mozc::server::RpcFrameReader;
+using ::mozc::server::RpcRequest;
+using ::mozc::server::RpcRequestQueue;
+
 constexpr size_t kMaxRequestSize = 32 * 32 * 8192;
 constexpr size_t kMaxOutputSize = 32 * 32 * 8192;
 constexpr int kInvalidSocket = -1;
+constexpr size_t kReadChunkSize = 8192;
+
+// Interval to close the connections sending an incomplete request too long.
+constexpr absl::Duration kSweepInterval = absl::Seconds(1);
+
+#if defined(_WIN32)
+constexpr int kSendFlag = 0;
+#elif defined(__APPLE__)  // defined(_WIN32)
+constexpr int kSendFlag = SO_NOSIGPIPE;
+#else                     // defined(__APPLE__)
+constexpr int kSendFlag = MSG_NOSIGNAL;
+#endif                    // defined(__APPLE__)
+
+absl::Duration GetRpcTimeout() {
+  return absl::Milliseconds(absl::GetFlag(FLAGS_rpc_timeout));
+}
+
+// Returns true if the last socket call failed only because the non-blocking
+// socket isn't ready.
+bool IsWouldBlock() {
+#ifdef _WIN32
+  return ::WSAGetLastError() == WSAEWOULDBLOCK;
+#else   // _WIN32
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif  // _WIN32
+}
+
+int Poll(pollfd *fds, size_t size, absl::Duration timeout) {
+  const int timeout_msec =
+      timeout == absl::InfiniteDuration()
+          ? -1
+          : static_cast<int>(absl::ToInt64Milliseconds(
+                std::max(timeout, absl::ZeroDuration())));
+#ifdef _WIN32
+  return ::WSAPoll(fds, static_cast<ULONG>(size), timeout_msec);
+#else   // _WIN32
+  return ::poll(fds, size, timeout_msec);
+#endif  // _WIN32
+}
 
-// TODO(taku): timeout should be handled.
-bool Recv(int socket, char *buf, size_t buf_size, int timeout) {
-  ssize_t buf_left = buf_size;
-  while (buf_left > 0) {
-    const ssize_t read_size = ::recv(socket, buf, buf_left, 0);
+void SetCloseOnExec(int socket) {
+#ifndef _WIN32
+  int flags = ::fcntl(socket, F_GETFD, 0);
+  CHECK_GE(flags, 0) << "fcntl(F_GETFD) failed";
+  flags |= FD_CLOEXEC;
+  CHECK_EQ(::fcntl(socket, F_SETFD, flags), 0) << "fctl(F_SETFD) failed";
+#endif  // !_WIN32
+}
+
+void SetNonBlocking(int socket) {
+#ifdef _WIN32
+  u_long on = 1;
+  CHECK_EQ(::ioctlsocket(socket, FIONBIO, &on), 0) << "ioctlsocket failed";
+#else   // _WIN32
+  const int flags = ::fcntl(socket, F_GETFL, 0);
+  CHECK_GE(flags, 0) << "fcntl(F_GETFL) failed";
+  CHECK_EQ(::fcntl(socket, F_SETFL, flags | O_NONBLOCK), 0)
+      << "fcntl(F_SETFL) failed";
+#endif  // _WIN32
+}
+
+void SetNoDelay(int socket) {
+  int on = 1;
+  ::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char *>(&on),
+               sizeof(on));
+}
+
+// Waits until |socket| gets ready for |events|.
+bool WaitFor(int socket, short events, absl::Time deadline) {
+  pollfd fd = {};
+  fd.fd = socket;
+  fd.events = events;
+  while (true) {
+    const int result = Poll(&fd, 1, deadline - absl::Now());
+    if (result > 0) {
+      return true;
+    }
+    if (result == 0) {
+      LOG(ERROR) << "timeout";
+      return false;
+    }
+    if (!IsWouldBlock()) {
+      LOG(ERROR) << "an error occurred during poll()";
+      return false;
+    }
+  }
+}
+
+bool Recv(int socket, char *buf, size_t buf_size, absl::Duration timeout) {
+  const absl::Time deadline = absl::Now() + timeout;
+  while (buf_size > 0) {
+    const ssize_t read_size = ::recv(socket, buf, buf_size, 0);
+    if (read_size == 0) {
+      LOG(ERROR) << "connection closed by peer";
+      return false;
+    }
     if (read_size < 0) {
+      if (IsWouldBlock() && WaitFor(socket, POLLIN, deadline)) {
+        continue;
+      }
       LOG(ERROR) << "an error occurred during recv()";
       return false;
     }
     buf += read_size;
-    buf_left -= read_size;
+    buf_size -= read_size;
   }
-  return buf_left == 0;
+  return true;
 }
 
-// TODO(taku): timeout should be handled.
-bool Send(int socket, const char *buf, size_t buf_size, int timeout) {
-  ssize_t buf_left = buf_size;
-  while (buf_left > 0) {
-#if defined(_WIN32)
-    constexpr int kFlag = 0;
-#elif defined(__APPLE__)  // defined(_WIN32)
-    constexpr int kFlag = SO_NOSIGPIPE;
-#else                     // defined(__APPLE__)
-    constexpr int kFlag = MSG_NOSIGNAL;
-#endif                    // defined(__APPLE__)
-    const ssize_t read_size = ::send(socket, buf, buf_left, kFlag);
-    if (read_size < 0) {
+bool Send(int socket, const char *buf, size_t buf_size,
+          absl::Duration timeout) {
+  const absl::Time deadline = absl::Now() + timeout;
+  while (buf_size > 0) {
+    const ssize_t sent_size = ::send(socket, buf, buf_size, kSendFlag);
+    if (sent_size < 0) {
+      if (IsWouldBlock() && WaitFor(socket, POLLOUT, deadline)) {
+        continue;
+      }
       LOG(ERROR) << "an error occurred during sending";
       return false;
     }
-    buf += read_size;
-    buf_left -= read_size;
+    buf += sent_size;
+    buf_size -= sent_size;
   }
-  return buf_left == 0;
+  return true;
 }
 
+// Shuts down before closing, as the descriptor may be reused by another
+// thread once closed.
 void CloseSocket(int client_socket) {
 #ifdef _WIN32
-  ::closesocket(client_socket);
   ::shutdown(client_socket, SD_BOTH);
+  ::closesocket(client_socket);
 #else   // _WIN32
-  ::close(client_socket);
   ::shutdown(client_socket, SHUT_RDWR);
+  ::close(client_socket);
 #endif  // _WIN32
 }
 
@@ -128,18 +277,13 @@ class RPCServer {
  public:
   RPCServer()
       : server_socket_(kInvalidSocket),
+        queue_(std::max(1, absl::GetFlag(FLAGS_max_pending_requests))),
+        max_connections_(std::max(1, absl::GetFlag(FLAGS_max_connections))),
         handler_(new SessionHandler(EngineFactory::Create().value())) {
     server_socket_ = ::socket(AF_INET, SOCK_STREAM, 0);
 
     CHECK_NE(server_socket_, kInvalidSocket) << "socket failed";
-
-#ifndef _WIN32
-    int flags = ::fcntl(server_socket_, F_GETFD, 0);
-    CHECK_GE(flags, 0) << "fcntl(F_GETFD) failed";
-    flags |= FD_CLOEXEC;
-    CHECK_EQ(::fcntl(server_socket_, F_SETFD, flags), 0)
-        << "fctl(F_SETFD) failed";
-#endif  // !_WIN32
+    SetCloseOnExec(server_socket_);
 
     struct sockaddr_in sin = {};
     sin.sin_port = htons(absl::GetFlag(FLAGS_port));
@@ -157,11 +301,22 @@ class RPCServer {
 
     CHECK_GE(::listen(server_socket_, SOMAXCONN), 0) << "listen failed";
     CHECK_NE(server_socket_, 0);
+    SetNonBlocking(server_socket_);
 
+    CreateWakeupSockets();
     handler_->AddObserver(Singleton<session::SessionUsageObserver>::get());
   }
 
   ~RPCServer() {
+    queue_.Stop();
+    for (Thread &worker : workers_) {
+      worker.Join();
+    }
+    for (const auto &[id, connection] : connections_) {
+      CloseSocket(connection.socket);
+    }
+    CloseSocket(wakeup_sockets_[0]);
+    CloseSocket(wakeup_sockets_[1]);
     CloseSocket(server_socket_);
     server_socket_ = kInvalidSocket;
   }
@@ -169,68 +324,338 @@ class RPCServer {
   void Loop() {
     LOG(INFO) << "Start Mozc RPCServer";
 
+    const int num_workers = std::max(1, absl::GetFlag(FLAGS_num_workers));
+    for (int i = 0; i < num_workers; ++i) {
+      workers_.emplace_back([this] { RunWorker(); });
+    }
+
+    std::vector<pollfd> fds;
+    std::vector<uint64_t> ids;
+    absl::Time next_sweep = absl::Now() + kSweepInterval;
     while (true) {
-      const int client_socket = ::accept(server_socket_, nullptr, nullptr);
+      // Stops reading the requests while the workers are busy.
+      const bool readable = !queue_.IsFull();
+      fds.clear();
+      ids.clear();
+      fds.push_back({server_socket_,
+                     static_cast<short>(
+                         readable && connections_.size() < max_connections_
+                             ? POLLIN
+                             : 0),
+                     0});
+      fds.push_back({wakeup_sockets_[0], POLLIN, 0});
+      for (const auto &[id, connection] : connections_) {
+        short events = 0;
+        if (readable && !connection.in_flight && !connection.peer_closed) {
+          events |= POLLIN;
+        }
+        if (connection.written < connection.write_buffer.size()) {
+          events |= POLLOUT;
+        }
+        // Otherwise poll() keeps reporting POLLHUP of the closed peers.
+        fds.push_back(
+            {events != 0 ? connection.socket : kInvalidSocket, events, 0});
+        ids.push_back(id);
+      }
+
+      if (Poll(fds.data(), fds.size(), next_sweep - absl::Now()) < 0) {
+        if (IsWouldBlock()) {
+          continue;
+        }
+        LOG(FATAL) << "poll() failed";
+      }
 
+      if (fds[1].revents != 0) {
+        ReceiveResponses();
+      }
+      for (size_t i = 0; i < ids.size(); ++i) {
+        if (fds[i + 2].revents != 0) {
+          HandleEvents(ids[i], fds[i + 2].revents);
+        }
+      }
+      if (fds[0].revents != 0) {
+        Accept();
+      }
+
+      // The workers have taken some requests, so the ones read while the
+      // queue was full can be dispatched now.
+      if (fds[1].revents != 0) {
+        DispatchBufferedRequests();
+      }
+
+      const absl::Time now = absl::Now();
+      if (now >= next_sweep) {
+        CloseStalledConnections(now);
+        next_sweep = now + kSweepInterval;
+      }
+    }
+  }
+
+ private:
+  struct Connection {
+    int socket = kInvalidSocket;
+    // Received bytes not dispatched yet.
+    RpcFrameReader reader{kMaxRequestSize};
+    std::string write_buffer;
+    size_t written = 0;
+    // True while a worker owns the request of this connection.
+    bool in_flight = false;
+    // True if the peer has shut down its sending side.
+    bool peer_closed = false;
+  };
+
+  struct Response {
+    uint64_t connection_id;
+    // Empty to close the connection.
+    std::string body;
+  };
+
+  // Creates a connected pair of sockets for the workers to wake up poll().
+  // It's made of TCP so that WSAPoll() can poll it on Windows as well.
+  void CreateWakeupSockets() {
+    const int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    CHECK_NE(listener, kInvalidSocket) << "socket failed";
+    struct sockaddr_in sin = {};
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t sin_len = sizeof(sin);
+    CHECK_GE(::bind(listener, reinterpret_cast<struct sockaddr *>(&sin),
+                    sizeof(sin)),
+             0)
+        << "bind failed";
+    CHECK_GE(::listen(listener, 1), 0) << "listen failed";
+    CHECK_GE(::getsockname(listener, reinterpret_cast<struct sockaddr *>(&sin),
+                           &sin_len),
+             0)
+        << "getsockname failed";
+    wakeup_sockets_[1] = ::socket(AF_INET, SOCK_STREAM, 0);
+    CHECK_NE(wakeup_sockets_[1], kInvalidSocket) << "socket failed";
+    CHECK_GE(::connect(wakeup_sockets_[1],
+                       reinterpret_cast<struct sockaddr *>(&sin), sin_len),
+             0)
+        << "connect failed";
+    wakeup_sockets_[0] = ::accept(listener, nullptr, nullptr);
+    CHECK_NE(wakeup_sockets_[0], kInvalidSocket) << "accept failed";
+    CloseSocket(listener);
+    for (const int socket : wakeup_sockets_) {
+      SetCloseOnExec(socket);
+      SetNonBlocking(socket);
+      SetNoDelay(socket);
+    }
+  }
+
+  void Accept() {
+    while (true) {
+      const int client_socket = ::accept(server_socket_, nullptr, nullptr);
       if (client_socket == kInvalidSocket) {
-        LOG(ERROR) << "accept failed";
-        continue;
+        if (!IsWouldBlock()) {
+          LOG(ERROR) << "accept failed";
+        }
+        return;
       }
+      SetCloseOnExec(client_socket);
+      SetNonBlocking(client_socket);
+      SetNoDelay(client_socket);
+      connections_[next_connection_id_++].socket = client_socket;
+    }
+  }
 
-      uint32_t request_size = 0;
-      // Receive the size of data.
-      if (!Recv(client_socket, reinterpret_cast<char *>(&request_size),
-                sizeof(request_size), absl::GetFlag(FLAGS_rpc_timeout))) {
-        LOG(ERROR) << "Cannot receive request_size header.";
-        CloseSocket(client_socket);
-        continue;
+  void HandleEvents(uint64_t id, short revents) {
+    auto it = connections_.find(id);
+    // Closed after an error response.
+    if (it == connections_.end()) {
+      return;
+    }
+    Connection &connection = it->second;
+    bool ok = true;
+    if (revents & POLLOUT) {
+      ok = Write(&connection);
+    }
+    if (ok && (revents & (POLLIN | POLLHUP))) {
+      ok = Read(&connection) && Dispatch(id, &connection);
+    }
+    if (ok && (revents & (POLLERR | POLLNVAL))) {
+      ok = false;
+    }
+    // The response of the last request is sent before closing.
+    if (connection.peer_closed && !connection.in_flight &&
+        connection.written == connection.write_buffer.size()) {
+      ok = false;
+    }
+    if (!ok) {
+      Close(it);
+    }
+  }
+
+  // Reads the available bytes.  Returns false if the connection is broken.
+  bool Read(Connection *connection) {
+    char buf[kReadChunkSize];
+    while (true) {
+      const ssize_t read_size = ::recv(connection->socket, buf, sizeof(buf), 0);
+      if (read_size == 0) {
+        connection->peer_closed = true;
+        return true;
       }
-      request_size = ntohl(request_size);
-      CHECK_GT(request_size, 0);
-      CHECK_LT(request_size, kMaxRequestSize);
-
-      // Receive the body of serialized protobuf.
-      std::unique_ptr<char[]> request_str(new char[request_size]);
-      if (!Recv(client_socket, request_str.get(), request_size,
-                absl::GetFlag(FLAGS_rpc_timeout))) {
-        LOG(ERROR) << "cannot receive body of request.";
-        CloseSocket(client_socket);
-        continue;
+      if (read_size < 0) {
+        return IsWouldBlock();
       }
+      // Stops reading a request larger than any valid one.
+      if (!connection->reader.Append(absl::string_view(buf, read_size),
+                                     absl::Now())) {
+        LOG(ERROR) << "Too large request";
+        return false;
+      }
+      if (static_cast<size_t>(read_size) < sizeof(buf)) {
+        return true;
+      }
+    }
+  }
+
+  // Sends the buffered responses.  Returns false if the connection is broken.
+  bool Write(Connection *connection) {
+    while (connection->written < connection->write_buffer.size()) {
+      const ssize_t sent_size =
+          ::send(connection->socket,
+                 connection->write_buffer.data() + connection->written,
+                 connection->write_buffer.size() - connection->written,
+                 kSendFlag);
+      if (sent_size < 0) {
+        return IsWouldBlock();
+      }
+      connection->written += sent_size;
+    }
+    connection->write_buffer.clear();
+    connection->written = 0;
+    return true;
+  }
+
+  // Hands the next request of |connection| to the workers if it is complete.
+  // Returns false if the request is broken.
+  bool Dispatch(uint64_t id, Connection *connection) {
+    if (connection->in_flight) {
+      return true;
+    }
+    switch (connection->reader.Peek()) {
+      case RpcFrameReader::Status::kIncomplete:
+        return true;
+      case RpcFrameReader::Status::kInvalid:
+        LOG(ERROR) << "Invalid request size";
+        return false;
+      case RpcFrameReader::Status::kFrame:
+        break;
+    }
+
+    // Retried by DispatchBufferedRequests() when the workers take some.  The
+    // loop is the only producer, so the queue has room after this check.
+    if (queue_.IsFull()) {
+      return true;
+    }
+    const absl::Time now = absl::Now();
+    RpcRequest request = {id, connection->reader.Pop(now),
+                          now + GetRpcTimeout()};
+    CHECK(queue_.TryPush(std::move(request)));
+    connection->in_flight = true;
+    return true;
+  }
 
-      commands::Command command;
-      if (!command.mutable_input()->ParseFromArray(request_str.get(),
-                                                   request_size)) {
-        LOG(ERROR) << "ParseFromArray failed";
-        CloseSocket(client_socket);
+  void ReceiveResponses() {
+    char buf[256];
+    while (::recv(wakeup_sockets_[0], buf, sizeof(buf), 0) > 0) {
+    }
+    std::vector<Response> responses;
+    {
+      absl::MutexLock lock(&mutex_);
+      responses.swap(responses_);
+    }
+    for (Response &response : responses) {
+      // The connection may have been closed by the peer.
+      auto it = connections_.find(response.connection_id);
+      if (it == connections_.end()) {
+        continue;
+      }
+      Connection &connection = it->second;
+      connection.in_flight = false;
+      if (response.body.empty()) {
+        Close(it);
         continue;
       }
+      AppendRpcFrame(response.body, &connection.write_buffer);
+      if (!Write(&connection) ||
+          (connection.peer_closed &&
+           connection.written == connection.write_buffer.size())) {
+        Close(it);
+      }
+    }
+  }
 
-      CHECK(handler_->EvalCommand(&command));
+  void DispatchBufferedRequests() {
+    std::vector<uint64_t> broken;
+    for (auto &[id, connection] : connections_) {
+      if (!Dispatch(id, &connection)) {
+        broken.push_back(id);
+      }
+    }
+    for (const uint64_t id : broken) {
+      Close(connections_.find(id));
+    }
+  }
 
-      std::string output_str;
-      // Return the result.
-      CHECK(command.output().SerializeToString(&output_str));
+  void CloseStalledConnections(absl::Time now) {
+    const absl::Duration timeout = GetRpcTimeout();
+    std::vector<uint64_t> stalled;
+    for (const auto &[id, connection] : connections_) {
+      if (!connection.in_flight && connection.reader.IsStalled(now, timeout)) {
+        stalled.push_back(id);
+      }
+    }
+    for (const uint64_t id : stalled) {
+      LOG(WARNING) << "Request timeout";
+      Close(connections_.find(id));
+    }
+  }
 
-      uint32_t output_size = output_str.size();
-      CHECK_GT(output_size, 0);
-      CHECK_LT(output_size, kMaxOutputSize);
-      output_size = htonl(output_size);
+  void Close(absl::flat_hash_map<uint64_t, Connection>::iterator it) {
+    CloseSocket(it->second.socket);
+    connections_.erase(it);
+  }
 
-      if (!Send(client_socket, reinterpret_cast<char *>(&output_size),
-                sizeof(output_size), absl::GetFlag(FLAGS_rpc_timeout)) ||
-          !Send(client_socket, output_str.data(), output_str.size(),
-                absl::GetFlag(FLAGS_rpc_timeout))) {
-        LOG(ERROR) << "Cannot send reply.";
+  void RunWorker() {
+    while (std::optional<RpcRequest> request = queue_.Pop()) {
+      Response response = {
+          request->connection_id,
+          server::EvalRpcRequest(*request, absl::Now(), handler_.get())};
+      if (response.body.size() > kMaxOutputSize) {
+        // Only this connection is given up.
+        LOG(ERROR) << "Too large response: " << response.body.size();
+        response.body.clear();
       }
 
-      CloseSocket(client_socket);
+      bool wakeup = false;
+      {
+        absl::MutexLock lock(&mutex_);
+        wakeup = responses_.empty();
+        responses_.push_back(std::move(response));
+      }
+      if (wakeup) {
+        const char c = 0;
+        ::send(wakeup_sockets_[1], &c, 1, kSendFlag);
+      }
     }
   }
 
- private:
   int server_socket_;
+  RpcRequestQueue queue_;
+  const size_t max_connections_;
+  // [0] is polled by the loop, and [1] is written by the workers.
+  int wakeup_sockets_[2] = {kInvalidSocket, kInvalidSocket};
   std::unique_ptr<SessionHandler> handler_;
+  absl::flat_hash_map<uint64_t, Connection> connections_;
+  uint64_t next_connection_id_ = 0;
+  std::vector<Thread> workers_;
+
+  // Guards the responses from the workers.
+  absl::Mutex mutex_;
+  std::vector<Response> responses_ ABSL_GUARDED_BY(mutex_);
 };
 
 // Standalone RPCClient.
@@ -238,7 +663,13 @@ class RPCServer {
 // This allows us to reuse client::Session library and SessionServer.
 class RPCClient {
  public:
-  RPCClient() : id_(0) {}
+  RPCClient()
+      : id_(0),
+        socket_(kInvalidSocket),
+        keep_alive_(absl::GetFlag(FLAGS_client_keep_alive)) {}
+  RPCClient(const RPCClient &) = delete;
+  RPCClient &operator=(const RPCClient &) = delete;
+  ~RPCClient() { Disconnect(); }
 
   bool CreateSession() {
     id_ = 0;
@@ -256,14 +687,15 @@ class RPCClient {
   bool DeleteSession() {
     commands::Input input;
     commands::Output output;
-    id_ = 0;
     input.set_type(commands::Input::DELETE_SESSION);
+    input.set_id(id_);
+    id_ = 0;
     return (Call(input, &output) &&
             output.error_code() == commands::Output::SESSION_SUCCESS);
   }
 
   bool SendKey(const mozc::commands::KeyEvent &key,
-               mozc::commands::Output *output) const {
+               mozc::commands::Output *output) {
     if (id_ == 0) {
       return false;
     }
@@ -276,56 +708,78 @@ class RPCClient {
   }
 
  private:
-  bool Call(const commands::Input &input, commands::Output *output) const {
+  bool Connect() {
     struct addrinfo hints = {}, *res;
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_family = AF_INET;
 
     const std::string port_str = std::to_string(absl::GetFlag(FLAGS_port));
-    CHECK_EQ(::getaddrinfo(absl::GetFlag(FLAGS_host).c_str(), port_str.c_str(),
-                           &hints, &res),
-             0)
-        << "getaddrinfo failed";
-
-    const int client_socket =
-        ::socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-    CHECK_NE(client_socket, kInvalidSocket) << "socket failed";
-    CHECK_GE(::connect(client_socket, res->ai_addr, res->ai_addrlen), 0)
-        << "connect failed";
-
-    std::string request_str;
-    CHECK(input.SerializeToString(&request_str));
-    uint32_t request_size = request_str.size();
-    CHECK_GT(request_size, 0);
-    CHECK_LT(request_size, kMaxRequestSize);
-    request_size = htonl(request_size);
-
-    CHECK(Send(client_socket, reinterpret_cast<char *>(&request_size),
-               sizeof(request_size), absl::GetFlag(FLAGS_rpc_timeout)));
-    CHECK(Send(client_socket, request_str.data(), request_str.size(),
-               absl::GetFlag(FLAGS_rpc_timeout)));
-
-    uint32_t output_size = 0;
-    CHECK(Recv(client_socket, reinterpret_cast<char *>(&output_size),
-               sizeof(output_size), absl::GetFlag(FLAGS_rpc_timeout)));
-    output_size = ntohl(output_size);
-    CHECK_GT(output_size, 0);
-    CHECK_LT(output_size, kMaxOutputSize);
+    if (::getaddrinfo(absl::GetFlag(FLAGS_host).c_str(), port_str.c_str(),
+                      &hints, &res) != 0) {
+      LOG(ERROR) << "getaddrinfo failed";
+      return false;
+    }
 
-    std::unique_ptr<char[]> output_str(new char[output_size]);
-    CHECK(Recv(client_socket, output_str.get(), output_size,
-               absl::GetFlag(FLAGS_rpc_timeout)));
+    socket_ = ::socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (socket_ == kInvalidSocket) {
+      LOG(ERROR) << "socket failed";
+    } else if (::connect(socket_, res->ai_addr, res->ai_addrlen) < 0) {
+      LOG(ERROR) << "connect failed";
+      Disconnect();
+    } else {
+      SetNoDelay(socket_);
+    }
+    ::freeaddrinfo(res);
+    return socket_ != kInvalidSocket;
+  }
 
-    CHECK(output->ParseFromArray(output_str.get(), output_size));
+  void Disconnect() {
+    if (socket_ != kInvalidSocket) {
+      CloseSocket(socket_);
+      socket_ = kInvalidSocket;
+    }
+  }
 
-    ::freeaddrinfo(res);
+  bool Call(const commands::Input &input, commands::Output *output) {
+    if (socket_ == kInvalidSocket && !Connect()) {
+      return false;
+    }
 
-    CloseSocket(client_socket);
+    std::string request_str;
+    CHECK(input.SerializeToString(&request_str));
+    CHECK_GT(request_str.size(), 0);
+    CHECK_LT(request_str.size(), kMaxRequestSize);
+    std::string frame;
+    AppendRpcFrame(request_str, &frame);
+
+    const absl::Duration timeout = GetRpcTimeout();
+    char header[kRpcHeaderSize];
+    std::string output_str;
+    bool result = Send(socket_, frame.data(), frame.size(), timeout) &&
+                  Recv(socket_, header, sizeof(header), timeout);
+    if (result) {
+      const uint32_t output_size =
+          PeekRpcFrameSize(absl::string_view(header, sizeof(header)));
+      result = output_size > 0 && output_size < kMaxOutputSize;
+      if (result) {
+        output_str.resize(output_size);
+        result = Recv(socket_, output_str.data(), output_size, timeout) &&
+                 output->ParseFromString(output_str);
+      }
+    }
 
-    return true;
+    if (!result) {
+      LOG(ERROR) << "RPC failed";
+    }
+    if (!result || !keep_alive_) {
+      Disconnect();
+    }
+    return result;
   }
 
   uint64_t id_;
+  int socket_;
+  const bool keep_alive_;
 };
 
 // Wrapper class for WSAStartup on Windows.
@@ -343,6 +797,61 @@ class ScopedWSAData {
 #endif  // _WIN32
   }
 };
+
+// Sends random key events on a session and records the latency of each.
+void RunClient(std::vector<absl::Duration> *latencies) {
+  RPCClient client;
+  CHECK(client.CreateSession());
+  session::RandomKeyEventsGenerator key_events_generator;
+  for (int n = 0; n < absl::GetFlag(FLAGS_client_test_size); ++n) {
+    std::vector<commands::KeyEvent> keys;
+    key_events_generator.GenerateSequence(&keys);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      MOZC_VLOG(1) << "Sending to Server: " << protobuf::Utf8Format(keys[i]);
+      commands::Output output;
+      const absl::Time start = absl::Now();
+      CHECK(client.SendKey(keys[i], &output));
+      latencies->push_back(absl::Now() - start);
+      MOZC_VLOG(1) << "Output of SendKey: " << protobuf::Utf8Format(output);
+    }
+  }
+  CHECK(client.DeleteSession());
+}
+
+// Runs --client_threads clients concurrently and reports the latency
+// percentiles and the throughput of SEND_KEY.
+void RunLoadTest() {
+  const int num_threads = std::max(1, absl::GetFlag(FLAGS_client_threads));
+  std::vector<std::vector<absl::Duration>> latencies(num_threads);
+  std::vector<Thread> threads;
+  const absl::Time start = absl::Now();
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back(RunClient, &latencies[i]);
+  }
+  for (Thread &thread : threads) {
+    thread.Join();
+  }
+  const absl::Duration elapsed = absl::Now() - start;
+
+  std::vector<absl::Duration> all;
+  for (const std::vector<absl::Duration> &thread_latencies : latencies) {
+    all.insert(all.end(), thread_latencies.begin(), thread_latencies.end());
+  }
+  if (all.empty()) {
+    return;
+  }
+  std::sort(all.begin(), all.end());
+  const auto percentile = [&all](size_t p) {
+    return all[std::min(all.size() - 1, all.size() * p / 100)];
+  };
+  std::cout << "threads: " << num_threads << std::endl
+            << "requests: " << all.size() << std::endl
+            << "qps: " << all.size() / absl::ToDoubleSeconds(elapsed)
+            << std::endl
+            << "p50: " << percentile(50) << std::endl
+            << "p99: " << percentile(99) << std::endl
+            << "max: " << all.back() << std::endl;
+}
 }  // namespace
 
 }  // namespace mozc
@@ -360,22 +869,7 @@ int main(int argc, char *argv[]) {
   }
 
   if (absl::GetFlag(FLAGS_client)) {
-    mozc::RPCClient client;
-    CHECK(client.CreateSession());
-    mozc::session::RandomKeyEventsGenerator key_events_generator;
-    for (int n = 0; n < absl::GetFlag(FLAGS_client_test_size); ++n) {
-      std::vector<mozc::commands::KeyEvent> keys;
-      key_events_generator.GenerateSequence(&keys);
-      for (size_t i = 0; i < keys.size(); ++i) {
-        LOG(INFO) << "Sending to Server: "
-                  << mozc::protobuf::Utf8Format(keys[i]);
-        mozc::commands::Output output;
-        CHECK(client.SendKey(keys[i], &output));
-        LOG(INFO) << "Output of SendKey: "
-                  << mozc::protobuf::Utf8Format(output);
-      }
-    }
-    CHECK(client.DeleteSession());
+    mozc::RunLoadTest();
     return 0;
   } else if (absl::GetFlag(FLAGS_server)) {
     mozc::RPCServer server;
@@ -0,0 +1,167 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "server/rpc_util.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "base/logging.h"
+#include "protocol/commands.pb.h"
+#include "session/session_handler_interface.h"
+
+namespace mozc {
+namespace server {
+
+void AppendRpcFrame(absl::string_view payload, std::string *frame) {
+  const uint32_t size = static_cast<uint32_t>(payload.size());
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    frame->push_back(static_cast<char>((size >> shift) & 0xff));
+  }
+  frame->append(payload.data(), payload.size());
+}
+
+uint32_t PeekRpcFrameSize(absl::string_view buffer) {
+  if (buffer.size() < kRpcHeaderSize) {
+    return 0;
+  }
+  uint32_t size = 0;
+  for (size_t i = 0; i < kRpcHeaderSize; ++i) {
+    size = (size << 8) | static_cast<uint8_t>(buffer[i]);
+  }
+  return size;
+}
+
+bool RpcFrameReader::Append(absl::string_view data, absl::Time now) {
+  if (buffer_.empty() && !data.empty()) {
+    start_ = now;
+  }
+  buffer_.append(data.data(), data.size());
+  return buffer_.size() <= kRpcHeaderSize + max_frame_size_;
+}
+
+RpcFrameReader::Status RpcFrameReader::Peek() const {
+  if (buffer_.size() > kRpcHeaderSize + max_frame_size_) {
+    return Status::kInvalid;
+  }
+  if (buffer_.size() < kRpcHeaderSize) {
+    return Status::kIncomplete;
+  }
+  const uint32_t size = PeekRpcFrameSize(buffer_);
+  if (size == 0 || size > max_frame_size_) {
+    return Status::kInvalid;
+  }
+  return buffer_.size() < kRpcHeaderSize + size ? Status::kIncomplete
+                                                : Status::kFrame;
+}
+
+std::string RpcFrameReader::Pop(absl::Time now) {
+  DCHECK(Peek() == Status::kFrame);
+  const uint32_t size = PeekRpcFrameSize(buffer_);
+  std::string payload = buffer_.substr(kRpcHeaderSize, size);
+  buffer_.erase(0, kRpcHeaderSize + size);
+  start_ = now;
+  return payload;
+}
+
+bool RpcFrameReader::IsStalled(absl::Time now, absl::Duration timeout) const {
+  return !buffer_.empty() && Peek() == Status::kIncomplete &&
+         now - start_ > timeout;
+}
+
+bool RpcRequestQueue::IsFull() const {
+  absl::MutexLock lock(&mutex_);
+  return requests_.size() >= capacity_;
+}
+
+bool RpcRequestQueue::TryPush(RpcRequest &&request) {
+  absl::MutexLock lock(&mutex_);
+  if (requests_.size() >= capacity_) {
+    return false;
+  }
+  requests_.push_back(std::move(request));
+  cond_.Signal();
+  return true;
+}
+
+std::optional<RpcRequest> RpcRequestQueue::Pop() {
+  absl::MutexLock lock(&mutex_);
+  while (!stopping_ && requests_.empty()) {
+    cond_.Wait(&mutex_);
+  }
+  if (stopping_) {
+    return std::nullopt;
+  }
+  RpcRequest request = std::move(requests_.front());
+  requests_.pop_front();
+  return request;
+}
+
+void RpcRequestQueue::Stop() {
+  absl::MutexLock lock(&mutex_);
+  stopping_ = true;
+  cond_.SignalAll();
+}
+
+std::string EvalRpcRequest(const RpcRequest &request, absl::Time now,
+                           SessionHandlerInterface *handler) {
+  commands::Command command;
+  if (!command.mutable_input()->ParseFromArray(request.body.data(),
+                                               request.body.size())) {
+    LOG(ERROR) << "ParseFromArray failed";
+    return "";
+  }
+  if (now > request.deadline) {
+    LOG(WARNING) << "Deadline exceeded before evaluation";
+    command.mutable_output()->set_id(command.input().id());
+    command.mutable_output()->set_error_code(
+        commands::Output::SESSION_FAILURE);
+  } else if (!handler->EvalCommand(&command)) {
+    LOG(ERROR) << "EvalCommand failed";
+    command.mutable_output()->set_error_code(
+        commands::Output::SESSION_FAILURE);
+  }
+  std::string output;
+  CHECK(command.output().SerializeToString(&output));
+  // An empty message still needs a frame.
+  if (output.empty()) {
+    command.mutable_output()->set_id(command.input().id());
+    CHECK(command.output().SerializeToString(&output));
+  }
+  return output;
+}
+
+}  // namespace server
+}  // namespace mozc
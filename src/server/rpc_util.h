@@ -0,0 +1,144 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Building blocks of the standalone RPC server, mozc_rpc_server_main.
+//
+// Each message is a serialized protobuf prefixed with its size in a 32-bit
+// integer of the network byte order.  RpcFrameReader splits the bytes received
+// on a connection into the messages, and RpcRequestQueue hands them to the
+// worker threads with a bound to push back on the clients.
+
+#ifndef MOZC_SERVER_RPC_UTIL_H_
+#define MOZC_SERVER_RPC_UTIL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "session/session_handler_interface.h"
+
+namespace mozc {
+namespace server {
+
+inline constexpr size_t kRpcHeaderSize = sizeof(uint32_t);
+
+// Appends |payload| with the size header to |frame|.
+void AppendRpcFrame(absl::string_view payload, std::string *frame);
+
+// Returns the payload size of the frame at the beginning of |buffer|, or 0 if
+// the header isn't complete.
+uint32_t PeekRpcFrameSize(absl::string_view buffer);
+
+// Accumulates the bytes received on a connection and splits them into frames.
+class RpcFrameReader {
+ public:
+  enum class Status {
+    kIncomplete,  // More bytes are needed.
+    kFrame,       // The first frame is complete.
+    kInvalid,     // The first frame is empty or too large.
+  };
+
+  // |max_frame_size| is the largest payload size accepted.
+  explicit RpcFrameReader(size_t max_frame_size)
+      : max_frame_size_(max_frame_size) {}
+
+  // Appends |data| received at |now|.  Returns false if more bytes than the
+  // largest frame are buffered, in which case Peek() returns kInvalid and the
+  // connection should be closed.
+  bool Append(absl::string_view data, absl::Time now);
+
+  // Returns the status of the first frame.
+  Status Peek() const;
+
+  // Removes the first frame, for which Peek() returns kFrame, and returns its
+  // payload.  The following bytes, if any, start a new frame at |now|.
+  std::string Pop(absl::Time now);
+
+  // Returns true if an incomplete frame has been waiting for more than
+  // |timeout| at |now|.
+  bool IsStalled(absl::Time now, absl::Duration timeout) const;
+
+  bool empty() const { return buffer_.empty(); }
+
+ private:
+  size_t max_frame_size_;
+  std::string buffer_;
+  // When the first byte of the first frame came.
+  absl::Time start_ = absl::InfinitePast();
+};
+
+struct RpcRequest {
+  uint64_t connection_id = 0;
+  // The serialized commands::Input.
+  std::string body;
+  absl::Time deadline = absl::InfiniteFuture();
+};
+
+// Bounded queue of the requests waiting for the workers.  Thread-safe.
+class RpcRequestQueue {
+ public:
+  explicit RpcRequestQueue(size_t capacity) : capacity_(capacity) {}
+
+  bool IsFull() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Adds |request| unless the queue is full.  Returns false and leaves
+  // |request| untouched if it's full.
+  bool TryPush(RpcRequest &&request) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Waits for a request.  Returns std::nullopt once Stop() is called.
+  std::optional<RpcRequest> Pop() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Wakes up all the waiting Pop() calls.
+  void Stop() ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  const size_t capacity_;
+  mutable absl::Mutex mutex_;
+  absl::CondVar cond_;
+  bool stopping_ ABSL_GUARDED_BY(mutex_) = false;
+  std::deque<RpcRequest> requests_ ABSL_GUARDED_BY(mutex_);
+};
+
+// Evaluates |request| with |handler| and returns the serialized
+// commands::Output, or an empty string if the request is broken.  A request
+// past its deadline at |now| is answered with SESSION_FAILURE without being
+// evaluated.
+std::string EvalRpcRequest(const RpcRequest &request, absl::Time now,
+                           SessionHandlerInterface *handler);
+
+}  // namespace server
+}  // namespace mozc
+
+#endif  // MOZC_SERVER_RPC_UTIL_H_
@@ -0,0 +1,267 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "server/rpc_util.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "base/thread.h"
+#include "protocol/commands.pb.h"
+#include "session/session_handler_interface.h"
+#include "testing/gunit.h"
+
+namespace mozc {
+namespace server {
+namespace {
+
+constexpr size_t kMaxFrameSize = 64;
+
+const absl::Time kNow = absl::FromUnixSeconds(1000);
+
+std::string MakeFrame(absl::string_view payload) {
+  std::string frame;
+  AppendRpcFrame(payload, &frame);
+  return frame;
+}
+
+// Counts the evaluated commands and answers them with the session id 1.
+class FakeSessionHandler : public SessionHandlerInterface {
+ public:
+  bool IsAvailable() const override { return true; }
+  bool EvalCommand(commands::Command *command) override {
+    ++eval_count_;
+    command->mutable_output()->set_id(1);
+    return true;
+  }
+  void StartWatchDog() override {}
+  void AddObserver(session::SessionObserverInterface *observer) override {}
+  absl::string_view GetDataVersion() const override { return ""; }
+
+  int eval_count() const { return eval_count_; }
+
+ private:
+  int eval_count_ = 0;
+};
+
+TEST(RpcUtilTest, Frame) {
+  const std::string frame = MakeFrame("abc");
+  EXPECT_EQ(frame, absl::string_view("\0\0\0\3abc", 7));
+  EXPECT_EQ(PeekRpcFrameSize(frame), 3);
+  EXPECT_EQ(PeekRpcFrameSize(frame.substr(0, 3)), 0);
+}
+
+TEST(RpcFrameReaderTest, PartialFrames) {
+  RpcFrameReader reader(kMaxFrameSize);
+  EXPECT_TRUE(reader.empty());
+  EXPECT_EQ(reader.Peek(), RpcFrameReader::Status::kIncomplete);
+
+  // The header and the payload come in pieces.
+  const std::string frame = MakeFrame("hello");
+  reader.Append(frame.substr(0, 2), kNow);
+  EXPECT_EQ(reader.Peek(), RpcFrameReader::Status::kIncomplete);
+  reader.Append(frame.substr(2, 4), kNow);
+  EXPECT_EQ(reader.Peek(), RpcFrameReader::Status::kIncomplete);
+  reader.Append(frame.substr(6), kNow);
+  ASSERT_EQ(reader.Peek(), RpcFrameReader::Status::kFrame);
+  EXPECT_EQ(reader.Pop(kNow), "hello");
+  EXPECT_TRUE(reader.empty());
+
+  // Two frames and a part of the third come at once.
+  const std::string frames =
+      MakeFrame("a") + MakeFrame("bc") + MakeFrame("def").substr(0, 5);
+  reader.Append(frames, kNow);
+  ASSERT_EQ(reader.Peek(), RpcFrameReader::Status::kFrame);
+  EXPECT_EQ(reader.Pop(kNow), "a");
+  ASSERT_EQ(reader.Peek(), RpcFrameReader::Status::kFrame);
+  EXPECT_EQ(reader.Pop(kNow), "bc");
+  EXPECT_EQ(reader.Peek(), RpcFrameReader::Status::kIncomplete);
+  reader.Append("ef", kNow);
+  ASSERT_EQ(reader.Peek(), RpcFrameReader::Status::kFrame);
+  EXPECT_EQ(reader.Pop(kNow), "def");
+  EXPECT_TRUE(reader.empty());
+}
+
+TEST(RpcFrameReaderTest, InvalidFrames) {
+  {
+    RpcFrameReader reader(kMaxFrameSize);
+    reader.Append(MakeFrame(std::string(kMaxFrameSize + 1, 'x')), kNow);
+    EXPECT_EQ(reader.Peek(), RpcFrameReader::Status::kInvalid);
+  }
+  {
+    // The size alone is enough to reject the frame.
+    RpcFrameReader reader(kMaxFrameSize);
+    reader.Append(MakeFrame(std::string(1000, 'x')).substr(0, 4), kNow);
+    EXPECT_EQ(reader.Peek(), RpcFrameReader::Status::kInvalid);
+  }
+  {
+    RpcFrameReader reader(kMaxFrameSize);
+    reader.Append(MakeFrame(""), kNow);
+    EXPECT_EQ(reader.Peek(), RpcFrameReader::Status::kInvalid);
+  }
+  {
+    RpcFrameReader reader(kMaxFrameSize);
+    reader.Append(MakeFrame(std::string(kMaxFrameSize - 1, 'x')), kNow);
+    EXPECT_EQ(reader.Peek(), RpcFrameReader::Status::kFrame);
+  }
+}
+
+TEST(RpcFrameReaderTest, LargestFrame) {
+  // A frame of exactly the largest size is accepted.
+  RpcFrameReader reader(kMaxFrameSize);
+  const std::string frame = MakeFrame(std::string(kMaxFrameSize, 'x'));
+  EXPECT_TRUE(reader.Append(frame.substr(0, kRpcHeaderSize), kNow));
+  EXPECT_EQ(reader.Peek(), RpcFrameReader::Status::kIncomplete);
+  EXPECT_TRUE(reader.Append(frame.substr(kRpcHeaderSize), kNow));
+  ASSERT_EQ(reader.Peek(), RpcFrameReader::Status::kFrame);
+  EXPECT_EQ(reader.Pop(kNow), std::string(kMaxFrameSize, 'x'));
+  EXPECT_TRUE(reader.empty());
+}
+
+TEST(RpcFrameReaderTest, TooManyBufferedBytes) {
+  // The buffer holds at most one frame of the largest size, however the bytes
+  // are split.
+  RpcFrameReader reader(kMaxFrameSize);
+  const std::string frame = MakeFrame(std::string(kMaxFrameSize, 'x'));
+  EXPECT_TRUE(reader.Append(frame, kNow));
+  EXPECT_FALSE(reader.Append("y", kNow));
+  EXPECT_EQ(reader.Peek(), RpcFrameReader::Status::kInvalid);
+
+  // Small frames sent back to back without waiting for the responses count
+  // as well.
+  RpcFrameReader pipelined(kMaxFrameSize);
+  const std::string small_frame = MakeFrame(std::string(10, 'x'));
+  size_t size = 0;
+  while (size + small_frame.size() <= kRpcHeaderSize + kMaxFrameSize) {
+    EXPECT_TRUE(pipelined.Append(small_frame, kNow));
+    size += small_frame.size();
+  }
+  EXPECT_FALSE(pipelined.Append(small_frame, kNow));
+  EXPECT_EQ(pipelined.Peek(), RpcFrameReader::Status::kInvalid);
+}
+
+TEST(RpcFrameReaderTest, StalledClient) {
+  const absl::Duration kTimeout = absl::Seconds(10);
+  RpcFrameReader reader(kMaxFrameSize);
+  EXPECT_FALSE(reader.IsStalled(kNow + absl::Hours(1), kTimeout));
+
+  // The timeout counts from the first byte of the incomplete frame.
+  const std::string frame = MakeFrame("hello");
+  reader.Append(frame.substr(0, 3), kNow);
+  reader.Append(frame.substr(3, 2), kNow + absl::Seconds(9));
+  EXPECT_FALSE(reader.IsStalled(kNow + kTimeout, kTimeout));
+  EXPECT_TRUE(reader.IsStalled(kNow + absl::Seconds(11), kTimeout));
+
+  // A complete frame waiting for the workers isn't stalled.
+  reader.Append(frame.substr(5), kNow + absl::Seconds(11));
+  EXPECT_FALSE(reader.IsStalled(kNow + absl::Seconds(30), kTimeout));
+
+  // The rest of the bytes start a new frame when the first one is taken.
+  reader.Append(absl::string_view("\0", 1), kNow + absl::Seconds(12));
+  EXPECT_EQ(reader.Pop(kNow + absl::Seconds(30)), "hello");
+  EXPECT_FALSE(reader.IsStalled(kNow + absl::Seconds(40), kTimeout));
+  EXPECT_TRUE(reader.IsStalled(kNow + absl::Seconds(41), kTimeout));
+}
+
+TEST(RpcRequestQueueTest, FullQueue) {
+  RpcRequestQueue queue(2);
+  EXPECT_FALSE(queue.IsFull());
+  EXPECT_TRUE(queue.TryPush({1, "a"}));
+  EXPECT_TRUE(queue.TryPush({2, "b"}));
+  EXPECT_TRUE(queue.IsFull());
+
+  RpcRequest request = {3, "c"};
+  EXPECT_FALSE(queue.TryPush(std::move(request)));
+  EXPECT_EQ(request.connection_id, 3);
+  EXPECT_EQ(request.body, "c");
+
+  // A worker takes the oldest request, which makes room for another.
+  std::optional<RpcRequest> popped = queue.Pop();
+  ASSERT_TRUE(popped.has_value());
+  EXPECT_EQ(popped->connection_id, 1);
+  EXPECT_FALSE(queue.IsFull());
+  EXPECT_TRUE(queue.TryPush(std::move(request)));
+
+  popped = queue.Pop();
+  ASSERT_TRUE(popped.has_value());
+  EXPECT_EQ(popped->body, "b");
+  popped = queue.Pop();
+  ASSERT_TRUE(popped.has_value());
+  EXPECT_EQ(popped->body, "c");
+}
+
+TEST(RpcRequestQueueTest, PopWaitsForPushOrStop) {
+  RpcRequestQueue queue(1);
+  std::optional<RpcRequest> popped;
+  Thread worker([&queue, &popped] { popped = queue.Pop(); });
+  EXPECT_TRUE(queue.TryPush({1, "a"}));
+  worker.Join();
+  ASSERT_TRUE(popped.has_value());
+  EXPECT_EQ(popped->body, "a");
+
+  Thread stopped_worker([&queue, &popped] { popped = queue.Pop(); });
+  queue.Stop();
+  stopped_worker.Join();
+  EXPECT_FALSE(popped.has_value());
+}
+
+TEST(EvalRpcRequestTest, Deadline) {
+  FakeSessionHandler handler;
+  commands::Input input;
+  input.set_type(commands::Input::SEND_KEY);
+  input.set_id(1);
+  const RpcRequest request = {1, input.SerializeAsString(), kNow};
+
+  commands::Output output;
+  ASSERT_TRUE(output.ParseFromString(EvalRpcRequest(request, kNow, &handler)));
+  EXPECT_EQ(handler.eval_count(), 1);
+  EXPECT_EQ(output.error_code(), commands::Output::SESSION_SUCCESS);
+
+  // The request which waited too long isn't evaluated.
+  ASSERT_TRUE(output.ParseFromString(
+      EvalRpcRequest(request, kNow + absl::Milliseconds(1), &handler)));
+  EXPECT_EQ(handler.eval_count(), 1);
+  EXPECT_EQ(output.id(), 1);
+  EXPECT_EQ(output.error_code(), commands::Output::SESSION_FAILURE);
+}
+
+TEST(EvalRpcRequestTest, BrokenRequest) {
+  FakeSessionHandler handler;
+  const RpcRequest request = {1, "\xff\xff\xff", kNow};
+  EXPECT_EQ(EvalRpcRequest(request, kNow, &handler), "");
+  EXPECT_EQ(handler.eval_count(), 0);
+}
+
+}  // namespace
+}  // namespace server
+}  // namespace mozc
@@ -111,6 +111,7 @@
       'type': 'executable',
       'sources': [
         'mozc_rpc_server_main.cc',
+        'rpc_util.cc',
       ],
       'dependencies': [
         '<(mozc_oss_src_dir)/base/base.gyp:base',
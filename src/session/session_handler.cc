@@ -42,6 +42,7 @@
 
 #include "absl/flags/flag.h"
 #include "absl/random/random.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "base/clock.h"
 #include "base/logging.h"
@@ -59,6 +60,7 @@
 #include "protocol/config.pb.h"
 #include "protocol/engine_builder.pb.h"
 #include "protocol/user_dictionary_storage.pb.h"
+#include "rewriter/rewriter_profiler.h"
 #include "session/common.h"
 #include "session/internal/keymap.h"
 #include "session/session.h"
@@ -187,11 +189,11 @@ void SessionHandler::Init(std::unique_ptr<EngineInterface> engine,
 }
 
 SessionHandler::~SessionHandler() {
+  // Deletes the sessions before the engine they refer to.
   for (SessionElement *element =
            const_cast<SessionElement *>(session_map_->Head());
        element != nullptr; element = element->next) {
-    delete element->value;
-    element->value = nullptr;
+    element->value.reset();
   }
   session_map_->Clear();
 }
@@ -225,13 +227,18 @@ void SessionHandler::UpdateSessions(const config::Config &config,
   for (SessionElement *element =
            const_cast<SessionElement *>(session_map_->Head());
        element != nullptr; element = element->next) {
-    if (element->value != nullptr) {
-      element->value->SetConfig(new_config.get());
-      element->value->SetKeyMapManager(
+    if (element->value == nullptr) {
+      continue;
+    }
+    absl::MutexLock session_lock(&element->value->mutex);
+    session::SessionInterface *session = element->value->session.get();
+    if (session != nullptr) {
+      session->SetConfig(new_config.get());
+      session->SetKeyMapManager(
           (new_key_map_manager ? new_key_map_manager : key_map_manager_).get());
-      element->value->SetRequest(new_request.get());
+      session->SetRequest(new_request.get());
       if (table != nullptr) {
-        element->value->SetTable(table);
+        session->SetTable(table);
       }
     }
   }
@@ -246,8 +253,22 @@ void SessionHandler::UpdateSessions(const config::Config &config,
   request_ = std::move(new_request);
 }
 
+void SessionHandler::InitSession(session::SessionInterface *session) {
+  session->SetConfig(config_.get());
+  session->SetKeyMapManager(key_map_manager_.get());
+  session->SetRequest(request_.get());
+  const auto *data_manager = engine_->GetDataManager();
+  if (data_manager != nullptr) {
+    session->SetTable(
+        table_manager_->GetTable(*request_, *config_, *data_manager));
+  }
+  config::CharacterFormManager::GetCharacterFormManager()->ReloadConfig(
+      *config_);
+}
+
 bool SessionHandler::SyncData(commands::Command *command) {
   MOZC_VLOG(1) << "Syncing user data";
+  absl::MutexLock engine_lock(&engine_mutex_);
   engine_->GetUserDataManager()->Sync();
   engine_->GetUserDataManager()->Wait();
   return true;
@@ -263,35 +284,52 @@ bool SessionHandler::Shutdown(commands::Command *command) {
 
 bool SessionHandler::Reload(commands::Command *command) {
   MOZC_VLOG(1) << "Reloading server";
-  UpdateSessions(*config::ConfigHandler::GetConfig(), *request_);
+  {
+    absl::MutexLock lock(&mutex_);
+    UpdateSessions(*config::ConfigHandler::GetConfig(), *request_);
+  }
+  absl::MutexLock engine_lock(&engine_mutex_);
   engine_->Reload();
   return true;
 }
 
 bool SessionHandler::ReloadAndWait(commands::Command *command) {
   MOZC_VLOG(1) << "Reloading server and wait for reloader";
-  UpdateSessions(*config::ConfigHandler::GetConfig(), *request_);
+  {
+    absl::MutexLock lock(&mutex_);
+    UpdateSessions(*config::ConfigHandler::GetConfig(), *request_);
+  }
+  absl::MutexLock engine_lock(&engine_mutex_);
   engine_->ReloadAndWait();
   return true;
 }
 
 bool SessionHandler::ClearUserHistory(commands::Command *command) {
   MOZC_VLOG(1) << "Clearing user history";
-  engine_->GetUserDataManager()->ClearUserHistory();
+  {
+    absl::MutexLock engine_lock(&engine_mutex_);
+    engine_->GetUserDataManager()->ClearUserHistory();
+  }
   UsageStats::IncrementCount("ClearUserHistory");
   return true;
 }
 
 bool SessionHandler::ClearUserPrediction(commands::Command *command) {
   MOZC_VLOG(1) << "Clearing user prediction";
-  engine_->GetUserDataManager()->ClearUserPrediction();
+  {
+    absl::MutexLock engine_lock(&engine_mutex_);
+    engine_->GetUserDataManager()->ClearUserPrediction();
+  }
   UsageStats::IncrementCount("ClearUserPrediction");
   return true;
 }
 
 bool SessionHandler::ClearUnusedUserPrediction(commands::Command *command) {
   MOZC_VLOG(1) << "Clearing unused user prediction";
-  engine_->GetUserDataManager()->ClearUnusedUserPrediction();
+  {
+    absl::MutexLock engine_lock(&engine_mutex_);
+    engine_->GetUserDataManager()->ClearUnusedUserPrediction();
+  }
   UsageStats::IncrementCount("ClearUnusedUserPrediction");
   return true;
 }
@@ -301,6 +339,7 @@ bool SessionHandler::GetConfig(commands::Command *command) {
   config::ConfigHandler::GetConfig(command->mutable_output()->mutable_config());
   // Ensure the onmemory config is same as the locally stored one
   // because the local data could be changed by sync.
+  absl::MutexLock lock(&mutex_);
   UpdateSessions(command->output().config(), *request_);
   return true;
 }
@@ -325,6 +364,7 @@ bool SessionHandler::SetRequest(commands::Command *command) {
     LOG(WARNING) << "request is empty";
     return false;
   }
+  absl::MutexLock lock(&mutex_);
   UpdateSessions(*config_, command->input().request());
   return true;
 }
@@ -403,6 +443,9 @@ bool SessionHandler::EvalCommand(commands::Command *command) {
     case commands::Input::RELOAD_SPELL_CHECKER:
       eval_succeeded = ReloadSpellChecker(command);
       break;
+    case commands::Input::GET_REWRITER_PROFILE:
+      eval_succeeded = GetRewriterProfile(command);
+      break;
     default:
       eval_succeeded = false;
   }
@@ -422,6 +465,7 @@ bool SessionHandler::EvalCommand(commands::Command *command) {
 
   if (eval_succeeded) {
     // TODO(komatsu): Make sre if checking eval_succeeded is necessary or not.
+    absl::MutexLock observer_lock(&observer_mutex_);
     observer_handler_->EvalCommandHandler(*command);
   }
 
@@ -439,6 +483,7 @@ session::SessionInterface *SessionHandler::NewSession() {
 }
 
 void SessionHandler::AddObserver(session::SessionObserverInterface *observer) {
+  absl::MutexLock observer_lock(&observer_mutex_);
   observer_handler_->AddObserver(observer);
 }
 
@@ -451,43 +496,76 @@ void SessionHandler::MaybeUpdateConfig(commands::Command *command) {
   Reload(command);
 }
 
+std::shared_ptr<SessionHandler::SessionEntry> SessionHandler::LookupSession(
+    SessionID id) {
+  absl::MutexLock lock(&mutex_);
+  std::shared_ptr<SessionEntry> *entry = session_map_->MutableLookup(id);
+  if (entry == nullptr) {
+    return nullptr;
+  }
+  return *entry;
+}
+
 bool SessionHandler::SendKey(commands::Command *command) {
   const SessionID id = command->input().id();
-  session::SessionInterface **session = session_map_->MutableLookup(id);
-  if (session == nullptr || *session == nullptr) {
+  const std::shared_ptr<SessionEntry> entry = LookupSession(id);
+  if (entry == nullptr) {
     LOG(WARNING) << "SessionID " << id << " is not available";
     return false;
   }
-  (*session)->SendKey(command);
+  {
+    absl::MutexLock session_lock(&entry->mutex);
+    if (entry->session == nullptr) {
+      LOG(WARNING) << "SessionID " << id << " is deleted";
+      return false;
+    }
+    absl::MutexLock engine_lock(&engine_mutex_);
+    entry->session->SendKey(command);
+  }
   MaybeUpdateConfig(command);
   return true;
 }
 
 bool SessionHandler::TestSendKey(commands::Command *command) {
   const SessionID id = command->input().id();
-  session::SessionInterface **session = session_map_->MutableLookup(id);
-  if (session == nullptr || *session == nullptr) {
+  const std::shared_ptr<SessionEntry> entry = LookupSession(id);
+  if (entry == nullptr) {
     LOG(WARNING) << "SessionID " << id << " is not available";
     return false;
   }
-  (*session)->TestSendKey(command);
+  absl::MutexLock session_lock(&entry->mutex);
+  if (entry->session == nullptr) {
+    LOG(WARNING) << "SessionID " << id << " is deleted";
+    return false;
+  }
+  absl::MutexLock engine_lock(&engine_mutex_);
+  entry->session->TestSendKey(command);
   return true;
 }
 
 bool SessionHandler::SendCommand(commands::Command *command) {
   const SessionID id = command->input().id();
-  session::SessionInterface **session =
-      const_cast<session::SessionInterface **>(session_map_->Lookup(id));
-  if (session == nullptr || *session == nullptr) {
+  const std::shared_ptr<SessionEntry> entry = LookupSession(id);
+  if (entry == nullptr) {
     LOG(WARNING) << "SessionID " << id << " is not available";
     return false;
   }
-  (*session)->SendCommand(command);
+  {
+    absl::MutexLock session_lock(&entry->mutex);
+    if (entry->session == nullptr) {
+      LOG(WARNING) << "SessionID " << id << " is deleted";
+      return false;
+    }
+    absl::MutexLock engine_lock(&engine_mutex_);
+    entry->session->SendCommand(command);
+  }
   MaybeUpdateConfig(command);
   return true;
 }
 
 bool SessionHandler::CreateSession(commands::Command *command) {
+  absl::MutexLock lock(&mutex_);
+
   // prevent DOS attack
   // don't allow CreateSession in very short period.
   const absl::Duration create_session_minimum_interval = std::max(
@@ -515,10 +593,9 @@ bool SessionHandler::CreateSession(commands::Command *command) {
       LOG(ERROR) << "oldest SessionElement is NULL";
       return false;
     }
-    delete oldest_element->value;
-    oldest_element->value = nullptr;
-    session_map_->Erase(oldest_element->key);
-    MOZC_VLOG(1) << "Session is FULL, oldest SessionID " << oldest_element->key
+    const SessionID oldest_id = oldest_element->key;
+    DeleteSessionID(oldest_id);
+    MOZC_VLOG(1) << "Session is FULL, oldest SessionID " << oldest_id
                  << " is removed";
   }
 
@@ -543,6 +620,7 @@ bool SessionHandler::CreateSession(commands::Command *command) {
         engine_response.response;
     if (engine_response.engine && engine_response.response.status() ==
                                       EngineReloadResponse::RELOAD_READY) {
+      absl::MutexLock engine_lock(&engine_mutex_);
       if (engine_ && engine_->GetUserDataManager()) {
         engine_->GetUserDataManager()->Wait();
       }
@@ -565,20 +643,12 @@ bool SessionHandler::CreateSession(commands::Command *command) {
     }
   }
 
-  session::SessionInterface *session = NewSession();
+  std::unique_ptr<session::SessionInterface> session(NewSession());
   if (session == nullptr) {
     LOG(ERROR) << "Cannot allocate new Session";
     return false;
   }
 
-  const SessionID new_id = CreateNewSessionID();
-  SessionElement *element = session_map_->Insert(new_id);
-  element->value = session;
-  command->mutable_output()->set_id(new_id);
-
-  // The oldes item should be reused
-  DCHECK(oldest_element == nullptr || oldest_element == element);
-
   if (command->input().has_capability()) {
     session->set_client_capability(command->input().capability());
   }
@@ -588,10 +658,22 @@ bool SessionHandler::CreateSession(commands::Command *command) {
   }
 
   // The created session has not been fully initialized yet.
-  // SetConfig() will complete the initialization by setting information
-  // (e.g., config, request, keymap, ...) to all the sessions,
-  // including the newly created one.
-  UpdateSessions(*config::ConfigHandler::GetConfig(), *request_);
+  // InitSession() completes the initialization by setting the current
+  // information (e.g., config, request, keymap, ...), which SetConfig(),
+  // SetRequest() and Reload() keep up to date for all the sessions.
+  InitSession(session.get());
+
+  const SessionID new_id = CreateNewSessionID();
+  SessionElement *element = session_map_->Insert(new_id);
+  element->value = std::make_shared<SessionEntry>();
+  {
+    absl::MutexLock session_lock(&element->value->mutex);
+    element->value->session = std::move(session);
+  }
+  command->mutable_output()->set_id(new_id);
+
+  // The oldes item should be reused
+  DCHECK(oldest_element == nullptr || oldest_element == element);
 
   // session is not empty.
   last_session_empty_time_ = absl::InfinitePast();
@@ -602,7 +684,11 @@ bool SessionHandler::CreateSession(commands::Command *command) {
 }
 
 bool SessionHandler::DeleteSession(commands::Command *command) {
-  DeleteSessionID(command->input().id());
+  {
+    absl::MutexLock lock(&mutex_);
+    DeleteSessionID(command->input().id());
+  }
+  absl::MutexLock engine_lock(&engine_mutex_);
   if (engine_->GetUserDataManager()) {
     engine_->GetUserDataManager()->Sync();
   }
@@ -618,6 +704,7 @@ bool SessionHandler::DeleteSession(commands::Command *command) {
 // request to the server for FLAGS_timeout sec.
 bool SessionHandler::Cleanup(commands::Command *command) {
   const absl::Time current_time = Clock::GetAbslTime();
+  absl::ReleasableMutexLock lock(&mutex_);
 
   // suspend/hibernation may happen
   absl::Duration suspend_time = absl::ZeroDuration();
@@ -651,7 +738,11 @@ bool SessionHandler::Cleanup(commands::Command *command) {
   for (SessionElement *element =
            const_cast<SessionElement *>(session_map_->Head());
        element != nullptr; element = element->next) {
-    session::SessionInterface *session = element->value;
+    absl::MutexLock session_lock(&element->value->mutex);
+    const session::SessionInterface *session = element->value->session.get();
+    if (session == nullptr) {
+      continue;
+    }
     if (!IsApplicationAlive(session)) {
       MOZC_VLOG(2) << "Application is not alive. Removing: " << element->key;
       remove_ids.push_back(element->key);
@@ -674,17 +765,24 @@ bool SessionHandler::Cleanup(commands::Command *command) {
     MOZC_VLOG(1) << "Session ID " << remove_ids[i] << " is removed by server";
   }
 
-  // Sync all data. This is a regression bug fix http://b/3033708
-  engine_->GetUserDataManager()->Sync();
-
   // timeout is enabled.
-  if (absl::GetFlag(FLAGS_timeout) > 0 &&
+  const bool shutdown =
+      absl::GetFlag(FLAGS_timeout) > 0 &&
       (current_time - last_session_empty_time_) >=
-          suspend_time + absl::Seconds(absl::GetFlag(FLAGS_timeout))) {
-    Shutdown(command);
-  }
+          suspend_time + absl::Seconds(absl::GetFlag(FLAGS_timeout));
 
   last_cleanup_time_ = current_time;
+  lock.Release();
+
+  {
+    // Sync all data. This is a regression bug fix http://b/3033708
+    absl::MutexLock engine_lock(&engine_mutex_);
+    engine_->GetUserDataManager()->Sync();
+  }
+
+  if (shutdown) {
+    Shutdown(command);
+  }
 
   return true;
 }
@@ -694,6 +792,8 @@ bool SessionHandler::SendUserDictionaryCommand(commands::Command *command) {
     return false;
   }
   user_dictionary::UserDictionaryCommandStatus status;
+  // Importing a large user dictionary shouldn't block the conversions.
+  absl::MutexLock lock(&user_dictionary_mutex_);
   const bool result = user_dictionary_session_handler_->Evaluate(
       command->input().user_dictionary_command(), &status);
   if (result) {
@@ -729,6 +829,13 @@ bool SessionHandler::ReloadSpellChecker(commands::Command *command) {
   return true;
 }
 
+bool SessionHandler::GetRewriterProfile(commands::Command *command) {
+  RewriterProfiler::Get()->Execute(
+      command->input().rewriter_profile_request(),
+      command->mutable_output()->mutable_rewriter_profile());
+  return true;
+}
+
 // Create Random Session ID in order to make the session id unpredicable
 SessionID SessionHandler::CreateNewSessionID() {
   while (true) {
@@ -745,12 +852,18 @@ SessionID SessionHandler::CreateNewSessionID() {
 }
 
 bool SessionHandler::DeleteSessionID(SessionID id) {
-  session::SessionInterface **session = session_map_->MutableLookup(id);
-  if (session == nullptr || *session == nullptr) {
+  std::shared_ptr<SessionEntry> *entry = session_map_->MutableLookup(id);
+  if (entry == nullptr || *entry == nullptr) {
     LOG_IF(WARNING, id != 0) << "cannot find SessionID " << id;
     return false;
   }
-  delete *session;
+  {
+    // Waits for the command in flight, if any, so that no session outlives
+    // its entry in the table and refers to a replaced engine.
+    absl::MutexLock session_lock(&(*entry)->mutex);
+    (*entry)->session.reset();
+  }
+  entry->reset();
 
   session_map_->Erase(id);  // remove from LRU
 
@@ -37,8 +37,10 @@
 #include <memory>
 #include <optional>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/random/random.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "composer/table.h"
 #include "dictionary/user_dictionary_session_handler.h"
@@ -61,6 +63,16 @@
 
 namespace mozc {
 
+// EvalCommand() is thread-safe.  The commands to a session are serialized by
+// the lock of the session, and the handler-wide |mutex_| is held only around
+// the operations on the session table, the config and the engine reload.  As
+// the engine isn't thread-safe, the commands using it (key events, session
+// commands and syncing, reloading or clearing the user data) still take turns
+// on |engine_mutex_|.  SEND_USER_DICTIONARY_COMMAND and creating sessions don't
+// wait for the conversions, unless the session to evict is converting.
+//
+// The locks are taken in the order of |mutex_|, the lock of a session and
+// |engine_mutex_|.
 class SessionHandler : public SessionHandlerInterface {
  public:
   explicit SessionHandler(std::unique_ptr<EngineInterface> engine);
@@ -94,8 +106,16 @@ class SessionHandler : public SessionHandlerInterface {
   FRIEND_TEST(SessionHandlerTest, EngineUpdateSuccessfulScenarioTest);
   FRIEND_TEST(SessionHandlerTest, EngineRollbackDataTest);
 
+  // A session and the lock serializing the commands to it.  The commands in
+  // flight share the entry with the session table, and find |session| reset
+  // if the session is deleted in the meantime.
+  struct SessionEntry {
+    absl::Mutex mutex;
+    std::unique_ptr<session::SessionInterface> session ABSL_GUARDED_BY(mutex);
+  };
+
   using SessionMap =
-      mozc::storage::LruCache<SessionID, session::SessionInterface *>;
+      mozc::storage::LruCache<SessionID, std::shared_ptr<SessionEntry>>;
   using SessionElement = SessionMap::Element;
 
   void Init(std::unique_ptr<EngineInterface> engine,
@@ -129,7 +149,11 @@ class SessionHandler : public SessionHandlerInterface {
   // Then updates config_ and request_.
   // This method doesn't reload the sessions.
   void UpdateSessions(const config::Config &config,
-                      const commands::Request &request);
+                      const commands::Request &request)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Sets the current config, request, key map and table to a new |session|.
+  void InitSession(session::SessionInterface *session)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   bool Cleanup(commands::Command *command);
   bool SendUserDictionaryCommand(commands::Command *command);
@@ -137,15 +161,30 @@ class SessionHandler : public SessionHandlerInterface {
   bool NoOperation(commands::Command *command);
   bool CheckSpelling(commands::Command *command);
   bool ReloadSpellChecker(commands::Command *command);
-
-  SessionID CreateNewSessionID();
-  bool DeleteSessionID(SessionID id);
+  bool GetRewriterProfile(commands::Command *command);
+
+  SessionID CreateNewSessionID() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool DeleteSessionID(SessionID id) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Returns the entry of the session |id|, or nullptr if it doesn't exist.
+  std::shared_ptr<SessionEntry> LookupSession(SessionID id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Guards the session table, the config, request and key map, the timestamps
+  // and the engine reload.  |engine_| is replaced with both |mutex_| and
+  // |engine_mutex_| held, so either of them is enough to read it.
+  absl::Mutex mutex_;
+  // Serializes the uses of the engine, which isn't thread-safe.
+  absl::Mutex engine_mutex_ ABSL_ACQUIRED_AFTER(mutex_);
+  // Guards |user_dictionary_session_handler_|.
+  absl::Mutex user_dictionary_mutex_;
+  // Guards the observers, which aren't thread-safe either.
+  absl::Mutex observer_mutex_;
 
   std::unique_ptr<SessionMap> session_map_;
 #ifndef MOZC_DISABLE_SESSION_WATCHDOG
   std::optional<SessionWatchDog> session_watch_dog_;
 #endif  // MOZC_DISABLE_SESSION_WATCHDOG
-  bool is_available_ = false;
+  std::atomic<bool> is_available_ = false;
   uint32_t max_session_size_ = 0;
   std::atomic<uint64_t> latest_engine_id_ = 0;
   std::atomic<uint64_t> current_engine_id_ = 0;
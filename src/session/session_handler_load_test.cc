@@ -0,0 +1,157 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Drives many sessions on a SessionHandler concurrently, as the IPC server
+// does with worker threads.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "base/logging.h"
+#include "base/thread.h"
+#include "engine/engine_interface.h"
+#include "engine/mock_data_engine_factory.h"
+#include "engine/user_data_manager_interface.h"
+#include "protocol/commands.pb.h"
+#include "protocol/user_dictionary_storage.pb.h"
+#include "session/random_keyevents_generator.h"
+#include "session/session_handler.h"
+#include "session/session_handler_tool.h"
+#include "testing/gunit.h"
+#include "testing/mozctest.h"
+
+ABSL_FLAG(int32_t, num_load_threads, 8, "The number of concurrent sessions.");
+ABSL_FLAG(int32_t, num_load_events, 300,
+          "The number of key events sent by each session.");
+
+namespace mozc::session {
+namespace {
+
+using ::mozc::user_dictionary::UserDictionaryCommand;
+using ::mozc::user_dictionary::UserDictionaryCommandStatus;
+
+class SessionHandlerLoadTest : public ::mozc::testing::TestWithTempUserProfile {
+ protected:
+  SessionHandlerLoadTest() {
+    std::unique_ptr<EngineInterface> engine =
+        MockDataEngineFactory::Create().value();
+    data_manager_ = engine->GetUserDataManager();
+    handler_ = std::make_unique<SessionHandler>(std::move(engine));
+  }
+
+  // Opens and closes a user dictionary session, which doesn't wait for the
+  // conversions.
+  bool SendUserDictionaryCommands() {
+    commands::Command command;
+    command.mutable_input()->set_type(
+        commands::Input::SEND_USER_DICTIONARY_COMMAND);
+    command.mutable_input()->mutable_user_dictionary_command()->set_type(
+        UserDictionaryCommand::CREATE_SESSION);
+    if (!handler_->EvalCommand(&command) ||
+        command.output().user_dictionary_command_status().status() !=
+            UserDictionaryCommandStatus::USER_DICTIONARY_COMMAND_SUCCESS) {
+      return false;
+    }
+    const uint64_t session_id =
+        command.output().user_dictionary_command_status().session_id();
+
+    command.Clear();
+    command.mutable_input()->set_type(
+        commands::Input::SEND_USER_DICTIONARY_COMMAND);
+    UserDictionaryCommand *dictionary_command =
+        command.mutable_input()->mutable_user_dictionary_command();
+    dictionary_command->set_type(UserDictionaryCommand::DELETE_SESSION);
+    dictionary_command->set_session_id(session_id);
+    return handler_->EvalCommand(&command) &&
+           command.output().user_dictionary_command_status().status() ==
+               UserDictionaryCommandStatus::USER_DICTIONARY_COMMAND_SUCCESS;
+  }
+
+  UserDataManagerInterface *data_manager_;
+  std::unique_ptr<SessionHandler> handler_;
+};
+
+TEST_F(SessionHandlerLoadTest, ConcurrentSessions) {
+  const int num_threads = absl::GetFlag(FLAGS_num_load_threads);
+  const size_t num_events = absl::GetFlag(FLAGS_num_load_events);
+
+  const absl::Time start = absl::Now();
+  std::vector<Thread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back([this, i, num_events] {
+      SessionHandlerTool client(handler_.get(), data_manager_);
+      RandomKeyEventsGenerator generator(
+          std::seed_seq{static_cast<uint32_t>(i)});
+      ASSERT_TRUE(client.CreateSession());
+      std::vector<commands::KeyEvent> keys;
+      commands::Output output;
+      size_t sent = 0;
+      while (sent < num_events) {
+        keys.clear();
+        generator.GenerateSequence(&keys);
+        for (const commands::KeyEvent &key : keys) {
+          ++sent;
+          EXPECT_TRUE(client.TestSendKey(key, &output));
+          EXPECT_TRUE(client.SendKey(key, &output));
+        }
+        if (i % 2 == 0) {
+          EXPECT_TRUE(SendUserDictionaryCommands());
+        }
+      }
+      EXPECT_TRUE(client.DeleteSession());
+    });
+  }
+  for (Thread &thread : threads) {
+    thread.Join();
+  }
+  const absl::Duration elapsed = absl::Now() - start;
+  LOG(INFO) << num_threads << " sessions x " << num_events << " events: "
+            << elapsed << " ("
+            << num_threads * num_events / absl::ToDoubleSeconds(elapsed)
+            << " events/s)";
+
+  // The handler is still consistent.
+  SessionHandlerTool client(handler_.get(), data_manager_);
+  ASSERT_TRUE(client.CreateSession());
+  commands::KeyEvent key;
+  key.set_key_code('a');
+  commands::Output output;
+  EXPECT_TRUE(client.SendKey(key, &output));
+  EXPECT_TRUE(output.consumed());
+  EXPECT_TRUE(client.DeleteSession());
+}
+
+}  // namespace
+}  // namespace mozc::session
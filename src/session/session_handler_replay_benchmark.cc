@@ -0,0 +1,334 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Replays recorded typing logs through the full SessionHandler::EvalCommand
+// stack, and reports the latency of each command type.
+//
+// Usage:
+// session_handler_replay_benchmark --input log0.tsv,log1.tsv --engine desktop
+//                                  --iterations 3 --output result.tsv
+//
+// The logs are in the format of session_handler_main (see
+// session_handler_main_sample.tsv).  SHOW* commands are ignored.
+//
+// Each command sent to the handler is classified by its output:
+//   Commit:      SEND_KEY or SEND_COMMAND that committed a result.
+//   Convert:     SEND_KEY or SEND_COMMAND that showed conversion candidates.
+//   Predict:     SEND_KEY or SEND_COMMAND that showed prediction or
+//                suggestion candidates.
+//   SendKey:     other SEND_KEY.
+//   SendCommand: other SEND_COMMAND.
+//   Other:       other input types, e.g. SET_CONFIG.
+//
+// The output has a "<metric>\t<value>" line per metric, so that the results of
+// two builds can be compared with diff or a spreadsheet:
+//   command.<type>.count, .total_us, .mean_us, .p50_us, .p90_us, .p99_us,
+//   .max_us, .allocs_per_command, .alloc_bytes_per_command
+//   command.<type>.histogram.<i>: number of commands that took less than 1 us
+//     for i = 0, and [2^(i-1), 2^i) us for i > 0.  The last bucket also counts
+//     longer commands.
+//   rss.start_kb, rss.end_kb, rss.growth_kb, rss.iteration.<i>_kb
+//   replay.iterations, replay.commands, replay.errors, replay.wall_ms
+
+#ifdef __linux__
+#include <unistd.h>
+#endif  // __linux__
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "base/file_stream.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/stopwatch.h"
+#include "base/system_util.h"
+#include "data_manager/oss/oss_data_manager.h"
+#include "engine/engine.h"
+#include "engine/engine_interface.h"
+#include "engine/user_data_manager_interface.h"
+#include "protocol/candidates.pb.h"
+#include "protocol/commands.pb.h"
+#include "session/session_handler.h"
+#include "session/session_handler_interface.h"
+#include "session/session_handler_tool.h"
+#include "session/session_observer_interface.h"
+#include "session/session_usage_observer.h"
+#include "testing/allocation_counter.h"
+
+ABSL_FLAG(std::string, input, "", "Comma separated typing logs to replay");
+ABSL_FLAG(std::string, output, "", "Output file. stdout if empty");
+ABSL_FLAG(std::string, profile, "", "User profile directory");
+ABSL_FLAG(std::string, engine, "desktop",
+          "Conversion engine: 'mobile' or 'desktop'");
+ABSL_FLAG(int32_t, iterations, 1, "Number of times to replay the logs");
+
+namespace mozc {
+namespace session {
+namespace {
+
+constexpr size_t kHistogramSize = 16;
+
+struct CommandStats {
+  std::vector<int64_t> latencies_us;
+  uint64_t allocs = 0;
+  uint64_t alloc_bytes = 0;
+};
+
+absl::string_view GetCommandType(const commands::Command &command) {
+  const commands::Input::CommandType type = command.input().type();
+  if (type != commands::Input::SEND_KEY &&
+      type != commands::Input::SEND_COMMAND) {
+    return "Other";
+  }
+  const commands::Output &output = command.output();
+  if (output.has_result()) {
+    return "Commit";
+  }
+  if (output.has_candidates()) {
+    return output.candidates().category() == commands::CONVERSION ? "Convert"
+                                                                  : "Predict";
+  }
+  return type == commands::Input::SEND_KEY ? "SendKey" : "SendCommand";
+}
+
+// Forwards the commands to SessionHandler, measuring each of them.
+class MeasuringSessionHandler : public SessionHandlerInterface {
+ public:
+  explicit MeasuringSessionHandler(std::unique_ptr<EngineInterface> engine)
+      : handler_(std::move(engine)) {}
+
+  bool IsAvailable() const override { return handler_.IsAvailable(); }
+
+  bool EvalCommand(commands::Command *command) override {
+    const testing::AllocationCounter counter;
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    const bool result = handler_.EvalCommand(command);
+    const absl::Duration elapsed = stopwatch.GetElapsed();
+    const int64_t allocs = counter.allocations();
+    const int64_t alloc_bytes = counter.allocated_bytes();
+
+    CommandStats &stats = stats_[std::string(GetCommandType(*command))];
+    stats.latencies_us.push_back(absl::ToInt64Microseconds(elapsed));
+    stats.allocs += allocs;
+    stats.alloc_bytes += alloc_bytes;
+    return result;
+  }
+
+  void StartWatchDog() override { handler_.StartWatchDog(); }
+
+  void AddObserver(SessionObserverInterface *observer) override {
+    handler_.AddObserver(observer);
+  }
+
+  absl::string_view GetDataVersion() const override {
+    return handler_.GetDataVersion();
+  }
+
+  void ClearStats() { stats_.clear(); }
+  const std::map<std::string, CommandStats> &stats() const {
+    return stats_;
+  }
+
+ private:
+  SessionHandler handler_;
+  std::map<std::string, CommandStats> stats_;
+};
+
+// Returns the current resident set size in KiB, or 0 if it's not available.
+int64_t GetRssKb() {
+#ifdef __linux__
+  std::ifstream statm("/proc/self/statm");
+  int64_t size = 0, resident = 0;
+  if (!(statm >> size >> resident)) {
+    return 0;
+  }
+  return resident * sysconf(_SC_PAGESIZE) / 1024;
+#else   // __linux__
+  return 0;
+#endif  // __linux__
+}
+
+size_t GetBucket(int64_t us) {
+  size_t bucket = 0;
+  while (us > 0 && bucket + 1 < kHistogramSize) {
+    us >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+void PrintCommandStats(absl::string_view type, CommandStats stats,
+                       std::ostream *os) {
+  std::vector<int64_t> &latencies = stats.latencies_us;
+  if (latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  int64_t total = 0;
+  std::array<uint64_t, kHistogramSize> histogram = {};
+  for (const int64_t latency : latencies) {
+    total += latency;
+    ++histogram[GetBucket(latency)];
+  }
+  // Nearest-rank percentile.
+  const auto percentile = [&latencies](int p) {
+    const size_t rank = (latencies.size() * p + 99) / 100;
+    return latencies[std::max<size_t>(rank, 1) - 1];
+  };
+  const size_t count = latencies.size();
+  const std::string prefix = absl::StrCat("command.", type, ".");
+  (*os) << prefix << "count\t" << count << "\n"
+        << prefix << "total_us\t" << total << "\n"
+        << prefix << "mean_us\t" << total / static_cast<int64_t>(count) << "\n"
+        << prefix << "p50_us\t" << percentile(50) << "\n"
+        << prefix << "p90_us\t" << percentile(90) << "\n"
+        << prefix << "p99_us\t" << percentile(99) << "\n"
+        << prefix << "max_us\t" << percentile(100) << "\n"
+        << prefix << "allocs_per_command\t" << stats.allocs / count << "\n"
+        << prefix << "alloc_bytes_per_command\t" << stats.alloc_bytes / count
+        << "\n";
+  for (size_t i = 0; i < kHistogramSize; ++i) {
+    (*os) << prefix << "histogram." << i << "\t" << histogram[i] << "\n";
+  }
+}
+
+std::vector<std::string> ReadLogs(absl::string_view inputs) {
+  std::vector<std::string> lines;
+  for (absl::string_view input :
+       absl::StrSplit(inputs, ',', absl::SkipWhitespace())) {
+    InputFileStream ifs{std::string(input)};
+    CHECK(ifs) << "Cannot open " << input;
+    std::string line;
+    while (std::getline(ifs, line)) {
+      lines.push_back(std::move(line));
+    }
+  }
+  return lines;
+}
+
+std::unique_ptr<EngineInterface> CreateEngine(absl::string_view engine) {
+  auto data_manager = std::make_unique<const oss::OssDataManager>();
+  if (engine == "mobile") {
+    return Engine::CreateMobileEngine(std::move(data_manager)).value();
+  }
+  CHECK_EQ(engine, "desktop") << "Unknown engine name";
+  return Engine::CreateDesktopEngine(std::move(data_manager)).value();
+}
+
+int Run() {
+  const std::vector<std::string> lines = ReadLogs(absl::GetFlag(FLAGS_input));
+  std::unique_ptr<EngineInterface> engine =
+      CreateEngine(absl::GetFlag(FLAGS_engine));
+  UserDataManagerInterface *data_manager = engine->GetUserDataManager();
+  MeasuringSessionHandler handler(std::move(engine));
+  SessionUsageObserver usage_observer;
+  handler.AddObserver(&usage_observer);
+
+  const int32_t iterations = std::max(absl::GetFlag(FLAGS_iterations), 1);
+  std::vector<int64_t> iteration_rss_kb;
+  int64_t start_rss_kb = 0;
+  uint64_t num_commands = 0, num_errors = 0;
+  absl::Duration wall_time;
+  {
+    SessionHandlerInterpreter interpreter(&handler, data_manager);
+    // Excludes the session setup.
+    handler.ClearStats();
+    start_rss_kb = GetRssKb();
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    for (int32_t i = 0; i < iterations; ++i) {
+      for (const std::string &line : lines) {
+        const std::vector<std::string> args = interpreter.Parse(line);
+        if (args.empty() || absl::StartsWith(args[0], "SHOW")) {
+          continue;
+        }
+        ++num_commands;
+        if (const absl::Status status = interpreter.Eval(args); !status.ok()) {
+          ++num_errors;
+          LOG(WARNING) << line << ": " << status;
+        }
+      }
+      iteration_rss_kb.push_back(GetRssKb());
+    }
+    wall_time = stopwatch.GetElapsed();
+  }
+
+  OutputFileStream ofs;
+  std::ostream *os = &std::cout;
+  if (!absl::GetFlag(FLAGS_output).empty()) {
+    ofs.open(absl::GetFlag(FLAGS_output));
+    CHECK(ofs) << "Cannot open " << absl::GetFlag(FLAGS_output);
+    os = &ofs;
+  }
+  for (const auto &[type, stats] : handler.stats()) {
+    PrintCommandStats(type, stats, os);
+  }
+  const int64_t end_rss_kb = iteration_rss_kb.back();
+  (*os) << "rss.start_kb\t" << start_rss_kb << "\n"
+        << "rss.end_kb\t" << end_rss_kb << "\n"
+        << "rss.growth_kb\t" << end_rss_kb - start_rss_kb << "\n";
+  for (size_t i = 0; i < iteration_rss_kb.size(); ++i) {
+    (*os) << "rss.iteration." << i << "_kb\t" << iteration_rss_kb[i] << "\n";
+  }
+  (*os) << "replay.iterations\t" << iterations << "\n"
+        << "replay.commands\t" << num_commands << "\n"
+        << "replay.errors\t" << num_errors << "\n"
+        << "replay.wall_ms\t" << absl::ToInt64Milliseconds(wall_time) << "\n";
+  os->flush();
+  return num_errors == 0 ? 0 : 1;
+}
+
+}  // namespace
+}  // namespace session
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  if (!absl::GetFlag(FLAGS_profile).empty()) {
+    mozc::SystemUtil::SetUserProfileDirectory(absl::GetFlag(FLAGS_profile));
+  }
+  return mozc::session::Run();
+}
@@ -59,6 +59,7 @@
 #include "engine/user_data_manager_mock.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
+#include "rewriter/rewriter_profiler.h"
 #include "session/internal/keymap.h"
 #include "session/session_handler_interface.h"
 #include "session/session_handler_test_util.h"
@@ -411,6 +412,54 @@ TEST_F(SessionHandlerTest, ClearHistoryTest) {
   EXPECT_COUNT_STATS("SessionAllEvent", 4);
 }
 
+TEST_F(SessionHandlerTest, RewriterProfileTest) {
+  SessionHandler handler(CreateMockDataEngine());
+
+  auto send_profile_command =
+      [&handler](commands::RewriterProfileRequest::Action action) {
+        commands::Command command;
+        command.mutable_input()->set_type(
+            commands::Input::GET_REWRITER_PROFILE);
+        command.mutable_input()->mutable_rewriter_profile_request()->set_action(
+            action);
+        EXPECT_TRUE(handler.EvalCommand(&command));
+        return command.output().rewriter_profile();
+      };
+  send_profile_command(commands::RewriterProfileRequest::RESET);
+  EXPECT_TRUE(
+      send_profile_command(commands::RewriterProfileRequest::ENABLE).enabled());
+
+  uint64_t session_id = 0;
+  EXPECT_TRUE(CreateSession(&handler, &session_id));
+  for (const char key : {'k', 'a'}) {
+    commands::Command command;
+    command.mutable_input()->set_id(session_id);
+    command.mutable_input()->set_type(commands::Input::SEND_KEY);
+    command.mutable_input()->mutable_key()->set_key_code(key);
+    EXPECT_TRUE(handler.EvalCommand(&command));
+  }
+  EXPECT_TRUE(IsGoodSession(&handler, session_id));
+
+  const commands::RewriterProfile profile =
+      send_profile_command(commands::RewriterProfileRequest::DISABLE);
+  EXPECT_FALSE(profile.enabled());
+  uint64_t calls = 0;
+  for (const commands::RewriterProfile::Entry &entry : profile.entries()) {
+    EXPECT_FALSE(entry.name().empty());
+    EXPECT_EQ(entry.time_histogram_size(), RewriterProfiler::kHistogramSize);
+    calls += entry.calls();
+  }
+  EXPECT_GT(calls, 0);
+
+  const commands::RewriterProfile reset_profile =
+      send_profile_command(commands::RewriterProfileRequest::RESET);
+  EXPECT_EQ(reset_profile.entries_size(), profile.entries_size());
+  for (const commands::RewriterProfile::Entry &entry :
+       reset_profile.entries()) {
+    EXPECT_EQ(entry.calls(), 0);
+  }
+}
+
 TEST_F(SessionHandlerTest, ElapsedTimeTest) {
   SessionHandler handler(CreateMockDataEngine());
 
@@ -857,4 +906,41 @@ TEST_F(SessionHandlerTest, EngineReloadSessionExistsTest) {
   EXPECT_EQ(new_engine_ptr, &handler.engine());
 }
 
+TEST_F(SessionHandlerTest, ConcurrentSessionsTest) {
+  SessionHandler handler(CreateMockDataEngine());
+
+  constexpr int kNumThreads = 4;
+  std::vector<Thread> threads;
+  std::vector<int> succeeded(kNumThreads, 0);
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&handler, &succeeded, i]() {
+      uint64_t id = 0;
+      if (!CreateSession(&handler, &id)) {
+        return;
+      }
+      for (int j = 0; j < 10; ++j) {
+        commands::Command command;
+        commands::Input *input = command.mutable_input();
+        input->set_id(id);
+        input->set_type(commands::Input::SEND_KEY);
+        input->mutable_key()->set_key_code('a');
+        if (handler.EvalCommand(&command) &&
+            command.output().error_code() ==
+                commands::Output::SESSION_SUCCESS) {
+          ++succeeded[i];
+        }
+      }
+      if (DeleteSession(&handler, id)) {
+        ++succeeded[i];
+      }
+    });
+  }
+  for (Thread &thread : threads) {
+    thread.Join();
+  }
+  for (int i = 0; i < kNumThreads; ++i) {
+    EXPECT_EQ(succeeded[i], 11) << "thread " << i;
+  }
+}
+
 }  // namespace mozc
@@ -92,10 +92,15 @@ SessionHandlerTool::SessionHandlerTool(std::unique_ptr<EngineInterface> engine)
     : id_(0),
       usage_observer_(std::make_unique<SessionUsageObserver>()),
       data_manager_(engine->GetUserDataManager()),
-      handler_(std::make_unique<SessionHandler>(std::move(engine))) {
+      owned_handler_(std::make_unique<SessionHandler>(std::move(engine))),
+      handler_(owned_handler_.get()) {
   handler_->AddObserver(usage_observer_.get());
 }
 
+SessionHandlerTool::SessionHandlerTool(SessionHandlerInterface *handler,
+                                       UserDataManagerInterface *data_manager)
+    : id_(0), data_manager_(data_manager), handler_(handler) {}
+
 bool SessionHandlerTool::CreateSession() {
   Command command;
   command.mutable_input()->set_type(commands::Input::CREATE_SESSION);
@@ -271,8 +276,18 @@ SessionHandlerInterpreter::SessionHandlerInterpreter()
     : SessionHandlerInterpreter(EngineFactory::Create().value()) {}
 
 SessionHandlerInterpreter::SessionHandlerInterpreter(
-    std::unique_ptr<EngineInterface> engine) {
-  client_ = std::make_unique<SessionHandlerTool>(std::move(engine));
+    std::unique_ptr<EngineInterface> engine)
+    : SessionHandlerInterpreter(
+          std::make_unique<SessionHandlerTool>(std::move(engine))) {}
+
+SessionHandlerInterpreter::SessionHandlerInterpreter(
+    SessionHandlerInterface *handler, UserDataManagerInterface *data_manager)
+    : SessionHandlerInterpreter(
+          std::make_unique<SessionHandlerTool>(handler, data_manager)) {}
+
+SessionHandlerInterpreter::SessionHandlerInterpreter(
+    std::unique_ptr<SessionHandlerTool> client)
+    : client_(std::move(client)) {
   config_ = std::make_unique<Config>();
   last_output_ = std::make_unique<Output>();
   request_ = std::make_unique<Request>();
@@ -53,6 +53,10 @@ namespace session {
 class SessionHandlerTool {
  public:
   explicit SessionHandlerTool(std::unique_ptr<EngineInterface> engine);
+  // Drives a session on |handler| shared with other tools, e.g. one per thread
+  // in load tests.  |handler| and |data_manager| must outlive this object.
+  SessionHandlerTool(SessionHandlerInterface *handler,
+                     UserDataManagerInterface *data_manager);
   SessionHandlerTool(const SessionHandlerTool &) = delete;
   SessionHandlerTool &operator=(const SessionHandlerTool &) = delete;
 
@@ -95,7 +99,8 @@ class SessionHandlerTool {
   uint64_t id_;  // Session ID
   std::unique_ptr<SessionObserverInterface> usage_observer_;
   UserDataManagerInterface *data_manager_;
-  std::unique_ptr<SessionHandlerInterface> handler_;
+  std::unique_ptr<SessionHandlerInterface> owned_handler_;
+  SessionHandlerInterface *handler_;
   std::string callback_text_;
 };
 
@@ -103,6 +108,11 @@ class SessionHandlerInterpreter final {
  public:
   SessionHandlerInterpreter();
   explicit SessionHandlerInterpreter(std::unique_ptr<EngineInterface> engine);
+  // Evaluates the commands on |handler|, e.g. a wrapper of SessionHandler that
+  // measures the commands.  |handler| and |data_manager| must outlive this
+  // object.
+  SessionHandlerInterpreter(SessionHandlerInterface *handler,
+                            UserDataManagerInterface *data_manager);
   ~SessionHandlerInterpreter();
 
   void ClearState();
@@ -123,6 +133,8 @@ class SessionHandlerInterpreter final {
   void SetRequest(const commands::Request &request);
 
  private:
+  explicit SessionHandlerInterpreter(std::unique_ptr<SessionHandlerTool> client);
+
   std::unique_ptr<SessionHandlerTool> client_;
   std::unique_ptr<config::Config> config_;
   std::unique_ptr<commands::Output> last_output_;
@@ -33,9 +33,11 @@
 
 #include "session/session_server.h"
 
+#include <cstdint>
 #include <memory>
 #include <string>
 
+#include "absl/flags/flag.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "base/logging.h"
@@ -47,6 +49,10 @@
 #include "session/session_handler.h"
 #include "session/session_usage_observer.h"
 
+ABSL_FLAG(int32_t, ipc_worker_threads, 0,
+          "The number of threads to evaluate the commands on. 0 evaluates "
+          "them on the IPC thread. Ignored on Windows and macOS.");
+
 namespace {
 
 #ifdef _WIN32
@@ -74,6 +80,7 @@ SessionServer::SessionServer()
   // start session watch dog timer
   session_handler_->StartWatchDog();
   session_handler_->AddObserver(usage_observer_.get());
+  set_num_worker_threads(absl::GetFlag(FLAGS_ipc_worker_threads));
 
   // Send a notification event to the UI.
   NamedEventNotifier notifier(kEventName);
@@ -118,4 +125,12 @@ bool SessionServer::Process(absl::string_view request, std::string *response) {
 
   return true;
 }
+
+uint64_t SessionServer::GetRequestKey(absl::string_view request) const {
+  commands::Input input;
+  if (!input.ParseFromArray(request.data(), request.size())) {
+    return 0;
+  }
+  return input.id();
+}
 }  // namespace mozc
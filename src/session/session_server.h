@@ -32,6 +32,7 @@
 #ifndef MOZC_SESSION_SESSION_SERVER_H_
 #define MOZC_SESSION_SESSION_SERVER_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -62,6 +63,10 @@ class SessionServer : public IPCServer {
 
   bool Process(absl::string_view request, std::string *response) override;
 
+  // Returns the session ID so that the commands of a session are evaluated in
+  // order while the others are received and sent concurrently.
+  uint64_t GetRequestKey(absl::string_view request) const override;
+
  private:
   std::unique_ptr<session::SessionUsageObserver> usage_observer_;
   std::unique_ptr<SessionHandlerInterface> session_handler_;
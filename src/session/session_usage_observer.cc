@@ -100,6 +100,7 @@ bool IsSessionIndependentCommand(commands::Input::CommandType type) {
     case commands::Input::SYNC_DATA:
     case commands::Input::CHECK_SPELLING:
     case commands::Input::SET_REQUEST:
+    case commands::Input::GET_REWRITER_PROFILE:
       // LINT.ThenChange()
       return true;
     default:
@@ -35,6 +35,7 @@
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
 #include "base/encryptor.h"
 #include "base/file_stream.h"
 #include "base/file_util.h"
@@ -60,33 +61,36 @@ constexpr size_t kMaxFileSize = 64 * 1024 * 1024;
 bool EncryptedStringStorage::Load(std::string *output) const {
   DCHECK(output);
 
-  std::string salt;
-
   // Reads encrypted message and salt from local file
-  {
-    const absl::StatusOr<Mmap> mmap = Mmap::Map(filename_, Mmap::READ_ONLY);
-    if (!mmap.ok()) {
-      LOG(ERROR) << "cannot open user history file: " << mmap.status();
-      return false;
-    }
+  const absl::StatusOr<Mmap> mmap = Mmap::Map(filename_, Mmap::READ_ONLY);
+  if (!mmap.ok()) {
+    LOG(ERROR) << "cannot open user history file: " << mmap.status();
+    return false;
+  }
 
-    if (mmap->size() < kSaltSize) {
-      LOG(ERROR) << "file size is too small";
-      return false;
-    }
+  if (mmap->size() > kMaxFileSize) {
+    LOG(ERROR) << "file size is too big.";
+    return false;
+  }
 
-    if (mmap->size() > kMaxFileSize) {
-      LOG(ERROR) << "file size is too big.";
-      return false;
-    }
+  return DecryptRecord(absl::string_view(mmap->begin(), mmap->size()), output);
+}
 
-    // copy salt
-    salt.assign(mmap->begin(), kSaltSize);
+bool EncryptedStringStorage::DecryptRecord(absl::string_view record,
+                                           std::string *output) const {
+  DCHECK(output);
 
-    // copy body
-    output->assign(mmap->begin() + kSaltSize, mmap->size() - kSaltSize);
+  if (record.size() < kSaltSize) {
+    LOG(ERROR) << "file size is too small";
+    return false;
   }
 
+  // copy salt
+  const std::string salt(record.substr(0, kSaltSize));
+
+  // copy body
+  output->assign(record.data() + kSaltSize, record.size() - kSaltSize);
+
   return Decrypt(salt, output);
 }
 
@@ -121,11 +125,8 @@ bool EncryptedStringStorage::Decrypt(const std::string &salt,
 }
 
 bool EncryptedStringStorage::Save(const std::string &input) const {
-  // Generate salt.
-  const std::string salt = random_.ByteString(kSaltSize);
-
-  std::string output(input);
-  if (!Encrypt(salt, &output)) {
+  std::string output;
+  if (!EncryptRecord(input, &output)) {
     return false;
   }
 
@@ -140,7 +141,6 @@ bool EncryptedStringStorage::Save(const std::string &input) const {
     }
 
     VLOG(1) << "Syncing user history to: " << filename_;
-    ofs.write(salt.data(), salt.size());
     ofs.write(output.data(), output.size());
   }
 
@@ -161,6 +161,23 @@ bool EncryptedStringStorage::Save(const std::string &input) const {
   return true;
 }
 
+bool EncryptedStringStorage::EncryptRecord(const std::string &input,
+                                           std::string *record) const {
+  DCHECK(record);
+
+  // Generate salt.
+  const std::string salt = random_.ByteString(kSaltSize);
+
+  std::string body(input);
+  if (!Encrypt(salt, &body)) {
+    return false;
+  }
+  record->reserve(salt.size() + body.size());
+  record->assign(salt);
+  record->append(body);
+  return true;
+}
+
 bool EncryptedStringStorage::Encrypt(const std::string &salt,
                                      std::string *data) const {
   DCHECK(data);
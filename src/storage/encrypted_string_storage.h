@@ -56,6 +56,13 @@ class EncryptedStringStorage : public StringStorageInterface {
   bool Load(std::string *output) const override;
   bool Save(const std::string &input) const override;
 
+  // Encrypts |input| with a new salt into |record|, in the same layout as the
+  // file written by Save(), so that records can be stored in other files.
+  bool EncryptRecord(const std::string &input, std::string *record) const;
+
+  // Decrypts |record| made by EncryptRecord() into |output|.
+  bool DecryptRecord(absl::string_view record, std::string *output) const;
+
  protected:
   virtual bool Encrypt(const std::string &salt, std::string *data) const;
   virtual bool Decrypt(const std::string &salt, std::string *data) const;
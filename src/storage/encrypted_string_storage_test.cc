@@ -31,6 +31,7 @@
 
 #include <ios>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <string>
 
@@ -126,6 +127,30 @@ TEST_F(EncryptedStringStorageTest, Encrypt) {
   EXPECT_LT(original_data.size(), result.size());
   EXPECT_TRUE(result.find(original_data) == std::string::npos);
 }
+
+TEST_F(EncryptedStringStorageTest, EncryptAndDecryptRecord) {
+  const std::string kData = "abcdefghijklmnopqrstuvwxyz";
+  std::string record1, record2;
+  ASSERT_TRUE(storage_->EncryptRecord(kData, &record1));
+  ASSERT_TRUE(storage_->EncryptRecord(kData, &record2));
+  // Each record has its own salt.
+  EXPECT_NE(record1, record2);
+
+  std::string output;
+  ASSERT_TRUE(storage_->DecryptRecord(record1, &output));
+  EXPECT_EQ(output, kData);
+  ASSERT_TRUE(storage_->DecryptRecord(record2, &output));
+  EXPECT_EQ(output, kData);
+  EXPECT_FALSE(storage_->DecryptRecord("too short", &output));
+
+  // The file written by Save() is a record.
+  ASSERT_TRUE(storage_->Save(kData));
+  InputFileStream ifs(filename_, std::ios::in | std::ios::binary);
+  const std::string contents((std::istreambuf_iterator<char>(ifs)),
+                             std::istreambuf_iterator<char>());
+  ASSERT_TRUE(storage_->DecryptRecord(contents, &output));
+  EXPECT_EQ(output, kData);
+}
 #endif  // __ANDROID__
 
 }  // namespace storage
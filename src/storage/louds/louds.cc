@@ -31,14 +31,18 @@
 
 #include <cstdint>
 
+#include "storage/louds/simple_succinct_bit_vector_index.h"
+
 namespace mozc {
 namespace storage {
 namespace louds {
 
 void Louds::Init(const uint8_t *image, int length, size_t bitvec_lb0_cache_size,
                  size_t bitvec_lb1_cache_size, size_t select0_cache_size,
-                 size_t select1_cache_size) {
-  index_.Init(image, length, bitvec_lb0_cache_size, bitvec_lb1_cache_size);
+                 size_t select1_cache_size,
+                 SimpleSuccinctBitVectorIndex::IndexType index_type) {
+  index_.Init(image, length, bitvec_lb0_cache_size, bitvec_lb1_cache_size,
+              index_type);
 
   // Cap the cache sizes.
   if (select0_cache_size > index_.GetNum0Bits()) {
@@ -92,9 +92,20 @@ class Louds {
   // and |select0_cache_size| to larger values.  On the other hand, to improve
   // the performance of upward traversal (i.e., from leaves to the root), set
   // |bitvec_lb1_cache_size| and |select1_cache_size| to larger values.
+  // |index_type| selects the layout of the rank/select index of the bit array;
+  // the lower bound cache sizes are not used for IndexType::kTwoLevel.
   void Init(const uint8_t *image, int length, size_t bitvec_lb0_cache_size,
             size_t bitvec_lb1_cache_size, size_t select0_cache_size,
-            size_t select1_cache_size);
+            size_t select1_cache_size,
+            SimpleSuccinctBitVectorIndex::IndexType index_type);
+
+  void Init(const uint8_t *image, int length, size_t bitvec_lb0_cache_size,
+            size_t bitvec_lb1_cache_size, size_t select0_cache_size,
+            size_t select1_cache_size) {
+    Init(image, length, bitvec_lb0_cache_size, bitvec_lb1_cache_size,
+         select0_cache_size, select1_cache_size,
+         SimpleSuccinctBitVectorIndex::IndexType::kChunk);
+  }
 
   // Explicitly clears the internal bit array.
   void Reset();
@@ -139,6 +150,21 @@ class Louds {
     ++node->node_id_;
   }
 
+  // Moves the given node to its |n|-th next sibling, i.e., is equivalent to
+  // calling MoveToNextSibling() |n| times.
+  static void MoveToNextSibling(Node *node, int n) {
+    node->edge_index_ += n;
+    node->node_id_ += n;
+  }
+
+  // Returns the number of the nodes from |node| to its last sibling, i.e., the
+  // number of the valid nodes visited by MoveToNextSibling() from |node|.  For
+  // example, in the above diagram of tree, returns 2 for node 2, 1 for node 3
+  // and 0 for the invalid node.
+  int GetNumSiblingsFrom(const Node &node) const {
+    return index_.CountConsecutive1Bits(node.edge_index_);
+  }
+
   // Moves the given node to its unique parent.  For example, in the above
   // diagram of tree, moves are as follows:
   //   * node 2 -> node 1
@@ -121,10 +121,12 @@ TEST_P(LoudsTest, Basic) {
     louds.MoveToFirstChild(&node);
     EXPECT_LEAF(louds, node);
     EXPECT_EQ(node.node_id(), 2);
+    EXPECT_EQ(louds.GetNumSiblingsFrom(node), 2);
 
     louds.MoveToNextSibling(&node);
     EXPECT_NO_SIBLING(louds, node);
     EXPECT_EQ(node.node_id(), 3);
+    EXPECT_EQ(louds.GetNumSiblingsFrom(node), 1);
 
     louds.MoveToFirstChild(&node);
     EXPECT_LEAF(louds, node);
@@ -136,6 +138,18 @@ TEST_P(LoudsTest, Basic) {
     EXPECT_EQ(node.node_id(), 5);
   }
 
+  // Moves 4 to 5, then past the last sibling.
+  {
+    Louds::Node node;
+    louds.InitNodeFromNodeId(4, &node);
+    Louds::Node sibling = node;
+    louds.MoveToNextSibling(&sibling, 1);
+    EXPECT_EQ(sibling.node_id(), 5);
+    louds.MoveToNextSibling(&node, louds.GetNumSiblingsFrom(node));
+    EXPECT_FALSE(louds.IsValidNode(node));
+    EXPECT_EQ(louds.GetNumSiblingsFrom(node), 0);
+  }
+
   // 4 -> 3 -> 1
   {
     Louds::Node node;
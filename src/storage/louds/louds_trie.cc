@@ -32,6 +32,11 @@
 #include <cstddef>
 #include <cstdint>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif  // __SSE2__ || _M_X64
+
+#include "absl/numeric/bits.h"
 #include "absl/strings/string_view.h"
 #include "base/bits.h"
 #include "base/logging.h"
@@ -41,22 +46,54 @@
 namespace mozc {
 namespace storage {
 namespace louds {
+namespace {
+
+// Returns the index of the first |label| in labels[0, size), or -1 if not
+// found.  Nodes near the root of the key trie have tens of children, so 16
+// labels are compared at once where SSE2 is available.
+int FindLabel(const char *labels, int size, char label) {
+  int i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+  const __m128i pattern = _mm_set1_epi8(label);
+  for (; i + 16 <= size; i += 16) {
+    const __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(labels + i));
+    const uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern));
+    if (mask != 0) {
+      return i + absl::countr_zero(mask);
+    }
+  }
+#endif  // __SSE2__ || _M_X64
+  for (; i < size; ++i) {
+    if (labels[i] == label) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+}  // namespace
 
 bool LoudsTrie::Open(const uint8_t *image, size_t louds_lb0_cache_size,
                      size_t louds_lb1_cache_size,
                      size_t louds_select0_cache_size,
                      size_t louds_select1_cache_size,
-                     size_t termvec_lb1_cache_size) {
+                     size_t termvec_lb1_cache_size,
+                     SimpleSuccinctBitVectorIndex::IndexType index_type) {
   // Reads a binary image data, which is compatible with rx.
   // The format is as follows:
   // [trie size: little endian 4byte int]
   // [terminal size: little endian 4byte int]
   // [num bits for each character annotated to an edge:
-  //  little endian 4 byte int. Currently, this class supports only 8-bits]
+  //  little endian 4 byte int. Currently, this class supports only 8-bits.
+  //  The second byte is the number of the dense levels.]
   // [edge character image size: little endian 4 byte int]
   // [trie image: "trie size" bytes]
   // [terminal image: "terminal size" bytes]
   // [edge character image: "edge character image size" bytes]
+  // If the number of the dense levels is positive:
+  // [number of the rows of dense table: little endian 4 byte int]
+  // [dense table: 256 little endian 4 byte ints for each row]
   //
   // Here, "terminal" means "the node is one of the end of a word."
   // For example, if we have a trie for "aa" and "aaa", the trie looks like:
@@ -69,11 +106,19 @@ bool LoudsTrie::Open(const uint8_t *image, size_t louds_lb0_cache_size,
   //   [3]
   // In this case, [0] and [1] are not terminal (as the original words contains
   // neither "" nor "a"), and [2] and [3] are terminal.
+  //
+  // The dense table has the child node IDs of the nodes at the top levels,
+  // indexed by edge label (0 if there's no such child).  Its row 0 is for the
+  // root and row i is for the node with ID i + 1, which is at depth 1 if the
+  // number of the dense levels is 2.
   const int louds_size = LoadUnalignedAdvance<uint32_t>(image);
   const int terminal_size = LoadUnalignedAdvance<uint32_t>(image);
-  const int num_character_bits = LoadUnalignedAdvance<uint32_t>(image);
+  const uint32_t character_format = LoadUnalignedAdvance<uint32_t>(image);
   const int edge_character_size = LoadUnalignedAdvance<uint32_t>(image);
+  const int num_character_bits = character_format & 0xFF;
+  const int dense_levels = (character_format >> 8) & 0xFF;
   CHECK_EQ(num_character_bits, 8);
+  CHECK_LE(dense_levels, 2);
   CHECK_GT(edge_character_size, 0);
 
   const uint8_t *louds_image = image;
@@ -82,12 +127,20 @@ bool LoudsTrie::Open(const uint8_t *image, size_t louds_lb0_cache_size,
 
   louds_.Init(louds_image, louds_size, louds_lb0_cache_size,
               louds_lb1_cache_size, louds_select0_cache_size,
-              louds_select1_cache_size);
+              louds_select1_cache_size, index_type);
   terminal_bit_vector_.Init(terminal_image, terminal_size,
                             0,  // Select0 is not carried out.
-                            termvec_lb1_cache_size);
+                            termvec_lb1_cache_size, index_type);
   edge_character_ = reinterpret_cast<const char *>(edge_character);
 
+  dense_table_ = nullptr;
+  dense_table_rows_ = 0;
+  if (dense_levels > 0) {
+    const uint8_t *dense_table = edge_character + edge_character_size;
+    dense_table_rows_ = LoadUnalignedAdvance<uint32_t>(dense_table);
+    dense_table_ = dense_table;
+  }
+
   return true;
 }
 
@@ -95,17 +148,34 @@ void LoudsTrie::Close() {
   louds_.Reset();
   terminal_bit_vector_.Reset();
   edge_character_ = nullptr;
+  dense_table_ = nullptr;
+  dense_table_rows_ = 0;
 }
 
 bool LoudsTrie::MoveToChildByLabel(char label, Node *node) const {
-  MoveToFirstChild(node);
-  while (IsValidNode(*node)) {
-    if (GetEdgeLabelToParentNode(*node) == label) {
+  const int row = node->node_id() - 1;
+  if (row < dense_table_rows_) {
+    const int child_id = LoadUnaligned<uint32_t>(
+        dense_table_ + 4 * (row * 256 + static_cast<uint8_t>(label)));
+    if (child_id != 0) {
+      louds_.InitNodeFromNodeId(child_id, node);
       return true;
     }
-    MoveToNextSibling(node);
+    // Fall back to the search so that |node| becomes invalid in the same way.
+  }
+  // The labels of the siblings are contiguous in |edge_character_|.  On
+  // failure, |node| moves past the last child, i.e., becomes invalid, as
+  // with the sibling-by-sibling scan.
+  MoveToFirstChild(node);
+  const int num_children = louds_.GetNumSiblingsFrom(*node);
+  const int index =
+      FindLabel(edge_character_ + node->node_id() - 1, num_children, label);
+  if (index < 0) {
+    Louds::MoveToNextSibling(node, num_children);
+    return false;
   }
-  return false;
+  Louds::MoveToNextSibling(node, index);
+  return true;
 }
 
 bool LoudsTrie::Traverse(absl::string_view key, Node *node) const {
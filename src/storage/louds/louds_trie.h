@@ -58,10 +58,22 @@ class LoudsTrie {
   // information of cache size.  The last one is passed to the underlying
   // terminal bit vector.  This class doesn't own the "data", so it is caller's
   // responsibility to keep the data alive until Close is invoked.  See .cc file
-  // for the detailed format of the binary image.
+  // for the detailed format of the binary image.  |index_type| selects the
+  // layout of the rank/select index of both the LOUDS and the terminal bit
+  // vector; see simple_succinct_bit_vector_index.h.
   bool Open(const uint8_t *image, size_t louds_lb0_cache_size,
             size_t louds_lb1_cache_size, size_t louds_select0_cache_size,
-            size_t louds_select1_cache_size, size_t termvec_lb1_cache_size);
+            size_t louds_select1_cache_size, size_t termvec_lb1_cache_size,
+            SimpleSuccinctBitVectorIndex::IndexType index_type);
+
+  bool Open(const uint8_t *image, size_t louds_lb0_cache_size,
+            size_t louds_lb1_cache_size, size_t louds_select0_cache_size,
+            size_t louds_select1_cache_size, size_t termvec_lb1_cache_size) {
+    return Open(image, louds_lb0_cache_size, louds_lb1_cache_size,
+                louds_select0_cache_size, louds_select1_cache_size,
+                termvec_lb1_cache_size,
+                SimpleSuccinctBitVectorIndex::IndexType::kChunk);
+  }
 
   bool Open(const uint8_t *data) { return Open(data, 0, 0, 0, 0, 0); }
 
@@ -200,6 +212,12 @@ class LoudsTrie {
   // This array also doesn't have an entry for super root.
   // In other words, id=2 in louds_ corresponds to edge_character_[1].
   const char *edge_character_ = nullptr;
+
+  // Optional child node IDs of the top level nodes indexed by edge label; see
+  // .cc file for the format.  The node with ID i uses the (i - 1)-th row if
+  // i <= dense_table_rows_.
+  const uint8_t *dense_table_ = nullptr;
+  int dense_table_rows_ = 0;
 };
 
 }  // namespace louds
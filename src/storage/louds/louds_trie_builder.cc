@@ -31,6 +31,7 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <iterator>
 #include <string>
 #include <vector>
@@ -45,7 +46,8 @@ namespace {
 
 using ::mozc::storage::louds::internal::PushInt32;
 
-// A pair of word and its original index in the (sorted) word_list_.
+// A pair of word and its original index in the (sorted) word_list_, with the
+// ID of the last node output for the word.
 class Entry {
  public:
   Entry(const std::string &word, size_t original_index)
@@ -53,10 +55,13 @@ class Entry {
 
   const std::string &word() const { return *word_; }
   size_t original_index() const { return original_index_; }
+  int node_id() const { return node_id_; }
+  void set_node_id(int node_id) { node_id_ = node_id; }
 
  private:
   const std::string *word_;
   size_t original_index_;
+  int node_id_ = 1;  // The root.
 };
 
 class EntryLengthLessThan {
@@ -79,6 +84,13 @@ void LoudsTrieBuilder::Add(const std::string &word) {
   word_list_.push_back(word);
 }
 
+void LoudsTrieBuilder::set_dense_levels(int dense_levels) {
+  CHECK(!built_);
+  CHECK_GE(dense_levels, 0);
+  CHECK_LE(dense_levels, 2);
+  dense_levels_ = dense_levels;
+}
+
 void LoudsTrieBuilder::Build() {
   CHECK(!built_);
 
@@ -98,11 +110,19 @@ void LoudsTrieBuilder::Build() {
   BitStream terminal_stream;
   std::string edge_character;
 
+  // Dense child tables of the nodes at depth < dense_levels_.  Row 0 is for
+  // the root and row (node_id - 1) is for the node at depth 1.
+  std::vector<uint32_t> dense_table;
+  if (dense_levels_ > 0) {
+    dense_table.resize(256);
+  }
+
   // Push root.
   trie_stream.PushBit(1);
   trie_stream.PushBit(0);
   edge_character.push_back('\0');
   terminal_stream.PushBit(0);
+  int node_id = 1;
 
   // Then, traverse the sorted word list.
   // The basic concept to output the trie is simple:
@@ -156,6 +176,12 @@ void LoudsTrieBuilder::Build() {
         // This is the first string of this node. Output an edge.
         trie_stream.PushBit(1);
         edge_character.push_back(entry_list[i].word()[depth]);
+        ++node_id;
+        if (depth < static_cast<size_t>(dense_levels_)) {
+          const size_t row = entry_list[i].node_id() - 1;
+          dense_table[row * 256 + static_cast<uint8_t>(word[depth])] = node_id;
+        }
+        entry_list[i].set_node_id(node_id);
 
         if (entry_list[i].word().length() == depth + 1) {
           // This is a terminal node.
@@ -168,6 +194,9 @@ void LoudsTrieBuilder::Build() {
           // This is not a terminal node.
           terminal_stream.PushBit(0);
         }
+      } else if (word.length() > depth) {
+        // The node is shared with the previous entry.
+        entry_list[i].set_node_id(entry_list[i - 1].node_id());
       }
 
       if (i == entry_list.size() - 1 ||
@@ -181,6 +210,11 @@ void LoudsTrieBuilder::Build() {
     entry_list.erase(std::remove_if(entry_list.begin(), entry_list.end(),
                                     EntryLengthLessThan(depth + 1)),
                      entry_list.end());
+
+    if (depth == 0 && dense_levels_ >= 2) {
+      // Add the rows for the nodes at depth 1, whose IDs are [2, node_id].
+      dense_table.resize(node_id * 256);
+    }
   }
 
   // Set 32-bits alignment.
@@ -190,14 +224,23 @@ void LoudsTrieBuilder::Build() {
   // Output
   PushInt32(trie_stream.ByteSize(), image_);
   PushInt32(terminal_stream.ByteSize(), image_);
-  // The num bits of each character annotated to each edge.
-  PushInt32(8, image_);
+  // The num bits of each character annotated to each edge, and the number of
+  // the dense levels in the second byte.
+  PushInt32(8 | (dense_levels_ << 8), image_);
   PushInt32(edge_character.size(), image_);
 
   image_.append(trie_stream.image());
   image_.append(terminal_stream.image());
   image_.append(edge_character);
 
+  if (dense_levels_ > 0) {
+    // The number of the rows, followed by the rows.
+    PushInt32(dense_table.size() / 256, image_);
+    for (const uint32_t child_id : dense_table) {
+      PushInt32(child_id, image_);
+    }
+  }
+
   built_ = true;
 }
 
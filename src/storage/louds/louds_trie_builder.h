@@ -53,6 +53,13 @@ class LoudsTrieBuilder {
   // before Build invocation.
   void Add(const std::string &word);
 
+  // Sets the number of the top levels of the trie, in [0, 2], whose children
+  // are also stored in dense tables indexed by edge label (default: 0).  The
+  // tables replace the scan of the siblings in LoudsTrie::MoveToChildByLabel
+  // at the cost of 1KB per node above those levels.  Key IDs are not
+  // affected.  It is necessary to call this method before Build invocation.
+  void set_dense_levels(int dense_levels);
+
   // Builds the trie image.
   void Build();
 
@@ -66,6 +73,7 @@ class LoudsTrieBuilder {
 
  private:
   bool built_ = false;
+  int dense_levels_ = 0;
 
   std::vector<std::string> word_list_;
   std::vector<int> id_list_;
@@ -30,10 +30,13 @@
 #include "storage/louds/louds_trie.h"
 
 #include <cstdint>
+#include <string>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "storage/louds/louds_trie_builder.h"
+#include "storage/louds/simple_succinct_bit_vector_index.h"
 #include "testing/gunit.h"
 
 namespace mozc {
@@ -528,6 +531,127 @@ TEST_P(LoudsTrieTest, RestoreKeyString) {
 }
 INSTANTIATE_TEST_CASE(GenRestoreKeyStringTest);
 
+TEST(LoudsTrieTest, DenseLevels) {
+  std::vector<std::string> keys;
+  for (int i = 0; i < 3000; ++i) {
+    keys.push_back(absl::StrCat(i * 7919 % 10007, "k", i % 13));
+  }
+  keys.push_back("a");
+  keys.push_back("ab");
+  keys.push_back("\xFF");
+
+  LoudsTrieBuilder builder;
+  for (const std::string &key : keys) {
+    builder.Add(key);
+  }
+  builder.Build();
+  LoudsTrie expected;
+  expected.Open(reinterpret_cast<const uint8_t *>(builder.image().data()));
+
+  for (int dense_levels = 1; dense_levels <= 2; ++dense_levels) {
+    LoudsTrieBuilder dense_builder;
+    dense_builder.set_dense_levels(dense_levels);
+    for (const std::string &key : keys) {
+      dense_builder.Add(key);
+    }
+    dense_builder.Build();
+    LoudsTrie actual;
+    actual.Open(reinterpret_cast<const uint8_t *>(dense_builder.image().data()));
+
+    for (const std::string &key : keys) {
+      EXPECT_EQ(dense_builder.GetId(key), builder.GetId(key));
+      EXPECT_EQ(actual.ExactSearch(key), expected.ExactSearch(key)) << key;
+
+      // Every step, including the failing one, ends at the same node.
+      const std::string query = absl::StrCat(key, "x");
+      LoudsTrie::Node expected_node, actual_node;
+      for (const char c : query) {
+        const bool found = expected.MoveToChildByLabel(c, &expected_node);
+        EXPECT_EQ(actual.MoveToChildByLabel(c, &actual_node), found);
+        EXPECT_EQ(actual_node, expected_node);
+        if (!found) {
+          EXPECT_FALSE(actual.IsValidNode(actual_node));
+          break;
+        }
+      }
+
+      std::vector<RecordCallbackArgs::CallbackArgs> expected_args, actual_args;
+      expected.PrefixSearch(query, RecordCallbackArgs(&expected_args));
+      actual.PrefixSearch(query, RecordCallbackArgs(&actual_args));
+      ASSERT_EQ(actual_args.size(), expected_args.size());
+      for (size_t i = 0; i < actual_args.size(); ++i) {
+        EXPECT_EQ(actual_args[i].prefix_len, expected_args[i].prefix_len);
+        EXPECT_EQ(actual_args[i].node, expected_args[i].node);
+      }
+    }
+    EXPECT_EQ(actual.ExactSearch("b"), -1);
+    EXPECT_EQ(actual.ExactSearch("\xFF" "b"), -1);
+  }
+}
+
+TEST(LoudsTrieTest, MoveToChildByLabelWithManyChildren) {
+  // The root and "a" have 255 children, "b" has 20 and "c" has 1.
+  LoudsTrieBuilder builder;
+  for (int c = 1; c < 256; ++c) {
+    builder.Add(std::string(1, c));
+    builder.Add(std::string("a") + static_cast<char>(c));
+  }
+  for (int c = 0; c < 20; ++c) {
+    builder.Add(std::string("b") + static_cast<char>('A' + 3 * c));
+  }
+  builder.Add("cd");
+  builder.Build();
+  LoudsTrie trie;
+  trie.Open(reinterpret_cast<const uint8_t *>(builder.image().data()));
+
+  for (const absl::string_view key : {"", "a", "b", "c", "cd", "a\xFF"}) {
+    const LoudsTrie::Node parent = Traverse(trie, key);
+    ASSERT_TRUE(trie.IsValidNode(parent)) << key;
+    for (int c = 0; c < 256; ++c) {
+      const char label = static_cast<char>(c);
+      // Scan the siblings one by one.
+      LoudsTrie::Node expected = trie.MoveToFirstChild(parent);
+      while (trie.IsValidNode(expected) &&
+             trie.GetEdgeLabelToParentNode(expected) != label) {
+        trie.MoveToNextSibling(&expected);
+      }
+
+      LoudsTrie::Node actual = parent;
+      EXPECT_EQ(trie.MoveToChildByLabel(label, &actual),
+                trie.IsValidNode(expected))
+          << key << ", " << c;
+      EXPECT_EQ(actual, expected) << key << ", " << c;
+    }
+  }
+}
+
+TEST(LoudsTrieTest, TwoLevelIndex) {
+  // Use enough keys for the bit vectors to span several index blocks.
+  LoudsTrieBuilder builder;
+  std::vector<std::string> keys;
+  for (int i = 0; i < 3000; ++i) {
+    keys.push_back(absl::StrCat(i * 7919 % 10007, "k", i % 13));
+    builder.Add(keys.back());
+  }
+  builder.Build();
+
+  const uint8_t *image =
+      reinterpret_cast<const uint8_t *>(builder.image().data());
+  LoudsTrie expected, actual;
+  expected.Open(image, 8, 8, 8, 8, 8);
+  actual.Open(image, 0, 0, 8, 8, 0,
+              SimpleSuccinctBitVectorIndex::IndexType::kTwoLevel);
+
+  char buf[LoudsTrie::kMaxDepth + 1];
+  for (const std::string &key : keys) {
+    const int id = expected.ExactSearch(key);
+    ASSERT_EQ(id, builder.GetId(key));
+    EXPECT_EQ(actual.ExactSearch(key), id) << key;
+    EXPECT_EQ(actual.RestoreKeyString(id, buf), key);
+    EXPECT_FALSE(actual.HasKey(absl::StrCat(key, "x")));
+  }
+}
+
 }  // namespace
 }  // namespace louds
 }  // namespace storage
@@ -35,6 +35,10 @@
 #include <iterator>
 #include <vector>
 
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif  // __BMI2__
+
 #include "absl/numeric/bits.h"
 #include "base/bits.h"
 #include "base/logging.h"
@@ -158,14 +162,163 @@ void InitLowerBound1Cache(const std::vector<int> &index, int chunk_size,
   cache->push_back(index.data() + index.size());
 }
 
+// Constants for IndexType::kTwoLevel.
+constexpr int kBlockBits = 512;
+constexpr int kWordsPerBlock = kBlockBits / 64;
+constexpr int kSelectSampleInterval = 512;
+constexpr uint64_t kRelativeCountMask = 0x1FF;
+
+// Constants for the broadword operations on 8 bytes and 7 9-bit fields.
+constexpr uint64_t kOnesStep8 = 0x0101010101010101;
+constexpr uint64_t kMsbsStep8 = kOnesStep8 << 7;
+constexpr uint64_t kOnesStep9 = 0x0040201008040201;
+constexpr uint64_t kMsbsStep9 = kOnesStep9 << 8;
+// The number of bits before the j-th word of a block at the (j - 1)-th field.
+constexpr uint64_t kBitsBeforeWords =
+    (uint64_t{64} << 0) | (uint64_t{128} << 9) | (uint64_t{192} << 18) |
+    (uint64_t{256} << 27) | (uint64_t{320} << 36) | (uint64_t{384} << 45) |
+    (uint64_t{448} << 54);
+
+// Returns the number of 1-bits in the block before its |word|-th word from
+// the packed relative counts.
+inline int RelativeCount1(uint64_t relative_counts, int word) {
+  return word == 0 ? 0
+                   : (relative_counts >> (9 * (word - 1))) & kRelativeCountMask;
+}
+
+// Returns the number of the words |word| in [1, 7] whose relative count is
+// less than or equal to |k|, that is, the word containing the (k + 1)-th bit.
+inline int FindWordInBlock(uint64_t relative_counts, int k) {
+  const uint64_t k_step = k * kOnesStep9;
+  // The MSB of each field is set if the field is less than or equal to k.
+  const uint64_t leq = (((((k_step | kMsbsStep9) -
+                           (relative_counts & ~kMsbsStep9)) |
+                          (relative_counts ^ k_step)) ^
+                         (relative_counts & ~k_step)) &
+                        kMsbsStep9) >>
+                       8;
+  return (leq * kOnesStep9 >> 54) & 0x7;
+}
+
+#if !defined(__BMI2__)
+// Table of the position of the (rank + 1)-th 1-bit in a byte.
+class SelectInByteTable {
+ public:
+  constexpr SelectInByteTable() : table_() {
+    for (int byte = 0; byte < 256; ++byte) {
+      for (int i = 0, rank = 0; i < 8; ++i) {
+        if (byte & (1 << i)) {
+          table_[rank++ * 256 + byte] = i;
+        }
+      }
+    }
+  }
+
+  constexpr int Select(uint32_t byte, int rank) const {
+    return table_[rank * 256 + byte];
+  }
+
+ private:
+  uint8_t table_[8 * 256];
+};
+
+constexpr SelectInByteTable kSelectInByteTable;
+#endif  // !__BMI2__
+
+// Returns the position of the |rank|-th (1-origin) 1-bit in |word|.
+inline int SelectInWord(uint64_t word, int rank) {
+  DCHECK_GT(rank, 0);
+  DCHECK_LE(rank, absl::popcount(word));
+#if defined(__BMI2__)
+  return absl::countr_zero(_pdep_u64(uint64_t{1} << (rank - 1), word));
+#else   // __BMI2__
+  // Find the byte by comparing the cumulative 1-bits of the bytes with the
+  // rank in parallel, then look up the bit in the byte.
+  const uint64_t k = rank - 1;
+  uint64_t sums = word - ((word >> 1) & 0x5555555555555555);
+  sums = (sums & 0x3333333333333333) + ((sums >> 2) & 0x3333333333333333);
+  sums = ((sums + (sums >> 4)) & 0x0F0F0F0F0F0F0F0F) * kOnesStep8;
+  const uint64_t k_step = k * kOnesStep8;
+  const uint64_t leq =
+      ((((k_step | kMsbsStep8) - (sums & ~kMsbsStep8)) ^ sums ^ k_step) &
+       kMsbsStep8) >>
+      7;
+  const int offset = ((leq * kOnesStep8) >> 53) & ~0x7;
+  const int byte_rank = k - (((sums << 8) >> offset) & 0xFF);
+  return offset +
+         kSelectInByteTable.Select((word >> offset) & 0xFF, byte_rank);
+#endif  // __BMI2__
+}
+
+// Stores the block to start Select from for every kSelectSampleInterval bits
+// of |bit|, followed by the last block as a sentinel.
+template <bool kBit>
+void InitSelectSamples(const std::vector<uint64_t> &rank_directory,
+                       std::vector<int> *samples) {
+  const int num_blocks = rank_directory.size() / 2 - 1;
+  samples->clear();
+  int64_t target = 1;
+  for (int block = 0; block < num_blocks; ++block) {
+    const int64_t num_1_bits = rank_directory[2 * (block + 1)];
+    const int64_t count =
+        kBit ? num_1_bits : int64_t{kBlockBits} * (block + 1) - num_1_bits;
+    for (; target <= count; target += kSelectSampleInterval) {
+      samples->push_back(block);
+    }
+  }
+  samples->push_back(std::max(num_blocks - 1, 0));
+}
+
 }  // namespace
 
 void SimpleSuccinctBitVectorIndex::Init(const uint8_t *data, int length,
                                         size_t lb0_cache_size,
-                                        size_t lb1_cache_size) {
+                                        size_t lb1_cache_size,
+                                        IndexType index_type) {
+  DCHECK_EQ(length % 4, 0);
   data_ = data;
   length_ = length;
+  index_type_ = index_type;
+  rank_directory_.clear();
+  select0_samples_.clear();
+  select1_samples_.clear();
+
+  if (index_type == IndexType::kTwoLevel) {
+    index_.clear();
+    lb0_cache_.clear();
+    lb1_cache_.clear();
+
+    // Reserve a sentinel block so that Rank1(8 * length) works.
+    const int num_words = (length + 7) / 8;
+    const int num_blocks = (num_words + kWordsPerBlock - 1) / kWordsPerBlock;
+    rank_directory_.assign(2 * (num_blocks + 1), 0);
+    uint64_t num_bits = 0;
+    for (int block = 0; block < num_blocks; ++block) {
+      rank_directory_[2 * block] = num_bits;
+      uint64_t relative_counts = 0;
+      int count = 0;
+      for (int i = 0; i < kWordsPerBlock; ++i) {
+        if (i > 0) {
+          relative_counts |= static_cast<uint64_t>(count) << (9 * (i - 1));
+        }
+        const int word = block * kWordsPerBlock + i;
+        if (word < num_words) {
+          count += absl::popcount(LoadWord64(word));
+        }
+      }
+      rank_directory_[2 * block + 1] = relative_counts;
+      num_bits += count;
+    }
+    rank_directory_[2 * num_blocks] = num_bits;
+    num_1_bits_ = num_bits;
+
+    InitSelectSamples<false>(rank_directory_, &select0_samples_);
+    InitSelectSamples<true>(rank_directory_, &select1_samples_);
+    return;
+  }
+
   InitIndex(data, length, chunk_size_, &index_);
+  num_1_bits_ = index_.back();
 
   // TODO(noriyukit): Currently, we simply use uniform increment width for lower
   // bound cache.  Nonuniform increment width may improve performance.
@@ -189,14 +342,84 @@ void SimpleSuccinctBitVectorIndex::Init(const uint8_t *data, int length,
 void SimpleSuccinctBitVectorIndex::Reset() {
   data_ = nullptr;
   length_ = 0;
+  num_1_bits_ = 0;
+  index_type_ = IndexType::kChunk;
   index_.clear();
   lb0_cache_increment_ = 1;
   lb0_cache_.clear();
   lb1_cache_increment_ = 1;
   lb1_cache_.clear();
+  rank_directory_.clear();
+  select0_samples_.clear();
+  select1_samples_.clear();
+}
+
+uint64_t SimpleSuccinctBitVectorIndex::LoadWord64(int word_index) const {
+  // The length is a multiple of 4, so the last word may be 32 bits.
+  const int offset = word_index * 8;
+  if (offset + 8 <= length_) {
+    return LoadUnaligned<uint64_t>(data_ + offset);
+  }
+  DCHECK_LE(offset + 4, length_);
+  return LoadUnaligned<uint32_t>(data_ + offset);
+}
+
+int SimpleSuccinctBitVectorIndex::TwoLevelRank1(int n) const {
+  const int block = n / kBlockBits;
+  const int word = n / 64;
+  int result = rank_directory_[2 * block] +
+               RelativeCount1(rank_directory_[2 * block + 1],
+                              word % kWordsPerBlock);
+  if (n % 64 > 0) {
+    result += absl::popcount(LoadWord64(word) << (64 - n % 64));
+  }
+  return result;
+}
+
+template <bool kBit>
+int SimpleSuccinctBitVectorIndex::TwoLevelSelect(int n) const {
+  DCHECK_GT(n, 0);
+  const std::vector<int> &samples = kBit ? select1_samples_ : select0_samples_;
+  // Returns the number of |kBit| bits before |block|.
+  auto count_before_block = [this](int block) -> int {
+    const int num_1_bits = rank_directory_[2 * block];
+    return kBit ? num_1_bits : kBlockBits * block - num_1_bits;
+  };
+
+  // Find the last block in [lo, hi] having fewer bits than n before it.
+  const int sample = (n - 1) / kSelectSampleInterval;
+  DCHECK_LT(sample + 1, samples.size());
+  int lo = samples[sample];
+  int hi = samples[sample + 1];
+  while (lo < hi) {
+    const int mid = (lo + hi + 1) / 2;
+    if (count_before_block(mid) < n) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  const int block = lo;
+  n -= count_before_block(block);
+
+  const uint64_t relative_counts =
+      kBit ? rank_directory_[2 * block + 1]
+           : kBitsBeforeWords - rank_directory_[2 * block + 1];
+  const int word = FindWordInBlock(relative_counts, n - 1);
+  if (word > 0) {
+    n -= (relative_counts >> (9 * (word - 1))) & kRelativeCountMask;
+  }
+
+  const int word_index = block * kWordsPerBlock + word;
+  const uint64_t bits = LoadWord64(word_index);
+  return word_index * 64 + SelectInWord(kBit ? bits : ~bits, n);
 }
 
 int SimpleSuccinctBitVectorIndex::Rank1(int n) const {
+  if (index_type_ == IndexType::kTwoLevel) {
+    return TwoLevelRank1(n);
+  }
+
   // Look up pre-computed 1-bits for the preceding chunks.
   const int num_chunks = n / (chunk_size_ * 8);
   int result = index_[n / (chunk_size_ * 8)];
@@ -217,6 +440,9 @@ int SimpleSuccinctBitVectorIndex::Rank1(int n) const {
 
 int SimpleSuccinctBitVectorIndex::Select0(int n) const {
   DCHECK_GT(n, 0);
+  if (index_type_ == IndexType::kTwoLevel) {
+    return TwoLevelSelect<false>(n);
+  }
 
   // Narrow down the range of |index_| on which lower bound is performed.
   int lb0_cache_index = n / lb0_cache_increment_;
@@ -262,6 +488,9 @@ int SimpleSuccinctBitVectorIndex::Select0(int n) const {
 
 int SimpleSuccinctBitVectorIndex::Select1(int n) const {
   DCHECK_GT(n, 0);
+  if (index_type_ == IndexType::kTwoLevel) {
+    return TwoLevelSelect<true>(n);
+  }
 
   // Narrow down the range of |index_| on which lower bound is performed.
   int lb1_cache_index = n / lb1_cache_increment_;
@@ -300,6 +529,28 @@ int SimpleSuccinctBitVectorIndex::Select1(int n) const {
   return index - 1;
 }
 
+int SimpleSuccinctBitVectorIndex::CountConsecutive1Bits(int index) const {
+  DCHECK_GE(index, 0);
+  const int num_words = (length_ + 7) / 8;
+  int word_index = index / 64;
+  if (word_index >= num_words) {
+    return 0;
+  }
+  // The shifted-in bits are 0, so the run never exceeds the word.
+  int result = absl::countr_one(LoadWord64(word_index) >> (index % 64));
+  if (result < 64 - index % 64) {
+    return result;
+  }
+  while (++word_index < num_words) {
+    const int count = absl::countr_one(LoadWord64(word_index));
+    result += count;
+    if (count < 64) {
+      break;
+    }
+  }
+  return result;
+}
+
 }  // namespace louds
 }  // namespace storage
 }  // namespace mozc
@@ -41,6 +41,20 @@ namespace louds {
 // This is simple(naive) C++ implementation of succinct bit vector.
 class SimpleSuccinctBitVectorIndex {
  public:
+  // Layout of the index built by Init().
+  enum class IndexType {
+    // The number of 1-bits is stored for each chunk of chunk_size bytes.
+    // Select binary-searches the chunks, narrowed by the lower bound caches.
+    kChunk,
+    // Two-level rank directory: the number of 1-bits before each 512-bit
+    // block, and the 9-bit relative counts of its 64-bit words packed into
+    // one 64-bit word next to it.  Select starts from a sampled block for
+    // every 512 bits of the same value.  Rank and Select are faster at the
+    // cost of about 25% of the bit vector size.  chunk_size and the lower
+    // bound caches are not used.
+    kTwoLevel,
+  };
+
   // The default chunk_size is 32.
   SimpleSuccinctBitVectorIndex()
       : data_(nullptr),
@@ -63,7 +77,12 @@ class SimpleSuccinctBitVectorIndex {
   // pointed by data, so it is caller's responsibility to manage its life time.
   // The 'data' needs to be aligned to 32-bits.
   void Init(const uint8_t *data, int length, size_t lb0_cache_size,
-            size_t lb1_cache_size);
+            size_t lb1_cache_size, IndexType index_type);
+
+  void Init(const uint8_t *data, int length, size_t lb0_cache_size,
+            size_t lb1_cache_size) {
+    Init(data, length, lb0_cache_size, lb1_cache_size, IndexType::kChunk);
+  }
 
   void Init(const uint8_t *data, int length) { Init(data, length, 0, 0); }
 
@@ -90,19 +109,41 @@ class SimpleSuccinctBitVectorIndex {
   // Returned index is 0-origin.
   int Select1(int n) const;
 
-  int GetNum1Bits() const { return index_.back(); }
-  int GetNum0Bits() const { return 8 * length_ - index_.back(); }
+  // Returns the length of the run of 1-bits starting at the index.
+  int CountConsecutive1Bits(int index) const;
+
+  int GetNum1Bits() const { return num_1_bits_; }
+  int GetNum0Bits() const { return 8 * length_ - num_1_bits_; }
+
+  IndexType index_type() const { return index_type_; }
 
  private:
+  // Implementations for IndexType::kTwoLevel.
+  uint64_t LoadWord64(int word_index) const;
+  int TwoLevelRank1(int n) const;
+  template <bool kBit>
+  int TwoLevelSelect(int n) const;
+
   // The order of members is optimized to minimize the padding size.
   const uint8_t *data_;
   int length_;
   int chunk_size_;
+  int num_1_bits_ = 0;
+  IndexType index_type_ = IndexType::kChunk;
   std::vector<int> index_;
   std::vector<const int *> lb0_cache_;
   int lb0_cache_increment_;
   int lb1_cache_increment_;
   std::vector<const int *> lb1_cache_;
+
+  // For IndexType::kTwoLevel.  rank_directory_[2 * i] is the number of 1-bits
+  // before the i-th block and rank_directory_[2 * i + 1] packs the 1-bits in
+  // the block before its j-th word at bits [9 * (j - 1), 9 * j), j in [1, 7].
+  // select{0,1}_samples_[k] is the block containing the (512 * k + 1)-th
+  // {0,1}-bit.
+  std::vector<uint64_t> rank_directory_;
+  std::vector<int> select0_samples_;
+  std::vector<int> select1_samples_;
 };
 
 }  // namespace louds
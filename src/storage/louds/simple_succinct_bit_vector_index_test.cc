@@ -32,6 +32,7 @@
 #include <cstdint>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "testing/gunit.h"
 
@@ -191,4 +192,91 @@ TEST_P(SimpleSuccinctBitVectorIndexTest, Pattern2) {
 }
 INSTANTIATE_TEST_CASE(GenPattern2Test);
 
+TEST(SimpleSuccinctBitVectorIndexTwoLevelTest, SameAsChunkIndex) {
+  using IndexType = SimpleSuccinctBitVectorIndex::IndexType;
+  std::vector<std::string> data_set = {
+      std::string(4, '\x00'),        std::string(4, '\xFF'),
+      std::string(1028, '\x00'),     std::string(1028, '\xFF'),
+      std::string(1024, '\xAA'),     std::string("\x01\x00\x00\x80", 4),
+      std::string(68, '\x00') + std::string("\x10\x00\x00\x00", 4),
+  };
+  // Sparse and dense bit vectors spanning many blocks and select samples.
+  for (const int length : {4, 60, 64, 68, 124, 4096, 4100}) {
+    std::string sparse(length, '\x00'), dense(length, '\xFF');
+    uint32_t x = 12345;
+    for (int i = 0; i < length; ++i) {
+      x = x * 1103515245 + 12345;
+      if (x % 7 == 0) {
+        sparse[i] = static_cast<char>(1 << (x >> 16) % 8);
+      }
+      if (x % 5 == 0) {
+        dense[i] = static_cast<char>(x >> 8);
+      }
+    }
+    data_set.push_back(sparse);
+    data_set.push_back(dense);
+  }
+
+  for (const std::string &data : data_set) {
+    const uint8_t *ptr = reinterpret_cast<const uint8_t *>(data.data());
+    SimpleSuccinctBitVectorIndex expected, actual;
+    expected.Init(ptr, data.size(), 8, 8);
+    actual.Init(ptr, data.size(), 0, 0, IndexType::kTwoLevel);
+    EXPECT_EQ(actual.index_type(), IndexType::kTwoLevel);
+    ASSERT_EQ(actual.GetNum0Bits(), expected.GetNum0Bits());
+    ASSERT_EQ(actual.GetNum1Bits(), expected.GetNum1Bits());
+    for (int i = 0; i <= data.size() * 8; ++i) {
+      ASSERT_EQ(actual.Rank1(i), expected.Rank1(i)) << i;
+      ASSERT_EQ(actual.Rank0(i), expected.Rank0(i)) << i;
+    }
+    for (int i = 1; i <= expected.GetNum1Bits(); ++i) {
+      ASSERT_EQ(actual.Select1(i), expected.Select1(i)) << i;
+    }
+    for (int i = 1; i <= expected.GetNum0Bits(); ++i) {
+      ASSERT_EQ(actual.Select0(i), expected.Select0(i)) << i;
+    }
+  }
+}
+
+TEST(SimpleSuccinctBitVectorIndexTwoLevelTest, Reinit) {
+  const std::string data(1024, '\xCC');
+  const uint8_t *ptr = reinterpret_cast<const uint8_t *>(data.data());
+  SimpleSuccinctBitVectorIndex bit_vector;
+  bit_vector.Init(ptr, data.size(), 0, 0,
+                  SimpleSuccinctBitVectorIndex::IndexType::kTwoLevel);
+  EXPECT_EQ(bit_vector.Select1(4096), 8191);
+  bit_vector.Reset();
+  EXPECT_EQ(bit_vector.index_type(),
+            SimpleSuccinctBitVectorIndex::IndexType::kChunk);
+  bit_vector.Init(ptr, data.size());
+  EXPECT_EQ(bit_vector.GetNum1Bits(), 4096);
+  EXPECT_EQ(bit_vector.Select1(4096), 8191);
+  EXPECT_EQ(bit_vector.Rank1(8192), 4096);
+}
+
+TEST(SimpleSuccinctBitVectorIndexRunTest, CountConsecutive1Bits) {
+  // 0x00 (8 bits), 0xFF * 10 (80 bits), 0x0F (4 bits), then 0x00 and 0xFF * 4
+  // at the end of a 32 bit tail word.
+  std::string data(20, '\xFF');
+  data[0] = '\x00';
+  data[11] = '\x0F';
+  data[12] = '\x00';
+  data[13] = '\x00';
+  data[14] = '\x00';
+  data[15] = '\x00';
+  const uint8_t *ptr = reinterpret_cast<const uint8_t *>(data.data());
+  SimpleSuccinctBitVectorIndex bit_vector;
+  bit_vector.Init(ptr, data.size());
+  for (int i = 0; i < data.size() * 8; ++i) {
+    int expected = 0;
+    while (i + expected < data.size() * 8 && bit_vector.Get(i + expected)) {
+      ++expected;
+    }
+    EXPECT_EQ(bit_vector.CountConsecutive1Bits(i), expected) << i;
+  }
+  EXPECT_EQ(bit_vector.CountConsecutive1Bits(8), 84);
+  EXPECT_EQ(bit_vector.CountConsecutive1Bits(128), 32);
+  EXPECT_EQ(bit_vector.CountConsecutive1Bits(160), 0);
+}
+
 }  // namespace
@@ -30,6 +30,7 @@
 #ifndef MOZC_STORAGE_LRU_CACHE_H_
 #define MOZC_STORAGE_LRU_CACHE_H_
 
+#include <cstdint>
 #include <memory>
 
 #include "absl/container/flat_hash_map.h"
@@ -59,6 +60,9 @@ class LruCache {
     Element* prev;
     Key key;
     Value value;
+    // Increases every time the element is pushed to the head of the LRU
+    // list, so the list is sorted by it in descending order.
+    uint64_t seq;
   };
 
   // Adds the specified key/value pair into the cache, putting it at the head
@@ -99,6 +103,11 @@ class LruCache {
 
   bool HasKey(const Key& key) const { return table_.find(key) != table_.end(); }
 
+  // Returns the element of the key, or nullptr.  Doesn't change the LRU order.
+  const Element* FindElement(const Key& key) const {
+    return LookupInternal(key);
+  }
+
   // Returns the head of LRU list
   const Element* Head() const { return lru_head_; }
   Element* MutableHead() const { return lru_head_; }
@@ -152,6 +161,7 @@ class LruCache {
   size_t block_capacity_ = 0;   // num elements the current blocks can hold
   size_t next_block_size_ = 0;  // size of the next block to allocate
   const size_t max_elements_;   // maximum elements to hold
+  uint64_t last_seq_ = 0;       // Element::seq of the last pushed element
 };
 
 template <typename Key, typename Value>
@@ -248,6 +258,7 @@ void LruCache<Key, Value>::PushLRUHead(Element* element) {
     return;
   }
   RemoveFromLRU(element);
+  element->seq = ++last_seq_;
   element->next = lru_head_;
   lru_head_ = element;
   if (element->next != nullptr) {
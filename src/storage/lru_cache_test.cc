@@ -29,6 +29,7 @@
 
 #include "storage/lru_cache.h"
 
+#include <cstdint>
 #include <vector>
 
 #include "testing/gmock.h"
@@ -101,6 +102,30 @@ TEST(LruCacheTest, LookupWithoutInsert) {
   EXPECT_TRUE(cache.LookupWithoutInsert(3) == nullptr);
 }
 
+TEST(LruCacheTest, SeqFollowsLruOrder) {
+  LruCache<int, int> cache(3);
+  for (int i = 0; i < 4; ++i) {
+    cache.Insert(i, i);
+  }
+  EXPECT_TRUE(cache.Lookup(1) != nullptr);
+  cache.Insert(2, 2);
+  EXPECT_THAT(GetOrderedKeys(cache), ElementsAre(2, 1, 3));
+
+  // The list is sorted by seq in descending order.
+  uint64_t prev_seq = cache.Head()->seq + 1;
+  for (const auto *element = cache.Head(); element != nullptr;
+       element = element->next) {
+    EXPECT_LT(element->seq, prev_seq);
+    prev_seq = element->seq;
+  }
+
+  // Only the LRU order changes the seq.
+  const uint64_t seq = cache.FindElement(3)->seq;
+  EXPECT_TRUE(cache.LookupWithoutInsert(3) != nullptr);
+  EXPECT_EQ(cache.FindElement(3)->seq, seq);
+  EXPECT_TRUE(cache.FindElement(0) == nullptr);
+}
+
 TEST(LruCacheTest, Erase) {
   LruCache<int, int> cache(5);
   for (int i = 0; i < 3; ++i) {
@@ -30,21 +30,28 @@
 #include "storage/lru_storage.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <deque>
 #include <ios>
 #include <iterator>
-#include <list>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/algorithm/container.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/flags/flag.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "base/bits.h"
 #include "base/clock.h"
 #include "base/file_stream.h"
@@ -52,6 +59,10 @@
 #include "base/hash.h"
 #include "base/logging.h"
 #include "base/mmap.h"
+#include "base/thread.h"
+
+ABSL_FLAG(bool, lru_storage_async_flush, false,
+          "allow LruStorage to write files in a background thread");
 
 namespace mozc {
 namespace storage {
@@ -60,11 +71,44 @@ namespace {
 constexpr size_t kMaxLruSize = 1000000;  // 1M
 constexpr size_t kMaxValueSize = 1024;   // 1024 byte
 
-// The byte length used to store LRU properties.
+// The byte length used to store LRU properties and state.  Every field is a
+// uint32 at the following offset.
+constexpr size_t kMagicOffset = 0;
+constexpr size_t kVersionOffset = 4;
+constexpr size_t kValueSizeOffset = 8;   // User specified value size.
+constexpr size_t kSizeOffset = 12;       // LRU capacity.
+constexpr size_t kSeedOffset = 16;       // Fingerprint seed.
+constexpr size_t kTableSizeOffset = 20;  // Number of slots in the table.
+constexpr size_t kUsedOffset = 24;       // Number of items.
+constexpr size_t kHeadOffset = 28;       // The most recently used item.
+constexpr size_t kTailOffset = 32;       // The least recently used item.
+constexpr size_t kStateOffset = 36;      // kClean or kUpdating.
+constexpr size_t kFileHeaderSize = 40;
+
+constexpr uint32_t kMagic = 0x534c5a4d;  // "MZLS"
+constexpr uint32_t kVersion = 2;
+constexpr uint32_t kClean = 0;
+constexpr uint32_t kUpdating = 1;
+
+// The version 1 file has only the following header and the items.
 // * 4 bytes for user specified value size
 // * 4 bytes for LRU capacity
 // * 4 bytes for fingerprint seed
-constexpr size_t kFileHeaderSize = 12;
+// As the value size is at most kMaxValueSize, it never matches kMagic.
+constexpr size_t kV1FileHeaderSize = 12;
+
+// The byte length of the previous and the next item indices of each item.
+constexpr size_t kLinkSize = 8;
+
+// The byte length of a table slot: the item index plus one (zero for an empty
+// slot) and the low 32 bits of the fingerprint.
+constexpr size_t kSlotSize = 8;
+
+// Represents no item in the LRU links and the table.
+constexpr uint32_t kNil = 0xffffffff;
+
+// The unit of the regions written back in the asynchronous flush mode.
+constexpr size_t kDirtyChunkSize = 256;
 
 constexpr uint64_t k62DaysInSec = 62 * 24 * 60 * 60;
 
@@ -103,8 +147,253 @@ class CompareByTimeStamp {
   }
 };
 
+uint32_t GetHeader(const char *header, size_t offset) {
+  return LoadUnaligned<uint32_t>(header + offset);
+}
+
+// Returns the number of table slots for |size| items.  The load factor is kept
+// at most 2/3 so that the probes stay short.
+uint32_t GetTableSize(size_t size) {
+  uint32_t table_size = 8;
+  while (table_size < size + size / 2 + 1) {
+    table_size *= 2;
+  }
+  return table_size;
+}
+
+size_t GetFileSize(size_t value_size, size_t size) {
+  return kFileHeaderSize +
+         (LruStorage::kItemHeaderSize + value_size + kLinkSize) * size +
+         kSlotSize * GetTableSize(size);
+}
+
+bool IsValidProperty(size_t value_size, size_t size) {
+  if (value_size % 4 != 0) {
+    LOG(ERROR) << "value_size_ must be 4 byte alignment";
+    return false;
+  }
+  if (size == 0 || size > kMaxLruSize) {
+    LOG(ERROR) << "LRU size is invalid: " << size;
+    return false;
+  }
+  if (value_size == 0 || value_size > kMaxValueSize) {
+    LOG(ERROR) << "value_size is invalid: " << value_size;
+    return false;
+  }
+  return true;
+}
+
+// Returns the header of an empty file.
+std::string MakeHeader(size_t value_size, size_t size, uint32_t seed,
+                       uint32_t state) {
+  std::string header(kFileHeaderSize, '\0');
+  char *ptr = header.data();
+  StoreUnaligned<uint32_t>(kMagic, ptr + kMagicOffset);
+  StoreUnaligned<uint32_t>(kVersion, ptr + kVersionOffset);
+  StoreUnaligned<uint32_t>(static_cast<uint32_t>(value_size),
+                           ptr + kValueSizeOffset);
+  StoreUnaligned<uint32_t>(static_cast<uint32_t>(size), ptr + kSizeOffset);
+  StoreUnaligned<uint32_t>(seed, ptr + kSeedOffset);
+  StoreUnaligned<uint32_t>(GetTableSize(size), ptr + kTableSizeOffset);
+  StoreUnaligned<uint32_t>(0, ptr + kUsedOffset);
+  StoreUnaligned<uint32_t>(kNil, ptr + kHeadOffset);
+  StoreUnaligned<uint32_t>(kNil, ptr + kTailOffset);
+  StoreUnaligned<uint32_t>(state, ptr + kStateOffset);
+  return header;
+}
+
+// Converts |filename| in the version 1 format, if so, to the current one.  The
+// items are kept as they are, and the index is rebuilt when the file is opened
+// as it is marked as being updated.
+bool MaybeMigrateFromV1(const std::string &filename) {
+  {
+    InputFileStream ifs(filename, std::ios::binary);
+    char magic[4];
+    if (!ifs.read(magic, sizeof(magic)) ||
+        LoadUnaligned<uint32_t>(magic) == kMagic) {
+      return true;
+    }
+  }
+
+  absl::StatusOr<std::string> contents = FileUtil::GetContents(filename);
+  if (!contents.ok()) {
+    LOG(ERROR) << "Cannot read " << filename << ": " << contents.status();
+    return false;
+  }
+  if (contents->size() < kV1FileHeaderSize) {
+    LOG(ERROR) << "file size is too small";
+    return false;
+  }
+  const char *ptr = contents->data();
+  const uint32_t value_size = LoadUnalignedAdvance<uint32_t>(ptr);
+  const uint32_t size = LoadUnalignedAdvance<uint32_t>(ptr);
+  const uint32_t seed = LoadUnalignedAdvance<uint32_t>(ptr);
+  if (!IsValidProperty(value_size, size)) {
+    return false;
+  }
+  const size_t items_size = (LruStorage::kItemHeaderSize + value_size) * size;
+  if (contents->size() != kV1FileHeaderSize + items_size) {
+    LOG(ERROR) << "LRU file is broken";
+    return false;
+  }
+
+  LOG(INFO) << "Converting " << filename << " to version " << kVersion;
+  std::string image = MakeHeader(value_size, size, seed, kUpdating);
+  image.append(ptr, items_size);
+  image.resize(GetFileSize(value_size, size), '\0');
+  const std::string tmp_filename = filename + ".tmp";
+  if (absl::Status s = FileUtil::SetContents(tmp_filename, image); !s.ok()) {
+    LOG(ERROR) << "Cannot write " << tmp_filename << ": " << s;
+    return false;
+  }
+  if (absl::Status s = FileUtil::AtomicRename(tmp_filename, filename);
+      !s.ok()) {
+    LOG(ERROR) << "Cannot replace " << filename << ": " << s;
+    FileUtil::UnlinkOrLogError(tmp_filename);
+    return false;
+  }
+  return true;
+}
+
 }  // namespace
 
+// Writes the regions copied by Sync() to the file in a background thread, in
+// the order they are scheduled.
+class LruStorage::AsyncWriter {
+ public:
+  struct Batch {
+    std::string bytes;
+    // Pairs of a file offset and the length of the next part of |bytes| to be
+    // written there.
+    std::vector<std::pair<size_t, size_t>> ranges;
+  };
+
+  explicit AsyncWriter(std::string filename)
+      : filename_(std::move(filename)), thread_([this] { Run(); }) {}
+
+  AsyncWriter(const AsyncWriter &) = delete;
+  AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+  // Writes all the scheduled batches before returning.
+  ~AsyncWriter() {
+    {
+      absl::MutexLock lock(&mutex_);
+      stopped_ = true;
+    }
+    thread_.Join();
+  }
+
+  void Schedule(Batch batch) ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
+    batches_.push_back(std::move(batch));
+  }
+
+  // Blocks until all the scheduled batches are written.  Returns false if any
+  // write failed since the last call.
+  bool Wait() ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(absl::Condition(this, &AsyncWriter::IsIdle));
+    return std::exchange(ok_, true);
+  }
+
+ private:
+  bool IsIdle() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return batches_.empty() && !writing_;
+  }
+
+  bool HasWork() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return !batches_.empty() || stopped_;
+  }
+
+  void Run() ABSL_LOCKS_EXCLUDED(mutex_) {
+    mutex_.Lock();
+    while (true) {
+      mutex_.Await(absl::Condition(this, &AsyncWriter::HasWork));
+      if (batches_.empty()) {
+        break;
+      }
+      std::deque<Batch> batches;
+      batches.swap(batches_);
+      writing_ = true;
+      mutex_.Unlock();
+      const bool ok = Write(batches);
+      mutex_.Lock();
+      writing_ = false;
+      ok_ = ok_ && ok;
+    }
+    mutex_.Unlock();
+  }
+
+  bool Write(const std::deque<Batch> &batches) const {
+    OutputFileStream ofs(filename_,
+                         std::ios::binary | std::ios::in | std::ios::out);
+    if (!ofs) {
+      LOG(ERROR) << "cannot open " << filename_;
+      return false;
+    }
+    for (const Batch &batch : batches) {
+      const char *bytes = batch.bytes.data();
+      for (const auto &[offset, length] : batch.ranges) {
+        ofs.seekp(static_cast<std::streamoff>(offset));
+        ofs.write(bytes, static_cast<std::streamsize>(length));
+        bytes += length;
+      }
+    }
+    ofs.flush();
+    if (!ofs) {
+      LOG(ERROR) << "cannot write " << filename_;
+      return false;
+    }
+    return true;
+  }
+
+  const std::string filename_;
+  absl::Mutex mutex_;
+  std::deque<Batch> batches_ ABSL_GUARDED_BY(mutex_);
+  bool writing_ ABSL_GUARDED_BY(mutex_) = false;
+  bool stopped_ ABSL_GUARDED_BY(mutex_) = false;
+  bool ok_ ABSL_GUARDED_BY(mutex_) = true;
+  Thread thread_;
+};
+
+LruStorage::LruStorage() = default;
+
+LruStorage::LruStorage(LruStorage &&other) { *this = std::move(other); }
+
+LruStorage &LruStorage::operator=(LruStorage &&other) {
+  if (this == &other) {
+    return *this;
+  }
+  Close();
+  value_size_ = other.value_size_;
+  size_ = other.size_;
+  seed_ = other.seed_;
+  table_size_ = other.table_size_;
+  used_ = std::exchange(other.used_, 0);
+  head_ = std::exchange(other.head_, kNil);
+  tail_ = std::exchange(other.tail_, kNil);
+  index_stale_ = other.index_stale_;
+  // The pointers stay valid as the mapping and the heap buffer move as is.
+  header_ = std::exchange(other.header_, nullptr);
+  begin_ = std::exchange(other.begin_, nullptr);
+  end_ = std::exchange(other.end_, nullptr);
+  links_ = std::exchange(other.links_, nullptr);
+  table_ = std::exchange(other.table_, nullptr);
+  filename_ = std::move(other.filename_);
+  data_ = std::exchange(other.data_, absl::Span<char>());
+  mmap_ = std::move(other.mmap_);
+  use_async_flush_ = other.use_async_flush_;
+  flush_interval_ = other.flush_interval_;
+  last_sync_time_ = other.last_sync_time_;
+  buffer_ = std::move(other.buffer_);
+  dirty_chunks_ = std::move(other.dirty_chunks_);
+  is_dirty_ = std::move(other.is_dirty_);
+  writer_ = std::move(other.writer_);
+  return *this;
+}
+
+LruStorage::~LruStorage() { Close(); }
+
 std::unique_ptr<LruStorage> LruStorage::Create(const char *filename) {
   auto result = std::make_unique<LruStorage>();
   if (!result->Open(filename)) {
@@ -148,42 +437,34 @@ bool LruStorage::CreateStorageFile(const char *filename, size_t value_size,
     return false;
   }
 
-  const uint32_t value_size_uint32 = static_cast<uint32_t>(value_size);
-  const uint32_t size_uint32 = static_cast<uint32_t>(size);
-
-  ofs.write(reinterpret_cast<const char *>(&value_size_uint32),
-            sizeof(value_size_uint32));
-  ofs.write(reinterpret_cast<const char *>(&size_uint32), sizeof(size_uint32));
-  ofs.write(reinterpret_cast<const char *>(&seed), sizeof(seed));
-  std::vector<char> ary(value_size, '\0');
-  const uint32_t last_access_time = 0;
-  const uint64_t fp = 0;
-
-  for (size_t i = 0; i < size; ++i) {
-    ofs.write(reinterpret_cast<const char *>(&fp), sizeof(fp));
-    ofs.write(reinterpret_cast<const char *>(&last_access_time),
-              sizeof(last_access_time));
-    ofs.write(reinterpret_cast<const char *>(&ary[0]),
-              static_cast<std::streamsize>(ary.size() * sizeof(ary[0])));
+  const std::string header = MakeHeader(value_size, size, seed, kClean);
+  ofs.write(header.data(), static_cast<std::streamsize>(header.size()));
+  // The items, the links and the table are all zero.
+  const std::vector<char> zeros(4096, '\0');
+  for (size_t rest = GetFileSize(value_size, size) - header.size(); rest > 0;) {
+    const size_t length = std::min(rest, zeros.size());
+    ofs.write(zeros.data(), static_cast<std::streamsize>(length));
+    rest -= length;
   }
 
   return true;
 }
 
-// Reopen file after initializing mapped page.
 bool LruStorage::Clear() {
   // Don't need to clear the page if the lru list is empty
-  if (mmap_.empty() || lru_list_.empty()) {
+  if (data_.empty() || used_ == 0) {
     return true;
   }
-  const size_t offset = sizeof(value_size_) + sizeof(size_) + sizeof(seed_);
-  if (offset >= mmap_.size()) {  // should not happen
-    return false;
-  }
-  std::fill(mmap_.begin() + offset, mmap_.end(), 0);
-  lru_list_.clear();
-  lru_map_.clear();
-  Open(mmap_.begin(), mmap_.size());
+  std::fill(begin_, data_.data() + data_.size(), 0);
+  used_ = 0;
+  head_ = kNil;
+  tail_ = kNil;
+  index_stale_ = false;
+  SetHeader(kUsedOffset, used_);
+  SetHeader(kHeadOffset, head_);
+  SetHeader(kTailOffset, tail_);
+  SetHeader(kStateOffset, kClean);
+  MarkAllDirty();
   return true;
 }
 
@@ -240,15 +521,15 @@ bool LruStorage::Merge(const LruStorage &storage) {
   const size_t old_size = static_cast<size_t>(end_ - begin_);
   const size_t new_size = std::min(buf.size(), old_size);
 
-  // TODO(taku): this part is not atomic.
-  // If the converter process is killed while memcpy or memset is running,
-  // the storage data will be broken.
+  // If the converter process is killed while the items are copied, the index
+  // is rebuilt on the next Open().
+  SetHeader(kStateOffset, kUpdating);
   char *new_end = absl::c_copy_n(buf, new_size, begin_);
   if (new_size < old_size) {
     std::fill(new_end, end_, 0);
   }
-
-  return Open(mmap_.begin(), mmap_.size());
+  RebuildIndex();
+  return true;
 }
 
 bool LruStorage::OpenOrCreate(const char *filename, size_t new_value_size,
@@ -310,71 +591,95 @@ bool LruStorage::OpenOrCreate(const char *filename, size_t new_value_size,
   return true;
 }
 
+void LruStorage::EnableAsyncFlush(absl::Duration flush_interval) {
+  use_async_flush_ = absl::GetFlag(FLAGS_lru_storage_async_flush);
+  flush_interval_ = flush_interval;
+}
+
 bool LruStorage::Open(const char *filename) {
-  absl::StatusOr<Mmap> mmap = Mmap::Map(filename, Mmap::READ_WRITE);
-  if (!mmap.ok()) {
-    LOG(ERROR) << "Cannot open " << filename
-               << " with read+write mode: " << mmap.status();
-    return false;
+  // The pending writes have to reach the file before it is read again.
+  if (writer_ != nullptr) {
+    Flush();
+    writer_.reset();
   }
-  mmap_ = *std::move(mmap);
 
-  if (mmap_.size() < 8) {
-    LOG(ERROR) << "file size is too small";
+  if (!MaybeMigrateFromV1(filename)) {
     return false;
   }
 
+  if (use_async_flush_) {
+    absl::StatusOr<std::string> contents = FileUtil::GetContents(filename);
+    if (!contents.ok()) {
+      LOG(ERROR) << "Cannot read " << filename << ": " << contents.status();
+      return false;
+    }
+    mmap_.Close();
+    buffer_ = *std::move(contents);
+    data_ = absl::MakeSpan(buffer_);
+    writer_ = std::make_unique<AsyncWriter>(filename);
+    last_sync_time_ = Clock::GetAbslTime();
+  } else {
+    absl::StatusOr<Mmap> mmap = Mmap::Map(filename, Mmap::READ_WRITE);
+    if (!mmap.ok()) {
+      LOG(ERROR) << "Cannot open " << filename
+                 << " with read+write mode: " << mmap.status();
+      return false;
+    }
+    mmap_ = *std::move(mmap);
+    data_ = absl::MakeSpan(mmap_.begin(), mmap_.size());
+  }
+
   filename_ = filename;
-  return Open(mmap_.begin(), mmap_.size());
+  return OpenImage();
 }
 
-bool LruStorage::Open(char *ptr, size_t ptr_size) {
-  begin_ = ptr;
-  end_ = ptr + ptr_size;
-
-  value_size_ = LoadUnalignedAdvance<uint32_t>(begin_);
-  size_ = LoadUnalignedAdvance<uint32_t>(begin_);
-  seed_ = LoadUnalignedAdvance<uint32_t>(begin_);
-
-  if (value_size_ % 4 != 0) {
-    LOG(ERROR) << "value_size_ must be 4 byte alignment";
+bool LruStorage::OpenImage() {
+  if (data_.size() < kFileHeaderSize) {
+    LOG(ERROR) << "file size is too small";
     return false;
   }
 
-  if (size_ == 0 || size_ > kMaxLruSize) {
-    LOG(ERROR) << "LRU size is invalid: " << size_;
+  const char *header = data_.data();
+  if (GetHeader(header, kMagicOffset) != kMagic ||
+      GetHeader(header, kVersionOffset) != kVersion) {
+    LOG(ERROR) << "Unknown file format";
     return false;
   }
 
-  if (value_size_ == 0 || value_size_ > kMaxValueSize) {
-    LOG(ERROR) << "value_size is invalid: " << value_size_;
+  value_size_ = GetHeader(header, kValueSizeOffset);
+  size_ = GetHeader(header, kSizeOffset);
+  seed_ = GetHeader(header, kSeedOffset);
+  table_size_ = GetHeader(header, kTableSizeOffset);
+  if (!IsValidProperty(value_size_, size_)) {
     return false;
   }
-
-  if (mmap_.size() != kFileHeaderSize + item_size() * size_) {
+  if (table_size_ != GetTableSize(size_) ||
+      data_.size() != GetFileSize(value_size_, size_)) {
     LOG(ERROR) << "LRU file is broken";
     return false;
   }
 
-  std::vector<char *> ary;
-  for (char *begin = begin_; begin < end_; begin += item_size()) {
-    ary.push_back(begin);
+  header_ = data_.data();
+  begin_ = header_ + kFileHeaderSize;
+  end_ = begin_ + item_size() * size_;
+  links_ = end_;
+  table_ = links_ + kLinkSize * size_;
+  used_ = GetHeader(header_, kUsedOffset);
+  head_ = GetHeader(header_, kHeadOffset);
+  tail_ = GetHeader(header_, kTailOffset);
+  index_stale_ = false;
+  if (writer_ != nullptr) {
+    dirty_chunks_.clear();
+    is_dirty_.assign((data_.size() + kDirtyChunkSize - 1) / kDirtyChunkSize,
+                     false);
   }
-  std::stable_sort(ary.begin(), ary.end(), CompareByTimeStamp());
 
-  lru_list_.clear();
-  lru_map_.clear();
-  char *next = nullptr;
-  for (size_t i = 0; i < ary.size(); ++i) {
-    if (GetTimeStamp(ary[i]) != 0) {
-      lru_list_.push_back(ary[i]);
-      lru_map_[GetFP(ary[i])] = std::prev(lru_list_.end());
-    } else if (next == nullptr) {
-      next = ary[i];
-    }
+  // The index is trusted only if the last update was completed and it is
+  // consistent with the items.
+  if (GetHeader(header_, kStateOffset) != kClean || !IsIndexValid()) {
+    LOG(WARNING) << "Rebuilding the index of " << filename_;
+    RebuildIndex();
   }
-  next_item_ = (next != nullptr) ? next : end_;
-  DCHECK_LE(next_item_, end_);
 
   // At the time file is opened, perform clean up.
   DeleteElementsUntouchedFor62Days();
@@ -382,29 +687,375 @@ bool LruStorage::Open(char *ptr, size_t ptr_size) {
   return true;
 }
 
+bool LruStorage::IsIndexValid() const {
+  if (used_ > size_) {
+    return false;
+  }
+  if (used_ == 0 ? (head_ != kNil || tail_ != kNil)
+                 : (head_ >= used_ || tail_ >= used_)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < used_; ++i) {
+    const uint32_t p = prev(i);
+    const uint32_t n = next(i);
+    if ((p != kNil && p >= used_) || (n != kNil && n >= used_)) {
+      return false;
+    }
+  }
+
+  // The list from the head reaches the tail through all the items.
+  uint32_t n = 0;
+  for (uint32_t i = head_, p = kNil; i != kNil; p = i, i = next(i), ++n) {
+    if (n >= used_ || prev(i) != p) {
+      return false;
+    }
+  }
+  if (n != used_ || (used_ > 0 && next(tail_) != kNil)) {
+    return false;
+  }
+
+  // Every item is in the table exactly once.
+  std::vector<bool> found(used_, false);
+  uint32_t filled = 0;
+  for (uint32_t s = 0; s < table_size_; ++s) {
+    const uint32_t index = LoadUnaligned<uint32_t>(table_ + s * kSlotSize);
+    if (index == 0) {
+      continue;
+    }
+    if (index > used_ || found[index - 1]) {
+      return false;
+    }
+    found[index - 1] = true;
+    ++filled;
+  }
+  return filled == used_;
+}
+
+void LruStorage::RebuildIndex() {
+  SetHeader(kStateOffset, kUpdating);
+
+  // Drops the duplicated fingerprints but the most recently used one.
+  std::vector<uint32_t> order;
+  for (uint32_t i = 0; i < size_; ++i) {
+    if (GetTimeStamp(item(i)) != 0) {
+      order.push_back(i);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+    return GetTimeStamp(item(a)) > GetTimeStamp(item(b));
+  });
+  std::vector<bool> keep(size_, false);
+  absl::flat_hash_set<uint64_t> seen;
+  for (const uint32_t i : order) {
+    keep[i] = seen.insert(GetFP(item(i))).second;
+  }
+
+  // Packs the items at the beginning, keeping their order.
+  std::vector<uint32_t> new_index(size_, kNil);
+  uint32_t used = 0;
+  for (uint32_t i = 0; i < size_; ++i) {
+    if (!keep[i]) {
+      continue;
+    }
+    if (used != i) {
+      std::copy_n(item(i), item_size(), item(used));
+    }
+    new_index[i] = used++;
+  }
+  std::fill(item(used), end_, 0);
+  std::vector<uint32_t> lru;  // Item indices from the most recently used.
+  lru.reserve(used);
+  for (const uint32_t i : order) {
+    if (new_index[i] != kNil) {
+      lru.push_back(new_index[i]);
+    }
+  }
+
+  std::fill(links_, table_ + kSlotSize * table_size_, 0);
+  for (size_t k = 0; k < lru.size(); ++k) {
+    char *ptr = links_ + lru[k] * kLinkSize;
+    ptr = StoreUnaligned<uint32_t>(k == 0 ? kNil : lru[k - 1], ptr);
+    StoreUnaligned<uint32_t>(k + 1 == lru.size() ? kNil : lru[k + 1], ptr);
+    TableInsert(GetFP(item(lru[k])), lru[k]);
+  }
+  used_ = used;
+  head_ = lru.empty() ? kNil : lru.front();
+  tail_ = lru.empty() ? kNil : lru.back();
+  index_stale_ = false;
+  SetHeader(kUsedOffset, used_);
+  SetHeader(kHeadOffset, head_);
+  SetHeader(kTailOffset, tail_);
+  SetHeader(kStateOffset, kClean);
+  MarkAllDirty();
+}
+
 void LruStorage::Close() {
   // Perform clean up before closing the file.
   DeleteElementsUntouchedFor62Days();
 
+  if (writer_ != nullptr) {
+    Flush();
+    writer_.reset();
+  }
+
   filename_.clear();
+  data_ = absl::Span<char>();
   mmap_.Close();
-  lru_list_.clear();
-  lru_map_.clear();
+  buffer_.clear();
+  buffer_.shrink_to_fit();
+  dirty_chunks_.clear();
+  is_dirty_.clear();
+  header_ = begin_ = end_ = links_ = table_ = nullptr;
+  used_ = 0;
+  head_ = tail_ = kNil;
+}
+
+bool LruStorage::Sync() {
+  if (writer_ == nullptr || dirty_chunks_.empty()) {
+    return true;
+  }
+  absl::c_sort(dirty_chunks_);
+
+  // The file is marked as being updated until the whole batch is written, so
+  // that the index is rebuilt if the writes are interrupted.
+  char updating[sizeof(uint32_t)];
+  StoreUnaligned<uint32_t>(kUpdating, updating);
+  AsyncWriter::Batch batch;
+  if (dirty_chunks_.front() != 0) {
+    batch.bytes.append(updating, sizeof(updating));
+    batch.ranges.emplace_back(kStateOffset, sizeof(updating));
+  }
+  for (auto it = dirty_chunks_.begin(); it != dirty_chunks_.end();) {
+    // Consecutive chunks are written at once.
+    const uint32_t first = *it;
+    uint32_t last = first;
+    while (++it != dirty_chunks_.end() && *it == last + 1) {
+      ++last;
+    }
+    const size_t offset = first * kDirtyChunkSize;
+    const size_t length =
+        std::min((last - first + 1) * kDirtyChunkSize, data_.size() - offset);
+    const size_t start = batch.bytes.size();
+    batch.bytes.append(data_.data() + offset, length);
+    if (offset == 0) {
+      batch.bytes.replace(start + kStateOffset, sizeof(updating), updating,
+                          sizeof(updating));
+    }
+    batch.ranges.emplace_back(offset, length);
+  }
+  batch.bytes.append(header_ + kStateOffset, sizeof(uint32_t));
+  batch.ranges.emplace_back(kStateOffset, sizeof(uint32_t));
+
+  for (const uint32_t chunk : dirty_chunks_) {
+    is_dirty_[chunk] = false;
+  }
+  dirty_chunks_.clear();
+  last_sync_time_ = Clock::GetAbslTime();
+  writer_->Schedule(std::move(batch));
+  return true;
+}
+
+bool LruStorage::Flush() {
+  if (writer_ == nullptr) {
+    return true;
+  }
+  Sync();
+  return writer_->Wait();
+}
+
+void LruStorage::MarkDirty(const char *ptr, size_t length) {
+  if (writer_ == nullptr) {
+    return;
+  }
+  const size_t offset = ptr - data_.data();
+  for (size_t chunk = offset / kDirtyChunkSize;
+       chunk <= (offset + length - 1) / kDirtyChunkSize; ++chunk) {
+    if (!is_dirty_[chunk]) {
+      is_dirty_[chunk] = true;
+      dirty_chunks_.push_back(static_cast<uint32_t>(chunk));
+    }
+  }
+}
+
+void LruStorage::MarkAllDirty() {
+  if (writer_ != nullptr && !data_.empty()) {
+    MarkDirty(data_.data(), data_.size());
+  }
+}
+
+void LruStorage::MaybeSync() {
+  if (writer_ != nullptr && flush_interval_ > absl::ZeroDuration() &&
+      Clock::GetAbslTime() - last_sync_time_ >= flush_interval_) {
+    Sync();
+  }
+}
+
+void LruStorage::BeginUpdate() { SetHeader(kStateOffset, kUpdating); }
+
+void LruStorage::EndUpdate() {
+  // Keeps the mark for the index to be rebuilt after Write().
+  if (!index_stale_) {
+    SetHeader(kStateOffset, kClean);
+  }
+}
+
+void LruStorage::SetHeader(size_t offset, uint32_t value) {
+  StoreUnaligned<uint32_t>(value, header_ + offset);
+  MarkDirty(header_ + offset, sizeof(value));
+}
+
+uint32_t LruStorage::prev(uint32_t i) const {
+  return LoadUnaligned<uint32_t>(links_ + i * kLinkSize);
+}
+
+uint32_t LruStorage::next(uint32_t i) const {
+  return LoadUnaligned<uint32_t>(links_ + i * kLinkSize + 4);
+}
+
+void LruStorage::SetLinks(uint32_t i, uint32_t prev, uint32_t next) {
+  char *ptr = links_ + i * kLinkSize;
+  StoreUnaligned<uint32_t>(next, StoreUnaligned<uint32_t>(prev, ptr));
+  MarkDirty(ptr, kLinkSize);
+}
+
+void LruStorage::Unlink(uint32_t i) {
+  const uint32_t p = prev(i);
+  const uint32_t n = next(i);
+  if (p == kNil) {
+    head_ = n;
+    SetHeader(kHeadOffset, head_);
+  } else {
+    SetLinks(p, prev(p), n);
+  }
+  if (n == kNil) {
+    tail_ = p;
+    SetHeader(kTailOffset, tail_);
+  } else {
+    SetLinks(n, p, next(n));
+  }
+}
+
+void LruStorage::PushFront(uint32_t i) {
+  SetLinks(i, kNil, head_);
+  if (head_ == kNil) {
+    tail_ = i;
+    SetHeader(kTailOffset, tail_);
+  } else {
+    SetLinks(head_, i, next(head_));
+  }
+  head_ = i;
+  SetHeader(kHeadOffset, head_);
+}
+
+void LruStorage::MoveToFront(uint32_t i) {
+  if (i != head_) {
+    Unlink(i);
+    PushFront(i);
+  }
+}
+
+uint32_t LruStorage::Find(uint64_t fp) const {
+  if (table_ == nullptr) {
+    return kNil;
+  }
+  const uint32_t tag = static_cast<uint32_t>(fp);
+  const uint32_t mask = table_size_ - 1;
+  // The probes are bounded in case the file is broken.
+  for (uint32_t n = 0, s = tag & mask; n < table_size_;
+       ++n, s = (s + 1) & mask) {
+    const char *slot = table_ + s * kSlotSize;
+    const uint32_t index = LoadUnaligned<uint32_t>(slot);
+    if (index == 0) {
+      break;
+    }
+    if (LoadUnaligned<uint32_t>(slot + 4) == tag && index <= used_ &&
+        GetFP(item(index - 1)) == fp) {
+      return index - 1;
+    }
+  }
+  return kNil;
+}
+
+char *LruStorage::FindSlot(uint64_t fp, uint32_t i) const {
+  const uint32_t mask = table_size_ - 1;
+  for (uint32_t n = 0, s = static_cast<uint32_t>(fp) & mask; n < table_size_;
+       ++n, s = (s + 1) & mask) {
+    char *slot = table_ + s * kSlotSize;
+    const uint32_t index = LoadUnaligned<uint32_t>(slot);
+    if (index == 0) {
+      break;
+    }
+    if (index == i + 1) {
+      return slot;
+    }
+  }
+  return nullptr;
+}
+
+void LruStorage::TableInsert(uint64_t fp, uint32_t i) {
+  const uint32_t tag = static_cast<uint32_t>(fp);
+  const uint32_t mask = table_size_ - 1;
+  for (uint32_t s = tag & mask;; s = (s + 1) & mask) {
+    char *slot = table_ + s * kSlotSize;
+    if (LoadUnaligned<uint32_t>(slot) == 0) {
+      StoreUnaligned<uint32_t>(tag, StoreUnaligned<uint32_t>(i + 1, slot));
+      MarkDirty(slot, kSlotSize);
+      return;
+    }
+  }
+}
+
+void LruStorage::TableErase(uint64_t fp, uint32_t i) {
+  char *slot = FindSlot(fp, i);
+  if (slot == nullptr) {
+    LOG(ERROR) << "The table doesn't have the item (broken?)";
+    return;
+  }
+  // Shifts the following entries back to fill the hole, so that every entry
+  // stays reachable from its home slot without tombstones.
+  const uint32_t mask = table_size_ - 1;
+  uint32_t hole = static_cast<uint32_t>((slot - table_) / kSlotSize);
+  for (uint32_t s = (hole + 1) & mask;; s = (s + 1) & mask) {
+    char *next_slot = table_ + s * kSlotSize;
+    if (LoadUnaligned<uint32_t>(next_slot) == 0) {
+      break;
+    }
+    const uint32_t home = LoadUnaligned<uint32_t>(next_slot + 4) & mask;
+    // The entry can't move if its home is cyclically in (hole, s].
+    const bool stays =
+        (hole <= s) ? (hole < home && home <= s) : (hole < home || home <= s);
+    if (!stays) {
+      std::copy_n(next_slot, kSlotSize, table_ + hole * kSlotSize);
+      MarkDirty(table_ + hole * kSlotSize, kSlotSize);
+      hole = s;
+    }
+  }
+  std::fill_n(table_ + hole * kSlotSize, kSlotSize, 0);
+  MarkDirty(table_ + hole * kSlotSize, kSlotSize);
+}
+
+void LruStorage::TableReplace(uint64_t fp, uint32_t from, uint32_t to) {
+  char *slot = FindSlot(fp, from);
+  if (slot == nullptr) {
+    LOG(ERROR) << "The table doesn't have the item (broken?)";
+    return;
+  }
+  StoreUnaligned<uint32_t>(to + 1, slot);
+  MarkDirty(slot, sizeof(uint32_t));
 }
 
 const char *LruStorage::Lookup(const absl::string_view key,
                                uint32_t *last_access_time) const {
-  const uint64_t fp = FingerprintWithSeed(key, seed_);
-  const auto it = lru_map_.find(fp);
-  if (it == lru_map_.end()) {
+  const uint32_t i = Find(FingerprintWithSeed(key, seed_));
+  if (i == kNil) {
     return nullptr;
   }
-  const uint32_t timestamp = GetTimeStamp(*it->second);
+  const uint32_t timestamp = GetTimeStamp(item(i));
   if (IsOlderThan62Days(timestamp)) {
     return nullptr;
   }
   *last_access_time = timestamp;
-  return GetValue(*it->second);
+  return GetValue(item(i));
 }
 
 void LruStorage::GetAllValues(std::vector<std::string> *values) const {
@@ -412,31 +1063,32 @@ void LruStorage::GetAllValues(std::vector<std::string> *values) const {
   values->clear();
   // Iterate data from the most recently used element to the least recently used
   // element.
-  for (const char *ptr : lru_list_) {
-    const uint32_t timestamp = GetTimeStamp(ptr);
+  for (uint32_t i = head_, n = 0; i != kNil && n < used_; i = next(i), ++n) {
+    const uint32_t timestamp = GetTimeStamp(item(i));
     if (IsOlderThan62Days(timestamp)) {
       break;
     }
     // Default constructor of string is not applicable
     // because value's size() must return value_size_.
-    DCHECK(ptr);
-    values->emplace_back(GetValue(ptr), value_size_);
+    values->emplace_back(GetValue(item(i)), value_size_);
   }
 }
 
 bool LruStorage::Touch(const absl::string_view key) {
-  const uint64_t fp = FingerprintWithSeed(key, seed_);
-  auto it = lru_map_.find(fp);
-  if (it == lru_map_.end()) {
+  const uint32_t i = Find(FingerprintWithSeed(key, seed_));
+  if (i == kNil) {
     return false;
   }
-  const uint32_t timestamp = GetTimeStamp(*it->second);
+  const uint32_t timestamp = GetTimeStamp(item(i));
   if (IsOlderThan62Days(timestamp)) {
     return false;
   }
-  Update(*it->second);
-  // Move the node pointed to by it->second to the front.
-  lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+  BeginUpdate();
+  Update(item(i));
+  MarkDirty(item(i), kItemHeaderSize);
+  MoveToFront(i);
+  EndUpdate();
+  MaybeSync();
   return true;
 }
 
@@ -445,118 +1097,122 @@ bool LruStorage::Insert(const absl::string_view key, const char *value) {
     return false;
   }
   const uint64_t fp = FingerprintWithSeed(key, seed_);
-
-  // If the data corresponding to |key| already exists in LRU, update it.
-  {
-    auto it = lru_map_.find(fp);
-    if (it != lru_map_.end()) {
-      // Overwrite the data pointed to by it->second and move it to the front.
-      Update(*it->second, fp, value, value_size_);
-      lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
-      return true;
-    }
-  }
-
-  // If the LRU is full or we run out of the mmap region, drop the least
-  // recently used element (actually, the least recently used element is
-  // overwritten with new data).
-  if (lru_map_.size() >= size_ || next_item_ == end_) {
-    auto it = std::prev(lru_list_.end());  // Least recently used data.
-    const uint64_t old_fp = GetFP(*it);
-    lru_map_.erase(old_fp);
-    lru_list_.splice(lru_list_.begin(), lru_list_, it);  // Move to front.
-    Update(*it, fp, value, value_size_);
-    lru_map_[fp] = it;
-    return true;
-  }
-
-  // A new item can be assigned in the mmap region.
-  if (next_item_ < end_) {
-    Update(next_item_, fp, value, value_size_);
-    lru_list_.push_front(next_item_);
-    lru_map_[fp] = lru_list_.begin();
-    // Advance next_item_ for next item.
-    next_item_ += item_size();
-    DCHECK_LE(next_item_, end_);
-    return true;
+  BeginUpdate();
+  uint32_t i = Find(fp);
+  if (i != kNil) {
+    // If the data corresponding to |key| already exists in LRU, overwrite it
+    // and move it to the front.
+    MoveToFront(i);
+  } else if (used_ >= size_) {
+    // If the LRU is full, the least recently used element is overwritten with
+    // new data.
+    i = tail_;
+    TableErase(GetFP(item(i)), i);
+    TableInsert(fp, i);
+    MoveToFront(i);
+  } else {
+    // A new item is appended to the item array.
+    i = used_++;
+    SetHeader(kUsedOffset, used_);
+    TableInsert(fp, i);
+    PushFront(i);
   }
-
-  LOG(ERROR) << "Insertion failed because no more mmap region is available.";
-  return false;
+  Update(item(i), fp, value, value_size_);
+  MarkDirty(item(i), item_size());
+  EndUpdate();
+  MaybeSync();
+  return true;
 }
 
 bool LruStorage::TryInsert(const absl::string_view key, const char *value) {
   const uint64_t fp = FingerprintWithSeed(key, seed_);
-  auto it = lru_map_.find(fp);
-  if (it != lru_map_.end()) {
-    Update(*it->second, fp, value, value_size_);
-    lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+  const uint32_t i = Find(fp);
+  if (i != kNil) {
+    BeginUpdate();
+    Update(item(i), fp, value, value_size_);
+    MarkDirty(item(i), item_size());
+    MoveToFront(i);
+    EndUpdate();
+    MaybeSync();
   }
   return true;
 }
 
 bool LruStorage::Delete(const absl::string_view key) {
   const uint64_t fp = FingerprintWithSeed(key, seed_);
-  return Delete(fp);
-}
-
-bool LruStorage::Delete(uint64_t fp) {
-  auto it = lru_map_.find(fp);
-  return (it == lru_map_.end() || Delete(fp, it->second));
-}
-
-bool LruStorage::Delete(std::list<char *>::iterator it) {
-  return (it == lru_list_.end() || Delete(GetFP(*it), it));
+  const uint32_t i = Find(fp);
+  if (i == kNil) {
+    return true;
+  }
+  BeginUpdate();
+  const bool result = Delete(fp, i);
+  EndUpdate();
+  MaybeSync();
+  return result;
 }
 
-bool LruStorage::Delete(uint64_t fp, std::list<char *>::iterator it) {
-  // Determine the last element in the mmap region.
-  if (next_item_ < begin_ + item_size()) {
-    LOG(ERROR) << "next_item_ points to invalid location (broken?)";
+bool LruStorage::Delete(uint64_t fp, uint32_t i) {
+  if (i >= used_) {
+    LOG(ERROR) << "The item is out of range (broken?)";
     return false;
   }
-  next_item_ -= item_size();
-
-  // Backup the location of mmap region to which another element will be moved.
-  char *deleted_item_pos = *it;
-
-  // Erase the LRU structure for (fp, it).
-  lru_map_.erase(fp);
-  lru_list_.erase(it);
-
-  if (next_item_ != deleted_item_pos) {
-    // Move the region for the last element to the deleted location.  Then,
-    // update the LRU structure for the moved element (the pointer to mmap
-    // region in the list node is updated.)
-    std::copy_n(next_item_, item_size(), deleted_item_pos);
-    const uint64_t fp = GetFP(next_item_);
-    *lru_map_[fp] = deleted_item_pos;
+  Unlink(i);
+  TableErase(fp, i);
+
+  const uint32_t last = used_ - 1;
+  if (i != last) {
+    // Move the last element to the deleted location, and update the links and
+    // the table for the moved element.
+    std::copy_n(item(last), item_size(), item(i));
+    MarkDirty(item(i), item_size());
+    const uint32_t p = prev(last);
+    const uint32_t n = next(last);
+    SetLinks(i, p, n);
+    if (p == kNil) {
+      head_ = i;
+      SetHeader(kHeadOffset, head_);
+    } else {
+      SetLinks(p, prev(p), i);
+    }
+    if (n == kNil) {
+      tail_ = i;
+      SetHeader(kTailOffset, tail_);
+    } else {
+      SetLinks(n, i, next(n));
+    }
+    TableReplace(GetFP(item(i)), last, i);
   }
 
-  // Clear the region for the next_item_.
-  std::fill_n(next_item_, item_size(), 0);
+  // Clear the region for the last element.
+  std::fill_n(item(last), item_size(), 0);
+  MarkDirty(item(last), item_size());
+  SetLinks(last, 0, 0);
+  used_ = last;
+  SetHeader(kUsedOffset, used_);
 
   return true;
 }
 
 int LruStorage::DeleteElementsBefore(uint32_t timestamp) {
-  if (mmap_.empty() || begin_ >= end_) {
+  if (data_.empty() || tail_ == kNil ||
+      GetTimeStamp(item(tail_)) >= timestamp) {
     return 0;
   }
   int num_deleted = 0;
-  while (!lru_list_.empty()) {
-    auto it = std::prev(lru_list_.end());
-    const uint32_t last_access_time = GetTimeStamp(*it);
+  BeginUpdate();
+  while (tail_ != kNil) {
+    const uint32_t last_access_time = GetTimeStamp(item(tail_));
     if (last_access_time >= timestamp) {
       break;
     }
-    if (Delete(it)) {
+    if (Delete(GetFP(item(tail_)), tail_)) {
       ++num_deleted;
       continue;
     }
     LOG(ERROR) << "Deletion failed for an item.  Abort deletion.";
     break;
   }
+  EndUpdate();
   return num_deleted;
 }
 
@@ -571,6 +1227,7 @@ void LruStorage::Write(size_t i, uint64_t fp, const absl::string_view value,
                        uint32_t last_access_time) {
   DCHECK_LT(i, size_);
   char *ptr = begin_ + (i * item_size());
+  MarkDirty(ptr, item_size());
   ptr = StoreUnaligned<uint64_t>(fp, ptr);
   ptr = StoreUnaligned<uint32_t>(last_access_time, ptr);
   if (value.size() == value_size_) {
@@ -578,6 +1235,8 @@ void LruStorage::Write(size_t i, uint64_t fp, const absl::string_view value,
   } else {
     LOG(ERROR) << "value size is not " << value_size_ << " byte.";
   }
+  index_stale_ = true;
+  SetHeader(kStateOffset, kUpdating);
 }
 
 void LruStorage::Read(size_t i, uint64_t *fp, std::string *value,
@@ -30,29 +30,62 @@
 #ifndef MOZC_STORAGE_LRU_STORAGE_H_
 #define MOZC_STORAGE_LRU_STORAGE_H_
 
+#include <cstddef>
 #include <cstdint>
-#include <list>
 #include <memory>
 #include <string>
 #include <vector>
 
-#include "absl/container/flat_hash_map.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "base/mmap.h"
 
 namespace mozc {
 namespace storage {
 
+// A fixed-capacity LRU of fixed-size values, stored in a file.
+//
+// The file keeps its index as well as the items, so opening it doesn't walk
+// the items:
+//  * The header holds the properties, the number of items, both ends of the
+//    LRU list and whether an update is in progress.
+//  * The items are packed at the beginning of the item array.
+//  * The LRU links hold the previous and the next item of each item.
+//  * The open-addressed table maps fingerprints to items with linear probing.
+//    Each slot holds the item index and the low 32 bits of the fingerprint,
+//    so a miss doesn't touch the items.
+// If the file was left in the middle of an update, or was written in the
+// older format without the index, the index is rebuilt from the items on
+// Open().
 class LruStorage {
  public:
-  LruStorage() = default;
-  LruStorage(LruStorage &&) = default;
-  LruStorage &operator=(LruStorage &&) = default;
-  ~LruStorage() { Close(); }
+  LruStorage();
+  LruStorage(LruStorage &&);
+  LruStorage &operator=(LruStorage &&);
+  ~LruStorage();
+
+  // Switches to the asynchronous flush mode, which takes effect from the next
+  // Open().  In this mode, the file is loaded into memory instead of being
+  // mapped, and the mutations only update the memory.  The modified items are
+  // written back to the file by a background thread at Sync(), or at the first
+  // mutation after |flush_interval| has passed since the last flush (never if
+  // it is zero).  Ignored when --lru_storage_async_flush is false.
+  void EnableAsyncFlush(absl::Duration flush_interval);
+  bool async_flush() const { return writer_ != nullptr; }
 
   bool Open(const char *filename);
   void Close();
 
+  // Starts writing the modified items back to the file in the background and
+  // returns without waiting.  Does nothing unless in the asynchronous flush
+  // mode, as the mapped file is already up to date.
+  bool Sync();
+
+  // Durability barrier: blocks until all the mutations made so far are written
+  // to the file.  Returns false if any write since the last Flush() failed.
+  bool Flush();
+
   // Try to open existing database
   // If the file is broken or cannot open, tries to recreate
   // new file
@@ -120,7 +153,7 @@ class LruStorage {
   size_t size() const { return size_; }
 
   // Returns the number of items in LRU.
-  size_t used_size() const { return lru_list_.size(); }
+  size_t used_size() const { return used_; }
 
   // Returns the seed used for fingerprinting.
   uint32_t seed() const { return seed_; }
@@ -129,7 +162,8 @@ class LruStorage {
 
   // Writes one entry at |i| th index.
   // i must be 0 <= i < size.
-  // This data will not update the index of the storage.
+  // This data will not update the index of the storage.  The index is rebuilt
+  // by Merge() or the next Open().
   void Write(size_t i, uint64_t fp, absl::string_view value,
              uint32_t last_access_time);
 
@@ -156,26 +190,81 @@ class LruStorage {
   static constexpr size_t kItemHeaderSize = 12;
 
  private:
-  // Initializes this LRU from memory buffer.
-  bool Open(char *ptr, size_t ptr_size);
-
-  // Deletes the element from |fp| or |it|.
-  bool Delete(uint64_t fp);
-  bool Delete(std::list<char *>::iterator it);
-
-  // Actual implementation of Delete() methods.
-  bool Delete(uint64_t fp, std::list<char *>::iterator it);
+  class AsyncWriter;
+
+  // Initializes this LRU from the file image in |data_|.
+  bool OpenImage();
+
+  // Returns true if the LRU links and the table in the image only refer to the
+  // items in use and link all of them.
+  bool IsIndexValid() const;
+
+  // Rebuilds the LRU links and the table from the items.  The items are
+  // packed and deduplicated, and ordered by their timestamps.
+  void RebuildIndex();
+
+  // Marks the file as being updated during a mutation, so that the index is
+  // rebuilt if the process dies before EndUpdate().
+  void BeginUpdate();
+  void EndUpdate();
+
+  char *item(uint32_t i) const { return begin_ + i * item_size(); }
+  uint32_t prev(uint32_t i) const;
+  uint32_t next(uint32_t i) const;
+  void SetLinks(uint32_t i, uint32_t prev, uint32_t next);
+  void SetHeader(size_t offset, uint32_t value);
+
+  // LRU list operations on the item indices.
+  void Unlink(uint32_t i);
+  void PushFront(uint32_t i);
+  void MoveToFront(uint32_t i);
+
+  // Table operations.  Find() returns the item index of |fp|, or kNil.
+  // FindSlot() returns the slot of the |i| th item, or nullptr.
+  uint32_t Find(uint64_t fp) const;
+  char *FindSlot(uint64_t fp, uint32_t i) const;
+  void TableInsert(uint64_t fp, uint32_t i);
+  void TableErase(uint64_t fp, uint32_t i);
+  void TableReplace(uint64_t fp, uint32_t from, uint32_t to);
+
+  // Deletes the |i| th item, whose fingerprint is |fp|.  The last item is moved
+  // to the hole to keep the items packed.
+  bool Delete(uint64_t fp, uint32_t i);
+
+  // Records the region to be written back by the next Sync().
+  void MarkDirty(const char *ptr, size_t length);
+  void MarkAllDirty();
+
+  // Calls Sync() if |flush_interval_| has passed since the last one.
+  void MaybeSync();
 
   size_t value_size_ = 0;
   size_t size_ = 0;
   uint32_t seed_ = 0;
-  char *next_item_ = nullptr;
-  char *begin_ = nullptr;
+  uint32_t table_size_ = 0;
+  uint32_t used_ = 0;
+  uint32_t head_ = 0xffffffff;  // The most recently used item.
+  uint32_t tail_ = 0xffffffff;  // The least recently used item.
+  bool index_stale_ = false;  // Set by Write().
+  char *header_ = nullptr;
+  char *begin_ = nullptr;  // The item array.
   char *end_ = nullptr;
+  char *links_ = nullptr;
+  char *table_ = nullptr;
   std::string filename_;
-  std::list<char *> lru_list_;  // Front is the most recently used data.
-  absl::flat_hash_map<uint64_t, std::list<char *>::iterator> lru_map_;
+  // The whole file image, which is either |mmap_| or |buffer_|.
+  absl::Span<char> data_;
   Mmap mmap_;
+
+  // Used only in the asynchronous flush mode.
+  bool use_async_flush_ = false;
+  absl::Duration flush_interval_;
+  absl::Time last_sync_time_;
+  std::string buffer_;
+  // Chunks of the image modified since the last Sync(), in no order.
+  std::vector<uint32_t> dirty_chunks_;
+  std::vector<bool> is_dirty_;
+  std::unique_ptr<AsyncWriter> writer_;
 };
 
 }  // namespace storage
@@ -0,0 +1,173 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark of LruStorage by capacity.
+//
+// For each size, the storage is filled with random keys, and then it measures
+// Open() with the index in the file, Open() with the index rebuilt from the
+// items (as after an interrupted update or the migration from the older
+// format), and --num_operations lookups of existing keys, lookups of missing
+// keys and insertions.
+//
+// Usage:
+//   lru_storage_benchmark --sizes=10000,100000
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "base/file/temp_dir.h"
+#include "base/file_util.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "base/status.h"
+#include "base/stopwatch.h"
+#include "storage/lru_storage.h"
+#include "testing/benchmark_result.h"
+
+ABSL_FLAG(std::vector<std::string>, sizes,
+          std::vector<std::string>({"10000", "100000"}),
+          "Capacities of the storage.");
+ABSL_FLAG(int32_t, num_operations, 1000000,
+          "Number of lookups and insertions.");
+
+namespace mozc {
+namespace storage {
+namespace {
+
+constexpr size_t kValueSize = 4;
+constexpr uint32_t kSeed = 0x76fef;
+
+// The offset of the state in the file header.  Setting it to non-zero makes
+// the next Open() rebuild the index.
+constexpr size_t kStateOffset = 36;
+
+void RunSize(const std::string &filename, int size) {
+  Random random;
+  std::vector<std::string> keys(size);
+  for (std::string &key : keys) {
+    key = random.ByteString(16);
+  }
+  {
+    CHECK(LruStorage::CreateStorageFile(filename.c_str(), kValueSize, size,
+                                        kSeed));
+    LruStorage storage;
+    CHECK(storage.Open(filename.c_str()));
+    for (const std::string &key : keys) {
+      storage.Insert(key, key.data());
+    }
+  }
+
+  {
+    LruStorage storage;
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    CHECK(storage.Open(filename.c_str()));
+    testing::PrintBenchmarkResult(absl::StrFormat("%d/open", size),
+                                  stopwatch.GetElapsed(), 1);
+  }
+  {
+    absl::StatusOr<std::string> contents = FileUtil::GetContents(filename);
+    CHECK_OK(contents);
+    (*contents)[kStateOffset] = 1;
+    CHECK_OK(FileUtil::SetContents(filename, *contents));
+    LruStorage storage;
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    CHECK(storage.Open(filename.c_str()));
+    testing::PrintBenchmarkResult(absl::StrFormat("%d/open_with_rebuild", size),
+                                  stopwatch.GetElapsed(), 1);
+  }
+
+  LruStorage storage;
+  CHECK(storage.Open(filename.c_str()));
+  const int num_operations = absl::GetFlag(FLAGS_num_operations);
+  std::vector<std::string> missing_keys(1024);
+  for (std::string &key : missing_keys) {
+    key = random.ByteString(16);
+  }
+  {
+    int64_t found = 0;
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    for (int i = 0; i < num_operations; ++i) {
+      found += storage.Lookup(keys[i % keys.size()]) != nullptr;
+    }
+    testing::PrintBenchmarkResult(absl::StrFormat("%d/lookup_hit", size),
+                                  stopwatch.GetElapsed(), num_operations);
+    CHECK_EQ(found, num_operations);
+  }
+  {
+    int64_t found = 0;
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    for (int i = 0; i < num_operations; ++i) {
+      found += storage.Lookup(missing_keys[i % missing_keys.size()]) != nullptr;
+    }
+    testing::PrintBenchmarkResult(absl::StrFormat("%d/lookup_miss", size),
+                                  stopwatch.GetElapsed(), num_operations);
+    CHECK_EQ(found, 0);
+  }
+  {
+    // Half of the insertions evict the least recently used items.
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    for (int i = 0; i < num_operations; ++i) {
+      const std::string &key = (i % 2 == 0)
+                                   ? keys[i % keys.size()]
+                                   : missing_keys[i % missing_keys.size()];
+      storage.Insert(key, key.data());
+    }
+    testing::PrintBenchmarkResult(absl::StrFormat("%d/insert", size),
+                                  stopwatch.GetElapsed(), num_operations);
+  }
+}
+
+void Run() {
+  absl::StatusOr<TempDirectory> temp_dir =
+      TempDirectory::Default().CreateTempDirectory();
+  CHECK_OK(temp_dir);
+  const std::string filename = FileUtil::JoinPath(temp_dir->path(), "lru");
+
+  for (const std::string &size : absl::GetFlag(FLAGS_sizes)) {
+    int value = 0;
+    CHECK(absl::SimpleAtoi(size, &value)) << size;
+    RunSize(filename, value);
+  }
+}
+
+}  // namespace
+}  // namespace storage
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  mozc::storage::Run();
+  return 0;
+}
@@ -40,18 +40,29 @@
 #include <utility>
 #include <vector>
 
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
 #include "absl/random/random.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "base/clock_mock.h"
 #include "base/file/temp_dir.h"
 #include "base/file_util.h"
+#include "base/hash.h"
 #include "base/logging.h"
 #include "base/random.h"
+#include "base/status.h"
 #include "storage/lru_cache.h"
 #include "testing/gmock.h"
 #include "testing/gunit.h"
 #include "testing/mozctest.h"
 
+ABSL_DECLARE_FLAG(bool, lru_storage_async_flush);
+
 namespace mozc {
 namespace storage {
 namespace {
@@ -117,9 +128,28 @@ std::vector<std::string> GetValuesInStorageOrder(const LruStorage &storage) {
   return ret;
 }
 
+std::string GetFileContents(const std::string &filename) {
+  absl::StatusOr<std::string> contents = FileUtil::GetContents(filename);
+  CHECK_OK(contents);
+  return *std::move(contents);
+}
+
 }  // namespace
 
 class LruStorageTest : public ::testing::Test {
+ protected:
+  // EnableAsyncFlush() takes effect only with the flag.
+  void SetUp() override {
+    original_async_flush_ = absl::GetFlag(FLAGS_lru_storage_async_flush);
+    absl::SetFlag(&FLAGS_lru_storage_async_flush, true);
+  }
+
+  void TearDown() override {
+    absl::SetFlag(&FLAGS_lru_storage_async_flush, original_async_flush_);
+  }
+
+ private:
+  bool original_async_flush_ = false;
 };
 
 TEST_F(LruStorageTest, LruStorageTest) {
@@ -558,5 +588,273 @@ TEST_F(LruStorageTest, OldDataAreNotLookedUp) {
   EXPECT_TRUE(storage.Touch("4444"));
 }
 
+TEST_F(LruStorageTest, AsyncFlush) {
+  ScopedClockMock clock(absl::FromUnixSeconds(10000));
+
+  constexpr size_t kValueSize = 4;
+  constexpr size_t kNumElements = 32;
+  TempFile mmap_file(testing::MakeTempFileOrDie());
+  TempFile async_file(testing::MakeTempFileOrDie());
+  LruStorage mmap_storage;
+  ASSERT_TRUE(mmap_storage.OpenOrCreate(mmap_file.path().c_str(), kValueSize,
+                                        kNumElements, kSeed));
+  LruStorage async_storage;
+  async_storage.EnableAsyncFlush(absl::ZeroDuration());
+  ASSERT_TRUE(async_storage.OpenOrCreate(async_file.path().c_str(),
+                                         kValueSize, kNumElements, kSeed));
+  EXPECT_TRUE(async_storage.async_flush());
+
+  // Both storages go through the same mutations, including evictions and
+  // deletions that move items.
+  for (int i = 0; i < kNumElements * 2; ++i) {
+    const std::string key = absl::StrFormat("key%d", i);
+    const std::string value = absl::StrFormat("%04d", i);
+    for (LruStorage *storage : {&mmap_storage, &async_storage}) {
+      EXPECT_TRUE(storage->Insert(key, value.data()));
+      // Flushes in the middle so that later mutations overwrite the items
+      // already written.
+      EXPECT_TRUE(storage->Sync());
+      if (i % 3 == 0) {
+        storage->Touch(absl::StrFormat("key%d", i / 2));
+      }
+      if (i % 5 == 0) {
+        EXPECT_TRUE(storage->Delete(absl::StrFormat("key%d", i - 1)));
+      }
+    }
+    clock->Advance(absl::Seconds(1));
+  }
+  for (int i = 0; i < kNumElements * 2; ++i) {
+    const std::string key = absl::StrFormat("key%d", i);
+    EXPECT_EQ(async_storage.LookupAsString(key),
+              mmap_storage.LookupAsString(key));
+  }
+
+  EXPECT_TRUE(async_storage.Flush());
+  EXPECT_EQ(GetFileContents(async_file.path()),
+            GetFileContents(mmap_file.path()));
+
+  // Clear() rewrites the whole file.
+  mmap_storage.Clear();
+  async_storage.Clear();
+  EXPECT_TRUE(async_storage.Flush());
+  EXPECT_EQ(GetFileContents(async_file.path()),
+            GetFileContents(mmap_file.path()));
+}
+
+TEST_F(LruStorageTest, AsyncFlushOnClose) {
+  constexpr size_t kValueSize = 4;
+  constexpr size_t kNumElements = 4;
+  TempFile file(testing::MakeTempFileOrDie());
+  {
+    LruStorage storage;
+    storage.EnableAsyncFlush(absl::ZeroDuration());
+    ASSERT_TRUE(storage.OpenOrCreate(file.path().c_str(), kValueSize,
+                                     kNumElements, kSeed));
+    EXPECT_TRUE(storage.Insert("1111", "aaaa"));
+    EXPECT_TRUE(storage.Insert("2222", "bbbb"));
+  }
+  LruStorage storage;
+  ASSERT_TRUE(storage.Open(file.path().c_str()));
+  EXPECT_EQ(storage.LookupAsString("1111"), "aaaa");
+  EXPECT_EQ(storage.LookupAsString("2222"), "bbbb");
+}
+
+TEST_F(LruStorageTest, AsyncFlushInterval) {
+  ScopedClockMock clock(absl::FromUnixSeconds(10000));
+
+  constexpr size_t kValueSize = 4;
+  constexpr size_t kNumElements = 4;
+  TempFile file(testing::MakeTempFileOrDie());
+  LruStorage storage;
+  storage.EnableAsyncFlush(absl::Seconds(10));
+  ASSERT_TRUE(storage.OpenOrCreate(file.path().c_str(), kValueSize,
+                                   kNumElements, kSeed));
+  const std::string initial_contents = GetFileContents(file.path());
+
+  EXPECT_TRUE(storage.Insert("1111", "aaaa"));
+  clock->Advance(absl::Seconds(5));
+  EXPECT_TRUE(storage.Insert("2222", "bbbb"));
+  EXPECT_EQ(GetFileContents(file.path()), initial_contents);
+
+  // The first mutation after the interval starts the flush.
+  clock->Advance(absl::Seconds(5));
+  EXPECT_TRUE(storage.Touch("1111"));
+  for (int i = 0; i < 1000; ++i) {
+    const std::string contents = GetFileContents(file.path());
+    if (absl::StrContains(contents, "aaaa") &&
+        absl::StrContains(contents, "bbbb")) {
+      break;
+    }
+    absl::SleepFor(absl::Milliseconds(10));
+  }
+  ASSERT_TRUE(storage.Flush());
+  LruStorage reader;
+  ASSERT_TRUE(reader.Open(file.path().c_str()));
+  EXPECT_EQ(reader.LookupAsString("1111"), "aaaa");
+  EXPECT_EQ(reader.LookupAsString("2222"), "bbbb");
+}
+
+TEST_F(LruStorageTest, MigrateFromV1) {
+  ScopedClockMock clock(absl::FromUnixSeconds(10000));
+
+  // Version 1 file: the properties followed by the items in no order.
+  constexpr uint32_t kValueSize = 4;
+  constexpr uint32_t kNumElements = 5;
+  std::string v1;
+  const auto append_uint32 = [&v1](uint32_t value) {
+    v1.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  };
+  const auto append_item = [&](absl::string_view key, absl::string_view value,
+                               uint32_t timestamp) {
+    const uint64_t fp = FingerprintWithSeed(key, kSeed);
+    v1.append(reinterpret_cast<const char *>(&fp), sizeof(fp));
+    append_uint32(timestamp);
+    v1.append(value.data(), value.size());
+  };
+  append_uint32(kValueSize);
+  append_uint32(kNumElements);
+  append_uint32(kSeed);
+  v1.append(LruStorage::kItemHeaderSize + kValueSize, '\0');  // Empty.
+  append_item("1111", "aaaa", 9000);
+  append_item("2222", "bbbb", 9500);
+  append_item("1111", "AAAA", 8000);  // Older duplicate.
+  append_item("3333", "cccc", 9200);
+  ASSERT_EQ(v1.size(),
+            12 + (LruStorage::kItemHeaderSize + kValueSize) * kNumElements);
+
+  TempFile file(testing::MakeTempFileOrDie());
+  ASSERT_OK(FileUtil::SetContents(file.path(), v1));
+  for (int i = 0; i < 2; ++i) {
+    LruStorage storage;
+    ASSERT_TRUE(storage.Open(file.path().c_str()));
+    EXPECT_EQ(storage.value_size(), kValueSize);
+    EXPECT_EQ(storage.size(), kNumElements);
+    EXPECT_EQ(storage.seed(), kSeed);
+    EXPECT_EQ(storage.used_size(), 3);
+    EXPECT_EQ(storage.LookupAsString("1111"), "aaaa");
+    EXPECT_EQ(storage.LookupAsString("2222"), "bbbb");
+    EXPECT_EQ(storage.LookupAsString("3333"), "cccc");
+    std::vector<std::string> values;
+    storage.GetAllValues(&values);
+    EXPECT_THAT(values, ::testing::ElementsAre("bbbb", "cccc", "aaaa"));
+  }
+  EXPECT_NE(GetFileContents(file.path()).substr(0, 4), v1.substr(0, 4));
+}
+
+TEST_F(LruStorageTest, RebuildIndexAfterInterruptedUpdate) {
+  ScopedClockMock clock(absl::FromUnixSeconds(10000));
+
+  constexpr size_t kValueSize = 4;
+  constexpr size_t kNumElements = 4;
+  TempFile file(testing::MakeTempFileOrDie());
+  {
+    LruStorage storage;
+    ASSERT_TRUE(storage.OpenOrCreate(file.path().c_str(), kValueSize,
+                                     kNumElements, kSeed));
+    EXPECT_TRUE(storage.Insert("1111", "aaaa"));
+    clock->Advance(absl::Seconds(1));
+    EXPECT_TRUE(storage.Insert("2222", "bbbb"));
+    clock->Advance(absl::Seconds(1));
+    EXPECT_TRUE(storage.Insert("3333", "cccc"));
+  }
+
+  // Simulates a crash in the middle of an update: the state is left updating
+  // and the table, which is at the end of the file, is lost.
+  std::string contents = GetFileContents(file.path());
+  contents[36] = 1;
+  constexpr size_t kTableBytes = 8 * 8;
+  std::fill(contents.end() - kTableBytes, contents.end(), '\0');
+  ASSERT_OK(FileUtil::SetContents(file.path(), contents));
+
+  LruStorage storage;
+  ASSERT_TRUE(storage.Open(file.path().c_str()));
+  EXPECT_EQ(storage.used_size(), 3);
+  EXPECT_EQ(storage.LookupAsString("1111"), "aaaa");
+  EXPECT_EQ(storage.LookupAsString("2222"), "bbbb");
+  EXPECT_EQ(storage.LookupAsString("3333"), "cccc");
+  std::vector<std::string> values;
+  storage.GetAllValues(&values);
+  EXPECT_THAT(values, ::testing::ElementsAre("cccc", "bbbb", "aaaa"));
+}
+
+TEST_F(LruStorageTest, RebuildIndexOfBrokenLinksAndTable) {
+  ScopedClockMock clock(absl::FromUnixSeconds(10000));
+
+  constexpr size_t kValueSize = 4;
+  constexpr size_t kNumElements = 4;
+  TempFile file(testing::MakeTempFileOrDie());
+  {
+    LruStorage storage;
+    ASSERT_TRUE(storage.OpenOrCreate(file.path().c_str(), kValueSize,
+                                     kNumElements, kSeed));
+    EXPECT_TRUE(storage.Insert("1111", "aaaa"));
+    clock->Advance(absl::Seconds(1));
+    EXPECT_TRUE(storage.Insert("2222", "bbbb"));
+    clock->Advance(absl::Seconds(1));
+    EXPECT_TRUE(storage.Insert("3333", "cccc"));
+  }
+  const std::string original = GetFileContents(file.path());
+
+  // The file is marked clean, but one of the links or the table slots refers
+  // to an item out of range.
+  constexpr size_t kLinksOffset =
+      40 + (LruStorage::kItemHeaderSize + kValueSize) * kNumElements;
+  constexpr size_t kTableOffset = kLinksOffset + 8 * kNumElements;
+  for (const size_t offset : {kLinksOffset + 8 * 2 + 4, kTableOffset + 8}) {
+    SCOPED_TRACE(offset);
+    std::string contents = original;
+    contents[offset] = 100;
+    ASSERT_OK(FileUtil::SetContents(file.path(), contents));
+
+    LruStorage storage;
+    ASSERT_TRUE(storage.Open(file.path().c_str()));
+    EXPECT_EQ(storage.used_size(), 3);
+    EXPECT_EQ(storage.LookupAsString("1111"), "aaaa");
+    EXPECT_EQ(storage.LookupAsString("2222"), "bbbb");
+    EXPECT_EQ(storage.LookupAsString("3333"), "cccc");
+    std::vector<std::string> values;
+    storage.GetAllValues(&values);
+    EXPECT_THAT(values, ::testing::ElementsAre("cccc", "bbbb", "aaaa"));
+  }
+}
+
+TEST_F(LruStorageTest, EvictAndDeleteKeepIndex) {
+  ScopedClockMock clock(absl::FromUnixSeconds(10000));
+
+  // Compares the storage with LruCache through random insertions and
+  // deletions, which move the items and the table entries around.
+  constexpr size_t kNumElements = 64;
+  TempFile file(testing::MakeTempFileOrDie());
+  LruStorage storage;
+  ASSERT_TRUE(
+      storage.OpenOrCreate(file.path().c_str(), 4, kNumElements, kSeed));
+  LruCache<std::string, uint32_t> cache(kNumElements);
+  Random random;
+  for (uint32_t i = 0; i < 10000; ++i) {
+    clock->Advance(absl::Seconds(1));
+    const std::string key = absl::StrFormat(
+        "%d", absl::Uniform<size_t>(random, 0, 3 * kNumElements));
+    if (absl::Bernoulli(random, 0.2)) {
+      EXPECT_TRUE(storage.Delete(key));
+      cache.Erase(key);
+    } else {
+      storage.Insert(key, reinterpret_cast<const char *>(&i));
+      cache.Insert(key, i);
+    }
+  }
+  EXPECT_EQ(storage.used_size(), cache.Size());
+  for (uint32_t k = 0; k < 3 * kNumElements; ++k) {
+    const std::string key = absl::StrFormat("%d", k);
+    const uint32_t *expected = cache.Lookup(key);
+    const char *actual = storage.Lookup(key);
+    if (expected == nullptr) {
+      EXPECT_EQ(actual, nullptr) << key;
+    } else {
+      ASSERT_NE(actual, nullptr) << key;
+      EXPECT_EQ(*reinterpret_cast<const uint32_t *>(actual), *expected) << key;
+    }
+  }
+}
+
 }  // namespace storage
 }  // namespace mozc
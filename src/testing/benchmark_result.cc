@@ -0,0 +1,69 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "testing/benchmark_result.h"
+
+#include <cstdint>
+#include <iostream>
+
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+namespace mozc {
+namespace testing {
+namespace {
+
+double PerOperation(double value, int64_t operations) {
+  return operations == 0 ? 0.0 : value / static_cast<double>(operations);
+}
+
+}  // namespace
+
+void PrintBenchmarkResult(absl::string_view name, absl::Duration elapsed,
+                          int64_t operations) {
+  std::cout << absl::StrFormat(
+                   "%-48s %12.3f ms %12.1f ns/op", name,
+                   absl::ToDoubleMilliseconds(elapsed),
+                   PerOperation(absl::ToDoubleNanoseconds(elapsed), operations))
+            << std::endl;
+}
+
+void PrintBenchmarkResult(absl::string_view name, absl::Duration elapsed,
+                          int64_t operations, int64_t allocations) {
+  std::cout << absl::StrFormat(
+                   "%-48s %12.3f ms %12.1f ns/op %8.2f allocs/op", name,
+                   absl::ToDoubleMilliseconds(elapsed),
+                   PerOperation(absl::ToDoubleNanoseconds(elapsed), operations),
+                   PerOperation(static_cast<double>(allocations), operations))
+            << std::endl;
+}
+
+}  // namespace testing
+}  // namespace mozc